@@ -0,0 +1,53 @@
+#include "allocationcounter.h"
+#include <cstddef>
+#include <cstdlib>
+
+namespace {
+// Zero-initialized, so it is usable from malloc before any constructor has run
+thread_local quint64 t_allocations = 0;
+}
+
+#if defined(__GLIBC__)
+
+extern "C" {
+void *__libc_malloc(std::size_t size) noexcept;
+void *__libc_calloc(std::size_t count, std::size_t size) noexcept;
+void *__libc_realloc(void *pointer, std::size_t size) noexcept;
+
+void *malloc(std::size_t size) noexcept
+{
+    ++t_allocations;
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept
+{
+    ++t_allocations;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size) noexcept
+{
+    ++t_allocations;
+    return __libc_realloc(pointer, size);
+}
+}
+
+bool AllocationCounter::isAvailable()
+{
+    return true;
+}
+
+#else
+
+bool AllocationCounter::isAvailable()
+{
+    return false;
+}
+
+#endif
+
+quint64 AllocationCounter::threadCount()
+{
+    return t_allocations;
+}
@@ -0,0 +1,24 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Counts heap allocations made by the calling thread
+ * 
+ * Linked into the benchmark executable only: it interposes malloc, calloc and realloc
+ * (and with them operator new) and forwards to the C library. Counting is available with
+ * glibc; elsewhere isAvailable() returns false and the count stays zero.
+ */
+namespace AllocationCounter {
+
+bool isAvailable();
+
+/**
+ * @brief Returns the number of allocations the calling thread has made so far
+ */
+quint64 threadCount();
+
+} // namespace AllocationCounter
+
+#endif // ALLOCATIONCOUNTER_H
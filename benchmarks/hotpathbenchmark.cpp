@@ -0,0 +1,414 @@
+#include <QtTest>
+#include <QEventLoop>
+#include <QHttpServerResponse>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "allocationcounter.h"
+#include "apiserver.h"
+#include "configmanager.h"
+#include "problemdetail.h"
+
+/**
+ * @brief The HotPathBenchmark class measures the components every request goes through
+ * 
+ * Run with "-o results.xml,xml" and convert with scripts/benchmarks-to-json.py to compare
+ * builds; the benchmarks-json target does both. allocationsPerRequest reports heap
+ * allocations instead of time, so that allocation regressions show up in the same results.
+ */
+class HotPathBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void problemDetailToJsonResponse();
+    void configGetter_data();
+    void configGetter();
+    void addSecurityHeaders();
+    void addCorsHeaders();
+    void isRateLimited_data();
+    void isRateLimited();
+    void allocationsPerRequest_data();
+    void allocationsPerRequest();
+};
+
+namespace {
+// Clients already tracked in the current rate limit window
+constexpr int RateLimitTableSize = 100000;
+
+// Calls per benchmark iteration, split across the contending threads
+constexpr int RateLimitCalls = 64000;
+
+// Requests that fill the per-thread pools and caches, and requests that are counted
+constexpr int WarmupRequests = 200;
+constexpr int MeasuredRequests = 2000;
+
+struct ConfigGetter
+{
+    const char *name;
+    std::function<void(const ConfigManager &)> call;
+};
+
+// Keeps the compiler from discarding a getter's result
+template <typename T>
+void consume(const T &value)
+{
+    static thread_local const void *sink = nullptr;
+    sink = &value;
+}
+
+#define CONFIG_GETTER(getter) ConfigGetter{#getter, [](const ConfigManager &config) { consume(config.getter()); }}
+
+const std::vector<ConfigGetter> &configGetters()
+{
+    static const std::vector<ConfigGetter> getters = {
+    CONFIG_GETTER(getPort),
+    CONFIG_GETTER(getAddress),
+    CONFIG_GETTER(getWorkers),
+    CONFIG_GETTER(isHttpRedirectEnabled),
+    CONFIG_GETTER(getHttpPort),
+    CONFIG_GETTER(getRedirectCanonicalHost),
+    CONFIG_GETTER(getRedirectAllowedHosts),
+    CONFIG_GETTER(isHttp2Enabled),
+    CONFIG_GETTER(getHttp2MaxConcurrentStreams),
+    CONFIG_GETTER(getHttp2StreamWindowSize),
+    CONFIG_GETTER(isHandoffEnabled),
+    CONFIG_GETTER(getHandoffSocketPath),
+    CONFIG_GETTER(getDrainTimeoutMs),
+    CONFIG_GETTER(isAdminEnabled),
+    CONFIG_GETTER(getAdminAllowedAddresses),
+    CONFIG_GETTER(getIdleTimeoutMs),
+    CONFIG_GETTER(getHeaderTimeoutMs),
+    CONFIG_GETTER(getRequestTimeoutMs),
+    CONFIG_GETTER(getMaxConnectionsPerIp),
+    CONFIG_GETTER(getMaxConnections),
+    CONFIG_GETTER(isRateLimitEnabled),
+    CONFIG_GETTER(getMaxRequestsPerMinute),
+    CONFIG_GETTER(getRateLimitIpWhitelist),
+    CONFIG_GETTER(isCorsEnabled),
+    CONFIG_GETTER(getAllowedOrigins),
+    CONFIG_GETTER(getAllowedMethods),
+    CONFIG_GETTER(getAllowedHeaders),
+    CONFIG_GETTER(getCorsMaxAge),
+    CONFIG_GETTER(isTlsEnabled),
+    CONFIG_GETTER(getCertificatePath),
+    CONFIG_GETTER(getKeyPath),
+    CONFIG_GETTER(getPassphrase),
+    CONFIG_GETTER(getContentTypeOptions),
+    CONFIG_GETTER(getFrameOptions),
+    CONFIG_GETTER(getContentSecurityPolicy),
+    CONFIG_GETTER(getPermissionsPolicy),
+    CONFIG_GETTER(getReferrerPolicy),
+    CONFIG_GETTER(getXssProtection),
+    CONFIG_GETTER(getHstsMaxAge),
+    CONFIG_GETTER(getHstsIncludeSubdomains),
+    CONFIG_GETTER(getCacheControl),
+    CONFIG_GETTER(getClearSiteData),
+    CONFIG_GETTER(getCrossOriginEmbedderPolicy),
+    CONFIG_GETTER(getCrossOriginOpenerPolicy),
+    CONFIG_GETTER(getCrossOriginResourcePolicy),
+    CONFIG_GETTER(getProblemBaseUrl),
+    CONFIG_GETTER(includeDebugInfo),
+    CONFIG_GETTER(getContactEmail),
+    CONFIG_GETTER(isMetricsEnabled),
+    CONFIG_GETTER(getMetricsAllowedAddresses),
+    CONFIG_GETTER(getServerTimingSampleRate),
+    CONFIG_GETTER(isTracingEnabled),
+    CONFIG_GETTER(getTracingSampleRate),
+    CONFIG_GETTER(getTracingExporter),
+    CONFIG_GETTER(getTracingFile),
+    CONFIG_GETTER(getTracingEndpoint),
+    CONFIG_GETTER(getTracingServiceName),
+    CONFIG_GETTER(getProxyRoutes),
+    CONFIG_GETTER(getProxyTimeoutMs),
+    CONFIG_GETTER(getProxyIdleTimeoutMs),
+    CONFIG_GETTER(getCircuitBreakerWindowSize),
+    CONFIG_GETTER(getCircuitBreakerMinimumCalls),
+    CONFIG_GETTER(getCircuitBreakerFailureRatePercent),
+    CONFIG_GETTER(getCircuitBreakerSlowCallMs),
+    CONFIG_GETTER(getCircuitBreakerSlowCallRatePercent),
+    CONFIG_GETTER(getCircuitBreakerOpenDurationMs),
+    CONFIG_GETTER(getCircuitBreakerHalfOpenProbes),
+    CONFIG_GETTER(getConcurrencyInitialLimit),
+    CONFIG_GETTER(getConcurrencyMinLimit),
+    CONFIG_GETTER(getConcurrencyMaxLimit),
+    CONFIG_GETTER(getConcurrencyBackoffPercent),
+    CONFIG_GETTER(getConcurrencyLatencyTolerancePercent),
+    CONFIG_GETTER(isResponseCacheEnabled),
+    CONFIG_GETTER(getResponseCacheMaxSizeMb),
+    CONFIG_GETTER(getResponseCacheShards),
+    CONFIG_GETTER(getResponseCacheCompressMinBytes),
+    CONFIG_GETTER(isAuthEnabled),
+    CONFIG_GETTER(getAuthJwksFile),
+    CONFIG_GETTER(getAuthIssuer),
+    CONFIG_GETTER(getAuthAudience),
+    CONFIG_GETTER(getAuthProtectedPrefixes),
+    CONFIG_GETTER(getAuthRequiredScopes),
+    CONFIG_GETTER(getAuthLeewaySeconds),
+    CONFIG_GETTER(getAuthCacheMaxEntries),
+    CONFIG_GETTER(getAuthCacheShards),
+    CONFIG_GETTER(getStaticFileMounts),
+    CONFIG_GETTER(getStaticFileMaxOpenFiles),
+    CONFIG_GETTER(getStaticFileRevalidateMs),
+    CONFIG_GETTER(getStaticFileStreamThresholdKb),
+    CONFIG_GETTER(getStaticFileMaxAgeSeconds),
+    CONFIG_GETTER(isIdempotencyEnabled),
+    CONFIG_GETTER(getIdempotencyTtlSeconds),
+    CONFIG_GETTER(getIdempotencyMaxEntries),
+    CONFIG_GETTER(getIdempotencyMaxSizeMb),
+    CONFIG_GETTER(getIdempotencyWaitTimeoutMs),
+    CONFIG_GETTER(isWebSocketEnabled),
+    CONFIG_GETTER(getWebSocketPort),
+    CONFIG_GETTER(getWebSocketPath),
+    CONFIG_GETTER(getWebSocketMaxConnections),
+    CONFIG_GETTER(getWebSocketMaxQueueKb),
+    CONFIG_GETTER(getWebSocketSlowConsumerPolicy),
+    CONFIG_GETTER(getWebSocketMaxMessageKb),
+    CONFIG_GETTER(getWebSocketMaxTopicsPerConnection),
+    CONFIG_GETTER(getWebSocketPingIntervalMs),
+    CONFIG_GETTER(isUnixSocketEnabled),
+    CONFIG_GETTER(getUnixSocketPath),
+    CONFIG_GETTER(getUnixSocketPermissions),
+    CONFIG_GETTER(isUnixSocketExclusive),
+    CONFIG_GETTER(isUnixSocketProxyProtocolEnabled),
+    CONFIG_GETTER(getUnixSocketHeaderTimeoutMs),
+    CONFIG_GETTER(getUnixSocketTrustedProxyHeader),
+    CONFIG_GETTER(getLogLevel),
+    CONFIG_GETTER(getLogFile),
+    CONFIG_GETTER(isConsoleLoggingEnabled),
+    CONFIG_GETTER(includeTimestamp),
+    CONFIG_GETTER(getLogMaxFileSizeMb),
+    CONFIG_GETTER(getLogMaxFiles),
+    };
+    return getters;
+}
+
+#undef CONFIG_GETTER
+
+// Sends requests one at a time over a keep-alive connection, reading each response fully
+bool sendRequests(quint16 port, const QByteArray &path, int count)
+{
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    if (!socket.waitForConnected(5000)) {
+        return false;
+    }
+    
+    const QByteArray request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    QByteArray buffer;
+    
+    for (int i = 0; i < count; ++i) {
+        socket.write(request);
+        
+        qsizetype headerEnd = -1;
+        qsizetype responseLength = -1;
+        while (responseLength < 0 || buffer.size() < responseLength) {
+            if (!socket.waitForReadyRead(5000)) {
+                return false;
+            }
+            buffer += socket.readAll();
+            
+            if (headerEnd < 0 && (headerEnd = buffer.indexOf("\r\n\r\n")) >= 0) {
+                qsizetype contentLength = 0;
+                const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+                for (const QByteArray &line : lines) {
+                    if (line.toLower().startsWith("content-length:")) {
+                        contentLength = line.mid(15).trimmed().toLongLong();
+                    }
+                }
+                responseLength = headerEnd + 4 + contentLength;
+            }
+        }
+        
+        buffer.remove(0, responseLength);
+    }
+    
+    return true;
+}
+
+// Runs the server's event loop until a client thread has sent its requests
+bool serveRequests(quint16 port, const QByteArray &path, int count)
+{
+    QEventLoop loop;
+    bool succeeded = false;
+    
+    std::thread client([&]() {
+        succeeded = sendRequests(port, path, count);
+        QMetaObject::invokeMethod(&loop, &QEventLoop::quit, Qt::QueuedConnection);
+    });
+    
+    loop.exec();
+    client.join();
+    
+    return succeeded;
+}
+
+QString clientAddress(int index)
+{
+    return QString("10.%1.%2.%3").arg((index >> 16) & 0xff).arg((index >> 8) & 0xff).arg(index & 0xff);
+}
+}
+
+void HotPathBenchmark::problemDetailToJsonResponse()
+{
+    ProblemDetail problem(404);
+    problem.setTitle("Not Found");
+    problem.setDetail("The requested resource '/api/missing' was not found");
+    problem.setInstance("/api/missing");
+    
+    QBENCHMARK {
+        QHttpServerResponse response = problem.toJsonResponse();
+        Q_UNUSED(response);
+    }
+}
+
+void HotPathBenchmark::configGetter_data()
+{
+    QTest::addColumn<int>("getter");
+    
+    const std::vector<ConfigGetter> &getters = configGetters();
+    for (int i = 0; i < static_cast<int>(getters.size()); ++i) {
+        QTest::newRow(getters[i].name) << i;
+    }
+}
+
+void HotPathBenchmark::configGetter()
+{
+    QFETCH(int, getter);
+    
+    ConfigManager config;
+    const ConfigGetter &configGetter = configGetters()[getter];
+    
+    QBENCHMARK {
+        configGetter.call(config);
+    }
+}
+
+void HotPathBenchmark::addSecurityHeaders()
+{
+    ApiServer server;
+    QHttpServerResponse response("text/plain", QByteArray("Hello World"));
+    
+    QBENCHMARK {
+        server.addSecurityHeaders(response);
+    }
+}
+
+void HotPathBenchmark::addCorsHeaders()
+{
+    ApiServer server;
+    server.setCorsEnabled(true, {"https://app.example.com"});
+    QHttpServerResponse response("text/plain", QByteArray("Hello World"));
+    
+    QBENCHMARK {
+        server.addCorsHeaders(response);
+    }
+}
+
+void HotPathBenchmark::isRateLimited_data()
+{
+    QTest::addColumn<int>("threads");
+    
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("16 threads") << 16;
+}
+
+void HotPathBenchmark::isRateLimited()
+{
+    QFETCH(int, threads);
+    
+    // High enough that no client is ever limited, so every call takes the same path
+    ApiServer server;
+    server.setRateLimit(1 << 30);
+    
+    QStringList clients;
+    clients.reserve(RateLimitTableSize);
+    for (int i = 0; i < RateLimitTableSize; ++i) {
+        clients.append(clientAddress(i));
+        server.m_clientRequests.insert(clients.last(), 1);
+    }
+    
+    // The workers are started once, so that thread creation is not part of the measurement;
+    // each benchmark iteration starts a round and waits for every worker to finish it
+    std::atomic<int> round{0};
+    std::atomic<int> finished{0};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<size_t>(threads));
+    
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&server, &clients, &round, &finished, &stop, t, threads]() {
+            int completed = 0;
+            for (;;) {
+                // Wait for the next round, so that the threads start together and actually contend
+                while (round.load() == completed && !stop.load()) {
+                    std::this_thread::yield();
+                }
+                if (stop.load()) {
+                    return;
+                }
+                completed = round.load();
+                
+                const int calls = RateLimitCalls / threads;
+                for (int i = 0; i < calls; ++i) {
+                    server.isRateLimited(clients.at((t * calls + i * 7919) % RateLimitTableSize));
+                }
+                finished.fetch_add(1);
+            }
+        });
+    }
+    
+    QBENCHMARK {
+        finished.store(0);
+        round.fetch_add(1);
+        while (finished.load() < threads) {
+            std::this_thread::yield();
+        }
+    }
+    
+    stop.store(true);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void HotPathBenchmark::allocationsPerRequest_data()
+{
+    QTest::addColumn<QByteArray>("path");
+    
+    QTest::newRow("text") << QByteArray("/");
+    QTest::newRow("json") << QByteArray("/api");
+    QTest::newRow("problem") << QByteArray("/api/missing");
+}
+
+void HotPathBenchmark::allocationsPerRequest()
+{
+    if (!AllocationCounter::isAvailable()) {
+        QSKIP("Counting allocations requires glibc");
+    }
+    
+    QFETCH(QByteArray, path);
+    
+    // Requests are served on this thread, so its allocations are the server's; the client
+    // runs on its own thread and is not counted
+    ApiServer server;
+    server.setRateLimit(1 << 30);
+    QVERIFY(server.listen(0));
+    const quint16 port = server.m_listeners.first()->serverPort();
+    
+    QVERIFY(serveRequests(port, path, WarmupRequests));
+    
+    const quint64 before = AllocationCounter::threadCount();
+    QVERIFY(serveRequests(port, path, MeasuredRequests));
+    const quint64 allocations = AllocationCounter::threadCount() - before;
+    
+    QTest::setBenchmarkResult(static_cast<qreal>(allocations) / MeasuredRequests, QTest::Events);
+}
+
+QTEST_GUILESS_MAIN(HotPathBenchmark)
+
+#include "hotpathbenchmark.moc"
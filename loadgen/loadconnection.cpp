@@ -0,0 +1,210 @@
+#include "loadconnection.h"
+#include <QSslSocket>
+#include <QTimer>
+
+namespace {
+// Back-off before reconnecting, so that a stopped server is not hammered with connects
+constexpr int ReconnectDelayMs = 100;
+}
+
+LoadConnection::LoadConnection(const LoadPlan &plan, bool overLimit, QObject *parent)
+    : QObject(parent),
+      m_plan(plan),
+      m_overLimit(overLimit),
+      m_stopped(false),
+      m_socket(nullptr)
+{
+}
+
+void LoadConnection::start()
+{
+    m_stopped = false;
+    connectSocket();
+}
+
+void LoadConnection::stop()
+{
+    m_stopped = true;
+    
+    if (m_socket) {
+        QTcpSocket *socket = m_socket;
+        m_socket = nullptr;
+        socket->abort();
+        socket->deleteLater();
+    }
+}
+
+bool LoadConnection::isOverLimit() const
+{
+    return m_overLimit;
+}
+
+bool LoadConnection::canSend() const
+{
+    return m_socket && m_socket->state() == QAbstractSocket::ConnectedState
+        && (!m_plan.tls || static_cast<QSslSocket *>(m_socket)->isEncrypted())
+        && m_inFlight.size() < m_plan.pipelineDepth;
+}
+
+void LoadConnection::send(const QByteArray &request, qint64 intendedNs)
+{
+    m_inFlight.enqueue(intendedNs);
+    m_socket->write(request);
+}
+
+void LoadConnection::connectSocket()
+{
+    QTcpSocket *socket = nullptr;
+    if (m_plan.tls) {
+        // The server under test normally has a self-signed certificate
+        auto *sslSocket = new QSslSocket(this);
+        sslSocket->setPeerVerifyMode(QSslSocket::VerifyNone);
+        connect(sslSocket, &QSslSocket::encrypted, this, &LoadConnection::onConnected);
+        socket = sslSocket;
+    } else {
+        socket = new QTcpSocket(this);
+        connect(socket, &QTcpSocket::connected, this, &LoadConnection::onConnected);
+    }
+    
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(socket, &QIODevice::readyRead, this, &LoadConnection::onReadyRead);
+    connect(socket, &QAbstractSocket::stateChanged, this, [this, socket](QAbstractSocket::SocketState state) {
+        // Covers both refused connects and connections closed by the server
+        if (state == QAbstractSocket::UnconnectedState && socket == m_socket) {
+            onDisconnected();
+        }
+    });
+    
+    m_socket = socket;
+    
+    if (m_overLimit) {
+        m_socket->bind(m_plan.overLimitSource);
+    }
+    
+    if (m_plan.tls) {
+        static_cast<QSslSocket *>(m_socket)->connectToHostEncrypted(m_plan.address.toString(), m_plan.port);
+    } else {
+        m_socket->connectToHost(m_plan.address, m_plan.port);
+    }
+}
+
+void LoadConnection::onConnected()
+{
+    emit ready(this);
+}
+
+void LoadConnection::onReadyRead()
+{
+    m_buffer += m_socket->readAll();
+    
+    bool closeConnection = false;
+    int statusCode = 0;
+    qint64 size = 0;
+    while ((size = completeResponseSize(statusCode, closeConnection)) > 0) {
+        m_buffer.remove(0, size);
+        
+        if (!m_inFlight.isEmpty()) {
+            emit responseReceived(this, statusCode, m_inFlight.dequeue());
+        }
+        
+        if (closeConnection) {
+            m_socket->disconnectFromHost();
+            return;
+        }
+    }
+    
+    if (canSend()) {
+        emit ready(this);
+    }
+}
+
+void LoadConnection::onDisconnected()
+{
+    const int lostRequests = m_inFlight.size();
+    m_inFlight.clear();
+    m_buffer.clear();
+    
+    m_socket->deleteLater();
+    m_socket = nullptr;
+    
+    emit failed(this, lostRequests);
+    
+    if (!m_stopped) {
+        QTimer::singleShot(lostRequests > 0 ? 0 : ReconnectDelayMs, this, [this]() {
+            if (!m_stopped && !m_socket) {
+                connectSocket();
+            }
+        });
+    }
+}
+
+qint64 LoadConnection::completeResponseSize(int &statusCode, bool &closeConnection) const
+{
+    const qint64 headerEnd = m_buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        return 0;
+    }
+    
+    // "HTTP/1.1 200 OK"
+    statusCode = m_buffer.mid(9, 3).toInt();
+    
+    qint64 contentLength = 0;
+    bool chunked = false;
+    closeConnection = false;
+    
+    qint64 lineStart = m_buffer.indexOf("\r\n") + 2;
+    while (lineStart < headerEnd) {
+        const qint64 lineEnd = m_buffer.indexOf("\r\n", lineStart);
+        const QByteArray line = m_buffer.mid(lineStart, lineEnd - lineStart);
+        const qint64 colon = line.indexOf(':');
+        if (colon > 0) {
+            const QByteArray name = line.left(colon).trimmed().toLower();
+            const QByteArray value = line.mid(colon + 1).trimmed().toLower();
+            if (name == "content-length") {
+                contentLength = value.toLongLong();
+            } else if (name == "transfer-encoding") {
+                chunked = value.contains("chunked");
+            } else if (name == "connection") {
+                closeConnection = value.contains("close");
+            }
+        }
+        lineStart = lineEnd + 2;
+    }
+    
+    const qint64 bodyStart = headerEnd + 4;
+    if (!chunked) {
+        const qint64 total = bodyStart + contentLength;
+        return total <= m_buffer.size() ? total : 0;
+    }
+    
+    // Chunked body: size lines followed by data, ending with a zero-size chunk
+    qint64 position = bodyStart;
+    while (true) {
+        const qint64 lineEnd = m_buffer.indexOf("\r\n", position);
+        if (lineEnd < 0) {
+            return 0;
+        }
+        
+        QByteArray sizeField = m_buffer.mid(position, lineEnd - position);
+        const qint64 extension = sizeField.indexOf(';');
+        if (extension >= 0) {
+            sizeField.truncate(extension);
+        }
+        const qint64 chunkSize = sizeField.trimmed().toLongLong(nullptr, 16);
+        position = lineEnd + 2;
+        
+        if (chunkSize == 0) {
+            // Optional trailers end with an empty line
+            if (m_buffer.mid(position, 2) == "\r\n") {
+                return position + 2;
+            }
+            const qint64 trailerEnd = m_buffer.indexOf("\r\n\r\n", position);
+            return trailerEnd < 0 ? 0 : trailerEnd + 4;
+        }
+        
+        position += chunkSize + 2;
+        if (position > m_buffer.size()) {
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef LOADCONNECTION_H
+#define LOADCONNECTION_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QQueue>
+#include <QTcpSocket>
+#include "loadplan.h"
+
+/**
+ * @brief The LoadConnection class is one keep-alive client connection of the load generator
+ * 
+ * Requests may be pipelined up to the plan's depth. Responses are parsed just far enough to
+ * find their status code and end (Content-Length or chunked encoding). Each request carries
+ * the time it was meant to be sent, which is reported with its response so that latency can
+ * be measured from the intended rather than the actual send time.
+ */
+class LoadConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    LoadConnection(const LoadPlan &plan, bool overLimit, QObject *parent = nullptr);
+    
+    /**
+     * @brief Connects, and reconnects whenever the server closes the connection
+     */
+    void start();
+    
+    /**
+     * @brief Stops sending and closes the connection
+     */
+    void stop();
+    
+    bool isOverLimit() const;
+    
+    /**
+     * @brief Returns true if the connection is open and has room in its pipeline
+     */
+    bool canSend() const;
+    
+    /**
+     * @brief Sends a pre-serialized request
+     * 
+     * @param request The request bytes
+     * @param intendedNs When the request was scheduled to be sent, on the worker's clock
+     */
+    void send(const QByteArray &request, qint64 intendedNs);
+
+signals:
+    void ready(LoadConnection *connection);
+    void responseReceived(LoadConnection *connection, int statusCode, qint64 intendedNs);
+    void failed(LoadConnection *connection, int lostRequests);
+
+private:
+    const LoadPlan &m_plan;
+    bool m_overLimit;
+    bool m_stopped;
+    QTcpSocket *m_socket;
+    QByteArray m_buffer;
+    QQueue<qint64> m_inFlight;
+    
+    void connectSocket();
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    
+    // Returns the size of the complete response at the start of the buffer, or 0 if incomplete
+    qint64 completeResponseSize(int &statusCode, bool &closeConnection) const;
+};
+
+#endif // LOADCONNECTION_H
@@ -0,0 +1,33 @@
+#ifndef LOADPLAN_H
+#define LOADPLAN_H
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+
+/**
+ * @brief One kind of request in the load mix, pre-serialized once
+ */
+struct RequestKind
+{
+    QByteArray name;
+    QByteArray request;
+    int weight = 0;
+};
+
+/**
+ * @brief The LoadPlan struct describes the traffic every worker thread generates
+ */
+struct LoadPlan
+{
+    QHostAddress address;
+    quint16 port = 8080;
+    bool tls = false;
+    int pipelineDepth = 1;         // Requests in flight per connection
+    double ratePerConnection = 0;  // Requests per second per connection; 0 runs closed-loop
+    QList<RequestKind> kinds;      // Sent by regular connections, picked by weight
+    RequestKind overLimitKind;     // Sent by the connections from the over-limit source address
+    QHostAddress overLimitSource;  // Second loopback address, so its requests are rate limited
+};
+
+#endif // LOADPLAN_H
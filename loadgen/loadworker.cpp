@@ -0,0 +1,141 @@
+#include "loadworker.h"
+#include "loadconnection.h"
+
+LoadWorker::LoadWorker(const LoadPlan &plan, int connections, int overLimitConnections, quint32 seed, QObject *parent)
+    : QObject(parent),
+      m_plan(plan),
+      m_pacer(this),
+      m_intervalNs(plan.ratePerConnection > 0 ? static_cast<qint64>(1e9 / plan.ratePerConnection) : 0),
+      m_running(false),
+      m_random(seed),
+      m_totalWeight(0),
+      m_completed(0),
+      m_errors(0),
+      m_reconnects(0)
+{
+    for (const RequestKind &kind : m_plan.kinds) {
+        m_totalWeight += kind.weight;
+    }
+    
+    for (int i = 0; i < connections; ++i) {
+        auto *connection = new LoadConnection(m_plan, i < overLimitConnections, this);
+        connect(connection, &LoadConnection::ready, this, &LoadWorker::fill);
+        connect(connection, &LoadConnection::responseReceived, this, &LoadWorker::onResponse);
+        connect(connection, &LoadConnection::failed, this, &LoadWorker::onFailed);
+        m_connections.append(connection);
+    }
+    
+    // Open-loop sends are released by a 1 ms pacer in addition to responses arriving
+    m_pacer.setInterval(1);
+    m_pacer.setTimerType(Qt::PreciseTimer);
+    connect(&m_pacer, &QTimer::timeout, this, &LoadWorker::onPace);
+}
+
+void LoadWorker::start()
+{
+    m_clock.start();
+    m_running = true;
+    
+    // Stagger the open-loop schedules so that the connections do not send in bursts
+    std::uniform_int_distribution<qint64> offset(0, qMax<qint64>(0, m_intervalNs - 1));
+    for (LoadConnection *connection : std::as_const(m_connections)) {
+        m_nextSendNs.insert(connection, offset(m_random));
+        connection->start();
+    }
+    
+    if (m_intervalNs > 0) {
+        m_pacer.start();
+    }
+}
+
+void LoadWorker::stop()
+{
+    m_running = false;
+    m_pacer.stop();
+    
+    for (LoadConnection *connection : std::as_const(m_connections)) {
+        connection->stop();
+    }
+}
+
+LoadWorker::Result LoadWorker::result() const
+{
+    Result result;
+    m_latencyUs.addTo(result.latencyUs);
+    result.statusCodes = m_statusCodes;
+    result.completed = m_completed;
+    result.errors = m_errors;
+    result.reconnects = m_reconnects;
+    return result;
+}
+
+const QByteArray &LoadWorker::pickRequest(const LoadConnection *connection)
+{
+    if (connection->isOverLimit() || m_totalWeight <= 0) {
+        return m_plan.overLimitKind.request;
+    }
+    
+    int pick = std::uniform_int_distribution<int>(0, m_totalWeight - 1)(m_random);
+    for (const RequestKind &kind : m_plan.kinds) {
+        if (pick < kind.weight) {
+            return kind.request;
+        }
+        pick -= kind.weight;
+    }
+    return m_plan.kinds.last().request;
+}
+
+void LoadWorker::fill(LoadConnection *connection)
+{
+    if (!m_running) {
+        return;
+    }
+    
+    const qint64 now = m_clock.nsecsElapsed();
+    
+    if (m_intervalNs <= 0) {
+        // Closed loop: keep the pipeline full
+        while (connection->canSend()) {
+            connection->send(pickRequest(connection), now);
+        }
+        return;
+    }
+    
+    // Open loop: send everything that is due. Requests that fell behind keep their
+    // original schedule, so their wait counts towards the measured latency.
+    qint64 &nextSendNs = m_nextSendNs[connection];
+    while (nextSendNs <= now && connection->canSend()) {
+        connection->send(pickRequest(connection), nextSendNs);
+        nextSendNs += m_intervalNs;
+    }
+}
+
+void LoadWorker::onPace()
+{
+    for (LoadConnection *connection : std::as_const(m_connections)) {
+        fill(connection);
+    }
+}
+
+void LoadWorker::onResponse(LoadConnection *connection, int statusCode, qint64 intendedNs)
+{
+    Q_UNUSED(connection);
+    
+    if (!m_running) {
+        return;
+    }
+    
+    m_latencyUs.record(static_cast<quint64>(qMax<qint64>(0, m_clock.nsecsElapsed() - intendedNs) / 1000));
+    m_statusCodes[statusCode]++;
+    m_completed++;
+}
+
+void LoadWorker::onFailed(LoadConnection *connection, int lostRequests)
+{
+    Q_UNUSED(connection);
+    
+    if (m_running) {
+        m_errors += static_cast<quint64>(lostRequests);
+        m_reconnects++;
+    }
+}
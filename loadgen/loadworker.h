@@ -0,0 +1,79 @@
+#ifndef LOADWORKER_H
+#define LOADWORKER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QTimer>
+#include <random>
+#include "latencyhistogram.h"
+#include "loadplan.h"
+
+class LoadConnection;
+
+/**
+ * @brief The LoadWorker class drives a share of the load generator's connections on one thread
+ * 
+ * In closed-loop mode every connection sends its next request as soon as its pipeline has room.
+ * In open-loop mode requests are scheduled at a fixed rate per connection, and latency is
+ * measured from the scheduled send time: a request that had to wait behind a slow response is
+ * charged for the wait, which corrects for coordinated omission.
+ */
+class LoadWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result
+    {
+        LatencyHistogram::Snapshot latencyUs;
+        QMap<int, quint64> statusCodes;
+        quint64 completed = 0;
+        quint64 errors = 0;      // Requests lost with a closed connection
+        quint64 reconnects = 0;  // Connections closed or refused by the server
+    };
+    
+    LoadWorker(const LoadPlan &plan, int connections, int overLimitConnections, quint32 seed, QObject *parent = nullptr);
+    
+    /**
+     * @brief Opens the connections and starts sending; call in the worker's thread
+     */
+    void start();
+    
+    /**
+     * @brief Stops sending and closes the connections; call in the worker's thread
+     */
+    void stop();
+    
+    /**
+     * @brief Returns the results so far; call in the worker's thread
+     */
+    Result result() const;
+
+private:
+    const LoadPlan &m_plan;
+    QList<LoadConnection *> m_connections;
+    QHash<LoadConnection *, qint64> m_nextSendNs;  // Open-loop schedule per connection
+    QElapsedTimer m_clock;
+    QTimer m_pacer;
+    qint64 m_intervalNs;
+    bool m_running;
+    std::mt19937 m_random;
+    int m_totalWeight;
+    
+    LatencyHistogram m_latencyUs;
+    QMap<int, quint64> m_statusCodes;
+    quint64 m_completed;
+    quint64 m_errors;
+    quint64 m_reconnects;
+    
+    const QByteArray &pickRequest(const LoadConnection *connection);
+    void fill(LoadConnection *connection);
+    void onPace();
+    void onResponse(LoadConnection *connection, int statusCode, qint64 intendedNs);
+    void onFailed(LoadConnection *connection, int lostRequests);
+};
+
+#endif // LOADWORKER_H
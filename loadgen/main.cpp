@@ -0,0 +1,208 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QHostAddress>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include "loadplan.h"
+#include "loadworker.h"
+
+namespace {
+QByteArray buildRequest(const QByteArray &method, const QByteArray &path, const QByteArray &host, const QByteArray &extraHeaders = QByteArray())
+{
+    return method + ' ' + path + " HTTP/1.1\r\nHost: " + host + "\r\nUser-Agent: qt6-web-api-loadgen\r\n" + extraHeaders + "\r\n";
+}
+
+// Parses "root=40,api=40,notfound=10,overlimit=5,preflight=5"
+bool parseMix(const QString &mix, QHash<QString, int> &weights)
+{
+    for (const QString &entry : mix.split(',', Qt::SkipEmptyParts)) {
+        const QStringList parts = entry.split('=');
+        bool ok = false;
+        const int weight = parts.value(1).toInt(&ok);
+        if (parts.size() != 2 || !ok || weight < 0 || !weights.contains(parts[0].trimmed())) {
+            return false;
+        }
+        weights[parts[0].trimmed()] = weight;
+    }
+    return true;
+}
+
+void printLatency(const char *label, quint64 microseconds)
+{
+    std::cout << "  " << std::left << std::setw(8) << label << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << microseconds / 1000.0 << " ms" << std::endl;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qt6-web-api-loadgen");
+    QCoreApplication::setApplicationVersion("1.0.0");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Load generator for the Qt6 Web API example; only targets localhost");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    
+    QCommandLineOption hostOption("host", "Loopback address of the server.", "address", "127.0.0.1");
+    QCommandLineOption portOption("port", "Server port.", "port", "8080");
+    QCommandLineOption tlsOption("tls", "Connect with TLS (certificates are not verified).");
+    QCommandLineOption connectionsOption({"c", "connections"}, "Total keep-alive connections.", "count", "64");
+    QCommandLineOption threadsOption({"t", "threads"}, "Worker threads.", "count", "4");
+    QCommandLineOption durationOption({"d", "duration"}, "Test duration in seconds.", "seconds", "10");
+    QCommandLineOption rateOption({"r", "rate"}, "Total requests per second (open loop); 0 runs closed-loop.", "rate", "0");
+    QCommandLineOption pipelineOption("pipeline", "Requests in flight per connection.", "depth", "1");
+    QCommandLineOption mixOption("mix", "Weighted request mix.", "mix", "root=40,api=40,notfound=10,overlimit=5,preflight=5");
+    
+    parser.addOptions({hostOption, portOption, tlsOption, connectionsOption, threadsOption,
+                       durationOption, rateOption, pipelineOption, mixOption});
+    parser.process(app);
+    
+    // Never generate load against anything but this machine
+    const QString host = parser.value(hostOption) == "localhost" ? QString("127.0.0.1") : parser.value(hostOption);
+    const QHostAddress address(host);
+    if (address.isNull() || !address.isLoopback()) {
+        std::cerr << "Error: --host must be a loopback address" << std::endl;
+        return 1;
+    }
+    
+    const int connections = parser.value(connectionsOption).toInt();
+    const int threads = qBound(1, parser.value(threadsOption).toInt(), qMax(1, connections));
+    const int duration = parser.value(durationOption).toInt();
+    const double rate = parser.value(rateOption).toDouble();
+    if (connections <= 0 || duration <= 0 || rate < 0) {
+        std::cerr << "Error: connections and duration must be positive and rate non-negative" << std::endl;
+        return 1;
+    }
+    
+    QHash<QString, int> weights{{"root", 0}, {"api", 0}, {"notfound", 0}, {"overlimit", 0}, {"preflight", 0}};
+    if (!parseMix(parser.value(mixOption), weights)) {
+        std::cerr << "Error: --mix entries must be name=weight with names root, api, notfound, overlimit, preflight" << std::endl;
+        return 1;
+    }
+    
+    LoadPlan plan;
+    plan.address = address;
+    plan.port = static_cast<quint16>(parser.value(portOption).toUInt());
+    plan.tls = parser.isSet(tlsOption);
+    plan.pipelineDepth = qMax(1, parser.value(pipelineOption).toInt());
+    plan.ratePerConnection = rate / connections;
+    
+    const QByteArray hostHeader = (address.protocol() == QAbstractSocket::IPv6Protocol ? '[' + host.toLatin1() + ']' : host.toLatin1())
+                                  + ':' + QByteArray::number(plan.port);
+    plan.kinds = {
+        {"root", buildRequest("GET", "/", hostHeader), weights["root"]},
+        {"api", buildRequest("GET", "/api", hostHeader), weights["api"]},
+        {"notfound", buildRequest("GET", "/does-not-exist", hostHeader), weights["notfound"]},
+        {"preflight", buildRequest("OPTIONS", "/api", hostHeader,
+                                   "Origin: https://app.example.com\r\nAccess-Control-Request-Method: POST\r\n"), weights["preflight"]}
+    };
+    
+    // Over-limit traffic comes from a second loopback address, which is not in the default
+    // rate limit whitelist; its share of the mix becomes its share of the connections
+    plan.overLimitKind = {"overlimit", buildRequest("GET", "/api", hostHeader), weights["overlimit"]};
+    plan.overLimitSource = address.protocol() == QAbstractSocket::IPv6Protocol ? QHostAddress::LocalHostIPv6 : QHostAddress("127.0.0.2");
+    
+    int totalWeight = 0;
+    for (int weight : std::as_const(weights)) {
+        totalWeight += weight;
+    }
+    if (totalWeight <= 0) {
+        std::cerr << "Error: the request mix is empty" << std::endl;
+        return 1;
+    }
+    int overLimitConnections = weights["overlimit"] > 0
+        ? qMax(1, static_cast<int>(static_cast<qint64>(connections) * weights["overlimit"] / totalWeight)) : 0;
+    if (overLimitConnections > 0 && plan.overLimitSource == QHostAddress::LocalHostIPv6) {
+        std::cerr << "Warning: IPv6 has a single loopback address, so over-limit connections are not separate clients" << std::endl;
+    }
+    if (totalWeight == weights["overlimit"]) {
+        overLimitConnections = connections;
+    }
+    
+    std::cout << "Running " << duration << " s against " << (plan.tls ? "https://" : "http://") << hostHeader.constData()
+              << " with " << connections << " connections on " << threads << " threads, pipeline depth " << plan.pipelineDepth;
+    if (rate > 0) {
+        std::cout << ", open loop at " << rate << " requests/s";
+    } else {
+        std::cout << ", closed loop";
+    }
+    std::cout << std::endl;
+    
+    // Spread the connections, including the over-limit ones, evenly over the threads
+    std::vector<std::unique_ptr<QThread>> workerThreads;
+    QList<LoadWorker *> workers;
+    for (int i = 0; i < threads; ++i) {
+        const int workerConnections = connections / threads + (i < connections % threads ? 1 : 0);
+        const int workerOverLimit = overLimitConnections / threads + (i < overLimitConnections % threads ? 1 : 0);
+        
+        auto thread = std::make_unique<QThread>();
+        auto *worker = new LoadWorker(plan, workerConnections, qMin(workerOverLimit, workerConnections), 0x9e3779b9u * (i + 1));
+        worker->moveToThread(thread.get());
+        QObject::connect(thread.get(), &QThread::finished, worker, &QObject::deleteLater);
+        thread->start();
+        
+        QMetaObject::invokeMethod(worker, &LoadWorker::start, Qt::QueuedConnection);
+        workers.append(worker);
+        workerThreads.push_back(std::move(thread));
+    }
+    
+    QElapsedTimer elapsed;
+    elapsed.start();
+    
+    QTimer::singleShot(duration * 1000, &app, [&]() {
+        const double seconds = elapsed.nsecsElapsed() / 1e9;
+        
+        LoadWorker::Result total;
+        for (LoadWorker *worker : std::as_const(workers)) {
+            LoadWorker::Result result;
+            QMetaObject::invokeMethod(worker, [worker, &result]() {
+                worker->stop();
+                result = worker->result();
+            }, Qt::BlockingQueuedConnection);
+            
+            total.latencyUs.merge(result.latencyUs);
+            for (auto it = result.statusCodes.cbegin(); it != result.statusCodes.cend(); ++it) {
+                total.statusCodes[it.key()] += it.value();
+            }
+            total.completed += result.completed;
+            total.errors += result.errors;
+            total.reconnects += result.reconnects;
+        }
+        
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Completed " << total.completed << " requests in " << seconds << " s: "
+                  << total.completed / seconds << " requests/s" << std::endl;
+        std::cout << "Lost requests: " << total.errors << ", reconnects: " << total.reconnects << std::endl;
+        
+        std::cout << "Status codes:";
+        for (auto it = total.statusCodes.cbegin(); it != total.statusCodes.cend(); ++it) {
+            std::cout << ' ' << it.key() << '=' << it.value();
+        }
+        std::cout << std::endl;
+        
+        std::cout << (rate > 0 ? "Latency (from scheduled send time, corrected for coordinated omission):"
+                               : "Latency (closed loop, not corrected for coordinated omission):") << std::endl;
+        if (total.latencyUs.count > 0) {
+            printLatency("mean", total.latencyUs.sum / total.latencyUs.count);
+        }
+        printLatency("p50", total.latencyUs.valueAtQuantile(0.50));
+        printLatency("p99", total.latencyUs.valueAtQuantile(0.99));
+        printLatency("p99.9", total.latencyUs.valueAtQuantile(0.999));
+        
+        for (const std::unique_ptr<QThread> &thread : workerThreads) {
+            thread->quit();
+            thread->wait();
+        }
+        
+        app.quit();
+    });
+    
+    return app.exec();
+}
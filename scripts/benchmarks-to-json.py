@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+"""Convert QtTest XML benchmark output into JSON for comparing builds.
+
+Usage:
+    ./benchmarks -o results.xml,xml
+    scripts/benchmarks-to-json.py results.xml > results.json
+"""
+
+import json
+import sys
+import xml.etree.ElementTree as ElementTree
+
+
+def convert(path):
+    root = ElementTree.parse(path).getroot()
+    results = []
+
+    for function in root.iter("TestFunction"):
+        for result in function.iter("BenchmarkResult"):
+            # QtTest reports the total over all iterations
+            total = float(result.get("value", "0"))
+            iterations = int(result.get("iterations", "1")) or 1
+            results.append({
+                "name": function.get("name"),
+                "tag": result.get("tag", ""),
+                "metric": result.get("metric"),
+                "iterations": iterations,
+                "total": total,
+                "perIteration": total / iterations,
+            })
+
+    return {
+        "testCase": root.get("name"),
+        "qtVersion": root.findtext("Environment/QtVersion", default=""),
+        "benchmarks": results,
+    }
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    json.dump(convert(sys.argv[1]), sys.stdout, indent=2)
+    sys.stdout.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,336 @@
+#include "accesslog.h"
+#include "metrics.h"
+#include "httpclock.h"
+#include "asciicopy.h"
+#include <QDateTime>
+#include <QMutexLocker>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+// The writer flushes at least this often, and as soon as a batch grows this large
+constexpr auto FlushInterval = std::chrono::milliseconds(50);
+constexpr int MaxBatchSize = 256 * 1024;
+
+void appendJsonString(QByteArray &out, const char *value)
+{
+    out += '"';
+    for (const char *c = value; *c; ++c) {
+        switch (*c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        default:
+            if (static_cast<unsigned char>(*c) < 0x20) {
+                out += "\\u00";
+                out += "0123456789abcdef"[(*c >> 4) & 0xf];
+                out += "0123456789abcdef"[*c & 0xf];
+            } else {
+                out += *c;
+            }
+            break;
+        }
+    }
+    out += '"';
+}
+
+const char *levelName(AccessLog::Level level)
+{
+    switch (level) {
+    case AccessLog::Level::Debug:
+        return "debug";
+    case AccessLog::Level::Warning:
+        return "warning";
+    case AccessLog::Level::Error:
+        return "error";
+    default:
+        return "info";
+    }
+}
+}
+
+AccessLog::AccessLog() = default;
+
+AccessLog &AccessLog::instance()
+{
+    static AccessLog accessLog;
+    return accessLog;
+}
+
+AccessLog::Level AccessLog::levelFromString(const QString &level)
+{
+    const QString normalized = level.trimmed().toLower();
+    if (normalized == "debug") {
+        return Level::Debug;
+    } else if (normalized == "warn" || normalized == "warning") {
+        return Level::Warning;
+    } else if (normalized == "error") {
+        return Level::Error;
+    }
+    return Level::Info;
+}
+
+void AccessLog::start(const Settings &settings)
+{
+    if (m_running.load()) {
+        return;
+    }
+
+    m_settings = settings;
+    m_minimumLevel.store(static_cast<int>(settings.level), std::memory_order_relaxed);
+
+    if (m_settings.console) {
+        m_console = std::make_unique<QFile>();
+        m_console->open(stdout, QIODevice::WriteOnly | QIODevice::Unbuffered);
+    }
+    openFile();
+
+    Metrics::instance().addCounter("access_log_dropped_records_total", "Log records dropped because a buffer was full.", [this]() {
+        return droppedCount();
+    });
+
+    m_running.store(true);
+    m_writer = std::thread(&AccessLog::run, this);
+}
+
+void AccessLog::stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+    }
+    m_wake.notify_all();
+    m_writer.join();
+
+    Metrics::instance().removeCounter("access_log_dropped_records_total");
+    m_file.reset();
+    m_console.reset();
+}
+
+void AccessLog::logRequest(const char *method, const QString &path, const QString &clientKey, int statusCode, quint64 latencyUs)
+{
+    if (!m_running.load(std::memory_order_relaxed) || m_minimumLevel.load(std::memory_order_relaxed) > static_cast<int>(Level::Info)) {
+        return;
+    }
+
+    Record record;
+    record.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    record.latencyUs = static_cast<quint32>(qMin<quint64>(latencyUs, 0xffffffffu));
+    record.statusCode = static_cast<quint16>(statusCode);
+    record.kind = Kind::Request;
+    record.level = Level::Info;
+    copyAscii(record.method, method);
+    copyAscii(record.client, clientKey);
+    copyAscii(record.text, path);
+
+    push(record);
+}
+
+void AccessLog::logEvent(Level level, const QString &message)
+{
+    if (!m_running.load(std::memory_order_relaxed) || m_minimumLevel.load(std::memory_order_relaxed) > static_cast<int>(level)) {
+        return;
+    }
+
+    Record record;
+    record.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    record.latencyUs = 0;
+    record.statusCode = 0;
+    record.kind = Kind::Event;
+    record.level = level;
+    record.method[0] = '\0';
+    record.client[0] = '\0';
+    copyAscii(record.text, message);
+
+    push(record);
+}
+
+quint64 AccessLog::droppedCount() const
+{
+    QMutexLocker locker(&m_ringsMutex);
+
+    quint64 dropped = 0;
+    for (const ThreadRing *threadRing : m_rings) {
+        dropped += threadRing->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+AccessLog::ThreadRing &AccessLog::localRing()
+{
+    // One ring per producing thread; rings live as long as the process so that a
+    // thread never writes into a ring that was freed
+    thread_local ThreadRing *threadRing = nullptr;
+
+    if (!threadRing) {
+        threadRing = new ThreadRing();
+
+        QMutexLocker locker(&m_ringsMutex);
+        m_rings.append(threadRing);
+    }
+
+    return *threadRing;
+}
+
+bool AccessLog::push(const Record &record)
+{
+    ThreadRing &threadRing = localRing();
+
+    if (!threadRing.ring.tryPush(record)) {
+        threadRing.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+void AccessLog::run()
+{
+    QByteArray batch;
+    batch.reserve(MaxBatchSize + 4096);
+
+    while (m_running.load()) {
+        // Keep writing full batches while the producers are ahead
+        while (drain(batch)) {
+            write(batch);
+            batch.clear();
+        }
+        if (!batch.isEmpty()) {
+            write(batch);
+            batch.clear();
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait_for(lock, FlushInterval, [this]() {
+            return !m_running.load();
+        });
+    }
+
+    // Write whatever is left on shutdown
+    while (drain(batch)) {
+        write(batch);
+        batch.clear();
+    }
+    write(batch);
+}
+
+bool AccessLog::drain(QByteArray &batch)
+{
+    QMutexLocker locker(&m_ringsMutex);
+    const QList<ThreadRing *> rings = m_rings;
+    locker.unlock();
+
+    Record record;
+    for (ThreadRing *threadRing : rings) {
+        while (threadRing->ring.tryPop(record)) {
+            format(record, batch);
+            if (batch.size() >= MaxBatchSize) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void AccessLog::format(const Record &record, QByteArray &out)
+{
+    out += '{';
+
+    if (m_settings.includeTimestamp) {
+        // Records arrive roughly in order, so the shared clock usually has this second formatted
+        const qint64 second = record.timestampMs / 1000;
+        if (m_lastStamp.epochSecond != second) {
+            m_lastStamp = HttpClock::instance().stampFor(second);
+        }
+
+        const int milliseconds = static_cast<int>(record.timestampMs % 1000);
+        char fraction[] = ".000Z\",";
+        fraction[1] = static_cast<char>('0' + milliseconds / 100);
+        fraction[2] = static_cast<char>('0' + milliseconds / 10 % 10);
+        fraction[3] = static_cast<char>('0' + milliseconds % 10);
+
+        out += "\"ts\":\"";
+        out.append(m_lastStamp.isoSecond, HttpClock::IsoSecondLength);
+        out += fraction;
+    }
+
+    if (record.kind == Kind::Request) {
+        out += "\"type\":\"request\",\"method\":";
+        appendJsonString(out, record.method);
+        out += ",\"path\":";
+        appendJsonString(out, record.text);
+        out += ",\"client\":";
+        appendJsonString(out, record.client);
+        out += ",\"status\":";
+        out += QByteArray::number(record.statusCode);
+        out += ",\"latencyUs\":";
+        out += QByteArray::number(record.latencyUs);
+    } else {
+        out += "\"type\":\"event\",\"level\":\"";
+        out += levelName(record.level);
+        out += "\",\"message\":";
+        appendJsonString(out, record.text);
+    }
+
+    out += "}\n";
+}
+
+void AccessLog::write(const QByteArray &batch)
+{
+    if (batch.isEmpty()) {
+        return;
+    }
+
+    if (m_console) {
+        m_console->write(batch);
+    }
+
+    if (m_file) {
+        m_file->write(batch);
+        if (m_settings.maxFileSize > 0 && m_file->size() >= m_settings.maxFileSize) {
+            rotate();
+        }
+    }
+}
+
+void AccessLog::openFile()
+{
+    m_file.reset();
+
+    if (m_settings.filePath.isEmpty()) {
+        return;
+    }
+
+    auto file = std::make_unique<QFile>(m_settings.filePath);
+    if (file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        m_file = std::move(file);
+    } else {
+        std::fprintf(stderr, "Warning: Failed to open log file %s\n", qPrintable(m_settings.filePath));
+    }
+}
+
+void AccessLog::rotate()
+{
+    m_file.reset();
+
+    // log -> log.1 -> log.2 ... up to maxFiles rotated files
+    const QString &path = m_settings.filePath;
+    QFile::remove(QString("%1.%2").arg(path).arg(m_settings.maxFiles));
+    for (int i = m_settings.maxFiles - 1; i >= 1; --i) {
+        QFile::rename(QString("%1.%2").arg(path).arg(i), QString("%1.%2").arg(path).arg(i + 1));
+    }
+    if (m_settings.maxFiles > 0) {
+        QFile::rename(path, path + ".1");
+    } else {
+        QFile::remove(path);
+    }
+
+    openFile();
+}
@@ -0,0 +1,140 @@
+#ifndef ACCESSLOG_H
+#define ACCESSLOG_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "spscring.h"
+#include "httpclock.h"
+
+/**
+ * @brief The AccessLog class writes structured access and event logs without blocking request threads
+ *
+ * Request threads copy fixed-size binary records into their own single-producer ring buffer.
+ * A background thread drains all rings, formats the records as JSON lines and writes them in
+ * large batches, rotating the log file by size. When a ring is full the record is dropped and
+ * counted instead of blocking the request thread.
+ */
+class AccessLog
+{
+public:
+    enum class Level : quint8 {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    struct Settings
+    {
+        Level level = Level::Info;
+        QString filePath;           // Empty: no log file
+        bool console = true;        // Also write to standard output
+        bool includeTimestamp = true;
+        qint64 maxFileSize = 100 * 1024 * 1024;
+        int maxFiles = 5;
+    };
+
+    /**
+     * @brief Returns the process-wide access log
+     */
+    static AccessLog &instance();
+
+    /**
+     * @brief Parses a level name ("debug", "info", "warn"/"warning", "error"), defaulting to info
+     */
+    static Level levelFromString(const QString &level);
+
+    /**
+     * @brief Starts the writer thread; records logged before start() are discarded
+     */
+    void start(const Settings &settings);
+
+    /**
+     * @brief Writes all pending records and stops the writer thread
+     */
+    void stop();
+
+    /**
+     * @brief Logs a handled request
+     *
+     * @param method The request method name
+     * @param path The request path, truncated if too long
+     * @param clientKey The client address key
+     * @param statusCode The response status code
+     * @param latencyUs The time taken to produce the response, in microseconds
+     */
+    void logRequest(const char *method, const QString &path, const QString &clientKey, int statusCode, quint64 latencyUs);
+
+    /**
+     * @brief Logs a server event
+     *
+     * @param level The event level
+     * @param message The event message, truncated if too long
+     */
+    void logEvent(Level level, const QString &message);
+
+    /**
+     * @brief Returns the number of records dropped because a ring buffer was full
+     */
+    quint64 droppedCount() const;
+
+private:
+    enum class Kind : quint8 {
+        Request,
+        Event
+    };
+
+    // Fixed-size record copied into the ring buffers; strings are truncated, not allocated
+    struct Record
+    {
+        qint64 timestampMs;
+        quint32 latencyUs;
+        quint16 statusCode;
+        Kind kind;
+        Level level;
+        char method[8];
+        char client[46];
+        char text[186];
+    };
+
+    static constexpr int RingCapacity = 4096;
+    using Ring = SpscRing<Record, RingCapacity>;
+
+    struct ThreadRing
+    {
+        Ring ring;
+        std::atomic<quint64> dropped{0};
+    };
+
+    Settings m_settings;
+    std::atomic<bool> m_running{false};
+    std::atomic<int> m_minimumLevel{static_cast<int>(Level::Info)};
+    mutable QMutex m_ringsMutex;  // Guards ring registration only
+    QList<ThreadRing *> m_rings;
+    std::thread m_writer;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::unique_ptr<QFile> m_file;
+    std::unique_ptr<QFile> m_console;
+    HttpClock::Stamp m_lastStamp;  // Writer thread only
+
+    AccessLog();
+    ThreadRing &localRing();
+    bool push(const Record &record);
+    void run();
+    bool drain(QByteArray &batch);
+    void format(const Record &record, QByteArray &out);
+    void write(const QByteArray &batch);
+    void openFile();
+    void rotate();
+};
+
+#endif // ACCESSLOG_H
@@ -1,33 +1,168 @@
 #include "apiserver.h"
 #include "problemdetail.h"
 #include "configmanager.h"
+#include "connectionmanager.h"
+#include "metrics.h"
+#include "accesslog.h"
+#include "httpclock.h"
+#include "stagetimer.h"
+#include "tracing.h"
+#include "eventloopmonitor.h"
+#include "processstats.h"
+#include "requestarena.h"
+#include "responsecache.h"
+#include "jsonschema.h"
+#include "unixsocketlistener.h"
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QString>
 #include <QFile>
+#include <QFileInfo>
 #include <QSslConfiguration>
+#include <QSslServer>
+#include <QSslSocket>
 #include <QSslKey>
 #include <QSslCertificate>
 #include <QHostAddress>
 #include <QNetworkInterface>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QMutexLocker>
 #include <QHostInfo>
+#include <QHttpHeaders>
+#include <QThreadPool>
+#include <QUrlQuery>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 9, 0)
+#include <QHttp2Configuration>
+#endif
+#include <algorithm>
+#include <functional>
+#include <vector>
 #include <stdexcept>
 
+namespace {
+// Load balancer probes, whose pre-built responses the after-request handler sends unchanged
+const QString LivenessProbePath = QStringLiteral("/livez");
+const QString ReadinessProbePath = QStringLiteral("/readyz");
+
+bool isHealthProbePath(const QString &path)
+{
+    return path == LivenessProbePath || path == ReadinessProbePath;
+}
+
+// Client address in a forwarding header (X-Forwarded-For, X-Real-IP or Forwarded). Only the
+// last entry is used: it was added by the trusted proxy, earlier ones are whatever the client sent.
+QHostAddress lastForwardedAddress(const QByteArray &value)
+{
+    QByteArray entry = value.mid(value.lastIndexOf(',') + 1).trimmed();
+    
+    // Forwarded (RFC 7239): for=192.0.2.60;proto=https or for="[2001:db8::1]:4711"
+    for (const QByteArray &parameter : entry.split(';')) {
+        const QByteArray trimmed = parameter.trimmed();
+        if (trimmed.size() > 4 && qstrnicmp(trimmed.constData(), "for=", 4) == 0) {
+            entry = trimmed.mid(4);
+        }
+    }
+    if (entry.size() >= 2 && entry.startsWith('"') && entry.endsWith('"')) {
+        entry = entry.mid(1, entry.size() - 2);
+    }
+    
+    // Strip the port: [IPv6]:port or IPv4:port
+    if (entry.startsWith('[')) {
+        const qsizetype end = entry.indexOf(']');
+        entry = end > 0 ? entry.mid(1, end - 1) : QByteArray();
+    } else if (entry.count(':') == 1) {
+        entry.truncate(entry.indexOf(':'));
+    }
+    
+    return QHostAddress(QString::fromLatin1(entry));
+}
+
+const char *methodName(QHttpServerRequest::Method method)
+{
+    switch (method) {
+    case QHttpServerRequest::Method::Get:
+        return "GET";
+    case QHttpServerRequest::Method::Put:
+        return "PUT";
+    case QHttpServerRequest::Method::Delete:
+        return "DELETE";
+    case QHttpServerRequest::Method::Post:
+        return "POST";
+    case QHttpServerRequest::Method::Head:
+        return "HEAD";
+    case QHttpServerRequest::Method::Options:
+        return "OPTIONS";
+    case QHttpServerRequest::Method::Patch:
+        return "PATCH";
+    case QHttpServerRequest::Method::Connect:
+        return "CONNECT";
+    case QHttpServerRequest::Method::Trace:
+        return "TRACE";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+// Accepts application/json and structured syntax suffixes such as application/problem+json
+bool isJsonMediaType(const QByteArray &contentType)
+{
+    const QByteArray mediaType = contentType.split(';').first().trimmed().toLower();
+    return mediaType == "application/json" || (mediaType.startsWith("application/") && mediaType.endsWith("+json"));
+}
+}
+
 ApiServer::ApiServer(QObject *parent)
     : QObject(parent), 
       m_server(new QHttpServer(this)),
       m_redirectServer(nullptr),
+      m_redirectThread(nullptr),
+      m_redirectContext(nullptr),
+      m_redirectListener(nullptr),
+      m_redirectConnectionManager(nullptr),
+      m_redirectLoopMonitor(nullptr),
       m_corsEnabled(false),
       m_corsAllowedOrigins({"*"}),
       m_rateLimit(100), // Default: 100 requests per minute
       m_problemBaseUrl("https://problemdetails.example.com/problems"),
       m_tlsEnabled(false),
       m_config(new ConfigManager()),
-      m_httpsPort(0)
+      m_httpsPort(0),
+      m_connectionManager(new ConnectionManager(this)),
+      m_unixProxyProtocol(false),
+      m_draining(false),
+      m_drainTimer(nullptr),
+      m_loopMonitor(new EventLoopMonitor(100, this)),
+      m_responseCache(new ResponseCache()),
+      m_reverseProxy(new ReverseProxy(this)),
+      m_authenticator(new JwtAuthenticator()),
+      m_authEnabled(false),
+      m_staticFiles(new StaticFiles()),
+      m_idempotency(new IdempotencyGuard(std::make_unique<MemoryIdempotencyStore>(10000, 16 * 1024 * 1024))),
+      m_idempotencyEnabled(true),
+      m_customIdempotencyStore(false),
+      m_webSockets(new WebSocketHub(this))
 {
+    applyConnectionLimits();
+    applyResponseCacheSettings();
+    applyAuthSettings();
+    applyIdempotencySettings();
+    applyWebSocketSettings();
+    applyUnixSocketSettings();
+    rebuildHeaderCache();
+    
+    m_webSockets->setAdmission([this](const QString &path, const QByteArray &authorization, const QHostAddress &peer) {
+        return admitWebSocket(path, authorization, peer);
+    });
+    m_reverseProxy->setConnectionAborter([this](const QHostAddress &peerAddress, quint16 peerPort) {
+        m_connectionManager->abort(peerAddress, peerPort);
+    });
+    
+    setupHealthRoutes();
     setupRoutes();
+    setupAdminRoutes();
+    setupMetricsRoute();
     setupErrorHandler();
     setupSecurityHeaders();
     
@@ -37,219 +172,1596 @@ ApiServer::ApiServer(QObject *parent)
     rateLimitTimer->start(60000); // 1 minute
 }
 
-ApiServer::~ApiServer()
+ApiServer::~ApiServer()
+{
+    Metrics::instance().removeGauge("rate_limit_table_size");
+    Metrics::instance().removeGauge("http_open_connections");
+    Metrics::instance().removeGauge("http_active_requests");
+    Metrics::instance().removeGauge("response_cache_bytes");
+    Metrics::instance().removeGauge("response_cache_entries");
+    Metrics::instance().removeCounter("response_cache_hits_total");
+    Metrics::instance().removeCounter("response_cache_misses_total");
+    Metrics::instance().removeCounter("response_cache_coalesced_total");
+    Metrics::instance().removeGauge("proxy_active_requests");
+    Metrics::instance().removeGauge("auth_token_cache_entries");
+    Metrics::instance().removeCounter("auth_token_cache_hits_total");
+    Metrics::instance().removeCounter("auth_token_cache_misses_total");
+    Metrics::instance().removeCounter("auth_rejected_requests_total");
+    Metrics::instance().removeGauge("static_files_open");
+    Metrics::instance().removeCounter("static_file_cache_hits_total");
+    Metrics::instance().removeCounter("static_file_cache_misses_total");
+    Metrics::instance().removeGauge("idempotency_keys");
+    Metrics::instance().removeCounter("idempotency_executed_total");
+    Metrics::instance().removeCounter("idempotency_replayed_total");
+    Metrics::instance().removeCounter("idempotency_conflicts_total");
+    Metrics::instance().removeGauge("websocket_connections");
+    Metrics::instance().removeGauge("websocket_topics");
+    Metrics::instance().removeCounter("websocket_messages_published_total");
+    Metrics::instance().removeCounter("websocket_frames_delivered_total");
+    Metrics::instance().removeCounter("websocket_frames_dropped_total");
+    Metrics::instance().removeCounter("websocket_slow_consumer_disconnects_total");
+    Metrics::instance().removeGauge("unix_socket_connections");
+    Metrics::instance().removeGauge("unix_socket_proxy_header_errors");
+    for (const QByteArray &name : std::as_const(m_upstreamGauges)) {
+        Metrics::instance().removeGauge(name);
+    }
+    for (const QByteArray &name : std::as_const(m_upstreamCounters)) {
+        Metrics::instance().removeCounter(name);
+    }
+    
+    stopHttpRedirect();
+    delete m_responseCache;
+    delete m_authenticator;
+    delete m_staticFiles;
+    delete m_idempotency;
+    delete m_config;
+}
+
+bool ApiServer::listen(int port, const QHostAddress &address)
+{
+    QTcpServer *tcpServer = createListener();
+    
+    if (!tcpServer->listen(address, port)) {
+        delete tcpServer;
+        return false;
+    }
+    
+    m_server->bind(tcpServer);
+    m_listeners.append(tcpServer);
+    m_httpsPort = port; // Store the HTTPS port for redirects
+    
+    return true;
+}
+
+bool ApiServer::listenOnDescriptor(qintptr socketDescriptor, int port)
+{
+    QTcpServer *tcpServer = createListener();
+    
+    // Adopt a listening socket that is already bound (socket activation or handoff)
+    if (!tcpServer->setSocketDescriptor(socketDescriptor)) {
+        delete tcpServer;
+        return false;
+    }
+    
+    m_server->bind(tcpServer);
+    m_listeners.append(tcpServer);
+    m_httpsPort = port; // Store the HTTPS port for redirects
+    
+    return true;
+}
+
+bool ApiServer::listenUnix(const QString &path, int permissions)
+{
+#if QT_CONFIG(localserver)
+    UnixSocketListener::Settings settings;
+    settings.proxyProtocol = m_config->isUnixSocketProxyProtocolEnabled();
+    settings.headerTimeoutMs = m_config->getUnixSocketHeaderTimeoutMs();
+    
+    // Not tracked by the connection manager: the peer is the trusted local proxy, which
+    // manages its own client connections
+    auto *listener = new UnixSocketListener(settings, this);
+    if (!listener->listenAt(path, permissions)) {
+        delete listener;
+        return false;
+    }
+    
+    m_server->bind(listener);
+    m_unixListeners.append(listener);
+    m_unixProxyProtocol = settings.proxyProtocol;
+    
+    return true;
+#else
+    Q_UNUSED(permissions);
+    AccessLog::instance().logEvent(AccessLog::Level::Warning,
+                                   QString("Cannot listen on %1: Qt was built without local socket support").arg(path));
+    return false;
+#endif
+}
+
+QHash<QString, qintptr> ApiServer::listenerDescriptors() const
+{
+    QHash<QString, qintptr> descriptors;
+    
+    if (!m_listeners.isEmpty() && m_listeners.first()->isListening()) {
+        descriptors.insert("api", m_listeners.first()->socketDescriptor());
+    }
+    
+    if (m_redirectListener && m_redirectListener->isListening()) {
+        descriptors.insert("redirect", m_redirectListener->socketDescriptor());
+    }
+    
+    return descriptors;
+}
+
+void ApiServer::stopAccepting()
+{
+    // Queued connections stay in the shared listen backlog for whichever
+    // process still holds the socket
+    for (QTcpServer *tcpServer : std::as_const(m_listeners)) {
+        tcpServer->close();
+    }
+    
+    if (m_redirectListener) {
+        QMetaObject::invokeMethod(m_redirectListener, &QTcpServer::close, Qt::BlockingQueuedConnection);
+    }
+    
+    // The socket file is left in place if a new instance has already replaced it
+    for (UnixSocketListener *listener : std::as_const(m_unixListeners)) {
+        listener->stop();
+    }
+    
+    m_webSockets->stopAccepting();
+}
+
+int ApiServer::activeRequestCount() const
+{
+    // The redirect manager lives in the worker thread; its counts are atomics
+    int count = m_connectionManager->activeRequestCount();
+    if (m_redirectConnectionManager) {
+        count += m_redirectConnectionManager->activeRequestCount();
+    }
+    for (const UnixSocketListener *listener : std::as_const(m_unixListeners)) {
+        count += listener->activeRequestCount();
+    }
+    return count;
+}
+
+void ApiServer::drain()
+{
+    if (m_draining) {
+        return;
+    }
+    
+    m_draining = true;
+    stopAccepting();
+    
+    // WebSocket clients are asked to reconnect elsewhere ("going away")
+    m_webSockets->closeAll(1001);
+    AccessLog::instance().logEvent(AccessLog::Level::Info, "Draining: stopped accepting new connections");
+    
+    // Give up on requests still in progress when the deadline passes
+    const int drainTimeoutMs = m_config ? m_config->getDrainTimeoutMs() : 30000;
+    m_drainTimer = new QTimer(this);
+    m_drainTimer->setSingleShot(true);
+    connect(m_drainTimer, &QTimer::timeout, this, &ApiServer::finishDrain);
+    m_drainTimer->start(drainTimeoutMs);
+    
+    // Every manager reports drained on its own; finish once none has a request left
+    connect(m_connectionManager, &ConnectionManager::drained, this, &ApiServer::checkDrained, Qt::QueuedConnection);
+    m_connectionManager->startDraining();
+    
+    if (m_redirectConnectionManager) {
+        connect(m_redirectConnectionManager, &ConnectionManager::drained, this, &ApiServer::checkDrained, Qt::QueuedConnection);
+        QMetaObject::invokeMethod(m_redirectConnectionManager, &ConnectionManager::startDraining, Qt::QueuedConnection);
+    }
+    
+    // With an exclusive Unix socket these are the only connections there are
+    for (UnixSocketListener *listener : std::as_const(m_unixListeners)) {
+        connect(listener, &UnixSocketListener::drained, this, &ApiServer::checkDrained, Qt::QueuedConnection);
+        listener->startDraining();
+    }
+}
+
+bool ApiServer::isDraining() const
+{
+    return m_draining;
+}
+
+void ApiServer::checkDrained()
+{
+    if (activeRequestCount() == 0) {
+        finishDrain();
+    }
+}
+
+void ApiServer::finishDrain()
+{
+    if (!m_drainTimer) {
+        return;
+    }
+
+    m_drainTimer->stop();
+    m_drainTimer->deleteLater();
+    m_drainTimer = nullptr;
+
+    AccessLog::instance().logEvent(AccessLog::Level::Info,
+                                   QString("Drain finished with %1 request(s) still in progress").arg(activeRequestCount()));
+    emit drained();
+}
+
+bool ApiServer::listenWebSocket(int port, const QHostAddress &address)
+{
+    // Not tracked by the connection manager: its idle and request timeouts would cut off
+    // long-lived subscriptions, which the hub keeps alive with pings instead
+    QTcpServer *listener = nullptr;
+    if (m_tlsEnabled) {
+        auto *sslServer = new QSslServer(this);
+        sslServer->setSslConfiguration(m_sslConfiguration);
+        listener = sslServer;
+    } else {
+        listener = new QTcpServer(this);
+    }
+    
+    if (!listener->listen(address, port)) {
+        delete listener;
+        return false;
+    }
+    
+    m_webSockets->attach(listener);
+    return true;
+}
+
+int ApiServer::publish(const QString &topic, const QByteArray &payload, bool binary)
+{
+    return m_webSockets->publish(topic, payload, binary);
+}
+
+QTcpServer *ApiServer::createListener()
+{
+    // Create the listener ourselves so every accepted connection is tracked
+    // by the connection manager before QHttpServer takes it over
+    QTcpServer *tcpServer = nullptr;
+    
+    if (m_tlsEnabled) {
+        auto *sslServer = new QSslServer(this);
+        sslServer->setSslConfiguration(m_sslConfiguration);
+        connect(sslServer, &QSslServer::startedEncryptionHandshake, this, [this](QSslSocket *socket) {
+            Metrics::instance().recordHandshake(Metrics::HandshakeResult::Started);
+            connect(socket, &QSslSocket::encrypted, this, []() {
+                Metrics::instance().recordHandshake(Metrics::HandshakeResult::Completed);
+            });
+            
+            if (!m_connectionManager->track(socket)) {
+                // Defer the close until QSslServer has finished setting up the socket
+                QMetaObject::invokeMethod(socket, &QAbstractSocket::abort, Qt::QueuedConnection);
+            }
+        });
+        connect(sslServer, &QSslServer::handshakeInterruptedOnError, this, []() {
+            Metrics::instance().recordHandshake(Metrics::HandshakeResult::Failed);
+        });
+        tcpServer = sslServer;
+    } else {
+        tcpServer = new ManagedTcpServer(m_connectionManager, this);
+    }
+    
+    return tcpServer;
+}
+
+bool ApiServer::listenHttpRedirect(int httpPort, int httpsPort, qintptr socketDescriptor)
+{
+    if (!m_tlsEnabled) {
+        // Only set up HTTP redirects if TLS is enabled
+        return false;
+    }
+    
+    stopHttpRedirect();
+    m_httpsPort = httpsPort;
+    
+    // Run the redirect server on its own thread so that redirect floods on the
+    // plaintext port cannot starve the HTTPS event loop
+    m_redirectThread = new QThread(this);
+    m_redirectThread->setObjectName("http-redirect");
+    m_redirectContext = new QObject();
+    m_redirectContext->moveToThread(m_redirectThread);
+    connect(m_redirectThread, &QThread::finished, m_redirectContext, &QObject::deleteLater);
+    m_redirectThread->start();
+    
+    // Create and bind the redirect server objects inside the worker thread
+    bool listening = false;
+    const ConnectionManager::Limits limits = m_connectionManager->limits();
+    QMetaObject::invokeMethod(m_redirectContext, [this, httpPort, httpsPort, socketDescriptor, limits, &listening]() {
+        m_redirectServer = new QHttpServer(m_redirectContext);
+        
+        // Set up the redirect server to handle all routes
+        setupHttpsRedirect(httpPort, httpsPort);
+        
+        auto *connectionManager = new ConnectionManager(m_redirectContext);
+        connectionManager->setLimits(limits);
+        m_redirectConnectionManager = connectionManager;
+        m_redirectLoopMonitor = new EventLoopMonitor(100, m_redirectContext);
+        
+        auto *tcpServer = new ManagedTcpServer(connectionManager, m_redirectContext);
+        if (socketDescriptor >= 0) {
+            listening = tcpServer->setSocketDescriptor(socketDescriptor);
+        } else {
+            listening = tcpServer->listen(QHostAddress::Any, httpPort);
+        }
+        
+        if (listening) {
+            m_redirectServer->bind(tcpServer);
+            m_redirectListener = tcpServer;
+        }
+    }, Qt::BlockingQueuedConnection);
+    
+    if (!listening) {
+        stopHttpRedirect();
+    }
+    
+    return listening;
+}
+
+void ApiServer::stopHttpRedirect()
+{
+    if (!m_redirectThread) {
+        return;
+    }
+    
+    // The redirect server objects are deleted with their context when the thread finishes
+    m_redirectThread->quit();
+    m_redirectThread->wait();
+    delete m_redirectThread;
+    
+    m_redirectThread = nullptr;
+    m_redirectContext = nullptr;
+    m_redirectServer = nullptr;
+    m_redirectListener = nullptr;
+    m_redirectConnectionManager = nullptr;
+    m_redirectLoopMonitor = nullptr;
+}
+
+bool ApiServer::enableTls(const QString &certPath, const QString &keyPath, const QString &keyPassphrase)
+{
+    QFile certFile(certPath);
+    QFile keyFile(keyPath);
+    
+    if (!certFile.open(QIODevice::ReadOnly) || !keyFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    // The certificate file may hold a full chain (e.g. Let's Encrypt fullchain.pem):
+    // the leaf certificate comes first, followed by any intermediates
+    const QList<QSslCertificate> certificateChain = QSslCertificate::fromData(certFile.readAll(), QSsl::Pem);
+    const QSslKey key = loadPrivateKey(keyFile.readAll(), keyPassphrase.toUtf8());
+    
+    certFile.close();
+    keyFile.close();
+    
+    if (certificateChain.isEmpty() || certificateChain.first().isNull() || key.isNull()) {
+        return false;
+    }
+    
+    // The private key must match the algorithm of the leaf certificate
+    if (certificateChain.first().publicKey().algorithm() != key.algorithm()) {
+        return false;
+    }
+    
+    QSslConfiguration sslConfig;
+    sslConfig.setLocalCertificateChain(certificateChain);
+    sslConfig.setPrivateKey(key);
+    sslConfig.setProtocol(QSsl::TlsV1_3OrLater);
+    
+    // Advertise HTTP/2 via ALPN so browsers multiplex requests over a single connection
+    // instead of opening one TLS connection per parallel request
+    if (m_config && m_config->isHttp2Enabled()) {
+        sslConfig.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2,
+                                           QSslConfiguration::NextProtocolHttp1_1});
+        setupHttp2();
+    }
+    
+    // Applied to the QSslServer created in listen()
+    m_sslConfiguration = sslConfig;
+    m_tlsEnabled = true;
+    rebuildHeaderCache();
+    
+    return true;
+}
+
+void ApiServer::setupHttp2()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 9, 0)
+    // HTTP/2 streams are served by the same routes and after-request handlers as HTTP/1.1;
+    // only the flow control limits need configuring
+    QHttp2Configuration http2Config = m_server->http2Configuration();
+    
+    if (m_config->getHttp2MaxConcurrentStreams() > 0) {
+        http2Config.setMaxConcurrentStreams(m_config->getHttp2MaxConcurrentStreams());
+    }
+    
+    if (m_config->getHttp2StreamWindowSize() > 0) {
+        http2Config.setStreamReceiveWindowSize(m_config->getHttp2StreamWindowSize());
+    }
+    
+    m_server->setHttp2Configuration(http2Config);
+#endif
+}
+
+QSslKey ApiServer::loadPrivateKey(const QByteArray &pemData, const QByteArray &passphrase)
+{
+    // Traditional PEM headers name the key algorithm; PKCS#8 ("BEGIN PRIVATE KEY" or
+    // "BEGIN ENCRYPTED PRIVATE KEY") does not, so try each supported algorithm in turn,
+    // starting with EC as the preferred choice for cheaper handshakes
+    QList<QSsl::KeyAlgorithm> candidates;
+    if (pemData.contains("BEGIN RSA PRIVATE KEY")) {
+        candidates = {QSsl::Rsa};
+    } else if (pemData.contains("BEGIN EC PRIVATE KEY")) {
+        candidates = {QSsl::Ec};
+    } else if (pemData.contains("BEGIN DSA PRIVATE KEY")) {
+        candidates = {QSsl::Dsa};
+    } else {
+        candidates = {QSsl::Ec, QSsl::Rsa, QSsl::Dsa};
+    }
+    
+    for (const QSsl::KeyAlgorithm algorithm : candidates) {
+        QSslKey key(pemData, algorithm, QSsl::Pem, QSsl::PrivateKey, passphrase);
+        if (!key.isNull()) {
+            return key;
+        }
+    }
+    
+    return QSslKey();
+}
+
+void ApiServer::setCorsEnabled(bool enabled, const QStringList &allowedOrigins)
+{
+    m_corsEnabled = enabled;
+    m_corsAllowedOrigins = allowedOrigins;
+    rebuildHeaderCache();
+    applyWebSocketSettings();
+}
+
+void ApiServer::setRateLimit(int maxRequestsPerMinute)
+{
+    m_rateLimit = maxRequestsPerMinute;
+}
+
+void ApiServer::setProblemBaseUrl(const QString &baseUrl)
+{
+    m_problemBaseUrl = baseUrl;
+    ProblemDetail::setDefaultBaseUrl(baseUrl);
+}
+
+void ApiServer::setConfig(ConfigManager *config)
+{
+    if (m_config) {
+        delete m_config;
+    }
+    m_config = config;
+    applyConnectionLimits();
+    applyResponseCacheSettings();
+    applyAuthSettings();
+    applyIdempotencySettings();
+    applyWebSocketSettings();
+    applyUnixSocketSettings();
+    rebuildHeaderCache();
+    setupProxyRoutes();
+    setupStaticRoutes();
+}
+
+void ApiServer::setIdempotencyStore(std::unique_ptr<IdempotencyStore> store)
+{
+    m_idempotency->setStore(std::move(store));
+    m_customIdempotencyStore = true;
+}
+
+void ApiServer::applyConnectionLimits()
+{
+    if (!m_config) {
+        return;
+    }
+    
+    ConnectionManager::Limits limits;
+    limits.idleTimeoutMs = m_config->getIdleTimeoutMs();
+    limits.headerTimeoutMs = m_config->getHeaderTimeoutMs();
+    limits.requestTimeoutMs = m_config->getRequestTimeoutMs();
+    limits.maxConnectionsPerIp = m_config->getMaxConnectionsPerIp();
+    limits.maxConnections = m_config->getMaxConnections();
+    
+    // Whitelisted clients (e.g. a local reverse proxy) are exempt from the per-IP cap
+    limits.exemptClients = m_config->getRateLimitIpWhitelist();
+    
+    m_connectionManager->setLimits(limits);
+}
+
+void ApiServer::applyResponseCacheSettings()
+{
+    if (!m_config) {
+        return;
+    }
+    
+    ResponseCache::Settings settings;
+    settings.maxBytes = static_cast<qint64>(m_config->getResponseCacheMaxSizeMb()) * 1024 * 1024;
+    settings.shardCount = m_config->getResponseCacheShards();
+    settings.compressMinBytes = m_config->getResponseCacheCompressMinBytes();
+    m_responseCache->setSettings(settings);
+}
+
+void ApiServer::applyIdempotencySettings()
+{
+    if (!m_config) {
+        return;
+    }
+    
+    m_idempotencyEnabled = m_config->isIdempotencyEnabled();
+    
+    IdempotencyGuard::Settings settings;
+    settings.ttlSeconds = m_config->getIdempotencyTtlSeconds();
+    settings.waitTimeoutMs = m_config->getIdempotencyWaitTimeoutMs();
+    m_idempotency->setSettings(settings);
+    
+    if (!m_customIdempotencyStore) {
+        const qint64 maxBytes = static_cast<qint64>(m_config->getIdempotencyMaxSizeMb()) * 1024 * 1024;
+        m_idempotency->setStore(std::make_unique<MemoryIdempotencyStore>(m_config->getIdempotencyMaxEntries(), maxBytes));
+    }
+}
+
+void ApiServer::applyAuthSettings()
+{
+    if (!m_config) {
+        return;
+    }
+    
+    m_authEnabled = m_config->isAuthEnabled();
+    m_authPrefixes.clear();
+    for (QString prefix : m_config->getAuthProtectedPrefixes()) {
+        while (prefix.endsWith('/')) {
+            prefix.chop(1);
+        }
+        m_authPrefixes.append(prefix);
+    }
+    
+    if (!m_authEnabled) {
+        return;
+    }
+    
+    JwtAuthenticator::Settings settings;
+    settings.jwksFile = m_config->getAuthJwksFile();
+    settings.issuer = m_config->getAuthIssuer();
+    settings.audience = m_config->getAuthAudience();
+    settings.requiredScopes = m_config->getAuthRequiredScopes();
+    settings.leewaySeconds = m_config->getAuthLeewaySeconds();
+    settings.cacheMaxEntries = m_config->getAuthCacheMaxEntries();
+    settings.cacheShards = m_config->getAuthCacheShards();
+    
+    // Fail closed: without keys every protected request is answered with a 401
+    QString error;
+    if (!m_authenticator->configure(settings, &error)) {
+        AccessLog::instance().logEvent(AccessLog::Level::Warning,
+                                       QString("Authentication is enabled but no token can be accepted: %1").arg(error));
+    }
+}
+
+bool ApiServer::requiresAuthentication(const QHttpServerRequest &request) const
+{
+    // CORS preflight requests never carry credentials
+    if (request.method() == QHttpServerRequest::Method::Options) {
+        return false;
+    }
+    
+    return isProtectedPath(request.url().path());
+}
+
+bool ApiServer::isProtectedPath(const QString &path) const
+{
+    if (!m_authEnabled) {
+        return false;
+    }
+    
+    for (const QString &prefix : m_authPrefixes) {
+        if (prefix.isEmpty() || path == prefix
+            || (path.startsWith(prefix) && path.at(prefix.size()) == QLatin1Char('/'))) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+QHttpServerResponse ApiServer::createAuthFailureResponse(const JwtAuthenticator::Result &result, const QHttpServerRequest &request)
+{
+    // RFC 6750: no error code when no token was sent, invalid_token for a rejected token
+    // and insufficient_scope (403) for a valid token without the required scopes
+    const bool forbidden = result.status == JwtAuthenticator::Status::InsufficientScope;
+    
+    ProblemDetail problem(forbidden ? 403 : 401);
+    problem.setDetail(result.detail);
+    problem.setInstance(request.url().path());
+    
+    auto response = problem.toJsonResponse();
+    QHttpHeaders headers = response.headers();
+    headers.replaceOrAppend("WWW-Authenticate", authChallenge(result));
+    response.setHeaders(std::move(headers));
+    
+    // Add CORS headers if enabled
+    addCorsHeaders(response);
+    
+    // Add OWASP recommended security headers
+    addSecurityHeaders(response);
+    
+    return response;
+}
+
+QByteArray ApiServer::authChallenge(const JwtAuthenticator::Result &result) const
+{
+    // RFC 6750: no error code when no token was sent, invalid_token for a rejected token
+    // and insufficient_scope for a valid token without the required scopes
+    QByteArray challenge = QByteArrayLiteral("Bearer realm=\"api\"");
+    if (result.status == JwtAuthenticator::Status::InsufficientScope) {
+        challenge += ", error=\"insufficient_scope\", scope=\"";
+        challenge += m_config->getAuthRequiredScopes().join(' ').toUtf8();
+        challenge += '"';
+    } else if (result.status != JwtAuthenticator::Status::Missing) {
+        challenge += ", error=\"invalid_token\"";
+    }
+    return challenge;
+}
+
+void ApiServer::applyWebSocketSettings()
+{
+    if (!m_config) {
+        return;
+    }
+    
+    WebSocketHub::Settings settings;
+    settings.path = m_config->getWebSocketPath();
+    settings.maxConnections = m_config->getWebSocketMaxConnections();
+    
+    // The per-client cap and header timeout of server.connections apply to WebSocket clients too
+    settings.maxConnectionsPerIp = m_config->getMaxConnectionsPerIp();
+    settings.exemptClients = m_config->getRateLimitIpWhitelist();
+    settings.handshakeTimeoutMs = m_config->getHeaderTimeoutMs();
+    settings.maxQueueBytes = static_cast<qint64>(m_config->getWebSocketMaxQueueKb()) * 1024;
+    settings.slowConsumerPolicy = m_config->getWebSocketSlowConsumerPolicy() == "disconnect"
+        ? WebSocketHub::SlowConsumerPolicy::Disconnect
+        : WebSocketHub::SlowConsumerPolicy::Drop;
+    settings.maxMessageBytes = m_config->getWebSocketMaxMessageKb() * 1024;
+    settings.maxTopicsPerConnection = m_config->getWebSocketMaxTopicsPerConnection();
+    settings.pingIntervalMs = m_config->getWebSocketPingIntervalMs();
+    
+    // Browser pages may connect from the origins allowed by CORS
+    settings.allowedOrigins = m_corsEnabled ? m_corsAllowedOrigins : QStringList{"*"};
+    
+    m_webSockets->setSettings(settings);
+}
+
+void ApiServer::applyUnixSocketSettings()
+{
+    if (!m_config) {
+        return;
+    }
+    
+    m_trustedProxyHeader = m_config->getUnixSocketTrustedProxyHeader().toUtf8();
+}
+
+std::optional<WebSocketHub::Rejection> ApiServer::admitWebSocket(const QString &path, const QByteArray &authorization,
+                                                                 const QHostAddress &peer)
+{
+    const QString clientKey = ConnectionManager::clientKey(peer);
+    if (isRateLimited(clientKey)) {
+        WebSocketHub::Rejection rejection;
+        rejection.statusCode = 429;
+        rejection.body = createRateLimitedResponse(clientKey).data();
+        rejection.headers.append({"Retry-After", "60"});
+        return rejection;
+    }
+    
+    // The token is checked once, when the connection is opened
+    if (isProtectedPath(path)) {
+        const JwtAuthenticator::Result auth = m_authenticator->authenticate(authorization);
+        if (auth.status != JwtAuthenticator::Status::Ok) {
+            WebSocketHub::Rejection rejection;
+            rejection.statusCode = auth.status == JwtAuthenticator::Status::InsufficientScope ? 403 : 401;
+            
+            ProblemDetail problem(rejection.statusCode);
+            problem.setDetail(auth.detail);
+            problem.setInstance(path);
+            rejection.body = problem.toJsonResponse().data();
+            rejection.headers.append({"WWW-Authenticate", authChallenge(auth)});
+            return rejection;
+        }
+    }
+    
+    return std::nullopt;
+}
+
+void ApiServer::setupRoutes()
+{
+    // All routes are wrapped with rate limiting, exception handling, CORS and security headers
+    // Constant bodies are serialized once and shared by every response
+    addRoute("/", [](const QHttpServerRequest &) {
+        static const QByteArray mimeType = QByteArrayLiteral("text/plain");
+        static const QByteArray body = QByteArrayLiteral("Hello World");
+        return QHttpServerResponse(mimeType, body);
+    });
+
+    // API routes with JSON response
+    addRoute("/api", [](const QHttpServerRequest &) {
+        static const QByteArray mimeType = QByteArrayLiteral("application/json");
+        static const QByteArray body = QByteArrayLiteral("{\"message\":\"Hello World\"}");
+        return QHttpServerResponse(mimeType, body);
+    });
+
+    // Cached route: the timestamp changes at most once per TTL, whatever the request rate
+    addCachedRoute("/api/time", CachePolicy{1000, {}}, [](const QHttpServerRequest &) {
+        const HttpClock::Stamp stamp = HttpClock::instance().now();
+        QJsonObject jsonObject{{"time", QString::fromLatin1(stamp.isoSecond) + QLatin1Char('Z')}};
+        return QHttpServerResponse(jsonObject);
+    });
+
+    // Validated route: bodies that do not match the schema are rejected before the handler runs
+    static const QJsonObject messageSchema{
+        {"type", "object"},
+        {"properties", QJsonObject{
+            {"text", QJsonObject{{"type", "string"}, {"minLength", 1}, {"maxLength", 280}}},
+            {"tags", QJsonObject{
+                {"type", "array"},
+                {"items", QJsonObject{{"type", "string"}}},
+                {"maxItems", 10}
+            }}
+        }},
+        {"required", QJsonArray{"text"}},
+        {"additionalProperties", false}
+    };
+    addValidatedRoute("/api/messages", messageSchema, [](const QHttpServerRequest &request) {
+        if (request.method() != QHttpServerRequest::Method::Post) {
+            ProblemDetail problem(405);
+            problem.setDetail("Messages can only be created with POST");
+            problem.setInstance("/api/messages");
+            QHttpServerResponse response = problem.toJsonResponse();
+            QHttpHeaders headers = response.headers();
+            headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::Allow, "POST");
+            response.setHeaders(std::move(headers));
+            return response;
+        }
+        
+        const QJsonObject message = QJsonDocument::fromJson(request.body()).object();
+        return QHttpServerResponse(QJsonObject{{"received", message}}, QHttpServerResponse::StatusCode::Created);
+    });
+
+    // Example route that triggers a 404 error
+    addRoute("/api/not-found", [](const QHttpServerRequest &) {
+        // This demonstrates how to manually trigger a problem detail error
+        ProblemDetail problem(404);
+        problem.setTitle("Resource Not Found");
+        problem.setDetail("The requested resource does not exist");
+        problem.setInstance("/api/not-found");
+        
+        return problem.toJsonResponse();
+    });
+
+    // Example route that triggers a 500 error
+    addRoute("/api/error", [](const QHttpServerRequest &) {
+        ProblemDetail problem(500);
+        problem.setTitle("Internal Server Error");
+        problem.setDetail("An unexpected error occurred");
+        problem.setInstance("/api/error");
+        problem.addExtension("server_info", "Qt6 Web API Example");
+        
+        return problem.toJsonResponse();
+    });
+    
+    // Handle OPTIONS requests for CORS
+    m_server->route("*", QHttpServerRequest::Method::Options, [this](const QHttpServerRequest &request) {
+        QHttpServerResponse response("");
+        
+        // Add CORS headers if enabled
+        addCorsHeaders(response);
+        
+        // Add OWASP recommended security headers
+        addSecurityHeaders(response);
+        
+        return response;
+    });
+}
+
+void ApiServer::setupMetricsRoute()
+{
+    // Prometheus scrape endpoint; per-thread metrics are only aggregated here
+    m_server->route("/metrics", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &request) {
+        if (!m_config || !m_config->isMetricsEnabled()
+                || !m_config->getMetricsAllowedAddresses().contains(ConnectionManager::clientKey(request.remoteAddress()))) {
+            ProblemDetail problem(404);
+            problem.setInstance(request.url().path());
+            return problem.toJsonResponse();
+        }
+        
+        return QHttpServerResponse("text/plain; version=0.0.4; charset=utf-8", Metrics::instance().toPrometheus());
+    });
+    
+    // Gauges and counters are read at scrape time
+    Metrics::instance().addGauge("rate_limit_table_size", "Client addresses tracked by the rate limiter.", [this]() {
+        QMutexLocker locker(&m_rateLimitMutex);
+        return static_cast<double>(m_clientRequests.size());
+    });
+    Metrics::instance().addGauge("http_open_connections", "Open client connections.", [this]() {
+        return static_cast<double>(m_connectionManager->connectionCount());
+    });
+    Metrics::instance().addGauge("http_active_requests", "Requests currently in progress.", [this]() {
+        return static_cast<double>(m_connectionManager->activeRequestCount());
+    });
+    Metrics::instance().addGauge("response_cache_bytes", "Bytes held by the response cache.", [this]() {
+        return static_cast<double>(m_responseCache->sizeBytes());
+    });
+    Metrics::instance().addGauge("response_cache_entries", "Responses held by the response cache.", [this]() {
+        return static_cast<double>(m_responseCache->entryCount());
+    });
+    Metrics::instance().addCounter("response_cache_hits_total", "Requests answered from the response cache.", [this]() {
+        return m_responseCache->hitCount();
+    });
+    Metrics::instance().addCounter("response_cache_misses_total", "Cacheable requests that ran the route handler.", [this]() {
+        return m_responseCache->missCount();
+    });
+    Metrics::instance().addCounter("response_cache_coalesced_total", "Cache misses that waited for a concurrent handler run.", [this]() {
+        return m_responseCache->coalescedCount();
+    });
+    Metrics::instance().addGauge("proxy_active_requests", "Requests waiting for or receiving an upstream response.", [this]() {
+        return static_cast<double>(m_reverseProxy->activeCount());
+    });
+    Metrics::instance().addGauge("auth_token_cache_entries", "Verified bearer tokens held by the token cache.", [this]() {
+        return static_cast<double>(m_authenticator->cachedCount());
+    });
+    Metrics::instance().addCounter("auth_token_cache_hits_total", "Bearer tokens accepted without a signature check.", [this]() {
+        return m_authenticator->hitCount();
+    });
+    Metrics::instance().addCounter("auth_token_cache_misses_total", "Bearer tokens whose signature had to be verified.", [this]() {
+        return m_authenticator->missCount();
+    });
+    Metrics::instance().addCounter("auth_rejected_requests_total", "Requests to protected routes answered with 401 or 403.", [this]() {
+        return m_authenticator->rejectedCount();
+    });
+    Metrics::instance().addGauge("static_files_open", "Static files kept open and memory-mapped.", [this]() {
+        return static_cast<double>(m_staticFiles->openCount());
+    });
+    Metrics::instance().addCounter("static_file_cache_hits_total", "Static file requests served from an open file.", [this]() {
+        return m_staticFiles->hitCount();
+    });
+    Metrics::instance().addCounter("static_file_cache_misses_total", "Static file requests that opened or reopened the file.", [this]() {
+        return m_staticFiles->missCount();
+    });
+    Metrics::instance().addGauge("idempotency_keys", "Idempotency keys whose response is stored.", [this]() {
+        return static_cast<double>(m_idempotency->store()->entryCount());
+    });
+    Metrics::instance().addCounter("idempotency_executed_total", "Requests with an Idempotency-Key that ran the handler.", [this]() {
+        return m_idempotency->executedCount();
+    });
+    Metrics::instance().addCounter("idempotency_replayed_total", "Requests answered with the stored response of their Idempotency-Key.", [this]() {
+        return m_idempotency->replayedCount();
+    });
+    Metrics::instance().addCounter("idempotency_conflicts_total", "Duplicates answered with 409 while the original was still running.", [this]() {
+        return m_idempotency->conflictCount();
+    });
+    Metrics::instance().addGauge("websocket_connections", "Open WebSocket connections.", [this]() {
+        return static_cast<double>(m_webSockets->connectionCount());
+    });
+    Metrics::instance().addGauge("websocket_topics", "Topics with at least one WebSocket subscriber.", [this]() {
+        return static_cast<double>(m_webSockets->topicCount());
+    });
+    Metrics::instance().addCounter("websocket_messages_published_total", "Messages published to a topic with subscribers.", [this]() {
+        return m_webSockets->publishedCount();
+    });
+    Metrics::instance().addCounter("websocket_frames_delivered_total", "Published frames queued for a subscriber.", [this]() {
+        return m_webSockets->deliveredCount();
+    });
+    Metrics::instance().addCounter("websocket_frames_dropped_total", "Published frames not sent because the subscriber's queue was full.", [this]() {
+        return m_webSockets->droppedCount();
+    });
+    Metrics::instance().addCounter("websocket_slow_consumer_disconnects_total", "WebSocket subscribers disconnected for falling behind.", [this]() {
+        return m_webSockets->slowDisconnectCount();
+    });
+    Metrics::instance().addGauge("unix_socket_connections", "Open connections on the Unix domain sockets.", [this]() {
+        int connections = 0;
+        for (const UnixSocketListener *listener : std::as_const(m_unixListeners)) {
+            connections += listener->connectionCount();
+        }
+        return static_cast<double>(connections);
+    });
+    Metrics::instance().addGauge("unix_socket_proxy_header_errors", "Unix socket connections closed for a missing or invalid PROXY protocol header.", [this]() {
+        quint64 errors = 0;
+        for (const UnixSocketListener *listener : std::as_const(m_unixListeners)) {
+            errors += listener->proxyHeaderErrorCount();
+        }
+        return static_cast<double>(errors);
+    });
+}
+
+void ApiServer::setupHealthRoutes()
+{
+    // Load balancer probes are answered from pre-serialized bodies, before rate limiting,
+    // CORS and security headers, and are not counted as requests in the metrics
+    static const QByteArray mimeType = "text/plain; charset=utf-8";
+    static const QByteArray liveBody = "ok\n";
+    static const QByteArray readyBody = "ready\n";
+    static const QByteArray notListeningBody = "not ready: not listening\n";
+    static const QByteArray drainingBody = "not ready: draining\n";
+    static const QByteArray sheddingBody = "not ready: shedding load\n";
+    
+    // Liveness: the event loop is running and answering
+    m_server->route(LivenessProbePath, QHttpServerRequest::Method::Get, [](const QHttpServerRequest &) {
+        return QHttpServerResponse(mimeType, liveBody);
+    });
+    
+    // Readiness: the node should receive new traffic
+    m_server->route(ReadinessProbePath, QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &) {
+        const QByteArray *notReadyBody = nullptr;
+        if (m_draining) {
+            notReadyBody = &drainingBody;
+        } else if ((m_listeners.isEmpty() && m_unixListeners.isEmpty())
+                   || std::any_of(m_listeners.cbegin(), m_listeners.cend(), [](const QTcpServer *tcpServer) { return !tcpServer->isListening(); })
+                   || std::any_of(m_unixListeners.cbegin(), m_unixListeners.cend(), [](const UnixSocketListener *listener) { return !listener->isListening(); })) {
+            notReadyBody = &notListeningBody;
+        } else if (m_connectionManager->isShedding()) {
+            notReadyBody = &sheddingBody;
+        }
+        
+        if (notReadyBody) {
+            return QHttpServerResponse(mimeType, *notReadyBody, QHttpServerResponder::StatusCode::ServiceUnavailable);
+        }
+        return QHttpServerResponse(mimeType, readyBody);
+    });
+}
+
+void ApiServer::setupAdminRoutes()
+{
+    // Put the node into drain mode, e.g. before removing it from a load balancer
+    m_server->route("/admin/drain", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &request) {
+        try {
+            if (!isAdminRequest(request)) {
+                return adminForbiddenResponse(request);
+            }
+            
+            // Start draining once this response has been handed to the connection
+            QMetaObject::invokeMethod(this, &ApiServer::drain, Qt::QueuedConnection);
+            
+            QJsonObject jsonObject{
+                {"status", "draining"},
+                {"activeRequests", activeRequestCount()},
+                {"drainTimeoutMs", m_config ? m_config->getDrainTimeoutMs() : 30000}
+            };
+            return QHttpServerResponse(jsonObject, QHttpServerResponder::StatusCode::Accepted);
+        } catch (const std::exception &e) {
+            return handleException(e, request);
+        }
+    });
+    
+    // Snapshot of the process internals for capacity tuning
+    m_server->route("/admin/stats", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &request) {
+        try {
+            if (!isAdminRequest(request)) {
+                return adminForbiddenResponse(request);
+            }
+            
+            return QHttpServerResponse(runtimeStats());
+        } catch (const std::exception &e) {
+            return handleException(e, request);
+        }
+    });
+    
+    // One-off dump of the clients with the most requests in the current rate limit window;
+    // the list is returned and also written to the log
+    m_server->route("/admin/rate-limit/offenders", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &request) {
+        try {
+            if (!isAdminRequest(request)) {
+                return adminForbiddenResponse(request);
+            }
+            
+            bool ok = false;
+            const int top = QUrlQuery(request.url()).queryItemValue("top").toInt(&ok);
+            const int count = ok ? qBound(1, top, 1000) : 20;
+            
+            const QJsonArray offenders = topRateLimitOffenders(count);
+            for (const QJsonValue &offender : offenders) {
+                const QJsonObject entry = offender.toObject();
+                AccessLog::instance().logEvent(AccessLog::Level::Info, QString("Rate limit offender: %1 with %2 requests this window")
+                                               .arg(entry["client"].toString()).arg(entry["requests"].toInt()));
+            }
+            
+            return QHttpServerResponse(QJsonObject{{"offenders", offenders}});
+        } catch (const std::exception &e) {
+            return handleException(e, request);
+        }
+    });
+    
+    // Push the request body to the WebSocket subscribers of a topic
+    m_server->route("/admin/publish", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &request) {
+        try {
+            if (!isAdminRequest(request)) {
+                return adminForbiddenResponse(request);
+            }
+            
+            const QString topic = QUrlQuery(request.url()).queryItemValue("topic", QUrl::FullyDecoded);
+            if (topic.isEmpty()) {
+                ProblemDetail problem(400);
+                problem.setDetail("The topic query parameter is required");
+                problem.setInstance(request.url().path());
+                return problem.toJsonResponse();
+            }
+            
+            // Binary frames for opaque payloads, text frames (UTF-8) for everything else
+            const bool binary = request.value("Content-Type").startsWith("application/octet-stream");
+            const int subscribers = publish(topic, request.body(), binary);
+            
+            return QHttpServerResponse(QJsonObject{{"topic", topic}, {"subscribers", subscribers}});
+        } catch (const std::exception &e) {
+            return handleException(e, request);
+        }
+    });
+}
+
+QJsonObject ApiServer::runtimeStats()
+{
+    const ProcessStats process = ProcessStats::read();
+    
+    QJsonArray unixSockets;
+    for (const UnixSocketListener *listener : std::as_const(m_unixListeners)) {
+        unixSockets.append(QJsonObject{
+            {"path", listener->path()},
+            {"connections", listener->connectionCount()},
+            {"proxyHeaderErrors", static_cast<qint64>(listener->proxyHeaderErrorCount())}
+        });
+    }
+    
+    QJsonObject memory{
+        {"residentBytes", process.residentBytes},
+        {"peakResidentBytes", process.peakResidentBytes},
+        {"virtualBytes", process.virtualBytes},
+        {"heapInUseBytes", process.heapInUseBytes},
+        {"heapFreeBytes", process.heapFreeBytes},
+        {"heapMappedBytes", process.heapMappedBytes}
+    };
+    
+    // One entry per event-loop thread serving connections
+    QJsonArray workers;
+    workers.append(QJsonObject{
+        {"name", "api"},
+        {"connections", m_connectionManager->connectionCount()},
+        {"activeRequests", m_connectionManager->activeRequestCount()},
+        {"eventLoopLagUs", m_loopMonitor->lastLagUs()},
+        {"maxEventLoopLagUs", m_loopMonitor->takeMaxLagUs()}
+    });
+    
+    if (m_redirectConnectionManager) {
+        // The counts are atomic, so the redirect thread is never blocked on to read them
+        workers.append(QJsonObject{
+            {"name", "http-redirect"},
+            {"connections", m_redirectConnectionManager->connectionCount()},
+            {"activeRequests", m_redirectConnectionManager->activeRequestCount()},
+            {"eventLoopLagUs", m_redirectLoopMonitor->lastLagUs()},
+            {"maxEventLoopLagUs", m_redirectLoopMonitor->takeMaxLagUs()}
+        });
+    }
+    
+    int trackedClients = 0;
+    {
+        QMutexLocker locker(&m_rateLimitMutex);
+        trackedClients = m_clientRequests.size();
+    }
+    
+    QJsonArray upstreams;
+    for (const QString &prefix : std::as_const(m_proxyPrefixes)) {
+        const std::shared_ptr<const CircuitBreaker> breaker = m_reverseProxy->circuitBreaker(prefix);
+        const std::shared_ptr<const ConcurrencyLimiter> limiter = m_reverseProxy->concurrencyLimiter(prefix);
+        upstreams.append(QJsonObject{
+            {"prefix", prefix},
+            {"circuit", CircuitBreaker::stateName(breaker->state())},
+            {"concurrencyLimit", limiter->limit()},
+            {"inFlight", limiter->inFlight()}
+        });
+    }
+    
+    // QThreadPool does not expose its queue length, only its thread usage
+    QThreadPool *threadPool = QThreadPool::globalInstance();
+    
+    return QJsonObject{
+        {"memory", memory},
+        {"threads", process.threads},
+        {"workers", workers},
+        {"rateLimit", QJsonObject{{"trackedClients", trackedClients}, {"maxRequestsPerMinute", m_rateLimit}}},
+        {"threadPool", QJsonObject{{"activeThreads", threadPool->activeThreadCount()}, {"maxThreads", threadPool->maxThreadCount()}}},
+        {"accessLog", QJsonObject{{"droppedRecords", static_cast<qint64>(AccessLog::instance().droppedCount())}}},
+        {"tracing", QJsonObject{{"droppedSpans", static_cast<qint64>(Tracer::instance().droppedCount())}}},
+        {"proxy", QJsonObject{{"activeRequests", m_reverseProxy->activeCount()}, {"upstreams", upstreams}}},
+        {"auth", QJsonObject{
+            {"enabled", m_authEnabled},
+            {"keys", m_authenticator->keyCount()},
+            {"cachedTokens", m_authenticator->cachedCount()},
+            {"cacheHits", static_cast<qint64>(m_authenticator->hitCount())},
+            {"cacheMisses", static_cast<qint64>(m_authenticator->missCount())},
+            {"rejected", static_cast<qint64>(m_authenticator->rejectedCount())}
+        }},
+        {"staticFiles", QJsonObject{
+            {"openFiles", m_staticFiles->openCount()},
+            {"hits", static_cast<qint64>(m_staticFiles->hitCount())},
+            {"misses", static_cast<qint64>(m_staticFiles->missCount())}
+        }},
+        {"webSockets", QJsonObject{
+            {"connections", m_webSockets->connectionCount()},
+            {"topics", m_webSockets->topicCount()},
+            {"published", static_cast<qint64>(m_webSockets->publishedCount())},
+            {"delivered", static_cast<qint64>(m_webSockets->deliveredCount())},
+            {"dropped", static_cast<qint64>(m_webSockets->droppedCount())},
+            {"slowConsumerDisconnects", static_cast<qint64>(m_webSockets->slowDisconnectCount())}
+        }},
+        {"unixSockets", unixSockets},
+        {"idempotency", QJsonObject{
+            {"keys", m_idempotency->store()->entryCount()},
+            {"bytes", m_idempotency->store()->sizeBytes()},
+            {"executed", static_cast<qint64>(m_idempotency->executedCount())},
+            {"replayed", static_cast<qint64>(m_idempotency->replayedCount())},
+            {"conflicts", static_cast<qint64>(m_idempotency->conflictCount())}
+        }},
+        {"responseCache", QJsonObject{
+            {"entries", m_responseCache->entryCount()},
+            {"bytes", m_responseCache->sizeBytes()},
+            {"hits", static_cast<qint64>(m_responseCache->hitCount())},
+            {"misses", static_cast<qint64>(m_responseCache->missCount())},
+            {"coalesced", static_cast<qint64>(m_responseCache->coalescedCount())}
+        }},
+        {"draining", m_draining}
+    };
+}
+
+QJsonArray ApiServer::topRateLimitOffenders(int count)
+{
+    using Offender = std::pair<int, QString>;
+    
+    // Select the top entries with a bounded min-heap while holding the lock, without
+    // copying the table, so request threads are only held up for a single pass
+    std::vector<Offender> heap;
+    heap.reserve(static_cast<size_t>(count) + 1);
+    {
+        QMutexLocker locker(&m_rateLimitMutex);
+        for (auto it = m_clientRequests.cbegin(); it != m_clientRequests.cend(); ++it) {
+            if (static_cast<int>(heap.size()) == count && it.value() <= heap.front().first) {
+                continue;
+            }
+            heap.emplace_back(it.value(), it.key());
+            std::push_heap(heap.begin(), heap.end(), std::greater<Offender>());
+            if (static_cast<int>(heap.size()) > count) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<Offender>());
+                heap.pop_back();
+            }
+        }
+    }
+    
+    std::sort_heap(heap.begin(), heap.end(), std::greater<Offender>());
+    
+    QJsonArray offenders;
+    for (const Offender &offender : heap) {
+        offenders.append(QJsonObject{
+            {"client", offender.second},
+            {"requests", offender.first},
+            {"limited", offender.first > m_rateLimit}
+        });
+    }
+    return offenders;
+}
+
+bool ApiServer::isAdminRequest(const QHttpServerRequest &request) const
+{
+    if (!m_config || !m_config->isAdminEnabled()) {
+        return false;
+    }
+    
+    return m_config->getAdminAllowedAddresses().contains(ConnectionManager::clientKey(request.remoteAddress()));
+}
+
+QHttpServerResponse ApiServer::adminForbiddenResponse(const QHttpServerRequest &request) const
+{
+    ProblemDetail problem(403);
+    problem.setTitle("Forbidden");
+    problem.setDetail("Admin endpoints are only available to allowed addresses");
+    problem.setInstance(request.url().path());
+    return problem.toJsonResponse();
+}
+
+void ApiServer::setupErrorHandler()
+{
+    // Handle 404 errors for any undefined routes
+    const int routeId = Metrics::instance().registerRoute("unmatched");
+    m_server->setMissingHandler(this, [this, routeId](const QHttpServerRequest &request, QHttpServerResponder &responder) {
+        QHttpServerResponse response = handleRequest(routeId, request, [](const QHttpServerRequest &request) {
+            ProblemDetail problem(404);
+            problem.setTitle("Not Found");
+            problem.setDetail(QString("The requested resource '%1' was not found").arg(request.url().path()));
+            problem.setInstance(request.url().path());
+            
+            return problem.toJsonResponse();
+        });
+        
+        // The missing handler answers through the responder, which bypasses the after-request handlers
+        finalizeResponse(request, response);
+        responder.sendResponse(std::move(response));
+    });
+}
+
+void ApiServer::addRoute(const QString &path, const RouteHandler &handler)
+{
+    const int routeId = Metrics::instance().registerRoute(path);
+    m_server->route(path, [this, routeId, handler](const QHttpServerRequest &request) {
+        return handleRequest(routeId, request, handler);
+    });
+}
+
+void ApiServer::addCachedRoute(const QString &path, const CachePolicy &policy, const RouteHandler &handler)
+{
+    // Header names are listed in the Vary header of every cached response
+    QByteArray vary;
+    for (const QByteArray &header : policy.varyHeaders) {
+        vary += vary.isEmpty() ? header : ", " + header;
+    }
+    
+    addRoute(path, [this, policy, vary, handler](const QHttpServerRequest &request) {
+        const bool cacheable = (request.method() == QHttpServerRequest::Method::Get
+                                || request.method() == QHttpServerRequest::Method::Head)
+            && m_config && m_config->isResponseCacheEnabled() && policy.ttlMs > 0;
+        if (!cacheable) {
+            return handler(request);
+        }
+        
+        ResponseCache::Outcome outcome = ResponseCache::Outcome::Miss;
+        const ResponseCache::EntryPtr entry = m_responseCache->fetch(
+            ResponseCache::key(request, policy.varyHeaders), policy.ttlMs,
+            [&]() {
+                ResponseCache::Entry produced = ResponseCache::capture(handler(request));
+                produced.vary = vary;
+                return produced;
+            },
+            &outcome);
+        
+        return ResponseCache::respond(*entry, request, outcome);
+    });
+}
+
+void ApiServer::addValidatedRoute(const QString &path, const QJsonObject &schema, const RouteHandler &handler)
+{
+    // A schema the validator cannot enforce is a programming error, reported at startup
+    QString error;
+    const std::shared_ptr<const JsonSchema> compiled = JsonSchema::compile(schema, &error);
+    if (!compiled) {
+        throw std::invalid_argument(QString("Invalid JSON schema for route %1: %2").arg(path, error).toStdString());
+    }
+    
+    addRoute(path, [compiled, path, handler](const QHttpServerRequest &request) {
+        const QHttpServerRequest::Method method = request.method();
+        if (method != QHttpServerRequest::Method::Post && method != QHttpServerRequest::Method::Put
+            && method != QHttpServerRequest::Method::Patch) {
+            return handler(request);
+        }
+        
+        if (!isJsonMediaType(request.value("Content-Type"))) {
+            ProblemDetail problem(415);
+            problem.setDetail("The request body must be JSON (Content-Type: application/json)");
+            problem.setInstance(request.url().path());
+            return problem.toJsonResponse();
+        }
+        
+        // The body is parsed and validated in one pass, without building a QJsonDocument
+        QList<JsonSchema::Violation> violations;
+        JsonSchema::Result result = JsonSchema::Result::Valid;
+        {
+            STAGE_TIMER(PipelineStage::Validation);
+            ScopedSpan span(PipelineStage::Validation);
+            result = compiled->validate(request.body(), violations);
+        }
+        if (result == JsonSchema::Result::Valid) {
+            return handler(request);
+        }
+        
+        if (result == JsonSchema::Result::Malformed) {
+            ProblemDetail problem(400);
+            problem.setDetail(violations.first().message);
+            problem.setInstance(request.url().path());
+            return problem.toJsonResponse();
+        }
+        
+        QJsonArray errors;
+        for (const JsonSchema::Violation &violation : violations) {
+            errors.append(QJsonObject{{"pointer", violation.pointer}, {"detail", violation.message}});
+        }
+        
+        ProblemDetail problem(422);
+        problem.setDetail(QString("The request body does not match the schema of %1").arg(path));
+        problem.setInstance(request.url().path());
+        problem.addExtension("errors", errors);
+        return problem.toJsonResponse();
+    });
+}
+
+void ApiServer::setupProxyRoutes()
 {
-    delete m_config;
-    if (m_redirectServer) {
-        delete m_redirectServer;
+    if (!m_config) {
+        return;
     }
-}
-
-bool ApiServer::listen(int port, const QHostAddress &address)
-{
-    const quint16 actualPort = m_server->listen(address, port);
     
-    if (actualPort != 0) {
-        m_httpsPort = port; // Store the HTTPS port for redirects
-    }
+    CircuitBreaker::Settings breaker;
+    breaker.windowSize = m_config->getCircuitBreakerWindowSize();
+    breaker.minimumCalls = m_config->getCircuitBreakerMinimumCalls();
+    breaker.failureRatePercent = m_config->getCircuitBreakerFailureRatePercent();
+    breaker.slowCallMs = m_config->getCircuitBreakerSlowCallMs();
+    breaker.slowCallRatePercent = m_config->getCircuitBreakerSlowCallRatePercent();
+    breaker.openDurationMs = m_config->getCircuitBreakerOpenDurationMs();
+    breaker.halfOpenProbes = m_config->getCircuitBreakerHalfOpenProbes();
     
-    return actualPort != 0;
+    ConcurrencyLimiter::Settings limiter;
+    limiter.initialLimit = m_config->getConcurrencyInitialLimit();
+    limiter.minLimit = m_config->getConcurrencyMinLimit();
+    limiter.maxLimit = m_config->getConcurrencyMaxLimit();
+    limiter.backoffPercent = m_config->getConcurrencyBackoffPercent();
+    limiter.latencyTolerancePercent = m_config->getConcurrencyLatencyTolerancePercent();
+    
+    m_reverseProxy->setProtection(breaker, limiter);
+    
+    const QJsonArray routes = m_config->getProxyRoutes();
+    for (const QJsonValue &value : routes) {
+        const QJsonObject object = value.toObject();
+        
+        ReverseProxy::Route route;
+        route.prefix = object["prefix"].toString();
+        while (route.prefix.endsWith('/')) {
+            route.prefix.chop(1);
+        }
+        route.upstream = QUrl(object["upstream"].toString());
+        route.stripPrefix = object["stripPrefix"].toBool(false);
+        route.timeoutMs = object["timeoutMs"].toInt(m_config->getProxyTimeoutMs());
+        route.idleTimeoutMs = object["idleTimeoutMs"].toInt(m_config->getProxyIdleTimeoutMs());
+        
+        if (!route.prefix.startsWith('/') || !route.upstream.isValid()
+                || (route.upstream.scheme() != "http" && route.upstream.scheme() != "https")) {
+            AccessLog::instance().logEvent(AccessLog::Level::Warning,
+                                           QString("Ignoring proxy route '%1': a path prefix and an http(s) upstream are required")
+                                               .arg(object["prefix"].toString()));
+            continue;
+        }
+        
+        // Routes cannot be removed from the server, so a prefix is only ever mounted once
+        if (m_proxyPrefixes.contains(route.prefix)) {
+            continue;
+        }
+        m_proxyPrefixes.insert(route.prefix);
+        m_reverseProxy->addUpstream(route);
+        addUpstreamGauges(route.prefix);
+        
+        const int routeId = Metrics::instance().registerRoute(route.prefix);
+        m_server->route(route.prefix, [this, route, routeId](const QHttpServerRequest &request, QHttpServerResponder &responder) {
+            forwardToUpstream(route, routeId, request, std::move(responder));
+        });
+        
+        // A QUrl argument matches the rest of the path, including further slashes
+        m_server->route(route.prefix + "/<arg>", [this, route, routeId](const QUrl &, const QHttpServerRequest &request, QHttpServerResponder &responder) {
+            forwardToUpstream(route, routeId, request, std::move(responder));
+        });
+    }
 }
 
-bool ApiServer::listenHttpRedirect(int httpPort, int httpsPort)
+void ApiServer::addUpstreamGauges(const QString &prefix)
 {
-    if (!m_tlsEnabled) {
-        // Only set up HTTP redirects if TLS is enabled
-        return false;
-    }
+    QByteArray label = prefix.toUtf8();
+    label.replace('\\', "\\\\").replace('"', "\\\"");
+    label = "{upstream=\"" + label + "\"}";
     
-    if (m_redirectServer) {
-        delete m_redirectServer;
-    }
+    // The breaker and limiter are shared with the gauges, so reading them needs no lookup
+    const std::shared_ptr<const CircuitBreaker> breaker = m_reverseProxy->circuitBreaker(prefix);
+    const std::shared_ptr<const ConcurrencyLimiter> limiter = m_reverseProxy->concurrencyLimiter(prefix);
     
-    m_redirectServer = new QHttpServer(this);
-    m_httpsPort = httpsPort;
+    const QList<QByteArray> names = {
+        "upstream_circuit_state" + label,
+        "upstream_circuit_rejected_requests_total" + label,
+        "upstream_concurrency_limit" + label,
+        "upstream_inflight_requests" + label,
+        "upstream_concurrency_rejected_requests_total" + label
+    };
     
-    // Set up the redirect server to handle all routes
-    setupHttpsRedirect(httpPort, httpsPort);
+    Metrics::instance().addGauge(names[0], "Circuit breaker state per upstream: 0 closed, 1 half-open, 2 open.", [breaker]() {
+        return static_cast<double>(breaker->state());
+    });
+    Metrics::instance().addCounter(names[1], "Requests failed fast by the circuit breaker.", [breaker]() {
+        return breaker->rejectedCount();
+    });
+    Metrics::instance().addGauge(names[2], "Adaptive concurrency limit per upstream.", [limiter]() {
+        return static_cast<double>(limiter->limit());
+    });
+    Metrics::instance().addGauge(names[3], "Requests in progress per upstream.", [limiter]() {
+        return static_cast<double>(limiter->inFlight());
+    });
+    Metrics::instance().addCounter(names[4], "Requests rejected by the concurrency limit.", [limiter]() {
+        return limiter->rejectedCount();
+    });
     
-    const quint16 actualPort = m_redirectServer->listen(QHostAddress::Any, httpPort);
-    return actualPort != 0;
+    m_upstreamGauges.append({names[0], names[2], names[3]});
+    m_upstreamCounters.append({names[1], names[4]});
 }
 
-bool ApiServer::enableTls(const QString &certPath, const QString &keyPath, const QString &keyPassphrase)
+void ApiServer::forwardToUpstream(const ReverseProxy::Route &route, int routeId, const QHttpServerRequest &request,
+                                  QHttpServerResponder &&responder)
 {
-    QFile certFile(certPath);
-    QFile keyFile(keyPath);
-    
-    if (!certFile.open(QIODevice::ReadOnly) || !keyFile.open(QIODevice::ReadOnly)) {
-        return false;
-    }
+    QElapsedTimer timer;
+    timer.start();
     
-    QSslCertificate certificate(&certFile, QSsl::Pem);
-    QSslKey key(&keyFile, QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey, keyPassphrase.toUtf8());
+    const QString clientKey = clientKeyOf(request);
+    const char *method = methodName(request.method());
+    const QString path = request.url().path();
     
-    certFile.close();
-    keyFile.close();
+    auto record = [routeId, timer, method, path, clientKey](int statusCode) {
+        const quint64 latencyUs = static_cast<quint64>(timer.nsecsElapsed() / 1000);
+        Metrics::instance().recordRequest(routeId, statusCode, latencyUs);
+        AccessLog::instance().logRequest(method, path, clientKey, statusCode, latencyUs);
+    };
     
-    if (certificate.isNull() || key.isNull()) {
-        return false;
+    // The upstream receives the Authorization header unchanged
+    if (std::optional<QHttpServerResponse> rejection = admissionFailure(request, clientKey)) {
+        record(static_cast<int>(rejection->statusCode()));
+        responder.sendResponse(*rejection);
+        return;
     }
     
-    QSslConfiguration sslConfig;
-    sslConfig.setLocalCertificate(certificate);
-    sslConfig.setPrivateKey(key);
-    sslConfig.setProtocol(QSsl::TlsV1_3OrLater);
-    
-    m_server->sslSetup(sslConfig);
-    m_tlsEnabled = true;
-    
-    return true;
-}
-
-void ApiServer::setCorsEnabled(bool enabled, const QStringList &allowedOrigins)
-{
-    m_corsEnabled = enabled;
-    m_corsAllowedOrigins = allowedOrigins;
+    m_reverseProxy->forward(route, request, method, std::move(responder),
+                            m_tlsEnabled ? QByteArrayLiteral("https") : QByteArrayLiteral("http"), record);
 }
 
-void ApiServer::setRateLimit(int maxRequestsPerMinute)
+void ApiServer::setupStaticRoutes()
 {
-    m_rateLimit = maxRequestsPerMinute;
+    if (!m_config) {
+        return;
+    }
+    
+    StaticFiles::Settings settings;
+    settings.maxOpenFiles = m_config->getStaticFileMaxOpenFiles();
+    settings.revalidateMs = m_config->getStaticFileRevalidateMs();
+    settings.streamThresholdBytes = static_cast<qint64>(m_config->getStaticFileStreamThresholdKb()) * 1024;
+    settings.maxAgeSeconds = m_config->getStaticFileMaxAgeSeconds();
+    m_staticFiles->setSettings(settings);
+    
+    const QJsonArray mounts = m_config->getStaticFileMounts();
+    for (const QJsonValue &value : mounts) {
+        const QJsonObject object = value.toObject();
+        
+        StaticFiles::Mount mount;
+        mount.prefix = object["prefix"].toString();
+        while (mount.prefix.endsWith('/')) {
+            mount.prefix.chop(1);
+        }
+        mount.root = QFileInfo(object["root"].toString()).canonicalFilePath();
+        mount.indexFile = object["index"].toString(mount.indexFile);
+        
+        if (!mount.prefix.startsWith('/') || mount.root.isEmpty() || !QFileInfo(mount.root).isDir()) {
+            AccessLog::instance().logEvent(AccessLog::Level::Warning,
+                                           QString("Ignoring static files mount '%1': a path prefix and an existing root directory are required")
+                                               .arg(object["prefix"].toString()));
+            continue;
+        }
+        
+        // Routes cannot be removed from the server, so a prefix is only ever mounted once
+        if (m_staticPrefixes.contains(mount.prefix) || m_proxyPrefixes.contains(mount.prefix)) {
+            continue;
+        }
+        m_staticPrefixes.insert(mount.prefix);
+        
+        const int routeId = Metrics::instance().registerRoute(mount.prefix);
+        m_server->route(mount.prefix, [this, mount, routeId](const QHttpServerRequest &request, QHttpServerResponder &responder) {
+            serveStaticFile(mount, routeId, request, responder);
+        });
+        
+        // A QUrl argument matches the rest of the path, including further slashes
+        m_server->route(mount.prefix + "/<arg>", [this, mount, routeId](const QUrl &, const QHttpServerRequest &request, QHttpServerResponder &responder) {
+            serveStaticFile(mount, routeId, request, responder);
+        });
+    }
 }
 
-void ApiServer::setProblemBaseUrl(const QString &baseUrl)
+void ApiServer::serveStaticFile(const StaticFiles::Mount &mount, int routeId, const QHttpServerRequest &request,
+                                QHttpServerResponder &responder)
 {
-    m_problemBaseUrl = baseUrl;
-    ProblemDetail::setDefaultBaseUrl(baseUrl);
+    QElapsedTimer timer;
+    timer.start();
+    
+    const QString clientKey = clientKeyOf(request);
+    
+    int statusCode = 0;
+    if (std::optional<QHttpServerResponse> rejection = admissionFailure(request, clientKey)) {
+        statusCode = static_cast<int>(rejection->statusCode());
+        responder.sendResponse(*rejection);
+    } else {
+        // Responder-based routes bypass the after-request handlers, so the Date header is added here
+        StaticFiles::HeaderList headers = m_staticHeaders;
+        headers.append({"Date", HttpClock::instance().httpDate()});
+        statusCode = m_staticFiles->serve(mount, request, responder, headers);
+    }
+    
+    const quint64 latencyUs = static_cast<quint64>(timer.nsecsElapsed() / 1000);
+    Metrics::instance().recordRequest(routeId, statusCode, latencyUs);
+    AccessLog::instance().logRequest(methodName(request.method()), request.url().path(), clientKey, statusCode, latencyUs);
 }
 
-void ApiServer::setConfig(ConfigManager *config)
+std::optional<QHttpServerResponse> ApiServer::admissionFailure(const QHttpServerRequest &request, const QString &clientKey)
 {
-    if (m_config) {
-        delete m_config;
+    if (isRateLimited(clientKey)) {
+        return createRateLimitedResponse(clientKey);
     }
-    m_config = config;
+    
+    if (requiresAuthentication(request)) {
+        const JwtAuthenticator::Result auth = m_authenticator->authenticate(request.value("Authorization"));
+        if (auth.status != JwtAuthenticator::Status::Ok) {
+            return createAuthFailureResponse(auth, request);
+        }
+    }
+    
+    return std::nullopt;
 }
 
-void ApiServer::setupRoutes()
+QHttpServerResponse ApiServer::handleRequest(int routeId, const QHttpServerRequest &request, const RouteHandler &handler)
 {
-    // Wrap all routes with rate limiting and exception handling
-    m_server->route("/", [this](const QHttpServerRequest &request) {
-        try {
-            // Check rate limiting
-            if (isRateLimited(request.remoteAddress().toString())) {
-                return createRateLimitedResponse(request.remoteAddress().toString());
-            }
-            
-            // Add CORS headers if enabled
-            QHttpServerResponse response("Hello World");
-            
-            // Add CORS headers if enabled
-            addCorsHeaders(response);
-            
-            // Add OWASP recommended security headers
-            addSecurityHeaders(response);
-            
-            return response;
-        } catch (const std::exception &e) {
-            return handleException(e, request);
-        }
-    });
-
-    // API routes with JSON response
-    m_server->route("/api", [this](const QHttpServerRequest &request) {
+    QElapsedTimer timer;
+    timer.start();
+    
+#ifdef API_STAGE_TIMING
+    StageTimings stageTimings;
+    STAGE_TIMING_SCOPE(&stageTimings);
+#endif
+    
+    // Trace context: unsampled requests only pay for parsing the traceparent header
+    RequestTrace trace;
+    Tracer::instance().begin(request.value("traceparent"), trace);
+    RequestTraceScope traceScope(&trace);
+    
+    // Scratch memory allocated while handling the request is released in one step at the end
+    RequestArenaScope arenaScope;
+    
+    const QString clientKey = clientKeyOf(request);
+    
+    QHttpServerResponse response = [&]() {
         try {
             // Check rate limiting
-            if (isRateLimited(request.remoteAddress().toString())) {
-                return createRateLimitedResponse(request.remoteAddress().toString());
+            bool rateLimited = false;
+            {
+                STAGE_TIMER(PipelineStage::RateLimit);
+                ScopedSpan span(PipelineStage::RateLimit);
+                rateLimited = isRateLimited(clientKey);
             }
-            
-            QJsonObject jsonObject{{"message", "Hello World"}};
-            QHttpServerResponse response(jsonObject);
-            
-            // Add CORS headers if enabled
-            addCorsHeaders(response);
-            
-            // Add OWASP recommended security headers
-            addSecurityHeaders(response);
-            
-            return response;
-        } catch (const std::exception &e) {
-            return handleException(e, request);
-        }
-    });
-
-    // Example route that triggers a 404 error
-    m_server->route("/api/not-found", [this](const QHttpServerRequest &request) {
-        try {
-            // Check rate limiting
-            if (isRateLimited(request.remoteAddress().toString())) {
-                return createRateLimitedResponse(request.remoteAddress().toString());
+            if (rateLimited) {
+                return createRateLimitedResponse(clientKey);
             }
             
-            // This demonstrates how to manually trigger a problem detail error
-            ProblemDetail problem(404);
-            problem.setTitle("Resource Not Found");
-            problem.setDetail("The requested resource does not exist");
-            problem.setInstance("/api/not-found");
-            
-            return problem.toJsonResponse();
-        } catch (const std::exception &e) {
-            return handleException(e, request);
-        }
-    });
-
-    // Example route that triggers a 500 error
-    m_server->route("/api/error", [this](const QHttpServerRequest &request) {
-        try {
-            // Check rate limiting
-            if (isRateLimited(request.remoteAddress().toString())) {
-                return createRateLimitedResponse(request.remoteAddress().toString());
+            // Verify the bearer token of protected routes; handlers read its claims
+            // through JwtAuthenticator::current()
+            JwtAuthenticator::Result auth;
+            const bool authenticate = requiresAuthentication(request);
+            if (authenticate) {
+                STAGE_TIMER(PipelineStage::Authentication);
+                ScopedSpan span(PipelineStage::Authentication);
+                auth = m_authenticator->authenticate(request.value("Authorization"));
             }
-            
-            ProblemDetail problem(500);
-            problem.setTitle("Internal Server Error");
-            problem.setDetail("An unexpected error occurred");
-            problem.setInstance("/api/error");
-            problem.addExtension("server_info", "Qt6 Web API Example");
-            
-            return problem.toJsonResponse();
-        } catch (const std::exception &e) {
-            return handleException(e, request);
-        }
-    });
-    
-    // Handle OPTIONS requests for CORS
-    m_server->route("*", QHttpServerRequest::Method::Options, [this](const QHttpServerRequest &request) {
-        QHttpServerResponse response("");
-        
-        // Add CORS headers if enabled
-        addCorsHeaders(response);
-        
-        // Add OWASP recommended security headers
-        addSecurityHeaders(response);
-        
-        return response;
-    });
-}
-
-void ApiServer::setupErrorHandler()
-{
-    // Handle 404 errors for any undefined routes
-    m_server->handleUnmatchedRoute([this](const QHttpServerRequest &request) {
-        try {
-            // Check rate limiting
-            if (isRateLimited(request.remoteAddress().toString())) {
-                return createRateLimitedResponse(request.remoteAddress().toString());
+            if (authenticate && auth.status != JwtAuthenticator::Status::Ok) {
+                return createAuthFailureResponse(auth, request);
             }
+            ClaimsScope claimsScope(auth.claims);
             
-            ProblemDetail problem(404);
-            problem.setTitle("Not Found");
-            problem.setDetail(QString("The requested resource '%1' was not found").arg(request.url().path()));
-            problem.setInstance(request.url().path());
+            QHttpServerResponse response = [&]() {
+                STAGE_TIMER(PipelineStage::Handler);
+                ScopedSpan span(PipelineStage::Handler);
+                
+                // Retries of a POST or PATCH with the same Idempotency-Key get the first response;
+                // keys are scoped to the token subject, or to the client address without one
+                if (m_idempotencyEnabled && IdempotencyGuard::appliesTo(request)) {
+                    const QByteArray client = auth.claims ? "sub:" + auth.claims->subject.toUtf8()
+                                                          : "ip:" + clientKey.toUtf8();
+                    return m_idempotency->handle(request, client, [&]() {
+                        return handler(request);
+                    });
+                }
+                return handler(request);
+            }();
             
-            auto response = problem.toJsonResponse();
+            STAGE_TIMER(PipelineStage::Headers);
+            ScopedSpan span(PipelineStage::Headers);
             
             // Add CORS headers if enabled
             addCorsHeaders(response);
@@ -261,42 +1773,111 @@ void ApiServer::setupErrorHandler()
         } catch (const std::exception &e) {
             return handleException(e, request);
         }
-    });
+    }();
+    
+#ifdef API_STAGE_TIMING
+    addServerTimingHeader(response, stageTimings);
+#endif
+    
+    const int statusCode = static_cast<int>(response.statusCode());
+    const quint64 latencyUs = static_cast<quint64>(timer.nsecsElapsed() / 1000);
+    Metrics::instance().recordRequest(routeId, statusCode, latencyUs);
+    const QString path = request.url().path();
+    AccessLog::instance().logRequest(methodName(request.method()), path, clientKey, statusCode, latencyUs);
+    Tracer::instance().finish(trace, methodName(request.method()), path, statusCode);
+    
+    return response;
 }
 
 void ApiServer::setupSecurityHeaders()
 {
     // Set security headers for all responses
-    m_server->afterRequest([this](QHttpServerResponse &&response) {
+    m_server->addAfterRequestHandler(this, [this](const QHttpServerRequest &request, QHttpServerResponse &response) {
+        finalizeResponse(request, response);
+    });
+}
+
+void ApiServer::finalizeResponse(const QHttpServerRequest &request, QHttpServerResponse &response)
+{
+    QHttpHeaders headers = response.headers();
+    
+    // RFC 7231 Date header from the once-per-second cached clock
+    headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::Date, HttpClock::instance().httpDate());
+    
+    // Health probe responses are otherwise sent as pre-built
+    if (!isHealthProbePath(request.url().path())) {
         // Add OWASP recommended security headers
-        addSecurityHeaders(response);
+        for (const auto &header : std::as_const(m_securityHeaders)) {
+            headers.replaceOrAppend(header.first, header.second);
+        }
         
-        return std::move(response);
-    });
+        // Ask keep-alive clients to reconnect elsewhere while draining
+        if (m_draining) {
+            headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::Connection, "close");
+        }
+    }
+    
+    response.setHeaders(std::move(headers));
 }
 
 void ApiServer::setupHttpsRedirect(int httpPort, int httpsPort)
 {
+    Q_UNUSED(httpPort);
+    
     if (!m_redirectServer) {
         return;
     }
     
-    // Capture all HTTP requests and redirect to HTTPS
-    m_redirectServer->route("*", [this, httpsPort](const QHttpServerRequest &request) {
-        QUrl url = request.url();
-        QString host = getServerHostname();
+    // Pre-serialize the "https://host[:port]" prefixes once, so that a redirect
+    // only appends the request path and never resolves the local hostname
+    const QByteArray portSuffix = (httpsPort == 443) ? QByteArray() : ':' + QByteArray::number(httpsPort);
+    
+    QString canonicalHost = m_config ? m_config->getRedirectCanonicalHost() : QString();
+    if (canonicalHost.isEmpty()) {
+        canonicalHost = getServerHostname();
+    }
+    const QByteArray defaultPrefix = "https://" + QUrl::toAce(canonicalHost) + portSuffix;
+    
+    // Hosts that may be echoed back from the request's Host header
+    QHash<QByteArray, QByteArray> allowedPrefixes;
+    if (m_config) {
+        for (const QString &host : m_config->getRedirectAllowedHosts()) {
+            const QByteArray normalizedHost = host.trimmed().toLower().toUtf8();
+            allowedPrefixes.insert(normalizedHost, "https://" + normalizedHost + portSuffix);
+        }
+    }
+    
+    // Capture all HTTP requests and redirect to HTTPS. The handler runs on the
+    // redirect thread, so it only uses the immutable data captured by value.
+    m_redirectServer->route("*", [defaultPrefix, allowedPrefixes](const QHttpServerRequest &request) {
+        QByteArray location = defaultPrefix;
+        
+        if (!allowedPrefixes.isEmpty()) {
+            QByteArray host = request.value("Host").trimmed().toLower();
+            if (host.startsWith('[')) {
+                host.truncate(host.indexOf(']') + 1);
+            } else if (host.contains(':')) {
+                host.truncate(host.lastIndexOf(':'));
+            }
+            
+            const auto it = allowedPrefixes.constFind(host);
+            if (it != allowedPrefixes.constEnd()) {
+                location = it.value();
+            }
+        }
         
-        // Create the HTTPS URL from the HTTP request
-        url.setScheme("https");
-        url.setHost(host);
-        url.setPort(httpsPort);
+        // Append the path and query of the HTTP request
+        location += request.url().toEncoded(QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment);
         
         QHttpServerResponse response(QHttpServerResponder::StatusCode::MovedPermanently);
-        response.setHeader("Location", url.toString().toUtf8());
+        QHttpHeaders headers;
+        headers.append(QHttpHeaders::WellKnownHeader::Location, location);
+        headers.append(QHttpHeaders::WellKnownHeader::Date, HttpClock::instance().httpDate());
         
         // Add security headers
-        response.setHeader("X-Content-Type-Options", "nosniff");
-        response.setHeader("Cache-Control", "no-store, max-age=0");
+        headers.append("X-Content-Type-Options", "nosniff");
+        headers.append(QHttpHeaders::WellKnownHeader::CacheControl, "no-store, max-age=0");
+        response.setHeaders(std::move(headers));
         
         return response;
     });
@@ -304,6 +1885,7 @@ void ApiServer::setupHttpsRedirect(int httpPort, int httpsPort)
 
 QString ApiServer::getServerHostname() const
 {
+    // Only called once when the redirect server is set up
     // Try to get the local hostname, fallback to localhost
     QString hostname = QHostInfo::localHostName();
     if (hostname.isEmpty() || hostname == "localhost") {
@@ -314,46 +1896,57 @@ QString ApiServer::getServerHostname() const
 
 void ApiServer::addSecurityHeaders(QHttpServerResponse &response)
 {
-    if (!m_config) {
-        return;
-    }
-    
-    // Add basic security headers
-    response.setHeader("X-Content-Type-Options", m_config->getContentTypeOptions().toUtf8());
-    response.setHeader("X-Frame-Options", m_config->getFrameOptions().toUtf8());
-    response.setHeader("Content-Security-Policy", m_config->getContentSecurityPolicy().toUtf8());
-    
-    // Add additional OWASP recommended headers
-    if (!m_config->getPermissionsPolicy().isEmpty()) {
-        response.setHeader("Permissions-Policy", m_config->getPermissionsPolicy().toUtf8());
-    }
-    
-    if (!m_config->getReferrerPolicy().isEmpty()) {
-        response.setHeader("Referrer-Policy", m_config->getReferrerPolicy().toUtf8());
-    }
-    
-    if (!m_config->getXssProtection().isEmpty()) {
-        response.setHeader("X-XSS-Protection", m_config->getXssProtection().toUtf8());
+    // Values are pre-serialized, so setting them only shares the buffers
+    QHttpHeaders headers = response.headers();
+    for (const auto &header : std::as_const(m_securityHeaders)) {
+        headers.replaceOrAppend(header.first, header.second);
     }
-    
-    if (!m_config->getCacheControl().isEmpty()) {
-        response.setHeader("Cache-Control", m_config->getCacheControl().toUtf8());
+    response.setHeaders(std::move(headers));
+}
+
+void ApiServer::addCorsHeaders(QHttpServerResponse &response)
+{
+    if (m_corsHeaders.isEmpty()) {
+        return;
     }
     
-    if (!m_config->getClearSiteData().isEmpty()) {
-        response.setHeader("Clear-Site-Data", m_config->getClearSiteData().toUtf8());
+    QHttpHeaders headers = response.headers();
+    for (const auto &header : std::as_const(m_corsHeaders)) {
+        headers.replaceOrAppend(header.first, header.second);
     }
+    response.setHeaders(std::move(headers));
+}
+
+void ApiServer::rebuildHeaderCache()
+{
+    m_securityHeaders.clear();
+    m_corsHeaders.clear();
+    m_staticHeaders.clear();
     
-    if (!m_config->getCrossOriginEmbedderPolicy().isEmpty()) {
-        response.setHeader("Cross-Origin-Embedder-Policy", m_config->getCrossOriginEmbedderPolicy().toUtf8());
+    if (!m_config) {
+        return;
     }
     
-    if (!m_config->getCrossOriginOpenerPolicy().isEmpty()) {
-        response.setHeader("Cross-Origin-Opener-Policy", m_config->getCrossOriginOpenerPolicy().toUtf8());
-    }
+    // Add basic security headers
+    m_securityHeaders.append({"X-Content-Type-Options", m_config->getContentTypeOptions().toUtf8()});
+    m_securityHeaders.append({"X-Frame-Options", m_config->getFrameOptions().toUtf8()});
+    m_securityHeaders.append({"Content-Security-Policy", m_config->getContentSecurityPolicy().toUtf8()});
     
-    if (!m_config->getCrossOriginResourcePolicy().isEmpty()) {
-        response.setHeader("Cross-Origin-Resource-Policy", m_config->getCrossOriginResourcePolicy().toUtf8());
+    // Add additional OWASP recommended headers, skipping those configured empty
+    const std::pair<const char *, QString> optionalHeaders[] = {
+        {"Permissions-Policy", m_config->getPermissionsPolicy()},
+        {"Referrer-Policy", m_config->getReferrerPolicy()},
+        {"X-XSS-Protection", m_config->getXssProtection()},
+        {"Cache-Control", m_config->getCacheControl()},
+        {"Clear-Site-Data", m_config->getClearSiteData()},
+        {"Cross-Origin-Embedder-Policy", m_config->getCrossOriginEmbedderPolicy()},
+        {"Cross-Origin-Opener-Policy", m_config->getCrossOriginOpenerPolicy()},
+        {"Cross-Origin-Resource-Policy", m_config->getCrossOriginResourcePolicy()},
+    };
+    for (const auto &header : optionalHeaders) {
+        if (!header.second.isEmpty()) {
+            m_securityHeaders.append({header.first, header.second.toUtf8()});
+        }
     }
     
     // Only add HSTS header if TLS is enabled
@@ -362,38 +1955,58 @@ void ApiServer::addSecurityHeaders(QHttpServerResponse &response)
         if (m_config->getHstsIncludeSubdomains()) {
             hstsValue += "; includeSubDomains";
         }
-        response.setHeader("Strict-Transport-Security", hstsValue.toUtf8());
+        m_securityHeaders.append({"Strict-Transport-Security", hstsValue.toUtf8()});
     }
-}
-
-void ApiServer::addCorsHeaders(QHttpServerResponse &response)
-{
+    
     if (m_corsEnabled) {
-        for (const auto &origin : m_corsAllowedOrigins) {
-            response.setHeader("Access-Control-Allow-Origin", origin.toUtf8());
+        // Each allowed origin replaces the previous one, so the last one is sent
+        if (!m_corsAllowedOrigins.isEmpty()) {
+            m_corsHeaders.append({"Access-Control-Allow-Origin", m_corsAllowedOrigins.last().toUtf8()});
         }
         
-        QString allowedMethods;
-        for (const auto &method : m_config->getAllowedMethods()) {
-            if (!allowedMethods.isEmpty()) {
-                allowedMethods += ", ";
-            }
-            allowedMethods += method;
+        m_corsHeaders.append({"Access-Control-Allow-Methods", m_config->getAllowedMethods().join(", ").toUtf8()});
+        m_corsHeaders.append({"Access-Control-Allow-Headers", m_config->getAllowedHeaders().join(", ").toUtf8()});
+        m_corsHeaders.append({"Access-Control-Max-Age", QByteArray::number(m_config->getCorsMaxAge())});
+    }
+    
+    // Static files are cacheable, so they get their own Cache-Control instead of the API's
+    for (const auto &header : std::as_const(m_securityHeaders)) {
+        if (header.first != "Cache-Control") {
+            m_staticHeaders.append(header);
         }
-        
-        QString allowedHeaders;
-        for (const auto &header : m_config->getAllowedHeaders()) {
-            if (!allowedHeaders.isEmpty()) {
-                allowedHeaders += ", ";
-            }
-            allowedHeaders += header;
+    }
+    m_staticHeaders.append(m_corsHeaders);
+}
+
+#ifdef API_STAGE_TIMING
+void ApiServer::addServerTimingHeader(QHttpServerResponse &response, const StageTimings &timings)
+{
+    // Only a sample of responses carries the header, 1 in serverTimingSampleRate
+    const int sampleRate = m_config ? m_config->getServerTimingSampleRate() : 0;
+    if (sampleRate <= 0) {
+        return;
+    }
+    
+    thread_local quint64 requestCount = 0;
+    if (requestCount++ % static_cast<quint64>(sampleRate) != 0) {
+        return;
+    }
+    
+    QByteArray value;
+    for (int stage = 0; stage < static_cast<int>(PipelineStage::Count); ++stage) {
+        if (!value.isEmpty()) {
+            value += ", ";
         }
-        
-        response.setHeader("Access-Control-Allow-Methods", allowedMethods.toUtf8());
-        response.setHeader("Access-Control-Allow-Headers", allowedHeaders.toUtf8());
-        response.setHeader("Access-Control-Max-Age", QString::number(m_config->getCorsMaxAge()).toUtf8());
+        value += pipelineStageName(static_cast<PipelineStage>(stage));
+        value += ";dur=";
+        value += QByteArray::number(StageClock::ticksToMicroseconds(timings.ticks[stage]) / 1000.0, 'f', 3);
     }
+    
+    QHttpHeaders headers = response.headers();
+    headers.replaceOrAppend("Server-Timing", value);
+    response.setHeaders(std::move(headers));
 }
+#endif
 
 QHttpServerResponse ApiServer::handleException(const std::exception &e, const QHttpServerRequest &request)
 {
@@ -413,6 +2026,27 @@ QHttpServerResponse ApiServer::handleException(const std::exception &e, const QH
     return response;
 }
 
+QString ApiServer::clientKeyOf(const QHttpServerRequest &request) const
+{
+    const QHostAddress peer = request.remoteAddress();
+    if (!peer.isNull() || m_unixListeners.isEmpty()) {
+        return ConnectionManager::clientKey(peer);
+    }
+    
+    // The peer of a Unix socket is the local proxy; the client is the one it forwards for. With
+    // the PROXY protocol the header is never consulted, not even for LOCAL connections, since
+    // the proxy is then not expected to overwrite what the client sent in it
+    QHostAddress client;
+    if (m_unixProxyProtocol) {
+        client = UnixSocketListener::currentClientAddress();
+    } else if (!m_trustedProxyHeader.isEmpty()) {
+        client = lastForwardedAddress(request.value(m_trustedProxyHeader));
+    }
+    
+    // Requests without a usable address share one limit
+    return client.isNull() ? QStringLiteral("unix") : ConnectionManager::clientKey(client);
+}
+
 bool ApiServer::isRateLimited(const QString &clientIp)
 {
     // Skip rate limiting if disabled
@@ -422,16 +2056,20 @@ bool ApiServer::isRateLimited(const QString &clientIp)
     
     // Check whitelist
     if (m_config && m_config->getRateLimitIpWhitelist().contains(clientIp)) {
+        Metrics::instance().recordRateLimitDecision(Metrics::RateLimitDecision::Exempt);
         return false;
     }
     
     QMutexLocker locker(&m_rateLimitMutex);
     
     // Increment request count for this client
-    m_clientRequests[clientIp]++;
+    const bool limited = ++m_clientRequests[clientIp] > m_rateLimit;
+    locker.unlock();
     
     // Check if client has exceeded rate limit
-    return m_clientRequests[clientIp] > m_rateLimit;
+    Metrics::instance().recordRateLimitDecision(limited ? Metrics::RateLimitDecision::Rejected
+                                                        : Metrics::RateLimitDecision::Allowed);
+    return limited;
 }
 
 QHttpServerResponse ApiServer::createRateLimitedResponse(const QString &clientIp)
@@ -443,7 +2081,9 @@ QHttpServerResponse ApiServer::createRateLimitedResponse(const QString &clientIp
     problem.addExtension("retryAfter", 60); // Try again in 60 seconds
     
     auto response = problem.toJsonResponse();
-    response.setHeader("Retry-After", "60");
+    QHttpHeaders headers = response.headers();
+    headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::RetryAfter, "60");
+    response.setHeaders(std::move(headers));
     
     // Add CORS headers if enabled
     addCorsHeaders(response);
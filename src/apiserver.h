@@ -8,11 +8,31 @@
 #include <QHostAddress>
 #include <QSslKey>
 #include <QSslCertificate>
+#include <QSslConfiguration>
+#include <QTcpServer>
 #include <QTimer>
 #include <QMap>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonArray>
 #include <QMutex>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <QThread>
+#include <QSet>
+#include "reverseproxy.h"
+#include "jwtauthenticator.h"
+#include "staticfiles.h"
+#include "idempotencyguard.h"
+#include "websockethub.h"
 
 class ConfigManager;
+class ConnectionManager;
+class EventLoopMonitor;
+class ResponseCache;
+class UnixSocketListener;
+struct StageTimings;
 
 class ApiServer : public QObject
 {
@@ -25,8 +45,36 @@ public:
     // Listen with improved security (default to localhost only)
     bool listen(int port, const QHostAddress &address = QHostAddress::LocalHost);
     
-    // Listen on HTTP port for HTTPS redirects (when TLS is enabled)
-    bool listenHttpRedirect(int httpPort, int httpsPort);
+    // Listen on an inherited, already bound socket (systemd socket activation or handoff)
+    bool listenOnDescriptor(qintptr socketDescriptor, int port);
+    
+    // Listen on HTTP port for HTTPS redirects (when TLS is enabled),
+    // optionally on an inherited, already bound socket
+    bool listenHttpRedirect(int httpPort, int httpsPort, qintptr socketDescriptor = -1);
+    
+    // Listen on a Unix domain socket for a reverse proxy on the same host, in addition to or instead
+    // of a TCP port; permissions are file mode bits such as 0660
+    bool listenUnix(const QString &path, int permissions = 0660);
+    
+    // Listen for WebSocket connections on a separate port; clients subscribe to topics
+    bool listenWebSocket(int port, const QHostAddress &address = QHostAddress::LocalHost);
+    
+    // Push a message to the WebSocket subscribers of a topic; returns the number of subscribers reached
+    int publish(const QString &topic, const QByteArray &payload, bool binary = false);
+    
+    // Listening socket descriptors keyed by listener name ("api", "redirect") for a handoff
+    QHash<QString, qintptr> listenerDescriptors() const;
+    
+    // Stop accepting new connections on all listeners
+    void stopAccepting();
+    
+    // Number of requests currently in progress, including those on the redirect and Unix socket listeners
+    int activeRequestCount() const;
+    
+    // Stop accepting, close keep-alive connections and wait for the requests in
+    // progress (up to the configured drain timeout); emits drained() when done
+    void drain();
+    bool isDraining() const;
     
     // Enable TLS/HTTPS
     bool enableTls(const QString &certPath, const QString &keyPath, const QString &keyPassphrase = QString());
@@ -42,10 +90,34 @@ public:
     
     // Set configuration manager
     void setConfig(ConfigManager *config);
+    
+    // Replace the in-memory Idempotency-Key store, e.g. with one that survives restarts
+    void setIdempotencyStore(std::unique_ptr<IdempotencyStore> store);
+
+signals:
+    // Emitted once draining has finished and the process may exit
+    void drained();
 
 private:
+    // The benchmarks exercise the private pipeline steps directly
+    friend class HotPathBenchmark;
+    
+    using RouteHandler = std::function<QHttpServerResponse(const QHttpServerRequest &)>;
+    
+    // Opt-in response caching for a route
+    struct CachePolicy
+    {
+        int ttlMs = 0;
+        QList<QByteArray> varyHeaders;  // Request headers that select between cached variants
+    };
+    
     QHttpServer *m_server;
     QHttpServer *m_redirectServer;  // Server for HTTP redirects
+    QThread *m_redirectThread;  // Worker thread running the redirect server
+    QObject *m_redirectContext;  // Owns the redirect server objects inside the worker thread
+    QTcpServer *m_redirectListener;  // Redirect listener, lives in the worker thread
+    ConnectionManager *m_redirectConnectionManager;  // Lives in the worker thread
+    EventLoopMonitor *m_redirectLoopMonitor;  // Lives in the worker thread, read through atomics
     bool m_corsEnabled;
     QStringList m_corsAllowedOrigins;
     int m_rateLimit;
@@ -55,18 +127,115 @@ private:
     bool m_tlsEnabled;
     ConfigManager *m_config;
     int m_httpsPort;  // HTTPS port for redirects
+    QSslConfiguration m_sslConfiguration;
+    ConnectionManager *m_connectionManager;  // Connection lifecycle limits for the listeners
+    QList<QTcpServer *> m_listeners;
+    QList<UnixSocketListener *> m_unixListeners;
+    bool m_unixProxyProtocol;  // The Unix sockets identify clients by their PROXY protocol header
+    QByteArray m_trustedProxyHeader;  // Otherwise carries the client address of requests on the Unix sockets
+    bool m_draining;
+    QTimer *m_drainTimer;  // Enforces the drain deadline
+    EventLoopMonitor *m_loopMonitor;  // Event-loop lag of the API thread
+    ResponseCache *m_responseCache;  // Shared by the routes registered with addCachedRoute
+    ReverseProxy *m_reverseProxy;  // Upstream connection pool of the API thread
+    QSet<QString> m_proxyPrefixes;  // Prefixes already routed to an upstream
+    QList<QByteArray> m_upstreamGauges;  // Per-upstream gauge names, unregistered on destruction
+    QList<QByteArray> m_upstreamCounters;  // Per-upstream counter names, unregistered on destruction
+    JwtAuthenticator *m_authenticator;  // Verifies bearer tokens and caches the verified ones
+    bool m_authEnabled;
+    QStringList m_authPrefixes;  // Path prefixes that require a bearer token
+    StaticFiles *m_staticFiles;  // Open, memory-mapped files of the static mounts
+    QSet<QString> m_staticPrefixes;  // Prefixes already serving static files
+    IdempotencyGuard *m_idempotency;  // Replays responses of POST and PATCH retries with an Idempotency-Key
+    bool m_idempotencyEnabled;
+    bool m_customIdempotencyStore;  // Set through setIdempotencyStore, kept across configuration changes
+    WebSocketHub *m_webSockets;  // Topic subscriptions of the WebSocket clients
+    
+    // Header name/value pairs serialized once from the configuration and shared by every response
+    QList<std::pair<QByteArray, QByteArray>> m_securityHeaders;
+    QList<std::pair<QByteArray, QByteArray>> m_corsHeaders;
+    StaticFiles::HeaderList m_staticHeaders;  // Security and CORS headers without Cache-Control
     
     void setupRoutes();
     void setupErrorHandler();
     void setupSecurityHeaders();
+    void finalizeResponse(const QHttpServerRequest &request, QHttpServerResponse &response);
     void addSecurityHeaders(QHttpServerResponse &response);
     void addCorsHeaders(QHttpServerResponse &response);
+    void rebuildHeaderCache();
+#ifdef API_STAGE_TIMING
+    void addServerTimingHeader(QHttpServerResponse &response, const StageTimings &timings);
+#endif
     QHttpServerResponse handleException(const std::exception &e, const QHttpServerRequest &request);
     bool isRateLimited(const QString &clientIp);
+    
+    // Rate limiting key of the client: its address, or for requests on a Unix socket the
+    // address forwarded by the proxy
+    QString clientKeyOf(const QHttpServerRequest &request) const;
+    void applyUnixSocketSettings();
     QHttpServerResponse createRateLimitedResponse(const QString &clientIp);
     void resetRateLimits();
     void setupHttpsRedirect(int httpPort, int httpsPort);
+    void stopHttpRedirect();
     QString getServerHostname() const;
+    void setupHttp2();
+    void applyConnectionLimits();
+    QTcpServer *createListener();
+    void setupHealthRoutes();
+    void setupAdminRoutes();
+    QJsonObject runtimeStats();
+    QJsonArray topRateLimitOffenders(int count);
+    void setupMetricsRoute();
+    
+    // Register a route whose handler runs inside the request pipeline
+    void addRoute(const QString &path, const RouteHandler &handler);
+    
+    // Register a route whose GET and HEAD responses are served from the response cache
+    void addCachedRoute(const QString &path, const CachePolicy &policy, const RouteHandler &handler);
+    void applyResponseCacheSettings();
+    
+    // Register a route whose POST, PUT and PATCH bodies must be JSON matching a schema;
+    // throws std::invalid_argument if the schema cannot be compiled
+    void addValidatedRoute(const QString &path, const QJsonObject &schema, const RouteHandler &handler);
+    
+    // Bearer token authentication in front of the protected prefixes
+    void applyAuthSettings();
+    bool requiresAuthentication(const QHttpServerRequest &request) const;
+    bool isProtectedPath(const QString &path) const;
+    QByteArray authChallenge(const JwtAuthenticator::Result &result) const;
+    QHttpServerResponse createAuthFailureResponse(const JwtAuthenticator::Result &result, const QHttpServerRequest &request);
+    
+    void applyIdempotencySettings();
+    
+    // Rate limiting and authentication of WebSocket upgrade requests
+    void applyWebSocketSettings();
+    std::optional<WebSocketHub::Rejection> admitWebSocket(const QString &path, const QByteArray &authorization,
+                                                          const QHostAddress &peer);
+    
+    // Mount the configured upstream prefixes; requests under them bypass the route pipeline
+    void setupProxyRoutes();
+    void addUpstreamGauges(const QString &prefix);
+    void forwardToUpstream(const ReverseProxy::Route &route, int routeId, const QHttpServerRequest &request,
+                           QHttpServerResponder &&responder);
+    
+    // Mount the configured static file directories
+    void setupStaticRoutes();
+    void serveStaticFile(const StaticFiles::Mount &mount, int routeId, const QHttpServerRequest &request,
+                         QHttpServerResponder &responder);
+    
+    // Rate limiting and authentication for routes answered through a responder;
+    // returns the response to send instead if the request may not proceed
+    std::optional<QHttpServerResponse> admissionFailure(const QHttpServerRequest &request, const QString &clientKey);
+    
+    // Request pipeline: rate limiting, authentication, handler, CORS and security headers, exception handling and metrics
+    QHttpServerResponse handleRequest(int routeId, const QHttpServerRequest &request, const RouteHandler &handler);
+    bool isAdminRequest(const QHttpServerRequest &request) const;
+    QHttpServerResponse adminForbiddenResponse(const QHttpServerRequest &request) const;
+    void checkDrained();
+    void finishDrain();
+    
+    // Load a PEM private key, detecting its algorithm (RSA, EC or DSA)
+    static QSslKey loadPrivateKey(const QByteArray &pemData, const QByteArray &passphrase);
 };
 
 #endif // APISERVER_H
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef ASCIICOPY_H
+#define ASCIICOPY_H
+
+#include <QString>
+
+/**
+ * @brief Copies a string into a fixed-size, NUL-terminated buffer without allocating
+ * 
+ * The string is truncated to fit; characters outside ASCII become '?'. Used to put
+ * strings into the trivially copyable records of the lock-free rings.
+ */
+template <int Size>
+inline void copyAscii(char (&destination)[Size], const QString &source)
+{
+    const int length = qMin(static_cast<int>(source.size()), Size - 1);
+    const QChar *data = source.constData();
+    for (int i = 0; i < length; ++i) {
+        const ushort unicode = data[i].unicode();
+        destination[i] = unicode < 0x80 ? static_cast<char>(unicode) : '?';
+    }
+    destination[length] = '\0';
+}
+
+/**
+ * @brief Copies a NUL-terminated string into a fixed-size buffer, truncating it to fit
+ */
+template <int Size>
+inline void copyAscii(char (&destination)[Size], const char *source)
+{
+    int i = 0;
+    for (; i < Size - 1 && source[i]; ++i) {
+        destination[i] = source[i];
+    }
+    destination[i] = '\0';
+}
+
+#endif // ASCIICOPY_H
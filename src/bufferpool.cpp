@@ -0,0 +1,46 @@
+#include "bufferpool.h"
+
+BufferPool::Slots &BufferPool::local()
+{
+    thread_local Slots slots;
+    return slots;
+}
+
+QByteArray BufferPool::acquire(qsizetype capacity)
+{
+    Slots &slots = local();
+    
+    // A slot is free when the pool holds the only reference to its buffer
+    for (QByteArray &buffer : slots.buffers) {
+        if (!buffer.isNull() && buffer.isDetached()) {
+            QByteArray reused = std::move(buffer);
+            buffer = QByteArray();
+            reused.truncate(0);  // Keeps the capacity
+            return reused;
+        }
+    }
+    
+    QByteArray buffer;
+    buffer.reserve(capacity);
+    return buffer;
+}
+
+void BufferPool::recycle(const QByteArray &buffer)
+{
+    if (buffer.isNull() || buffer.capacity() > MaxRetainedCapacity) {
+        return;
+    }
+    
+    Slots &slots = local();
+    
+    // Prefer an empty slot; otherwise replace slots round-robin
+    for (QByteArray &slot : slots.buffers) {
+        if (slot.isNull()) {
+            slot = buffer;
+            return;
+        }
+    }
+    
+    slots.buffers[slots.next] = buffer;
+    slots.next = (slots.next + 1) % SlotCount;
+}
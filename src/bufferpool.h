@@ -0,0 +1,53 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QByteArray>
+#include <array>
+
+/**
+ * @brief The BufferPool class recycles response body buffers on the calling thread
+ * 
+ * A buffer handed to a QHttpServerResponse is shared with the pool when it is recycled.
+ * Once the server has sent the response and dropped its reference, the pool holds the only
+ * reference again and the buffer's capacity can be reused for the next response, so that
+ * steady-state serialization does not allocate.
+ * 
+ * Usage:
+ * @code
+ * QByteArray body = BufferPool::acquire();
+ * body += ...;
+ * BufferPool::recycle(body);
+ * return QHttpServerResponse(mimeType, body);
+ * @endcode
+ */
+class BufferPool
+{
+public:
+    /**
+     * @brief Returns an empty buffer, reusing the capacity of a released one when possible
+     * 
+     * @param capacity The capacity to reserve for a new buffer
+     */
+    static QByteArray acquire(qsizetype capacity = 1024);
+    
+    /**
+     * @brief Lets the pool reuse a buffer once all other references to it are gone
+     * 
+     * Buffers larger than MaxRetainedCapacity are not kept.
+     */
+    static void recycle(const QByteArray &buffer);
+    
+    static constexpr int SlotCount = 32;
+    static constexpr qsizetype MaxRetainedCapacity = 64 * 1024;
+
+private:
+    struct Slots
+    {
+        std::array<QByteArray, SlotCount> buffers;
+        int next = 0;
+    };
+    
+    static Slots &local();
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,150 @@
+#include "circuitbreaker.h"
+#include <algorithm>
+#include <chrono>
+
+CircuitBreaker::CircuitBreaker(const Settings &settings)
+    : m_settings(settings),
+      m_state(State::Closed),
+      m_windowNext(0),
+      m_windowCount(0),
+      m_failures(0),
+      m_slowCalls(0),
+      m_openedAtMs(0),
+      m_probesInFlight(0),
+      m_probeSuccesses(0)
+{
+    m_settings.windowSize = std::max(1, m_settings.windowSize);
+    m_settings.halfOpenProbes = std::max(1, m_settings.halfOpenProbes);
+    m_window.assign(static_cast<size_t>(m_settings.windowSize), Success);
+}
+
+bool CircuitBreaker::tryAcquire()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    if (m_state == State::Open) {
+        const qint64 now = nowMs();
+        if (now - m_openedAtMs < m_settings.openDurationMs) {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        transitionTo(State::HalfOpen, now);
+    }
+    
+    if (m_state == State::HalfOpen) {
+        // Only a limited number of probes at a time; everything else keeps failing fast
+        if (m_probesInFlight >= m_settings.halfOpenProbes) {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ++m_probesInFlight;
+    }
+    
+    return true;
+}
+
+void CircuitBreaker::record(bool success, qint64 latencyMs)
+{
+    const quint8 outcome = !success ? Failure : (latencyMs > m_settings.slowCallMs ? Slow : Success);
+    
+    QMutexLocker locker(&m_mutex);
+    
+    switch (m_state) {
+    case State::HalfOpen:
+        m_probesInFlight = std::max(0, m_probesInFlight - 1);
+        if (outcome != Success) {
+            transitionTo(State::Open, nowMs());
+        } else if (++m_probeSuccesses >= m_settings.halfOpenProbes) {
+            transitionTo(State::Closed, nowMs());
+        }
+        break;
+    case State::Closed: {
+        // Replace the oldest outcome in the window
+        if (m_windowCount == m_settings.windowSize) {
+            const quint8 oldest = m_window[static_cast<size_t>(m_windowNext)];
+            m_failures -= (oldest == Failure);
+            m_slowCalls -= (oldest == Slow);
+        } else {
+            ++m_windowCount;
+        }
+        m_window[static_cast<size_t>(m_windowNext)] = outcome;
+        m_windowNext = (m_windowNext + 1) % m_settings.windowSize;
+        m_failures += (outcome == Failure);
+        m_slowCalls += (outcome == Slow);
+        
+        if (m_windowCount >= m_settings.minimumCalls
+                && (m_failures * 100 >= m_settings.failureRatePercent * m_windowCount
+                    || m_slowCalls * 100 >= m_settings.slowCallRatePercent * m_windowCount)) {
+            transitionTo(State::Open, nowMs());
+        }
+        break;
+    }
+    case State::Open:
+        // A call admitted before the breaker opened; its outcome no longer matters
+        break;
+    }
+}
+
+CircuitBreaker::State CircuitBreaker::state() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_state;
+}
+
+qint64 CircuitBreaker::remainingOpenMs() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_state != State::Open) {
+        return 0;
+    }
+    return std::max<qint64>(0, m_openedAtMs + m_settings.openDurationMs - nowMs());
+}
+
+quint64 CircuitBreaker::rejectedCount() const
+{
+    return m_rejected.load(std::memory_order_relaxed);
+}
+
+const char *CircuitBreaker::stateName(State state)
+{
+    switch (state) {
+    case State::Closed:
+        return "closed";
+    case State::HalfOpen:
+        return "half-open";
+    case State::Open:
+        return "open";
+    }
+    return "unknown";
+}
+
+void CircuitBreaker::transitionTo(State state, qint64 nowMs)
+{
+    m_state = state;
+    m_probesInFlight = 0;
+    m_probeSuccesses = 0;
+    
+    if (state == State::Open) {
+        m_openedAtMs = nowMs;
+    }
+    
+    // Every period of closed operation starts with an empty window
+    if (state == State::Closed) {
+        resetWindow();
+    }
+}
+
+void CircuitBreaker::resetWindow()
+{
+    std::fill(m_window.begin(), m_window.end(), Success);
+    m_windowNext = 0;
+    m_windowCount = 0;
+    m_failures = 0;
+    m_slowCalls = 0;
+}
+
+qint64 CircuitBreaker::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
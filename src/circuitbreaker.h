@@ -0,0 +1,91 @@
+#ifndef CIRCUITBREAKER_H
+#define CIRCUITBREAKER_H
+
+#include <QMutex>
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief The CircuitBreaker class stops calls to a dependency that keeps failing or responding slowly
+ * 
+ * While closed, the outcomes of the most recent calls are kept in a sliding window. Once the
+ * window holds enough calls and the share of failed or slow calls crosses its threshold, the
+ * breaker opens and rejects every call without contacting the dependency. After the open
+ * period it lets a few probe calls through (half-open): if they all succeed it closes again,
+ * and any failure reopens it.
+ * 
+ * Thread-safe; callers must pair each successful tryAcquire() with one record().
+ */
+class CircuitBreaker
+{
+public:
+    enum class State {
+        Closed,
+        HalfOpen,
+        Open
+    };
+    
+    struct Settings
+    {
+        int windowSize = 20;            // Most recent calls considered
+        int minimumCalls = 10;          // Calls in the window before the rates are evaluated
+        int failureRatePercent = 50;    // Opens at or above this share of failed calls
+        int slowCallMs = 2000;          // A successful call slower than this counts as slow
+        int slowCallRatePercent = 80;   // Opens at or above this share of slow calls
+        int openDurationMs = 10000;     // Time spent open before probing
+        int halfOpenProbes = 3;         // Successful probes needed to close
+    };
+    
+    explicit CircuitBreaker(const Settings &settings = Settings());
+    
+    /**
+     * @brief Returns true if a call may proceed, false if it must fail fast
+     */
+    bool tryAcquire();
+    
+    /**
+     * @brief Records the outcome of a call admitted by tryAcquire()
+     */
+    void record(bool success, qint64 latencyMs);
+    
+    State state() const;
+    
+    /**
+     * @brief Returns how long the breaker stays open, or 0 if it is not open
+     */
+    qint64 remainingOpenMs() const;
+    
+    /**
+     * @brief Returns the number of calls rejected without contacting the dependency
+     */
+    quint64 rejectedCount() const;
+    
+    static const char *stateName(State state);
+
+private:
+    enum Outcome : quint8 {
+        Success = 0,
+        Failure = 1,
+        Slow = 2
+    };
+    
+    Settings m_settings;
+    mutable QMutex m_mutex;
+    State m_state;
+    std::vector<quint8> m_window;  // Ring of Outcome values
+    int m_windowNext;
+    int m_windowCount;
+    int m_failures;
+    int m_slowCalls;
+    qint64 m_openedAtMs;
+    int m_probesInFlight;
+    int m_probeSuccesses;
+    std::atomic<quint64> m_rejected{0};
+    
+    void transitionTo(State state, qint64 nowMs);
+    void resetWindow();
+    static qint64 nowMs();
+};
+
+#endif // CIRCUITBREAKER_H
@@ -0,0 +1,84 @@
+#include "concurrencylimiter.h"
+#include <algorithm>
+#include <limits>
+
+ConcurrencyLimiter::ConcurrencyLimiter(const Settings &settings)
+    : m_settings(settings),
+      m_inFlight(0),
+      m_baselineUs(0),
+      m_windowMinUs(std::numeric_limits<qint64>::max()),
+      m_windowCalls(0)
+{
+    m_settings.minLimit = std::max(1, m_settings.minLimit);
+    m_settings.maxLimit = std::max(m_settings.minLimit, m_settings.maxLimit);
+    m_settings.baselineWindow = std::max(1, m_settings.baselineWindow);
+    m_limit = std::clamp(settings.initialLimit, m_settings.minLimit, m_settings.maxLimit);
+}
+
+bool ConcurrencyLimiter::tryAcquire()
+{
+    QMutexLocker locker(&m_mutex);
+    
+    if (m_inFlight >= static_cast<int>(m_limit)) {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    ++m_inFlight;
+    return true;
+}
+
+void ConcurrencyLimiter::release(qint64 latencyUs, bool failed)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    const int inFlight = m_inFlight;
+    m_inFlight = std::max(0, m_inFlight - 1);
+    
+    // The baseline is the best latency of the previous window, so that it follows a
+    // dependency whose normal latency changes instead of holding on to an old minimum
+    if (!failed) {
+        m_windowMinUs = std::min(m_windowMinUs, latencyUs);
+        if (m_baselineUs == 0) {
+            m_baselineUs = latencyUs;
+        }
+    }
+    if (++m_windowCalls >= m_settings.baselineWindow && m_windowMinUs != std::numeric_limits<qint64>::max()) {
+        m_baselineUs = m_windowMinUs;
+        m_windowMinUs = std::numeric_limits<qint64>::max();
+        m_windowCalls = 0;
+    }
+    
+    const bool congested = failed
+        || (m_baselineUs > 0 && latencyUs * 100 > m_baselineUs * m_settings.latencyTolerancePercent);
+    
+    if (congested) {
+        m_limit = std::max<double>(m_settings.minLimit, m_limit * m_settings.backoffPercent / 100.0);
+    } else if (inFlight * 2 >= static_cast<int>(m_limit)) {
+        // Only grow while the limit is actually being used
+        m_limit = std::min<double>(m_settings.maxLimit, m_limit + 1.0 / m_limit);
+    }
+}
+
+void ConcurrencyLimiter::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+    m_inFlight = std::max(0, m_inFlight - 1);
+}
+
+int ConcurrencyLimiter::limit() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_limit);
+}
+
+int ConcurrencyLimiter::inFlight() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_inFlight;
+}
+
+quint64 ConcurrencyLimiter::rejectedCount() const
+{
+    return m_rejected.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+#ifndef CONCURRENCYLIMITER_H
+#define CONCURRENCYLIMITER_H
+
+#include <QMutex>
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief The ConcurrencyLimiter class adapts the number of concurrent calls to a dependency to its latency
+ * 
+ * The limit follows additive-increase/multiplicative-decrease (AIMD). A call counts as a sign
+ * of congestion when it fails or when its latency exceeds the best latency seen recently by
+ * more than the configured tolerance; the limit is then multiplied by the backoff ratio.
+ * Otherwise, while at least half of the limit is in use, each call raises the limit by
+ * 1/limit, about one per round trip. Calls beyond the limit are rejected immediately instead
+ * of queueing behind a slow dependency.
+ * 
+ * Thread-safe; callers must pair each successful tryAcquire() with release() or cancel().
+ */
+class ConcurrencyLimiter
+{
+public:
+    struct Settings
+    {
+        int initialLimit = 20;
+        int minLimit = 1;
+        int maxLimit = 200;
+        int backoffPercent = 90;             // Limit multiplier on congestion
+        int latencyTolerancePercent = 200;   // Latency above this share of the baseline is congestion
+        int baselineWindow = 500;            // Calls after which the baseline latency is re-measured
+    };
+    
+    explicit ConcurrencyLimiter(const Settings &settings = Settings());
+    
+    /**
+     * @brief Returns true if another call may start
+     */
+    bool tryAcquire();
+    
+    /**
+     * @brief Ends a call and adjusts the limit from its outcome
+     * 
+     * @param latencyUs The call's latency
+     * @param failed True if the call failed or timed out
+     */
+    void release(qint64 latencyUs, bool failed);
+    
+    /**
+     * @brief Ends a call that was admitted but never made, without adjusting the limit
+     */
+    void cancel();
+    
+    int limit() const;
+    int inFlight() const;
+    
+    /**
+     * @brief Returns the number of calls rejected because the limit was reached
+     */
+    quint64 rejectedCount() const;
+
+private:
+    Settings m_settings;
+    mutable QMutex m_mutex;
+    double m_limit;
+    int m_inFlight;
+    qint64 m_baselineUs;       // Lowest latency of the previous window
+    qint64 m_windowMinUs;      // Lowest latency of the current window
+    int m_windowCalls;
+    std::atomic<quint64> m_rejected{0};
+};
+
+#endif // CONCURRENCYLIMITER_H
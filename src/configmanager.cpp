@@ -73,6 +73,11 @@ bool ConfigManager::processCommandLine()
                                     "HTTP port for redirects", "port", "80");
     parser.addOption(httpPortOption);
     
+    // HTTP/2 options
+    QCommandLineOption http2Option(QStringList() << "http2",
+                                 "Enable HTTP/2 on the TLS listener", "enable", "true");
+    parser.addOption(http2Option);
+    
     // Rate limiting options
     QCommandLineOption rateLimitOption(QStringList() << "rate-limit",
                                      "Enable rate limiting", "enable", "true");
@@ -144,6 +149,13 @@ bool ConfigManager::processCommandLine()
         serverObj["httpRedirect"] = httpRedirectObj;
     }
     
+    // HTTP/2 overrides
+    if (parser.isSet(http2Option)) {
+        QJsonObject http2Obj = serverObj["http2"].toObject();
+        http2Obj["enabled"] = (parser.value(http2Option).toLower() == "true");
+        serverObj["http2"] = http2Obj;
+    }
+    
     m_config["server"] = serverObj;
     
     // Rate limiting overrides
@@ -249,6 +261,81 @@ int ConfigManager::getHttpPort() const
     return getInt({"server", "httpRedirect", "httpPort"}, 80);
 }
 
+QString ConfigManager::getRedirectCanonicalHost() const
+{
+    return getString({"server", "httpRedirect", "canonicalHost"}, "");
+}
+
+QStringList ConfigManager::getRedirectAllowedHosts() const
+{
+    return getStringList({"server", "httpRedirect", "allowedHosts"}, {});
+}
+
+bool ConfigManager::isHttp2Enabled() const
+{
+    return getBool({"server", "http2", "enabled"}, true);
+}
+
+int ConfigManager::getHttp2MaxConcurrentStreams() const
+{
+    return getInt({"server", "http2", "maxConcurrentStreams"}, 100);
+}
+
+int ConfigManager::getHttp2StreamWindowSize() const
+{
+    return getInt({"server", "http2", "streamWindowSize"}, 65535);
+}
+
+bool ConfigManager::isHandoffEnabled() const
+{
+    return getBool({"server", "handoff", "enabled"}, false);
+}
+
+QString ConfigManager::getHandoffSocketPath() const
+{
+    return getString({"server", "handoff", "socketPath"}, "/run/qt6-web-api/handoff.sock");
+}
+
+int ConfigManager::getDrainTimeoutMs() const
+{
+    return getInt({"server", "shutdown", "drainTimeoutMs"}, 30000);
+}
+
+bool ConfigManager::isAdminEnabled() const
+{
+    return getBool({"admin", "enabled"}, true);
+}
+
+QStringList ConfigManager::getAdminAllowedAddresses() const
+{
+    return getStringList({"admin", "allowedAddresses"}, {"127.0.0.1", "::1"});
+}
+
+int ConfigManager::getIdleTimeoutMs() const
+{
+    return getInt({"server", "connections", "idleTimeoutMs"}, 30000);
+}
+
+int ConfigManager::getHeaderTimeoutMs() const
+{
+    return getInt({"server", "connections", "headerTimeoutMs"}, 10000);
+}
+
+int ConfigManager::getRequestTimeoutMs() const
+{
+    return getInt({"server", "connections", "requestTimeoutMs"}, 30000);
+}
+
+int ConfigManager::getMaxConnectionsPerIp() const
+{
+    return getInt({"server", "connections", "maxPerIp"}, 64);
+}
+
+int ConfigManager::getMaxConnections() const
+{
+    return getInt({"server", "connections", "maxConnections"}, 10000);
+}
+
 bool ConfigManager::isRateLimitEnabled() const
 {
     return getBool({"security", "rateLimit", "enabled"}, true);
@@ -389,6 +476,326 @@ QString ConfigManager::getContactEmail() const
     return getString({"problemDetails", "contactEmail"}, "");
 }
 
+bool ConfigManager::isMetricsEnabled() const
+{
+    return getBool({"metrics", "enabled"}, true);
+}
+
+QStringList ConfigManager::getMetricsAllowedAddresses() const
+{
+    return getStringList({"metrics", "allowedAddresses"}, {"127.0.0.1", "::1"});
+}
+
+int ConfigManager::getServerTimingSampleRate() const
+{
+    return getInt({"diagnostics", "serverTimingSampleRate"}, 0);
+}
+
+bool ConfigManager::isTracingEnabled() const
+{
+    return getBool({"tracing", "enabled"}, false);
+}
+
+int ConfigManager::getTracingSampleRate() const
+{
+    return getInt({"tracing", "sampleRate"}, 100);
+}
+
+QString ConfigManager::getTracingExporter() const
+{
+    return getString({"tracing", "exporter"}, "file");
+}
+
+QString ConfigManager::getTracingFile() const
+{
+    return getString({"tracing", "file"}, "spans.jsonl");
+}
+
+QString ConfigManager::getTracingEndpoint() const
+{
+    return getString({"tracing", "endpoint"}, "http://127.0.0.1:4318/v1/traces");
+}
+
+QString ConfigManager::getTracingServiceName() const
+{
+    return getString({"tracing", "serviceName"}, "qt6-web-api");
+}
+
+QJsonArray ConfigManager::getProxyRoutes() const
+{
+    const QJsonValue routes = m_config["proxy"].toObject()["routes"];
+    return routes.isArray() ? routes.toArray() : QJsonArray();
+}
+
+int ConfigManager::getProxyTimeoutMs() const
+{
+    return getInt({"proxy", "timeoutMs"}, 30000);
+}
+
+int ConfigManager::getProxyIdleTimeoutMs() const
+{
+    return getInt({"proxy", "idleTimeoutMs"}, 30000);
+}
+
+int ConfigManager::getCircuitBreakerWindowSize() const
+{
+    return getInt({"proxy", "circuitBreaker", "windowSize"}, 20);
+}
+
+int ConfigManager::getCircuitBreakerMinimumCalls() const
+{
+    return getInt({"proxy", "circuitBreaker", "minimumCalls"}, 10);
+}
+
+int ConfigManager::getCircuitBreakerFailureRatePercent() const
+{
+    return getInt({"proxy", "circuitBreaker", "failureRatePercent"}, 50);
+}
+
+int ConfigManager::getCircuitBreakerSlowCallMs() const
+{
+    return getInt({"proxy", "circuitBreaker", "slowCallMs"}, 2000);
+}
+
+int ConfigManager::getCircuitBreakerSlowCallRatePercent() const
+{
+    return getInt({"proxy", "circuitBreaker", "slowCallRatePercent"}, 80);
+}
+
+int ConfigManager::getCircuitBreakerOpenDurationMs() const
+{
+    return getInt({"proxy", "circuitBreaker", "openDurationMs"}, 10000);
+}
+
+int ConfigManager::getCircuitBreakerHalfOpenProbes() const
+{
+    return getInt({"proxy", "circuitBreaker", "halfOpenProbes"}, 3);
+}
+
+int ConfigManager::getConcurrencyInitialLimit() const
+{
+    return getInt({"proxy", "concurrency", "initialLimit"}, 20);
+}
+
+int ConfigManager::getConcurrencyMinLimit() const
+{
+    return getInt({"proxy", "concurrency", "minLimit"}, 1);
+}
+
+int ConfigManager::getConcurrencyMaxLimit() const
+{
+    return getInt({"proxy", "concurrency", "maxLimit"}, 200);
+}
+
+int ConfigManager::getConcurrencyBackoffPercent() const
+{
+    return getInt({"proxy", "concurrency", "backoffPercent"}, 90);
+}
+
+int ConfigManager::getConcurrencyLatencyTolerancePercent() const
+{
+    return getInt({"proxy", "concurrency", "latencyTolerancePercent"}, 200);
+}
+
+bool ConfigManager::isResponseCacheEnabled() const
+{
+    return getBool({"responseCache", "enabled"}, true);
+}
+
+int ConfigManager::getResponseCacheMaxSizeMb() const
+{
+    return getInt({"responseCache", "maxSizeMb"}, 64);
+}
+
+int ConfigManager::getResponseCacheShards() const
+{
+    return getInt({"responseCache", "shards"}, 16);
+}
+
+int ConfigManager::getResponseCacheCompressMinBytes() const
+{
+    return getInt({"responseCache", "compressMinBytes"}, 1024);
+}
+
+bool ConfigManager::isAuthEnabled() const
+{
+    return getBool({"auth", "enabled"}, false);
+}
+
+QString ConfigManager::getAuthJwksFile() const
+{
+    return getString({"auth", "jwksFile"}, "jwks.json");
+}
+
+QString ConfigManager::getAuthIssuer() const
+{
+    return getString({"auth", "issuer"}, "");
+}
+
+QString ConfigManager::getAuthAudience() const
+{
+    return getString({"auth", "audience"}, "");
+}
+
+QStringList ConfigManager::getAuthProtectedPrefixes() const
+{
+    return getStringList({"auth", "protectedPrefixes"}, {"/api"});
+}
+
+QStringList ConfigManager::getAuthRequiredScopes() const
+{
+    return getStringList({"auth", "requiredScopes"}, {});
+}
+
+int ConfigManager::getAuthLeewaySeconds() const
+{
+    return getInt({"auth", "leewaySeconds"}, 60);
+}
+
+int ConfigManager::getAuthCacheMaxEntries() const
+{
+    return getInt({"auth", "cacheMaxEntries"}, 10000);
+}
+
+int ConfigManager::getAuthCacheShards() const
+{
+    return getInt({"auth", "cacheShards"}, 16);
+}
+
+QJsonArray ConfigManager::getStaticFileMounts() const
+{
+    const QJsonValue mounts = m_config["staticFiles"].toObject()["mounts"];
+    return mounts.isArray() ? mounts.toArray() : QJsonArray();
+}
+
+int ConfigManager::getStaticFileMaxOpenFiles() const
+{
+    return getInt({"staticFiles", "maxOpenFiles"}, 256);
+}
+
+int ConfigManager::getStaticFileRevalidateMs() const
+{
+    return getInt({"staticFiles", "revalidateMs"}, 1000);
+}
+
+int ConfigManager::getStaticFileStreamThresholdKb() const
+{
+    return getInt({"staticFiles", "streamThresholdKb"}, 256);
+}
+
+int ConfigManager::getStaticFileMaxAgeSeconds() const
+{
+    return getInt({"staticFiles", "maxAgeSeconds"}, 3600);
+}
+
+bool ConfigManager::isIdempotencyEnabled() const
+{
+    return getBool({"idempotency", "enabled"}, true);
+}
+
+int ConfigManager::getIdempotencyTtlSeconds() const
+{
+    return getInt({"idempotency", "ttlSeconds"}, 86400);
+}
+
+int ConfigManager::getIdempotencyMaxEntries() const
+{
+    return getInt({"idempotency", "maxEntries"}, 10000);
+}
+
+int ConfigManager::getIdempotencyMaxSizeMb() const
+{
+    return getInt({"idempotency", "maxSizeMb"}, 16);
+}
+
+int ConfigManager::getIdempotencyWaitTimeoutMs() const
+{
+    return getInt({"idempotency", "waitTimeoutMs"}, 10000);
+}
+
+bool ConfigManager::isWebSocketEnabled() const
+{
+    return getBool({"webSocket", "enabled"}, false);
+}
+
+int ConfigManager::getWebSocketPort() const
+{
+    return getInt({"webSocket", "port"}, 8081);
+}
+
+QString ConfigManager::getWebSocketPath() const
+{
+    return getString({"webSocket", "path"}, "/ws");
+}
+
+int ConfigManager::getWebSocketMaxConnections() const
+{
+    return getInt({"webSocket", "maxConnections"}, 10000);
+}
+
+int ConfigManager::getWebSocketMaxQueueKb() const
+{
+    return getInt({"webSocket", "maxQueueKb"}, 1024);
+}
+
+QString ConfigManager::getWebSocketSlowConsumerPolicy() const
+{
+    return getString({"webSocket", "slowConsumerPolicy"}, "drop");
+}
+
+int ConfigManager::getWebSocketMaxMessageKb() const
+{
+    return getInt({"webSocket", "maxMessageKb"}, 64);
+}
+
+int ConfigManager::getWebSocketMaxTopicsPerConnection() const
+{
+    return getInt({"webSocket", "maxTopicsPerConnection"}, 32);
+}
+
+int ConfigManager::getWebSocketPingIntervalMs() const
+{
+    return getInt({"webSocket", "pingIntervalMs"}, 30000);
+}
+
+bool ConfigManager::isUnixSocketEnabled() const
+{
+    return getBool({"unixSocket", "enabled"}, false);
+}
+
+QString ConfigManager::getUnixSocketPath() const
+{
+    return getString({"unixSocket", "path"}, "/run/qt6-web-api/api.sock");
+}
+
+int ConfigManager::getUnixSocketPermissions() const
+{
+    // An octal file mode string, e.g. "0660"
+    bool ok = false;
+    const int permissions = getString({"unixSocket", "permissions"}, "0660").toInt(&ok, 8);
+    return ok && permissions >= 0 && permissions <= 0777 ? permissions : 0660;
+}
+
+bool ConfigManager::isUnixSocketExclusive() const
+{
+    return getBool({"unixSocket", "exclusive"}, false);
+}
+
+bool ConfigManager::isUnixSocketProxyProtocolEnabled() const
+{
+    return getBool({"unixSocket", "proxyProtocol"}, false);
+}
+
+int ConfigManager::getUnixSocketHeaderTimeoutMs() const
+{
+    return getInt({"unixSocket", "headerTimeoutMs"}, 5000);
+}
+
+QString ConfigManager::getUnixSocketTrustedProxyHeader() const
+{
+    return getString({"unixSocket", "trustedProxyHeader"}, "X-Forwarded-For");
+}
+
 QString ConfigManager::getLogLevel() const
 {
     return getString({"logging", "level"}, "info");
@@ -409,6 +816,16 @@ bool ConfigManager::includeTimestamp() const
     return getBool({"logging", "includeTimestamp"}, true);
 }
 
+int ConfigManager::getLogMaxFileSizeMb() const
+{
+    return getInt({"logging", "maxFileSizeMb"}, 100);
+}
+
+int ConfigManager::getLogMaxFiles() const
+{
+    return getInt({"logging", "maxFiles"}, 5);
+}
+
 void ConfigManager::setDefaults()
 {
     // Create default configuration
@@ -420,8 +837,33 @@ void ConfigManager::setDefaults()
     QJsonObject httpRedirectObj;
     httpRedirectObj["enabled"] = false;
     httpRedirectObj["httpPort"] = 80;
+    httpRedirectObj["canonicalHost"] = "";
+    httpRedirectObj["allowedHosts"] = QJsonArray();
     serverObj["httpRedirect"] = httpRedirectObj;
     
+    QJsonObject http2Obj;
+    http2Obj["enabled"] = true;
+    http2Obj["maxConcurrentStreams"] = 100;
+    http2Obj["streamWindowSize"] = 65535;
+    serverObj["http2"] = http2Obj;
+    
+    QJsonObject connectionsObj;
+    connectionsObj["idleTimeoutMs"] = 30000;
+    connectionsObj["headerTimeoutMs"] = 10000;
+    connectionsObj["requestTimeoutMs"] = 30000;
+    connectionsObj["maxPerIp"] = 64;
+    connectionsObj["maxConnections"] = 10000;
+    serverObj["connections"] = connectionsObj;
+    
+    QJsonObject handoffObj;
+    handoffObj["enabled"] = false;
+    handoffObj["socketPath"] = "/run/qt6-web-api/handoff.sock";
+    serverObj["handoff"] = handoffObj;
+    
+    QJsonObject shutdownObj;
+    shutdownObj["drainTimeoutMs"] = 30000;
+    serverObj["shutdown"] = shutdownObj;
+    
     QJsonObject rateLimitObj;
     rateLimitObj["enabled"] = true;
     rateLimitObj["maxRequestsPerMinute"] = 100;
@@ -483,12 +925,126 @@ void ConfigManager::setDefaults()
     loggingObj["file"] = "";
     loggingObj["console"] = true;
     loggingObj["includeTimestamp"] = true;
+    loggingObj["maxFileSizeMb"] = 100;
+    loggingObj["maxFiles"] = 5;
+    
+    QJsonObject adminObj;
+    adminObj["enabled"] = true;
+    QJsonArray adminAddressesArray;
+    adminAddressesArray.append("127.0.0.1");
+    adminAddressesArray.append("::1");
+    adminObj["allowedAddresses"] = adminAddressesArray;
+    
+    QJsonObject metricsObj;
+    metricsObj["enabled"] = true;
+    QJsonArray metricsAddressesArray;
+    metricsAddressesArray.append("127.0.0.1");
+    metricsAddressesArray.append("::1");
+    metricsObj["allowedAddresses"] = metricsAddressesArray;
+    
+    QJsonObject diagnosticsObj;
+    diagnosticsObj["serverTimingSampleRate"] = 0;
+    
+    QJsonObject tracingObj;
+    tracingObj["enabled"] = false;
+    tracingObj["sampleRate"] = 100;
+    tracingObj["exporter"] = "file";
+    tracingObj["file"] = "spans.jsonl";
+    tracingObj["endpoint"] = "http://127.0.0.1:4318/v1/traces";
+    tracingObj["serviceName"] = "qt6-web-api";
+    
+    QJsonObject proxyObj;
+    proxyObj["timeoutMs"] = 30000;
+    proxyObj["idleTimeoutMs"] = 30000;
+    proxyObj["routes"] = QJsonArray();
+    
+    QJsonObject circuitBreakerObj;
+    circuitBreakerObj["windowSize"] = 20;
+    circuitBreakerObj["minimumCalls"] = 10;
+    circuitBreakerObj["failureRatePercent"] = 50;
+    circuitBreakerObj["slowCallMs"] = 2000;
+    circuitBreakerObj["slowCallRatePercent"] = 80;
+    circuitBreakerObj["openDurationMs"] = 10000;
+    circuitBreakerObj["halfOpenProbes"] = 3;
+    proxyObj["circuitBreaker"] = circuitBreakerObj;
+    
+    QJsonObject concurrencyObj;
+    concurrencyObj["initialLimit"] = 20;
+    concurrencyObj["minLimit"] = 1;
+    concurrencyObj["maxLimit"] = 200;
+    concurrencyObj["backoffPercent"] = 90;
+    concurrencyObj["latencyTolerancePercent"] = 200;
+    proxyObj["concurrency"] = concurrencyObj;
+    
+    QJsonObject responseCacheObj;
+    responseCacheObj["enabled"] = true;
+    responseCacheObj["maxSizeMb"] = 64;
+    responseCacheObj["shards"] = 16;
+    responseCacheObj["compressMinBytes"] = 1024;
+    
+    QJsonObject authObj;
+    authObj["enabled"] = false;
+    authObj["jwksFile"] = "jwks.json";
+    authObj["issuer"] = "";
+    authObj["audience"] = "";
+    QJsonArray authPrefixesArray;
+    authPrefixesArray.append("/api");
+    authObj["protectedPrefixes"] = authPrefixesArray;
+    authObj["requiredScopes"] = QJsonArray();
+    authObj["leewaySeconds"] = 60;
+    authObj["cacheMaxEntries"] = 10000;
+    authObj["cacheShards"] = 16;
+    
+    QJsonObject staticFilesObj;
+    staticFilesObj["maxOpenFiles"] = 256;
+    staticFilesObj["revalidateMs"] = 1000;
+    staticFilesObj["streamThresholdKb"] = 256;
+    staticFilesObj["maxAgeSeconds"] = 3600;
+    staticFilesObj["mounts"] = QJsonArray();
+    
+    QJsonObject idempotencyObj;
+    idempotencyObj["enabled"] = true;
+    idempotencyObj["ttlSeconds"] = 86400;
+    idempotencyObj["maxEntries"] = 10000;
+    idempotencyObj["maxSizeMb"] = 16;
+    idempotencyObj["waitTimeoutMs"] = 10000;
+    
+    QJsonObject webSocketObj;
+    webSocketObj["enabled"] = false;
+    webSocketObj["port"] = 8081;
+    webSocketObj["path"] = "/ws";
+    webSocketObj["maxConnections"] = 10000;
+    webSocketObj["maxQueueKb"] = 1024;
+    webSocketObj["slowConsumerPolicy"] = "drop";
+    webSocketObj["maxMessageKb"] = 64;
+    webSocketObj["maxTopicsPerConnection"] = 32;
+    webSocketObj["pingIntervalMs"] = 30000;
+    
+    QJsonObject unixSocketObj;
+    unixSocketObj["enabled"] = false;
+    unixSocketObj["path"] = "/run/qt6-web-api/api.sock";
+    unixSocketObj["permissions"] = "0660";
+    unixSocketObj["exclusive"] = false;
+    unixSocketObj["proxyProtocol"] = false;
+    unixSocketObj["headerTimeoutMs"] = 5000;
+    unixSocketObj["trustedProxyHeader"] = "X-Forwarded-For";
     
     QJsonObject configObj;
     configObj["server"] = serverObj;
     configObj["security"] = securityObj;
     configObj["problemDetails"] = problemDetailsObj;
     configObj["logging"] = loggingObj;
+    configObj["metrics"] = metricsObj;
+    configObj["diagnostics"] = diagnosticsObj;
+    configObj["tracing"] = tracingObj;
+    configObj["proxy"] = proxyObj;
+    configObj["responseCache"] = responseCacheObj;
+    configObj["auth"] = authObj;
+    configObj["staticFiles"] = staticFilesObj;
+    configObj["idempotency"] = idempotencyObj;
+    configObj["webSocket"] = webSocketObj;
+    configObj["unixSocket"] = unixSocketObj;
+    configObj["admin"] = adminObj;
     
     m_config = configObj;
 }
@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QStringList>
 #include <QHostAddress>
 
@@ -43,6 +44,31 @@ public:
     // HTTP to HTTPS redirect settings
     bool isHttpRedirectEnabled() const;
     int getHttpPort() const;
+    QString getRedirectCanonicalHost() const;
+    QStringList getRedirectAllowedHosts() const;
+    
+    // HTTP/2 settings (TLS listener only, negotiated via ALPN)
+    bool isHttp2Enabled() const;
+    int getHttp2MaxConcurrentStreams() const;
+    int getHttp2StreamWindowSize() const;
+    
+    // Listening socket handoff settings
+    bool isHandoffEnabled() const;
+    QString getHandoffSocketPath() const;
+    
+    // Shutdown settings
+    int getDrainTimeoutMs() const;
+    
+    // Admin endpoint settings
+    bool isAdminEnabled() const;
+    QStringList getAdminAllowedAddresses() const;
+    
+    // Connection lifecycle settings
+    int getIdleTimeoutMs() const;
+    int getHeaderTimeoutMs() const;
+    int getRequestTimeoutMs() const;
+    int getMaxConnectionsPerIp() const;
+    int getMaxConnections() const;
     
     // Rate limiting settings
     bool isRateLimitEnabled() const;
@@ -82,11 +108,96 @@ public:
     bool includeDebugInfo() const;
     QString getContactEmail() const;
     
+    // Metrics
+    bool isMetricsEnabled() const;
+    QStringList getMetricsAllowedAddresses() const;
+    
+    // Diagnostics
+    int getServerTimingSampleRate() const;
+    
+    // Tracing
+    bool isTracingEnabled() const;
+    int getTracingSampleRate() const;
+    QString getTracingExporter() const;
+    QString getTracingFile() const;
+    QString getTracingEndpoint() const;
+    QString getTracingServiceName() const;
+    
+    // Reverse proxy
+    QJsonArray getProxyRoutes() const;
+    int getProxyTimeoutMs() const;
+    int getProxyIdleTimeoutMs() const;
+    int getCircuitBreakerWindowSize() const;
+    int getCircuitBreakerMinimumCalls() const;
+    int getCircuitBreakerFailureRatePercent() const;
+    int getCircuitBreakerSlowCallMs() const;
+    int getCircuitBreakerSlowCallRatePercent() const;
+    int getCircuitBreakerOpenDurationMs() const;
+    int getCircuitBreakerHalfOpenProbes() const;
+    int getConcurrencyInitialLimit() const;
+    int getConcurrencyMinLimit() const;
+    int getConcurrencyMaxLimit() const;
+    int getConcurrencyBackoffPercent() const;
+    int getConcurrencyLatencyTolerancePercent() const;
+    
+    // Response cache
+    bool isResponseCacheEnabled() const;
+    int getResponseCacheMaxSizeMb() const;
+    int getResponseCacheShards() const;
+    int getResponseCacheCompressMinBytes() const;
+    
+    // Authentication
+    bool isAuthEnabled() const;
+    QString getAuthJwksFile() const;
+    QString getAuthIssuer() const;
+    QString getAuthAudience() const;
+    QStringList getAuthProtectedPrefixes() const;
+    QStringList getAuthRequiredScopes() const;
+    int getAuthLeewaySeconds() const;
+    int getAuthCacheMaxEntries() const;
+    int getAuthCacheShards() const;
+    
+    // Static files
+    QJsonArray getStaticFileMounts() const;
+    int getStaticFileMaxOpenFiles() const;
+    int getStaticFileRevalidateMs() const;
+    int getStaticFileStreamThresholdKb() const;
+    int getStaticFileMaxAgeSeconds() const;
+    
+    // Idempotency keys
+    bool isIdempotencyEnabled() const;
+    int getIdempotencyTtlSeconds() const;
+    int getIdempotencyMaxEntries() const;
+    int getIdempotencyMaxSizeMb() const;
+    int getIdempotencyWaitTimeoutMs() const;
+    
+    // WebSockets
+    bool isWebSocketEnabled() const;
+    int getWebSocketPort() const;
+    QString getWebSocketPath() const;
+    int getWebSocketMaxConnections() const;
+    int getWebSocketMaxQueueKb() const;
+    QString getWebSocketSlowConsumerPolicy() const;
+    int getWebSocketMaxMessageKb() const;
+    int getWebSocketMaxTopicsPerConnection() const;
+    int getWebSocketPingIntervalMs() const;
+    
+    // Unix domain socket listener
+    bool isUnixSocketEnabled() const;
+    QString getUnixSocketPath() const;
+    int getUnixSocketPermissions() const;
+    bool isUnixSocketExclusive() const;
+    bool isUnixSocketProxyProtocolEnabled() const;
+    int getUnixSocketHeaderTimeoutMs() const;
+    QString getUnixSocketTrustedProxyHeader() const;
+    
     // Logging
     QString getLogLevel() const;
     QString getLogFile() const;
     bool isConsoleLoggingEnabled() const;
     bool includeTimestamp() const;
+    int getLogMaxFileSizeMb() const;
+    int getLogMaxFiles() const;
     
 private:
     QJsonObject m_config;
@@ -0,0 +1,310 @@
+#include "connectionmanager.h"
+#include <QSslSocket>
+#include <QSslConfiguration>
+
+namespace {
+// 512 slots of 250 ms cover a little over two minutes per rotation;
+// longer timeouts simply take extra rounds
+constexpr int WheelSlots = 512;
+constexpr int WheelTickMs = 250;
+
+// Upper bound on how much buffered input is scanned for the end of the request headers
+constexpr qint64 MaxHeaderPeek = 64 * 1024;
+}
+
+ConnectionManager::ConnectionManager(QObject *parent)
+    : QObject(parent),
+      m_wheel(WheelSlots, WheelTickMs),
+      m_tickTimer(this),
+      m_lastTick(0),
+      m_connectionCount(0),
+      m_activeRequests(0),
+      m_draining(false)
+{
+    m_clock.start();
+    
+    m_tickTimer.setInterval(WheelTickMs);
+    m_tickTimer.setTimerType(Qt::CoarseTimer);
+    connect(&m_tickTimer, &QTimer::timeout, this, &ConnectionManager::onTick);
+}
+
+ConnectionManager::~ConnectionManager()
+{
+    for (auto it = m_connections.begin(); it != m_connections.end(); ++it) {
+        it.key()->disconnect(this);
+        delete it.value();
+    }
+}
+
+void ConnectionManager::setLimits(const Limits &limits)
+{
+    m_limits = limits;
+}
+
+const ConnectionManager::Limits &ConnectionManager::limits() const
+{
+    return m_limits;
+}
+
+bool ConnectionManager::track(QTcpSocket *socket)
+{
+    const QString key = clientKey(socket->peerAddress());
+    
+    // Shed new connections once the total cap is reached
+    if (m_limits.maxConnections > 0 && m_connections.size() >= m_limits.maxConnections) {
+        return false;
+    }
+    
+    // Enforce the per-client connection cap
+    if (m_limits.maxConnectionsPerIp > 0 && !m_limits.exemptClients.contains(key)
+            && m_connectionsPerClient.value(key) >= m_limits.maxConnectionsPerIp) {
+        return false;
+    }
+    
+    auto *connection = new Connection;
+    connection->socket = socket;
+    connection->clientKey = key;
+    
+    m_connections.insert(socket, connection);
+    m_connectionsPerClient[key]++;
+    m_connectionCount.store(m_connections.size(), std::memory_order_relaxed);
+    
+    connect(socket, &QIODevice::readyRead, this, [this, connection]() {
+        onReadyRead(connection);
+    });
+    connect(socket, &QIODevice::bytesWritten, this, [this, connection]() {
+        onBytesWritten(connection);
+    });
+    connect(socket, &QAbstractSocket::disconnected, this, [this, socket]() {
+        untrack(socket);
+    });
+    connect(socket, &QObject::destroyed, this, [this, socket]() {
+        untrack(socket);
+    });
+    
+    // A fresh connection must deliver its first request within the header timeout
+    scheduleTimeout(connection, m_limits.headerTimeoutMs);
+    
+    if (!m_tickTimer.isActive()) {
+        m_lastTick = m_clock.elapsed();
+        m_tickTimer.start();
+    }
+    
+    return true;
+}
+
+bool ConnectionManager::abort(const QHostAddress &peerAddress, quint16 peerPort)
+{
+    // Only used on failure paths, so a scan is cheaper than keeping another index
+    for (auto it = m_connections.cbegin(); it != m_connections.cend(); ++it) {
+        QTcpSocket *socket = it.key();
+        if (socket->peerPort() == peerPort && socket->peerAddress() == peerAddress) {
+            socket->abort();
+            return true;
+        }
+    }
+    return false;
+}
+
+int ConnectionManager::connectionCount() const
+{
+    return m_connectionCount.load(std::memory_order_relaxed);
+}
+
+bool ConnectionManager::isShedding() const
+{
+    return m_limits.maxConnections > 0 && m_connections.size() >= m_limits.maxConnections * 9 / 10;
+}
+
+int ConnectionManager::activeRequestCount() const
+{
+    return m_activeRequests.load(std::memory_order_relaxed);
+}
+
+void ConnectionManager::startDraining()
+{
+    m_draining = true;
+    
+    // Collect first: closing a socket may untrack it synchronously
+    QList<QTcpSocket *> idleSockets;
+    for (auto it = m_connections.constBegin(); it != m_connections.constEnd(); ++it) {
+        if (it.value()->state == State::Idle || it.value()->state == State::AwaitingRequest) {
+            idleSockets.append(it.key());
+        }
+    }
+    
+    for (QTcpSocket *socket : std::as_const(idleSockets)) {
+        socket->disconnectFromHost();
+    }
+    
+    if (m_activeRequests == 0) {
+        emit drained();
+    }
+}
+
+QString ConnectionManager::clientKey(const QHostAddress &address)
+{
+    bool isIPv4 = false;
+    const quint32 ipv4Address = address.toIPv4Address(&isIPv4);
+    if (isIPv4) {
+        return QHostAddress(ipv4Address).toString();
+    }
+    return address.toString();
+}
+
+void ConnectionManager::onReadyRead(Connection *connection)
+{
+    const qint64 now = m_clock.elapsed();
+    
+    if (connection->state == State::AwaitingRequest || connection->state == State::Idle) {
+        // First bytes of a new request: the headers must arrive within the header timeout
+        // and the whole request must complete within the request deadline
+        setState(connection, State::ReadingHeaders);
+        connection->requestDeadline = m_limits.requestTimeoutMs > 0 ? now + m_limits.requestTimeoutMs : 0;
+        scheduleTimeout(connection, m_limits.headerTimeoutMs);
+    }
+    
+    if (connection->state != State::ReadingHeaders) {
+        return;
+    }
+    
+    // HTTP/2 is binary and multiplexed, so there is no header terminator to look for
+    bool headersComplete = false;
+    auto *sslSocket = qobject_cast<QSslSocket *>(connection->socket);
+    if (sslSocket && sslSocket->sslConfiguration().nextNegotiatedProtocol() == QSslConfiguration::ALPNProtocolHTTP2) {
+        headersComplete = true;
+    } else {
+        const qint64 available = qMin(connection->socket->bytesAvailable(), MaxHeaderPeek);
+        headersComplete = connection->socket->peek(available).contains("\r\n\r\n");
+    }
+    
+    if (headersComplete) {
+        setState(connection, State::Processing);
+        if (connection->requestDeadline > 0) {
+            scheduleTimeout(connection, qMax<qint64>(0, connection->requestDeadline - now));
+        } else {
+            m_wheel.cancel(connection);
+        }
+    }
+}
+
+void ConnectionManager::onBytesWritten(Connection *connection)
+{
+    // Once the response is fully flushed the connection becomes an idle keep-alive connection
+    if (connection->socket->bytesToWrite() > 0) {
+        return;
+    }
+    
+    if (connection->state == State::Processing || connection->state == State::ReadingHeaders) {
+        setState(connection, State::Idle);
+        
+        // No keep-alive while draining: the response has been sent, close the connection
+        if (m_draining) {
+            m_wheel.cancel(connection);
+            connection->socket->disconnectFromHost();
+            return;
+        }
+        
+        scheduleTimeout(connection, m_limits.idleTimeoutMs);
+    }
+}
+
+void ConnectionManager::untrack(QTcpSocket *socket)
+{
+    Connection *connection = m_connections.take(socket);
+    if (!connection) {
+        return;
+    }
+    m_connectionCount.store(m_connections.size(), std::memory_order_relaxed);
+    
+    socket->disconnect(this);
+    m_wheel.cancel(connection);
+    setState(connection, State::Idle);
+    
+    auto it = m_connectionsPerClient.find(connection->clientKey);
+    if (it != m_connectionsPerClient.end() && --it.value() <= 0) {
+        m_connectionsPerClient.erase(it);
+    }
+    
+    delete connection;
+    
+    if (m_connections.isEmpty()) {
+        m_tickTimer.stop();
+    }
+}
+
+void ConnectionManager::setState(Connection *connection, State state)
+{
+    const bool wasActive = connection->state == State::ReadingHeaders || connection->state == State::Processing;
+    const bool isActive = state == State::ReadingHeaders || state == State::Processing;
+    
+    connection->state = state;
+    
+    if (wasActive != isActive) {
+        const int activeRequests = m_activeRequests.load(std::memory_order_relaxed) + (isActive ? 1 : -1);
+        m_activeRequests.store(activeRequests, std::memory_order_relaxed);
+        
+        if (m_draining && activeRequests == 0) {
+            emit drained();
+        }
+    }
+}
+
+void ConnectionManager::scheduleTimeout(Connection *connection, qint64 delayMs)
+{
+    if (delayMs > 0) {
+        m_wheel.schedule(connection, delayMs);
+    } else {
+        m_wheel.cancel(connection);
+    }
+}
+
+void ConnectionManager::onTick()
+{
+    // Catch up on ticks missed while the event loop was busy
+    const qint64 now = m_clock.elapsed();
+    while (now - m_lastTick >= m_wheel.tickMs()) {
+        m_lastTick += m_wheel.tickMs();
+        
+        const QVector<TimerWheel::Entry *> expired = m_wheel.tick();
+        for (TimerWheel::Entry *entry : expired) {
+            expire(static_cast<Connection *>(entry));
+        }
+    }
+}
+
+void ConnectionManager::expire(Connection *connection)
+{
+    QTcpSocket *socket = connection->socket;
+    
+    if (connection->state == State::Idle) {
+        // Idle keep-alive connection: close it politely
+        socket->disconnectFromHost();
+    } else {
+        // Slow headers or an overrunning request: drop the connection
+        socket->abort();
+    }
+}
+
+ManagedTcpServer::ManagedTcpServer(ConnectionManager *manager, QObject *parent)
+    : QTcpServer(parent),
+      m_manager(manager)
+{
+}
+
+void ManagedTcpServer::incomingConnection(qintptr socketDescriptor)
+{
+    auto *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
+        return;
+    }
+    
+    if (!m_manager->track(socket)) {
+        socket->abort();
+        socket->deleteLater();
+        return;
+    }
+    
+    addPendingConnection(socket);
+}
@@ -0,0 +1,175 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include "timerwheel.h"
+#include <atomic>
+
+/**
+ * @brief The ConnectionManager class enforces connection lifecycle limits for a listener thread
+ * 
+ * Every accepted socket is tracked with a single timer wheel entry that enforces, depending on
+ * the connection state, the header-read timeout (slowloris protection), the total request
+ * deadline or the keep-alive idle timeout. It also caps the number of concurrent connections
+ * a single client address may hold.
+ * 
+ * A ConnectionManager and the sockets it tracks must live in the same thread.
+ */
+class ConnectionManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Connection lifecycle limits; a value of zero disables the limit
+     */
+    struct Limits
+    {
+        int idleTimeoutMs = 30000;
+        int headerTimeoutMs = 10000;
+        int requestTimeoutMs = 30000;
+        int maxConnectionsPerIp = 64;
+        int maxConnections = 10000;  // All clients together; new connections beyond it are shed
+        QStringList exemptClients;
+    };
+    
+    explicit ConnectionManager(QObject *parent = nullptr);
+    ~ConnectionManager();
+    
+    /**
+     * @brief Sets the limits applied to connections tracked from now on
+     * 
+     * @param limits The connection limits
+     */
+    void setLimits(const Limits &limits);
+    
+    /**
+     * @brief Returns the current connection limits
+     */
+    const Limits &limits() const;
+    
+    /**
+     * @brief Starts tracking an accepted socket
+     * 
+     * @param socket The accepted socket
+     * @return false if the client already holds the maximum number of connections or the
+     *         total connection cap is reached, in which case the caller must close the socket
+     */
+    bool track(QTcpSocket *socket);
+    
+    /**
+     * @brief Aborts the tracked connection with the given peer, e.g. to cut a response short
+     * 
+     * @return false if no tracked connection has that peer address and port
+     */
+    bool abort(const QHostAddress &peerAddress, quint16 peerPort);
+    
+    /**
+     * @brief Returns the number of tracked connections; safe to call from any thread
+     */
+    int connectionCount() const;
+    
+    /**
+     * @brief Returns the number of connections with a request in progress; safe to call from any thread
+     */
+    int activeRequestCount() const;
+    
+    /**
+     * @brief Returns true while load is being shed
+     * 
+     * The manager starts reporting shedding at 90% of the total connection cap, so that
+     * load balancers can steer traffic away before connections are actually refused.
+     */
+    bool isShedding() const;
+    
+    /**
+     * @brief Enters drain mode
+     * 
+     * Idle connections are closed immediately and every other connection is closed
+     * as soon as its current response has been flushed. drained() is emitted once
+     * no request is in progress.
+     */
+    void startDraining();
+    
+    /**
+     * @brief Returns the key used to identify a client address
+     * 
+     * IPv4-mapped IPv6 addresses are folded to their IPv4 form so that dual-stack
+     * listeners key a client the same way regardless of the socket family. This is
+     * the key used for rate limiting and per-IP connection caps.
+     * 
+     * @param address The client address
+     * @return The client key
+     */
+    static QString clientKey(const QHostAddress &address);
+
+signals:
+    /**
+     * @brief Emitted in drain mode once no request is in progress
+     */
+    void drained();
+
+private:
+    enum class State {
+        AwaitingRequest,
+        ReadingHeaders,
+        Processing,
+        Idle
+    };
+    
+    struct Connection : TimerWheel::Entry
+    {
+        QTcpSocket *socket = nullptr;
+        QString clientKey;
+        State state = State::AwaitingRequest;
+        qint64 requestDeadline = 0;
+    };
+    
+    Limits m_limits;
+    TimerWheel m_wheel;
+    QTimer m_tickTimer;
+    QElapsedTimer m_clock;
+    qint64 m_lastTick;
+    QHash<QTcpSocket *, Connection *> m_connections;
+    QHash<QString, int> m_connectionsPerClient;
+    
+    // Mirrors of the counts for readers on other threads, written only by the owning thread
+    std::atomic<int> m_connectionCount;
+    std::atomic<int> m_activeRequests;
+    bool m_draining;
+    
+    void onReadyRead(Connection *connection);
+    void onBytesWritten(Connection *connection);
+    void untrack(QTcpSocket *socket);
+    void setState(Connection *connection, State state);
+    void scheduleTimeout(Connection *connection, qint64 delayMs);
+    void onTick();
+    void expire(Connection *connection);
+};
+
+/**
+ * @brief The ManagedTcpServer class is a plaintext listener whose connections are tracked by a ConnectionManager
+ */
+class ManagedTcpServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit ManagedTcpServer(ConnectionManager *manager, QObject *parent = nullptr);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    ConnectionManager *m_manager;
+};
+
+#endif // CONNECTIONMANAGER_H
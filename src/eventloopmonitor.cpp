@@ -0,0 +1,40 @@
+#include "eventloopmonitor.h"
+
+EventLoopMonitor::EventLoopMonitor(int intervalMs, QObject *parent)
+    : QObject(parent),
+      m_timer(this),
+      m_expectedNs(0),
+      m_intervalNs(static_cast<qint64>(intervalMs) * 1000000)
+{
+    m_clock.start();
+    m_expectedNs = m_intervalNs;
+    
+    m_timer.setInterval(intervalMs);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &EventLoopMonitor::onTimeout);
+    m_timer.start();
+}
+
+qint64 EventLoopMonitor::lastLagUs() const
+{
+    return m_lastLagUs.load(std::memory_order_relaxed);
+}
+
+qint64 EventLoopMonitor::takeMaxLagUs()
+{
+    return m_maxLagUs.exchange(0, std::memory_order_relaxed);
+}
+
+void EventLoopMonitor::onTimeout()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    const qint64 lagUs = qMax<qint64>(0, now - m_expectedNs) / 1000;
+    
+    // Schedule relative to now, so one long stall is reported once rather than as a backlog
+    m_expectedNs = now + m_intervalNs;
+    
+    m_lastLagUs.store(lagUs, std::memory_order_relaxed);
+    qint64 maxLagUs = m_maxLagUs.load(std::memory_order_relaxed);
+    while (lagUs > maxLagUs && !m_maxLagUs.compare_exchange_weak(maxLagUs, lagUs, std::memory_order_relaxed)) {
+    }
+}
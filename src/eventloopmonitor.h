@@ -0,0 +1,44 @@
+#ifndef EVENTLOOPMONITOR_H
+#define EVENTLOOPMONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <atomic>
+
+/**
+ * @brief The EventLoopMonitor class measures how late the event loop of its thread runs timers
+ * 
+ * A precise timer fires every interval; the difference between when it was due and when
+ * it actually ran is the event-loop lag, i.e. how long ready events wait behind the work
+ * in progress. The results are atomics so that any thread may read them.
+ */
+class EventLoopMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EventLoopMonitor(int intervalMs = 100, QObject *parent = nullptr);
+    
+    /**
+     * @brief Returns the lag of the most recent timer tick, in microseconds
+     */
+    qint64 lastLagUs() const;
+    
+    /**
+     * @brief Returns the largest lag seen since the previous call, in microseconds
+     */
+    qint64 takeMaxLagUs();
+
+private:
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_expectedNs;
+    qint64 m_intervalNs;
+    std::atomic<qint64> m_lastLagUs{0};
+    std::atomic<qint64> m_maxLagUs{0};
+    
+    void onTimeout();
+};
+
+#endif // EVENTLOOPMONITOR_H
@@ -0,0 +1,152 @@
+#include "httpclock.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace {
+const char *const DayNames[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char *const MonthNames[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+qint64 currentSecond()
+{
+    // time() is served from the vDSO on Linux and does not enter the kernel
+    return static_cast<qint64>(std::time(nullptr));
+}
+
+struct ThreadHttpDate
+{
+    qint64 epochSecond = -1;
+    QByteArray value;
+};
+}
+
+HttpClock::HttpClock()
+{
+    for (std::atomic<quint64> &word : m_words) {
+        word.store(0, std::memory_order_relaxed);
+    }
+}
+
+HttpClock &HttpClock::instance()
+{
+    static HttpClock clock;
+    return clock;
+}
+
+HttpClock::Stamp HttpClock::now()
+{
+    return stampFor(currentSecond());
+}
+
+HttpClock::Stamp HttpClock::stampFor(qint64 epochSecond)
+{
+    const qint64 published = m_epochSecond.load(std::memory_order_acquire);
+
+    // Only move the shared stamp forward, or back to the wall clock after it was stepped
+    if (epochSecond != published && (epochSecond > published || epochSecond == currentSecond())) {
+        refresh(epochSecond);
+    }
+
+    Stamp stamp;
+    if (load(stamp) && stamp.epochSecond == epochSecond) {
+        return stamp;
+    }
+
+    // Another thread is publishing this second, or the caller asked for an old one
+    return format(epochSecond);
+}
+
+QByteArray HttpClock::httpDate()
+{
+    thread_local ThreadHttpDate cache;
+
+    const qint64 second = currentSecond();
+    if (cache.epochSecond != second) {
+        const Stamp stamp = stampFor(second);
+        cache.value = QByteArray(stamp.httpDate, HttpDateLength);
+        cache.epochSecond = second;
+    }
+
+    // Implicitly shared: no allocation or copy per response
+    return cache.value;
+}
+
+HttpClock::Stamp HttpClock::format(qint64 epochSecond)
+{
+    const std::time_t time = static_cast<std::time_t>(epochSecond);
+    std::tm utc;
+#ifdef Q_OS_WIN
+    gmtime_s(&utc, &time);
+#else
+    gmtime_r(&time, &utc);
+#endif
+
+    // Formatted by hand so that day and month names never depend on the locale
+    Stamp stamp;
+    stamp.epochSecond = epochSecond;
+    std::snprintf(stamp.httpDate, sizeof(stamp.httpDate), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                  DayNames[utc.tm_wday], utc.tm_mday, MonthNames[utc.tm_mon], utc.tm_year + 1900,
+                  utc.tm_hour, utc.tm_min, utc.tm_sec);
+    std::snprintf(stamp.isoSecond, sizeof(stamp.isoSecond), "%04d-%02d-%02dT%02d:%02d:%02d",
+                  utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+                  utc.tm_hour, utc.tm_min, utc.tm_sec);
+    return stamp;
+}
+
+bool HttpClock::load(Stamp &stamp) const
+{
+    quint64 words[WordCount];
+
+    // A writer only holds the sequence odd for a few stores, so a handful of retries suffices
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        const quint32 before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        for (int i = 0; i < WordCount; ++i) {
+            words[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (m_sequence.load(std::memory_order_relaxed) == before) {
+            std::memcpy(&stamp, words, sizeof(Stamp));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void HttpClock::publish(const Stamp &stamp)
+{
+    quint64 words[WordCount] = {};
+    std::memcpy(words, &stamp, sizeof(Stamp));
+
+    const quint32 sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (int i = 0; i < WordCount; ++i) {
+        m_words[i].store(words[i], std::memory_order_relaxed);
+    }
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+    m_epochSecond.store(stamp.epochSecond, std::memory_order_release);
+}
+
+void HttpClock::refresh(qint64 epochSecond)
+{
+    // Only one thread formats a new second; the others keep reading the previous stamp
+    bool expected = false;
+    if (!m_refreshing.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        return;
+    }
+
+    if (m_epochSecond.load(std::memory_order_relaxed) != epochSecond) {
+        publish(format(epochSecond));
+    }
+
+    m_refreshing.store(false, std::memory_order_release);
+}
@@ -0,0 +1,72 @@
+#ifndef HTTPCLOCK_H
+#define HTTPCLOCK_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief The HttpClock class provides preformatted timestamps that are refreshed once per second
+ *
+ * Formatting a date for every response or log line is far more expensive than the request
+ * itself needs. The clock keeps one shared stamp holding the current second as an RFC 7231
+ * HTTP date and an ISO-8601 prefix. The first reader that notices a new second formats it
+ * and publishes it through a seqlock; all other readers copy the published stamp without
+ * taking a lock. Each thread additionally caches the HTTP date as a QByteArray, so setting
+ * a Date header only shares an existing buffer.
+ */
+class HttpClock
+{
+public:
+    static constexpr int HttpDateLength = 29;  // "Sun, 06 Nov 1994 08:49:37 GMT"
+    static constexpr int IsoSecondLength = 19; // "1994-11-06T08:49:37" (milliseconds and zone are appended)
+
+    struct Stamp
+    {
+        qint64 epochSecond = -1;
+        char httpDate[HttpDateLength + 1];
+        char isoSecond[IsoSecondLength + 1];
+    };
+
+    /**
+     * @brief Returns the process-wide clock
+     */
+    static HttpClock &instance();
+
+    /**
+     * @brief Returns the stamp for the current second
+     */
+    Stamp now();
+
+    /**
+     * @brief Returns the stamp for the given second, reusing the shared stamp when it matches
+     */
+    Stamp stampFor(qint64 epochSecond);
+
+    /**
+     * @brief Returns the current second as an HTTP date, cached per thread
+     */
+    QByteArray httpDate();
+
+    /**
+     * @brief Formats a second without touching the shared stamp
+     */
+    static Stamp format(qint64 epochSecond);
+
+private:
+    static constexpr int WordCount = (sizeof(Stamp) + sizeof(quint64) - 1) / sizeof(quint64);
+
+    // Seqlock: odd while a writer is publishing. The stamp is stored as atomic words so
+    // that readers racing with a writer are well-defined and simply retry.
+    std::atomic<quint32> m_sequence{0};
+    std::atomic<quint64> m_words[WordCount];
+    std::atomic<qint64> m_epochSecond{-1};
+    std::atomic<bool> m_refreshing{false};
+
+    HttpClock();
+    bool load(Stamp &stamp) const;
+    void publish(const Stamp &stamp);
+    void refresh(qint64 epochSecond);
+};
+
+#endif // HTTPCLOCK_H
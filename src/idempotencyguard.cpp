@@ -0,0 +1,222 @@
+#include "idempotencyguard.h"
+#include "problemdetail.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QHttpHeaders>
+#include <QThread>
+#include <QUrl>
+
+namespace {
+constexpr qsizetype MaxKeyLength = 255;
+
+bool isValidKey(const QByteArray &key)
+{
+    if (key.isEmpty() || key.size() > MaxKeyLength) {
+        return false;
+    }
+    for (const char c : key) {
+        if (c < 0x20 || c > 0x7e) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+IdempotencyGuard::IdempotencyGuard(std::unique_ptr<IdempotencyStore> store, const Settings &settings)
+    : m_settings(settings),
+      m_store(std::move(store))
+{
+}
+
+IdempotencyGuard::~IdempotencyGuard() = default;
+
+void IdempotencyGuard::setSettings(const Settings &settings)
+{
+    m_settings = settings;
+}
+
+void IdempotencyGuard::setStore(std::unique_ptr<IdempotencyStore> store)
+{
+    m_store = std::move(store);
+}
+
+IdempotencyStore *IdempotencyGuard::store() const
+{
+    return m_store.get();
+}
+
+bool IdempotencyGuard::appliesTo(const QHttpServerRequest &request)
+{
+    // GET, PUT and DELETE are idempotent by definition and need no key
+    const QHttpServerRequest::Method method = request.method();
+    return (method == QHttpServerRequest::Method::Post || method == QHttpServerRequest::Method::Patch)
+        && !request.value("Idempotency-Key").isEmpty();
+}
+
+QHttpServerResponse IdempotencyGuard::handle(const QHttpServerRequest &request, const QByteArray &client,
+                                             const Producer &produce, Outcome *outcome)
+{
+    auto answer = [&](Outcome result, QHttpServerResponse response) {
+        if (outcome) {
+            *outcome = result;
+        }
+        return response;
+    };
+    
+    const QByteArray idempotencyKey = request.value("Idempotency-Key").trimmed();
+    if (!isValidKey(idempotencyKey)) {
+        return answer(Outcome::Invalid, problem(400, QString("The Idempotency-Key header must be 1 to %1 printable ASCII characters")
+                                                         .arg(MaxKeyLength), request));
+    }
+    
+    const QByteArray key = client + '\n' + idempotencyKey;
+    const QByteArray requestFingerprint = fingerprint(request);
+    const QDeadlineTimer deadline(m_settings.waitTimeoutMs);
+    
+    auto replayRecord = [&](const IdempotencyStore::Record &record) {
+        if (record.fingerprint != requestFingerprint) {
+            return answer(Outcome::Mismatch, problem(422, "The Idempotency-Key was already used for a different request", request));
+        }
+        m_replayed.fetch_add(1, std::memory_order_relaxed);
+        return answer(Outcome::Replayed, replay(record));
+    };
+    
+    // Become the request that runs the handler for this key, unless a response is stored or
+    // another request is running it; wait for that one and look again
+    std::shared_ptr<Flight> flight;
+    while (!flight) {
+        if (const IdempotencyStore::RecordPtr record = m_store->find(key)) {
+            return replayRecord(*record);
+        }
+        
+        QMutexLocker locker(&m_mutex);
+        const std::shared_ptr<Flight> running = m_inflight.value(key);
+        if (!running) {
+            flight = std::make_shared<Flight>();
+            flight->fingerprint = requestFingerprint;
+            flight->leader = QThread::currentThreadId();
+            m_inflight.insert(key, flight);
+            break;
+        }
+        
+        if (running->fingerprint != requestFingerprint) {
+            return answer(Outcome::Mismatch, problem(422, "The Idempotency-Key is in use by a different request", request));
+        }
+        
+        // A leader on this thread means the handler re-entered the event loop, and waiting would deadlock
+        bool finished = running->leader != QThread::currentThreadId();
+        while (finished && !running->finished) {
+            finished = running->done.wait(&m_mutex, deadline);
+        }
+        if (!finished) {
+            m_conflicts.fetch_add(1, std::memory_order_relaxed);
+            return answer(Outcome::Conflict, problem(409, "A request with this Idempotency-Key is still being processed", request));
+        }
+    }
+    
+    // The original may have stored its response just before this request took over the key
+    if (const IdempotencyStore::RecordPtr record = m_store->find(key)) {
+        finish(key, flight);
+        return replayRecord(*record);
+    }
+    
+    m_executed.fetch_add(1, std::memory_order_relaxed);
+    
+    QHttpServerResponse response = [&]() {
+        try {
+            return produce();
+        } catch (...) {
+            finish(key, flight);
+            throw;
+        }
+    }();
+    
+    // Server errors are not stored, so that a retry runs the handler again
+    if (static_cast<int>(response.statusCode()) < 500) {
+        IdempotencyStore::Record record = capture(response);
+        record.fingerprint = requestFingerprint;
+        record.expiresAtMs = QDateTime::currentMSecsSinceEpoch() + static_cast<qint64>(m_settings.ttlSeconds) * 1000;
+        m_store->insert(key, std::make_shared<const IdempotencyStore::Record>(std::move(record)));
+    }
+    finish(key, flight);
+    
+    return answer(Outcome::Executed, std::move(response));
+}
+
+quint64 IdempotencyGuard::executedCount() const
+{
+    return m_executed.load(std::memory_order_relaxed);
+}
+
+quint64 IdempotencyGuard::replayedCount() const
+{
+    return m_replayed.load(std::memory_order_relaxed);
+}
+
+quint64 IdempotencyGuard::conflictCount() const
+{
+    return m_conflicts.load(std::memory_order_relaxed);
+}
+
+void IdempotencyGuard::finish(const QByteArray &key, const std::shared_ptr<Flight> &flight)
+{
+    QMutexLocker locker(&m_mutex);
+    m_inflight.remove(key);
+    flight->finished = true;
+    flight->done.wakeAll();
+}
+
+QByteArray IdempotencyGuard::fingerprint(const QHttpServerRequest &request)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArray::number(static_cast<int>(request.method())));
+    hash.addData("\n");
+    hash.addData(request.url().path(QUrl::FullyEncoded).toUtf8());
+    hash.addData("?");
+    hash.addData(request.url().query(QUrl::FullyEncoded).toUtf8());
+    hash.addData("\n");
+    hash.addData(request.body());
+    return hash.result();
+}
+
+IdempotencyStore::Record IdempotencyGuard::capture(const QHttpServerResponse &response)
+{
+    IdempotencyStore::Record record;
+    record.statusCode = static_cast<int>(response.statusCode());
+    record.mimeType = response.mimeType();
+    record.body = response.data();
+    
+    // Headers the handler set (e.g. Location)
+    const QHttpHeaders headers = response.headers();
+    for (qsizetype i = 0; i < headers.size(); ++i) {
+        const QLatin1StringView name = headers.nameAt(i);
+        if (name == QLatin1StringView("content-type") || name == QLatin1StringView("content-length")) {
+            continue;
+        }
+        record.headers.append({QByteArray(name.data(), name.size()), headers.valueAt(i).toByteArray()});
+    }
+    
+    return record;
+}
+
+QHttpServerResponse IdempotencyGuard::replay(const IdempotencyStore::Record &record)
+{
+    QHttpServerResponse response(record.mimeType, record.body, QHttpServerResponse::StatusCode(record.statusCode));
+    QHttpHeaders headers = response.headers();
+    for (const auto &header : record.headers) {
+        headers.append(header.first, header.second);
+    }
+    headers.replaceOrAppend("Idempotent-Replayed", "true");
+    response.setHeaders(std::move(headers));
+    return response;
+}
+
+QHttpServerResponse IdempotencyGuard::problem(int statusCode, const QString &detail, const QHttpServerRequest &request)
+{
+    ProblemDetail problem(statusCode);
+    problem.setDetail(detail);
+    problem.setInstance(request.url().path());
+    return problem.toJsonResponse();
+}
@@ -0,0 +1,110 @@
+#ifndef IDEMPOTENCYGUARD_H
+#define IDEMPOTENCYGUARD_H
+
+#include "idempotencystore.h"
+#include <QByteArray>
+#include <QHash>
+#include <QHttpServerRequest>
+#include <QHttpServerResponse>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+ * @brief The IdempotencyGuard class runs a handler at most once per Idempotency-Key
+ * 
+ * The first request with a key runs the handler, and its response is stored under the key
+ * for the TTL. Later requests with the same key get the stored response again, marked with
+ * an "Idempotent-Replayed: true" header, without running the handler. A duplicate that
+ * arrives while the original is still running waits for it instead of running the handler
+ * a second time.
+ * 
+ * A key is bound to the request it was first used with (method, path, query and body):
+ * reusing it for a different request is answered with 422. A duplicate that cannot wait
+ * for the original (the wait timed out, or it arrived on the original's own thread) is
+ * answered with 409 and may be retried. Responses with a 5xx status are not stored, so a
+ * retry after a server error runs the handler again.
+ */
+class IdempotencyGuard
+{
+public:
+    struct Settings
+    {
+        int ttlSeconds = 24 * 60 * 60;  // How long a response is replayed
+        int waitTimeoutMs = 10000;      // How long a duplicate waits for the original
+    };
+    
+    enum class Outcome {
+        Executed,    // This request ran the handler
+        Replayed,    // A stored response was sent
+        Conflict,    // The original is still running; answered with 409
+        Mismatch,    // The key belongs to a different request; answered with 422
+        Invalid      // The key is malformed; answered with 400
+    };
+    
+    using Producer = std::function<QHttpServerResponse()>;
+    
+    explicit IdempotencyGuard(std::unique_ptr<IdempotencyStore> store, const Settings &settings = Settings());
+    ~IdempotencyGuard();
+    
+    /**
+     * @brief Replaces the settings; must not be called while serving
+     */
+    void setSettings(const Settings &settings);
+    
+    /**
+     * @brief Replaces the store; must not be called while serving
+     */
+    void setStore(std::unique_ptr<IdempotencyStore> store);
+    
+    IdempotencyStore *store() const;
+    
+    /**
+     * @brief Returns true if the request carries an Idempotency-Key and uses a method it applies to (POST or PATCH)
+     */
+    static bool appliesTo(const QHttpServerRequest &request);
+    
+    /**
+     * @brief Answers a request that carries an Idempotency-Key
+     * 
+     * Keys longer than 255 characters or with characters outside printable ASCII are
+     * answered with 400. If produce() throws, duplicates waiting for it run their own
+     * handler and the exception propagates.
+     * 
+     * @param client Identifies the client the key belongs to, e.g. its token subject or address
+     * @param outcome Receives how the response was obtained, if not null
+     */
+    QHttpServerResponse handle(const QHttpServerRequest &request, const QByteArray &client, const Producer &produce,
+                               Outcome *outcome = nullptr);
+    
+    quint64 executedCount() const;
+    quint64 replayedCount() const;
+    quint64 conflictCount() const;
+
+private:
+    struct Flight
+    {
+        QWaitCondition done;
+        bool finished = false;
+        QByteArray fingerprint;
+        Qt::HANDLE leader = nullptr;
+    };
+    
+    Settings m_settings;
+    std::unique_ptr<IdempotencyStore> m_store;
+    QMutex m_mutex;
+    QHash<QByteArray, std::shared_ptr<Flight>> m_inflight;  // Keys whose handler is running
+    std::atomic<quint64> m_executed{0};
+    std::atomic<quint64> m_replayed{0};
+    std::atomic<quint64> m_conflicts{0};
+    
+    void finish(const QByteArray &key, const std::shared_ptr<Flight> &flight);
+    static QByteArray fingerprint(const QHttpServerRequest &request);
+    static IdempotencyStore::Record capture(const QHttpServerResponse &response);
+    static QHttpServerResponse replay(const IdempotencyStore::Record &record);
+    static QHttpServerResponse problem(int statusCode, const QString &detail, const QHttpServerRequest &request);
+};
+
+#endif // IDEMPOTENCYGUARD_H
@@ -0,0 +1,97 @@
+#include "idempotencystore.h"
+#include <QDateTime>
+#include <algorithm>
+
+namespace {
+// Fixed per-record overhead charged against the budget: list node, hash node and Record
+constexpr qint64 RecordOverhead = 256;
+}
+
+qint64 IdempotencyStore::Record::cost() const
+{
+    qint64 bytes = RecordOverhead + fingerprint.size() + mimeType.size() + body.size();
+    for (const auto &header : headers) {
+        bytes += header.first.size() + header.second.size();
+    }
+    return bytes;
+}
+
+MemoryIdempotencyStore::MemoryIdempotencyStore(int maxEntries, qint64 maxBytes)
+    : m_maxEntries(std::max(1, maxEntries)),
+      m_maxBytes(std::max<qint64>(RecordOverhead, maxBytes))
+{
+}
+
+IdempotencyStore::RecordPtr MemoryIdempotencyStore::find(const QByteArray &key)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QMutexLocker locker(&m_mutex);
+    
+    const auto found = m_index.constFind(key);
+    if (found == m_index.constEnd()) {
+        return nullptr;
+    }
+    
+    const RecordPtr record = found.value()->record;
+    if (record->expiresAtMs <= now) {
+        erase(found.value());
+        return nullptr;
+    }
+    return record;
+}
+
+void MemoryIdempotencyStore::insert(const QByteArray &key, const RecordPtr &record)
+{
+    const qint64 cost = record->cost() + key.size();
+    if (cost > m_maxBytes) {
+        return;
+    }
+    
+    QMutexLocker locker(&m_mutex);
+    dropExpired(QDateTime::currentMSecsSinceEpoch());
+    
+    const auto existing = m_index.constFind(key);
+    if (existing != m_index.constEnd()) {
+        erase(existing.value());
+    }
+    
+    while (!m_records.empty() && (m_index.size() >= m_maxEntries || m_bytes + cost > m_maxBytes)) {
+        erase(m_records.begin());
+    }
+    
+    // Kept in expiry order; with a constant TTL every record goes to the back, but after the
+    // TTL was shortened a new record can expire before ones stored earlier
+    auto position = m_records.end();
+    while (position != m_records.begin() && std::prev(position)->record->expiresAtMs > record->expiresAtMs) {
+        --position;
+    }
+    
+    m_index.insert(key, m_records.insert(position, Node{key, record}));
+    m_bytes += cost;
+}
+
+int MemoryIdempotencyStore::entryCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_index.size());
+}
+
+qint64 MemoryIdempotencyStore::sizeBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+void MemoryIdempotencyStore::dropExpired(qint64 nowMs)
+{
+    while (!m_records.empty() && m_records.front().record->expiresAtMs <= nowMs) {
+        erase(m_records.begin());
+    }
+}
+
+void MemoryIdempotencyStore::erase(std::list<Node>::iterator node)
+{
+    m_bytes -= node->record->cost() + node->key.size();
+    m_index.remove(node->key);
+    m_records.erase(node);
+}
@@ -0,0 +1,91 @@
+#ifndef IDEMPOTENCYSTORE_H
+#define IDEMPOTENCYSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <list>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief The IdempotencyStore class is the interface of the stores that keep the responses of
+ * requests sent with an Idempotency-Key header
+ * 
+ * Records are keyed by client and idempotency key. Expiry times are wall-clock milliseconds
+ * since the epoch, so an implementation that persists records (to disk or a shared database)
+ * can keep honoring keys across restarts. Implementations must be thread-safe.
+ */
+class IdempotencyStore
+{
+public:
+    struct Record
+    {
+        QByteArray fingerprint;  // Hash of the request the response belongs to
+        int statusCode = 200;
+        QByteArray mimeType;
+        QByteArray body;
+        QList<std::pair<QByteArray, QByteArray>> headers;  // Set by the handler, e.g. Location
+        qint64 expiresAtMs = 0;  // Milliseconds since the epoch
+        
+        qint64 cost() const;
+    };
+    
+    using RecordPtr = std::shared_ptr<const Record>;
+    
+    virtual ~IdempotencyStore() = default;
+    
+    /**
+     * @brief Returns the record stored for a key, or null if there is none or it has expired
+     */
+    virtual RecordPtr find(const QByteArray &key) = 0;
+    
+    /**
+     * @brief Stores a record, replacing any record with the same key
+     * 
+     * A bounded store may evict other records, or decline to store this one, to stay within its limits.
+     */
+    virtual void insert(const QByteArray &key, const RecordPtr &record) = 0;
+    
+    virtual int entryCount() const = 0;
+    virtual qint64 sizeBytes() const = 0;
+};
+
+/**
+ * @brief The MemoryIdempotencyStore class keeps idempotency records in memory, bounded by
+ * an entry count and a byte budget
+ * 
+ * Records are kept in expiry order, so expired records are dropped from the front, and when
+ * a limit is reached the records closest to expiring are evicted first. This holds across a
+ * TTL change, when records stored before and after it expire out of insertion order.
+ */
+class MemoryIdempotencyStore : public IdempotencyStore
+{
+public:
+    MemoryIdempotencyStore(int maxEntries, qint64 maxBytes);
+    
+    RecordPtr find(const QByteArray &key) override;
+    void insert(const QByteArray &key, const RecordPtr &record) override;
+    int entryCount() const override;
+    qint64 sizeBytes() const override;
+
+private:
+    struct Node
+    {
+        QByteArray key;
+        RecordPtr record;
+    };
+    
+    const int m_maxEntries;
+    const qint64 m_maxBytes;
+    mutable QMutex m_mutex;
+    std::list<Node> m_records;  // Earliest expiry first
+    QHash<QByteArray, std::list<Node>::iterator> m_index;
+    qint64 m_bytes = 0;
+    
+    void dropExpired(qint64 nowMs);
+    void erase(std::list<Node>::iterator node);
+};
+
+#endif // IDEMPOTENCYSTORE_H
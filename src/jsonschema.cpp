@@ -0,0 +1,735 @@
+#include "jsonschema.h"
+#include <QJsonArray>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+// Keywords that only describe a schema and are never enforced
+bool isAnnotation(const QString &keyword)
+{
+    static const QStringList annotations = {
+        "$schema", "$id", "$comment", "title", "description", "default", "examples",
+        "format", "deprecated", "readOnly", "writeOnly"
+    };
+    return annotations.contains(keyword);
+}
+
+// Escapes a reference token for a JSON Pointer (RFC 6901, section 3)
+QString escapePointerToken(const QString &token)
+{
+    if (!token.contains('~') && !token.contains('/')) {
+        return token;
+    }
+    QString escaped = token;
+    escaped.replace(QLatin1String("~"), QLatin1String("~0"));
+    escaped.replace(QLatin1String("/"), QLatin1String("~1"));
+    return escaped;
+}
+
+bool readCount(const QJsonValue &value, int &count)
+{
+    const double number = value.toDouble(-1.0);
+    if (!value.isDouble() || number < 0 || number > INT_MAX || std::floor(number) != number) {
+        return false;
+    }
+    count = static_cast<int>(number);
+    return true;
+}
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+QString formatNumber(double number)
+{
+    return QString::number(number, 'g', 15);
+}
+}
+
+bool JsonSchema::Node::needsStringValue() const
+{
+    return minLength >= 0 || maxLength >= 0 || hasPattern || !allowed.isEmpty();
+}
+
+/**
+ * @brief Recursive-descent JSON parser that checks each value against its schema node as it goes
+ */
+class JsonSchema::Parser
+{
+public:
+    Parser(const JsonSchema &schema, const QByteArray &json, QList<Violation> &violations, int maxViolations)
+        : m_schema(schema),
+          m_begin(json.constData()),
+          m_pos(json.constData()),
+          m_end(json.constData() + json.size()),
+          m_violations(violations),
+          m_maxViolations(std::max(1, maxViolations))
+    {
+    }
+    
+    Result run()
+    {
+        if (!value(0, 0)) {
+            return m_malformed ? Result::Malformed : Result::Invalid;
+        }
+        
+        skipWhitespace();
+        if (m_pos != m_end) {
+            fail("the end of the document");
+            return Result::Malformed;
+        }
+        
+        return m_violations.isEmpty() ? Result::Valid : Result::Invalid;
+    }
+
+private:
+    const JsonSchema &m_schema;
+    const char *m_begin;
+    const char *m_pos;
+    const char *m_end;
+    QList<Violation> &m_violations;
+    int m_maxViolations;
+    QString m_pointer;  // Pointer to the value being parsed
+    bool m_malformed = false;
+    
+    // Each parse step returns false to stop: on a syntax error or once enough violations were found
+    bool value(int index, int depth)
+    {
+        if (depth > MaxDepth) {
+            return fail("less deeply nested values");
+        }
+        
+        skipWhitespace();
+        if (m_pos == m_end) {
+            return fail("a value");
+        }
+        
+        const Node *node = index >= 0 ? &m_schema.m_nodes[static_cast<size_t>(index)] : nullptr;
+        if (node && node->never) {
+            if (!violate(QStringLiteral("is not allowed"))) {
+                return false;
+            }
+            node = nullptr;
+        }
+        
+        switch (*m_pos) {
+        case '{':
+            if (!checkType(node, ObjectType)) {
+                return false;
+            }
+            return object(node, depth);
+        case '[':
+            if (!checkType(node, ArrayType)) {
+                return false;
+            }
+            return array(node, depth);
+        case '"': {
+            const bool needsText = node && node->needsStringValue();
+            QString text;
+            qsizetype length = 0;
+            if (!string(needsText ? &text : nullptr, length)) {
+                return false;
+            }
+            if (!checkType(node, StringType)) {
+                return false;
+            }
+            return !node || checkString(*node, text, length);
+        }
+        case 't':
+        case 'f': {
+            const bool flag = *m_pos == 't';
+            if (!literal(flag ? "true" : "false")) {
+                return false;
+            }
+            if (!checkType(node, BooleanType)) {
+                return false;
+            }
+            return !node || checkAllowed(*node, QJsonValue(flag));
+        }
+        case 'n':
+            if (!literal("null")) {
+                return false;
+            }
+            if (!checkType(node, NullType)) {
+                return false;
+            }
+            return !node || checkAllowed(*node, QJsonValue(QJsonValue::Null));
+        default: {
+            double number = 0;
+            if (!this->number(number)) {
+                return false;
+            }
+            // As in JSON Schema, 1.0 is an integer
+            const bool integral = std::isfinite(number) && std::floor(number) == number;
+            if (!checkType(node, integral ? IntegerType : NumberType)) {
+                return false;
+            }
+            return !node || checkNumber(*node, number);
+        }
+        }
+    }
+    
+    bool object(const Node *node, int depth)
+    {
+        ++m_pos;
+        
+        // Required properties seen so far, by Property::requiredBit
+        QVarLengthArray<bool, 16> seen(node ? node->required.size() : 0);
+        std::fill(seen.begin(), seen.end(), false);
+        
+        skipWhitespace();
+        if (m_pos < m_end && *m_pos == '}') {
+            ++m_pos;
+        } else {
+            while (true) {
+                skipWhitespace();
+                if (m_pos == m_end || *m_pos != '"') {
+                    return fail("a property name");
+                }
+                
+                QString key;
+                qsizetype length = 0;
+                if (!string(&key, length)) {
+                    return false;
+                }
+                
+                skipWhitespace();
+                if (m_pos == m_end || *m_pos != ':') {
+                    return fail("':'");
+                }
+                ++m_pos;
+                
+                const qsizetype parentLength = m_pointer.size();
+                m_pointer += QLatin1Char('/');
+                m_pointer += escapePointerToken(key);
+                
+                int child = -1;
+                if (node) {
+                    const auto property = node->properties.constFind(key);
+                    if (property != node->properties.constEnd()) {
+                        child = property->node;
+                        if (property->requiredBit >= 0) {
+                            seen[property->requiredBit] = true;
+                        }
+                    } else if (node->additionalNode >= 0) {
+                        child = node->additionalNode;
+                    } else if (!node->additionalProperties && !violate(QStringLiteral("is not an allowed property"))) {
+                        return false;
+                    }
+                }
+                
+                if (!value(child, depth + 1)) {
+                    return false;
+                }
+                m_pointer.truncate(parentLength);
+                
+                skipWhitespace();
+                if (m_pos < m_end && *m_pos == ',') {
+                    ++m_pos;
+                    continue;
+                }
+                if (m_pos < m_end && *m_pos == '}') {
+                    ++m_pos;
+                    break;
+                }
+                return fail("',' or '}'");
+            }
+        }
+        
+        if (node) {
+            for (int bit = 0; bit < seen.size(); ++bit) {
+                if (!seen[bit] && !violate(m_pointer + QLatin1Char('/') + escapePointerToken(node->required.at(bit)),
+                                           QStringLiteral("is required"))) {
+                    return false;
+                }
+            }
+        }
+        
+        return true;
+    }
+    
+    bool array(const Node *node, int depth)
+    {
+        ++m_pos;
+        int count = 0;
+        
+        skipWhitespace();
+        if (m_pos < m_end && *m_pos == ']') {
+            ++m_pos;
+        } else {
+            while (true) {
+                const qsizetype parentLength = m_pointer.size();
+                m_pointer += QLatin1Char('/');
+                m_pointer += QString::number(count);
+                
+                if (!value(node ? node->items : -1, depth + 1)) {
+                    return false;
+                }
+                m_pointer.truncate(parentLength);
+                ++count;
+                
+                skipWhitespace();
+                if (m_pos < m_end && *m_pos == ',') {
+                    ++m_pos;
+                    continue;
+                }
+                if (m_pos < m_end && *m_pos == ']') {
+                    ++m_pos;
+                    break;
+                }
+                return fail("',' or ']'");
+            }
+        }
+        
+        if (node && node->minItems >= 0 && count < node->minItems
+            && !violate(QString("must have at least %1 items").arg(node->minItems))) {
+            return false;
+        }
+        if (node && node->maxItems >= 0 && count > node->maxItems
+            && !violate(QString("must have at most %1 items").arg(node->maxItems))) {
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // Parses a string; the text is only decoded if asked for, the length (in code points) always
+    bool string(QString *text, qsizetype &length)
+    {
+        ++m_pos;
+        length = 0;
+        const char *chunk = m_pos;
+        
+        while (true) {
+            if (m_pos == m_end) {
+                return fail("a closing quote");
+            }
+            
+            const unsigned char c = static_cast<unsigned char>(*m_pos);
+            if (c == '"') {
+                if (text) {
+                    text->append(QString::fromUtf8(chunk, m_pos - chunk));
+                }
+                ++m_pos;
+                return true;
+            }
+            if (c < 0x20) {
+                return fail("an escaped control character");
+            }
+            if (c != '\\') {
+                // Count UTF-8 lead bytes, not continuation bytes
+                if ((c & 0xC0) != 0x80) {
+                    ++length;
+                }
+                ++m_pos;
+                continue;
+            }
+            
+            if (text) {
+                text->append(QString::fromUtf8(chunk, m_pos - chunk));
+            }
+            ++m_pos;
+            if (m_pos == m_end) {
+                return fail("an escape sequence");
+            }
+            
+            char16_t unit = 0;
+            switch (*m_pos++) {
+            case '"': unit = u'"'; break;
+            case '\\': unit = u'\\'; break;
+            case '/': unit = u'/'; break;
+            case 'b': unit = u'\b'; break;
+            case 'f': unit = u'\f'; break;
+            case 'n': unit = u'\n'; break;
+            case 'r': unit = u'\r'; break;
+            case 't': unit = u'\t'; break;
+            case 'u':
+                if (!hexUnit(unit)) {
+                    return false;
+                }
+                break;
+            default:
+                --m_pos;
+                return fail("a valid escape sequence");
+            }
+            
+            if (text) {
+                text->append(QChar(unit));
+            }
+            
+            // A surrogate pair written as two escapes is one code point
+            if (QChar::isHighSurrogate(unit) && m_end - m_pos >= 6 && m_pos[0] == '\\' && m_pos[1] == 'u') {
+                const char *pairStart = m_pos;
+                m_pos += 2;
+                char16_t low = 0;
+                if (!hexUnit(low)) {
+                    return false;
+                }
+                if (QChar::isLowSurrogate(low)) {
+                    if (text) {
+                        text->append(QChar(low));
+                    }
+                } else {
+                    m_pos = pairStart;
+                }
+            }
+            
+            ++length;
+            chunk = m_pos;
+        }
+    }
+    
+    bool hexUnit(char16_t &unit)
+    {
+        if (m_end - m_pos < 4) {
+            return fail("four hexadecimal digits");
+        }
+        int result = 0;
+        for (int i = 0; i < 4; ++i) {
+            const int digit = hexDigit(m_pos[i]);
+            if (digit < 0) {
+                return fail("four hexadecimal digits");
+            }
+            result = result * 16 + digit;
+        }
+        m_pos += 4;
+        unit = static_cast<char16_t>(result);
+        return true;
+    }
+    
+    bool number(double &number)
+    {
+        const char *start = m_pos;
+        auto isDigit = [this]() {
+            return m_pos < m_end && *m_pos >= '0' && *m_pos <= '9';
+        };
+        
+        if (*m_pos == '-') {
+            ++m_pos;
+        }
+        if (m_pos < m_end && *m_pos == '0') {
+            ++m_pos;
+        } else if (isDigit()) {
+            while (isDigit()) {
+                ++m_pos;
+            }
+        } else {
+            return fail("a value");
+        }
+        
+        if (m_pos < m_end && *m_pos == '.') {
+            ++m_pos;
+            if (!isDigit()) {
+                return fail("a digit");
+            }
+            while (isDigit()) {
+                ++m_pos;
+            }
+        }
+        
+        if (m_pos < m_end && (*m_pos == 'e' || *m_pos == 'E')) {
+            ++m_pos;
+            if (m_pos < m_end && (*m_pos == '+' || *m_pos == '-')) {
+                ++m_pos;
+            }
+            if (!isDigit()) {
+                return fail("a digit");
+            }
+            while (isDigit()) {
+                ++m_pos;
+            }
+        }
+        
+        // Out-of-range literals are valid JSON and convert to infinity
+        bool ok = false;
+        number = QByteArray::fromRawData(start, m_pos - start).toDouble(&ok);
+        if (!ok && !std::isinf(number)) {
+            m_pos = start;
+            return fail("a number");
+        }
+        return true;
+    }
+    
+    bool literal(const char *word)
+    {
+        const qsizetype length = qstrlen(word);
+        if (m_end - m_pos < length || qstrncmp(m_pos, word, length) != 0) {
+            return fail("a value");
+        }
+        m_pos += length;
+        return true;
+    }
+    
+    void skipWhitespace()
+    {
+        while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\t' || *m_pos == '\n' || *m_pos == '\r')) {
+            ++m_pos;
+        }
+    }
+    
+    bool checkType(const Node *&node, quint8 type)
+    {
+        // An integer also satisfies "number"
+        const quint8 accepted = type == IntegerType ? (IntegerType | NumberType) : type;
+        if (!node || node->types == 0 || (node->types & accepted)) {
+            return true;
+        }
+        
+        QStringList names;
+        const std::pair<quint8, const char *> typeNames[] = {
+            {ObjectType, "object"}, {ArrayType, "array"}, {StringType, "string"}, {NumberType, "number"},
+            {IntegerType, "integer"}, {BooleanType, "boolean"}, {NullType, "null"}
+        };
+        for (const auto &typeName : typeNames) {
+            if (node->types & typeName.first) {
+                names.append(QLatin1String(typeName.second));
+            }
+        }
+        
+        // The value's other constraints are meaningless for the wrong type
+        node = nullptr;
+        return violate(QString("must be of type %1").arg(names.join(QLatin1String(" or "))));
+    }
+    
+    bool checkString(const Node &node, const QString &text, qsizetype length)
+    {
+        if (node.minLength >= 0 && length < node.minLength
+            && !violate(QString("must be at least %1 characters long").arg(node.minLength))) {
+            return false;
+        }
+        if (node.maxLength >= 0 && length > node.maxLength
+            && !violate(QString("must be at most %1 characters long").arg(node.maxLength))) {
+            return false;
+        }
+        if (node.hasPattern && !node.pattern.match(text).hasMatch()
+            && !violate(QString("must match the pattern %1").arg(node.pattern.pattern()))) {
+            return false;
+        }
+        return checkAllowed(node, QJsonValue(text));
+    }
+    
+    bool checkNumber(const Node &node, double number)
+    {
+        if (node.minimum && number < *node.minimum
+            && !violate(QString("must be at least %1").arg(formatNumber(*node.minimum)))) {
+            return false;
+        }
+        if (node.exclusiveMinimum && number <= *node.exclusiveMinimum
+            && !violate(QString("must be greater than %1").arg(formatNumber(*node.exclusiveMinimum)))) {
+            return false;
+        }
+        if (node.maximum && number > *node.maximum
+            && !violate(QString("must be at most %1").arg(formatNumber(*node.maximum)))) {
+            return false;
+        }
+        if (node.exclusiveMaximum && number >= *node.exclusiveMaximum
+            && !violate(QString("must be less than %1").arg(formatNumber(*node.exclusiveMaximum)))) {
+            return false;
+        }
+        return checkAllowed(node, QJsonValue(number));
+    }
+    
+    bool checkAllowed(const Node &node, const QJsonValue &value)
+    {
+        if (node.allowed.isEmpty()) {
+            return true;
+        }
+        for (const QJsonValue &allowed : node.allowed) {
+            // Numbers compare by value, whether they were written as integers or not
+            if (allowed.isDouble() && value.isDouble() ? allowed.toDouble() == value.toDouble() : allowed == value) {
+                return true;
+            }
+        }
+        return violate(QStringLiteral("must be one of the allowed values"));
+    }
+    
+    bool violate(const QString &message)
+    {
+        return violate(m_pointer, message);
+    }
+    
+    bool violate(const QString &pointer, const QString &message)
+    {
+        m_violations.append(Violation{pointer, message});
+        return m_violations.size() < m_maxViolations;
+    }
+    
+    bool fail(const char *expected)
+    {
+        m_malformed = true;
+        m_violations.clear();
+        m_violations.append(Violation{m_pointer, QString("Malformed JSON: expected %1 at byte %2")
+                                                     .arg(QLatin1String(expected)).arg(m_pos - m_begin)});
+        return false;
+    }
+};
+
+std::shared_ptr<const JsonSchema> JsonSchema::compile(const QJsonObject &schema, QString *error)
+{
+    auto compiled = std::make_shared<JsonSchema>();
+    
+    QString reason;
+    if (compiled->compileNode(schema, QString(), &reason) < 0) {
+        if (error) {
+            *error = reason;
+        }
+        return nullptr;
+    }
+    
+    return compiled;
+}
+
+JsonSchema::Result JsonSchema::validate(const QByteArray &json, QList<Violation> &violations, int maxViolations) const
+{
+    violations.clear();
+    return Parser(*this, json, violations, maxViolations).run();
+}
+
+int JsonSchema::compileNode(const QJsonValue &schema, const QString &path, QString *error)
+{
+    // Children are appended while this node is compiled, so it is stored at the end
+    const int index = static_cast<int>(m_nodes.size());
+    m_nodes.emplace_back();
+    Node node;
+    
+    if (schema.isBool()) {
+        node.never = !schema.toBool();
+        m_nodes[static_cast<size_t>(index)] = std::move(node);
+        return index;
+    }
+    if (!schema.isObject()) {
+        *error = QString("The schema at '%1' is not an object").arg(path);
+        return -1;
+    }
+    
+    const QJsonObject object = schema.toObject();
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+        const QString keyword = it.key();
+        const QJsonValue value = it.value();
+        const QString location = path + QLatin1Char('/') + escapePointerToken(keyword);
+        bool valid = true;
+        
+        if (keyword == QLatin1String("type")) {
+            const QJsonArray names = value.isArray() ? value.toArray() : QJsonArray{value};
+            for (const QJsonValue &name : names) {
+                const QString type = name.toString();
+                if (type == QLatin1String("null")) {
+                    node.types |= NullType;
+                } else if (type == QLatin1String("boolean")) {
+                    node.types |= BooleanType;
+                } else if (type == QLatin1String("integer")) {
+                    node.types |= IntegerType;
+                } else if (type == QLatin1String("number")) {
+                    node.types |= NumberType;
+                } else if (type == QLatin1String("string")) {
+                    node.types |= StringType;
+                } else if (type == QLatin1String("array")) {
+                    node.types |= ArrayType;
+                } else if (type == QLatin1String("object")) {
+                    node.types |= ObjectType;
+                } else {
+                    valid = false;
+                }
+            }
+        } else if (keyword == QLatin1String("properties")) {
+            valid = value.isObject();
+            const QJsonObject properties = value.toObject();
+            for (auto property = properties.constBegin(); valid && property != properties.constEnd(); ++property) {
+                const int child = compileNode(property.value(), location + QLatin1Char('/') + escapePointerToken(property.key()), error);
+                if (child < 0) {
+                    return -1;
+                }
+                node.properties[property.key()].node = child;
+            }
+        } else if (keyword == QLatin1String("required")) {
+            valid = value.isArray();
+            for (const QJsonValue &name : value.toArray()) {
+                if (!name.isString()) {
+                    valid = false;
+                    break;
+                }
+                Property &property = node.properties[name.toString()];
+                if (property.requiredBit < 0) {
+                    property.requiredBit = static_cast<int>(node.required.size());
+                    node.required.append(name.toString());
+                }
+            }
+        } else if (keyword == QLatin1String("additionalProperties")) {
+            if (value.isBool()) {
+                node.additionalProperties = value.toBool();
+            } else {
+                node.additionalNode = compileNode(value, location, error);
+                if (node.additionalNode < 0) {
+                    return -1;
+                }
+            }
+        } else if (keyword == QLatin1String("items")) {
+            // The tuple form (an array of schemas) is not supported
+            valid = value.isObject() || value.isBool();
+            if (valid) {
+                node.items = compileNode(value, location, error);
+                if (node.items < 0) {
+                    return -1;
+                }
+            }
+        } else if (keyword == QLatin1String("minItems")) {
+            valid = readCount(value, node.minItems);
+        } else if (keyword == QLatin1String("maxItems")) {
+            valid = readCount(value, node.maxItems);
+        } else if (keyword == QLatin1String("minLength")) {
+            valid = readCount(value, node.minLength);
+        } else if (keyword == QLatin1String("maxLength")) {
+            valid = readCount(value, node.maxLength);
+        } else if (keyword == QLatin1String("pattern")) {
+            node.pattern = QRegularExpression(value.toString());
+            node.pattern.optimize();
+            node.hasPattern = true;
+            valid = value.isString() && node.pattern.isValid();
+        } else if (keyword == QLatin1String("minimum")) {
+            valid = value.isDouble();
+            node.minimum = value.toDouble();
+        } else if (keyword == QLatin1String("maximum")) {
+            valid = value.isDouble();
+            node.maximum = value.toDouble();
+        } else if (keyword == QLatin1String("exclusiveMinimum")) {
+            valid = value.isDouble();
+            node.exclusiveMinimum = value.toDouble();
+        } else if (keyword == QLatin1String("exclusiveMaximum")) {
+            valid = value.isDouble();
+            node.exclusiveMaximum = value.toDouble();
+        } else if (keyword == QLatin1String("enum") || keyword == QLatin1String("const")) {
+            const QJsonArray values = keyword == QLatin1String("enum") ? value.toArray() : QJsonArray{value};
+            valid = keyword == QLatin1String("const") || value.isArray();
+            for (const QJsonValue &allowed : values) {
+                if (allowed.isArray() || allowed.isObject()) {
+                    valid = false;
+                    break;
+                }
+                node.allowed.append(allowed);
+            }
+        } else if (!isAnnotation(keyword)) {
+            *error = QString("Unsupported JSON Schema keyword at '%1'").arg(location);
+            return -1;
+        }
+        
+        if (!valid) {
+            *error = QString("Invalid value for the JSON Schema keyword at '%1'").arg(location);
+            return -1;
+        }
+    }
+    
+    m_nodes[static_cast<size_t>(index)] = std::move(node);
+    return index;
+}
@@ -0,0 +1,117 @@
+#ifndef JSONSCHEMA_H
+#define JSONSCHEMA_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QList>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+ * @brief The JsonSchema class validates JSON documents against a precompiled JSON Schema
+ * 
+ * A schema is compiled once into a flat table of nodes, with property lookups hashed,
+ * required properties numbered and patterns compiled, so validating a document does not
+ * interpret the schema again. Validation runs while the document is parsed, in a single
+ * pass over the raw bytes, and builds no QJsonDocument; only strings that a constraint
+ * looks at are decoded.
+ * 
+ * Supported keywords: type, properties, required, additionalProperties, items, minItems,
+ * maxItems, minLength, maxLength, pattern, minimum, maximum, exclusiveMinimum,
+ * exclusiveMaximum, enum and const (scalar values only). Annotations such as title,
+ * description and format are ignored. Any other keyword ($ref, allOf, oneOf, ...) makes
+ * compilation fail, so a schema never silently enforces less than it says.
+ */
+class JsonSchema
+{
+public:
+    struct Violation
+    {
+        QString pointer;  // JSON Pointer (RFC 6901) to the offending value; empty for the document
+        QString message;
+    };
+    
+    enum class Result {
+        Valid,
+        Invalid,   // Well-formed JSON that does not match the schema
+        Malformed  // Not JSON; the single violation says where parsing failed
+    };
+    
+    static constexpr int MaxDepth = 64;
+    
+    /**
+     * @brief Compiles a schema
+     * 
+     * @param error Receives the reason if the schema is malformed or uses unsupported keywords
+     * @return The compiled schema, or null on error
+     */
+    static std::shared_ptr<const JsonSchema> compile(const QJsonObject &schema, QString *error = nullptr);
+    
+    /**
+     * @brief Parses a document and validates it against the schema in the same pass
+     * 
+     * @param violations Receives the violations found, in document order
+     * @param maxViolations Validation stops once this many violations were found
+     */
+    Result validate(const QByteArray &json, QList<Violation> &violations, int maxViolations = 20) const;
+
+private:
+    enum TypeFlag : quint8 {
+        NullType = 1,
+        BooleanType = 2,
+        IntegerType = 4,
+        NumberType = 8,
+        StringType = 16,
+        ArrayType = 32,
+        ObjectType = 64
+    };
+    
+    struct Property
+    {
+        int node = -1;         // Schema of the value, -1 accepts anything
+        int requiredBit = -1;  // Index among the required properties, -1 if optional
+    };
+    
+    struct Node
+    {
+        quint8 types = 0;  // Accepted TypeFlags; 0 accepts every type
+        bool never = false;  // The "false" schema
+        
+        QHash<QString, Property> properties;
+        QStringList required;  // Indexed by Property::requiredBit
+        bool additionalProperties = true;
+        int additionalNode = -1;
+        
+        int items = -1;
+        int minItems = -1;
+        int maxItems = -1;
+        
+        int minLength = -1;
+        int maxLength = -1;
+        QRegularExpression pattern;
+        bool hasPattern = false;
+        
+        std::optional<double> minimum;
+        std::optional<double> maximum;
+        std::optional<double> exclusiveMinimum;
+        std::optional<double> exclusiveMaximum;
+        
+        QList<QJsonValue> allowed;  // enum and const; empty accepts any value
+        
+        bool needsStringValue() const;
+    };
+    
+    class Parser;
+    
+    std::vector<Node> m_nodes;  // The root schema is node 0
+    
+    int compileNode(const QJsonValue &schema, const QString &path, QString *error);
+};
+
+#endif // JSONSCHEMA_H
@@ -0,0 +1,248 @@
+#include "jsonwriter.h"
+#include "requestarena.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QStringEncoder>
+#include <QVarLengthArray>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+JsonWriter::JsonWriter(QByteArray &out)
+    : m_out(out),
+      m_needsComma(false),
+      m_afterKey(false)
+{
+}
+
+void JsonWriter::beginObject()
+{
+    separator();
+    m_out += '{';
+    m_needsComma = false;
+}
+
+void JsonWriter::endObject()
+{
+    m_out += '}';
+    m_needsComma = true;
+}
+
+void JsonWriter::beginArray()
+{
+    separator();
+    m_out += '[';
+    m_needsComma = false;
+}
+
+void JsonWriter::endArray()
+{
+    m_out += ']';
+    m_needsComma = true;
+}
+
+void JsonWriter::key(QStringView name)
+{
+    separator();
+    m_out += '"';
+    appendEscaped(name);
+    m_out += "\":";
+    m_afterKey = true;
+}
+
+void JsonWriter::key(const char *name)
+{
+    separator();
+    m_out += '"';
+    appendEscaped(name, static_cast<qsizetype>(std::strlen(name)));
+    m_out += "\":";
+    m_afterKey = true;
+}
+
+void JsonWriter::value(QStringView text)
+{
+    separator();
+    m_out += '"';
+    appendEscaped(text);
+    m_out += '"';
+    m_needsComma = true;
+}
+
+void JsonWriter::value(const char *text)
+{
+    separator();
+    m_out += '"';
+    appendEscaped(text, static_cast<qsizetype>(std::strlen(text)));
+    m_out += '"';
+    m_needsComma = true;
+}
+
+void JsonWriter::value(std::initializer_list<QStringView> parts)
+{
+    separator();
+    m_out += '"';
+    for (QStringView part : parts) {
+        appendEscaped(part);
+    }
+    m_out += '"';
+    m_needsComma = true;
+}
+
+void JsonWriter::value(qint64 number)
+{
+    separator();
+    char digits[24];
+    const int length = std::snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(number));
+    m_out.append(digits, length);
+    m_needsComma = true;
+}
+
+void JsonWriter::value(int number)
+{
+    value(static_cast<qint64>(number));
+}
+
+void JsonWriter::value(double number)
+{
+    // JSON has no representation for NaN or infinity
+    if (!std::isfinite(number)) {
+        nullValue();
+        return;
+    }
+    
+    // Shortest form that parses back to the same double, e.g. 0.1 rather than 0.10000000000000001
+    separator();
+    m_out += QByteArray::number(number, 'g', QLocale::FloatingPointShortest);
+    m_needsComma = true;
+}
+
+void JsonWriter::value(bool flag)
+{
+    separator();
+    m_out += flag ? "true" : "false";
+    m_needsComma = true;
+}
+
+void JsonWriter::value(const QJsonValue &value)
+{
+    switch (value.type()) {
+    case QJsonValue::Bool:
+        this->value(value.toBool());
+        break;
+    case QJsonValue::Double: {
+        // Integral values are written without a fraction, as QJsonDocument does
+        const double number = value.toDouble();
+        if (std::trunc(number) == number && std::fabs(number) < 9007199254740992.0) {
+            this->value(static_cast<qint64>(number));
+        } else {
+            this->value(number);
+        }
+        break;
+    }
+    case QJsonValue::String:
+        this->value(QStringView(value.toString()));
+        break;
+    case QJsonValue::Array:
+        separator();
+        m_out += QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact);
+        m_needsComma = true;
+        break;
+    case QJsonValue::Object:
+        separator();
+        m_out += QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact);
+        m_needsComma = true;
+        break;
+    default:
+        nullValue();
+        break;
+    }
+}
+
+void JsonWriter::nullValue()
+{
+    separator();
+    m_out += "null";
+    m_needsComma = true;
+}
+
+void JsonWriter::separator()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+    
+    if (m_needsComma) {
+        m_out += ',';
+    }
+}
+
+void JsonWriter::appendEscaped(QStringView text)
+{
+    // ASCII is written directly; anything else is transcoded into the request arena first.
+    // Outside a request scope the arena is never rewound, so a local buffer is used instead.
+    const QChar *data = text.data();
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        if (data[i].unicode() >= 0x80) {
+            QStringEncoder encoder(QStringEncoder::Utf8);
+            const qsizetype size = encoder.requiredSpace(text.size());
+            RequestArena &arena = RequestArena::local();
+            if (arena.inScope()) {
+                char *utf8 = arena.allocateArray<char>(static_cast<std::size_t>(size));
+                const char *end = encoder.appendToBuffer(utf8, text);
+                appendEscaped(utf8, end - utf8);
+            } else {
+                QVarLengthArray<char, 256> utf8(size);
+                const char *end = encoder.appendToBuffer(utf8.data(), text);
+                appendEscaped(utf8.data(), end - utf8.data());
+            }
+            return;
+        }
+    }
+    
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const char c = static_cast<char>(data[i].unicode());
+        if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20) {
+            appendEscaped(&c, 1);
+        } else {
+            m_out += c;
+        }
+    }
+}
+
+void JsonWriter::appendEscaped(const char *text, qsizetype length)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    
+    for (qsizetype i = 0; i < length; ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        switch (c) {
+        case '"':
+            m_out += "\\\"";
+            break;
+        case '\\':
+            m_out += "\\\\";
+            break;
+        case '\n':
+            m_out += "\\n";
+            break;
+        case '\r':
+            m_out += "\\r";
+            break;
+        case '\t':
+            m_out += "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                m_out += "\\u00";
+                m_out += hexDigits[c >> 4];
+                m_out += hexDigits[c & 0xf];
+            } else {
+                m_out += static_cast<char>(c);
+            }
+            break;
+        }
+    }
+}
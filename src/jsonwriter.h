@@ -0,0 +1,58 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <QByteArray>
+#include <QJsonValue>
+#include <QStringView>
+#include <initializer_list>
+
+/**
+ * @brief The JsonWriter class serializes JSON straight into a byte buffer
+ * 
+ * Unlike building a QJsonObject and calling QJsonDocument::toJson(), it creates no
+ * intermediate tree and writes into a buffer the caller provides, typically one from
+ * BufferPool. Non-ASCII strings are transcoded to UTF-8 in the request arena, or in a
+ * local buffer when no RequestArenaScope is open. The writer does not validate the call
+ * sequence; keys and values must alternate inside objects.
+ */
+class JsonWriter
+{
+public:
+    explicit JsonWriter(QByteArray &out);
+    
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    
+    /**
+     * @brief Writes an object key; the next call must write its value
+     */
+    void key(QStringView name);
+    void key(const char *name);
+    
+    void value(QStringView text);
+    void value(const char *text);
+    void value(qint64 number);
+    void value(int number);
+    void value(double number);
+    void value(bool flag);
+    void value(const QJsonValue &value);
+    void nullValue();
+    
+    /**
+     * @brief Writes one string value made of several parts, without concatenating them first
+     */
+    void value(std::initializer_list<QStringView> parts);
+
+private:
+    QByteArray &m_out;
+    bool m_needsComma;
+    bool m_afterKey;
+    
+    void separator();
+    void appendEscaped(QStringView text);
+    void appendEscaped(const char *text, qsizetype length);
+};
+
+#endif // JSONWRITER_H
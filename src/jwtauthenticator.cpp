@@ -0,0 +1,627 @@
+#include "jwtauthenticator.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+
+#ifdef API_HAVE_OPENSSL
+#include <openssl/bn.h>
+#include <openssl/core_names.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/param_build.h>
+#endif
+
+namespace {
+// Larger Authorization values are rejected before any decoding
+constexpr int MaxTokenSize = 8192;
+
+// RSA keys shorter than this are refused when the key set is loaded
+constexpr int MinRsaKeyBits = 2048;
+
+thread_local JwtAuthenticator::ClaimsPtr s_currentClaims;
+
+// Decodes unpadded base64url (RFC 7515, section 2), failing on any other character
+QByteArray decodeBase64Url(const QByteArray &data, bool *ok)
+{
+    const QByteArray::FromBase64Result result = QByteArray::fromBase64Encoding(
+        data, QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals | QByteArray::AbortOnBase64DecodingErrors);
+    *ok = result.decodingStatus == QByteArray::Base64DecodingStatus::Ok;
+    return result.decoded;
+}
+
+// Decodes a base64url part into a JSON object
+bool decodeJsonPart(const QByteArray &part, QJsonObject &object)
+{
+    bool ok = false;
+    const QByteArray json = decodeBase64Url(part, &ok);
+    if (!ok) {
+        return false;
+    }
+    
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &error);
+    if (error.error != QJsonParseError::NoError || !document.isObject()) {
+        return false;
+    }
+    
+    object = document.object();
+    return true;
+}
+
+#ifdef API_HAVE_OPENSSL
+EVP_PKEY *createPublicKey(const char *type, OSSL_PARAM_BLD *builder)
+{
+    EVP_PKEY *key = nullptr;
+    OSSL_PARAM *params = OSSL_PARAM_BLD_to_param(builder);
+    EVP_PKEY_CTX *context = EVP_PKEY_CTX_new_from_name(nullptr, type, nullptr);
+    if (params && context && EVP_PKEY_fromdata_init(context) == 1) {
+        EVP_PKEY_fromdata(context, &key, EVP_PKEY_PUBLIC_KEY, params);
+    }
+    EVP_PKEY_CTX_free(context);
+    OSSL_PARAM_free(params);
+    return key;
+}
+
+EVP_PKEY *createRsaKey(const QByteArray &modulus, const QByteArray &exponent)
+{
+    EVP_PKEY *key = nullptr;
+    BIGNUM *n = BN_bin2bn(reinterpret_cast<const unsigned char *>(modulus.constData()), modulus.size(), nullptr);
+    BIGNUM *e = BN_bin2bn(reinterpret_cast<const unsigned char *>(exponent.constData()), exponent.size(), nullptr);
+    OSSL_PARAM_BLD *builder = OSSL_PARAM_BLD_new();
+    if (n && e && builder
+        && OSSL_PARAM_BLD_push_BN(builder, OSSL_PKEY_PARAM_RSA_N, n) == 1
+        && OSSL_PARAM_BLD_push_BN(builder, OSSL_PKEY_PARAM_RSA_E, e) == 1) {
+        key = createPublicKey("RSA", builder);
+    }
+    OSSL_PARAM_BLD_free(builder);
+    BN_free(n);
+    BN_free(e);
+    return key;
+}
+
+EVP_PKEY *createP256Key(const QByteArray &x, const QByteArray &y)
+{
+    // Uncompressed SEC 1 point; importing it checks that the point lies on the curve
+    const QByteArray point = '\x04' + x + y;
+    
+    EVP_PKEY *key = nullptr;
+    OSSL_PARAM_BLD *builder = OSSL_PARAM_BLD_new();
+    if (builder
+        && OSSL_PARAM_BLD_push_utf8_string(builder, OSSL_PKEY_PARAM_GROUP_NAME, "prime256v1", 0) == 1
+        && OSSL_PARAM_BLD_push_octet_string(builder, OSSL_PKEY_PARAM_PUB_KEY, point.constData(), point.size()) == 1) {
+        key = createPublicKey("EC", builder);
+    }
+    OSSL_PARAM_BLD_free(builder);
+    return key;
+}
+
+// JWS carries an ECDSA signature as the raw r || s pair, OpenSSL expects a DER ECDSA-Sig-Value
+QByteArray ecdsaSignatureToDer(const QByteArray &signature)
+{
+    if (signature.size() != 64) {
+        return QByteArray();
+    }
+    
+    const auto *raw = reinterpret_cast<const unsigned char *>(signature.constData());
+    ECDSA_SIG *sig = ECDSA_SIG_new();
+    BIGNUM *r = BN_bin2bn(raw, 32, nullptr);
+    BIGNUM *s = BN_bin2bn(raw + 32, 32, nullptr);
+    if (!sig || !r || !s || ECDSA_SIG_set0(sig, r, s) != 1) {
+        BN_free(r);
+        BN_free(s);
+        ECDSA_SIG_free(sig);
+        return QByteArray();
+    }
+    
+    unsigned char *der = nullptr;
+    const int length = i2d_ECDSA_SIG(sig, &der);
+    ECDSA_SIG_free(sig);
+    if (length <= 0) {
+        return QByteArray();
+    }
+    
+    const QByteArray result(reinterpret_cast<const char *>(der), length);
+    OPENSSL_free(der);
+    return result;
+}
+
+bool verifySha256Signature(EVP_PKEY *key, const QByteArray &input, const QByteArray &signature)
+{
+    if (signature.isEmpty()) {
+        return false;
+    }
+    
+    EVP_MD_CTX *context = EVP_MD_CTX_new();
+    const bool valid = context
+        && EVP_DigestVerifyInit(context, nullptr, EVP_sha256(), nullptr, key) == 1
+        && EVP_DigestVerify(context,
+                            reinterpret_cast<const unsigned char *>(signature.constData()), signature.size(),
+                            reinterpret_cast<const unsigned char *>(input.constData()), input.size()) == 1;
+    EVP_MD_CTX_free(context);
+    return valid;
+}
+#endif
+
+// Reads a NumericDate claim; fractional seconds are truncated
+bool numericDate(const QJsonObject &payload, const QString &name, qint64 &seconds)
+{
+    const QJsonValue value = payload.value(name);
+    if (!value.isDouble()) {
+        return false;
+    }
+    seconds = static_cast<qint64>(value.toDouble());
+    return true;
+}
+}
+
+struct JwtAuthenticator::Key
+{
+    QString kid;
+    QString alg;  // "RS256" or "ES256"
+#ifdef API_HAVE_OPENSSL
+    EVP_PKEY *key = nullptr;
+    
+    ~Key()
+    {
+        EVP_PKEY_free(key);
+    }
+#endif
+};
+
+JwtAuthenticator::JwtAuthenticator()
+    : m_shardCapacity(0)
+{
+    configure(Settings());
+}
+
+JwtAuthenticator::~JwtAuthenticator() = default;
+
+bool JwtAuthenticator::configure(const Settings &settings, QString *error)
+{
+    m_settings = settings;
+    m_settings.cacheShards = std::max(1, settings.cacheShards);
+    m_settings.leewaySeconds = std::max(0, settings.leewaySeconds);
+    
+    // Round the per-shard capacity up, so that a small budget does not disable the cache
+    const int maxEntries = std::max(0, m_settings.cacheMaxEntries);
+    m_shardCapacity = (maxEntries + m_settings.cacheShards - 1) / m_settings.cacheShards;
+    
+    m_shards.clear();
+    m_shards.reserve(static_cast<size_t>(m_settings.cacheShards));
+    for (int i = 0; i < m_settings.cacheShards; ++i) {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+    
+    m_keys.clear();
+    if (m_settings.jwksFile.isEmpty()) {
+        if (error) {
+            *error = QStringLiteral("No JWKS file is configured");
+        }
+        return false;
+    }
+    
+    if (!isSupported()) {
+        if (error) {
+            *error = QStringLiteral("Built without OpenSSL, tokens cannot be verified");
+        }
+        return false;
+    }
+    
+    QFile file(m_settings.jwksFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = QString("Cannot open JWKS file %1: %2").arg(m_settings.jwksFile, file.errorString());
+        }
+        return false;
+    }
+    
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError || !document.object().value("keys").isArray()) {
+        if (error) {
+            *error = QString("JWKS file %1 is not a JSON Web Key Set").arg(m_settings.jwksFile);
+        }
+        return false;
+    }
+    
+    // Unusable keys are skipped, so one unsupported entry does not disable the others
+    QString firstError;
+    const QJsonArray keys = document.object().value("keys").toArray();
+    for (const QJsonValue &value : keys) {
+        QString keyError;
+        KeyPtr key = parseKey(value.toObject(), &keyError);
+        if (key) {
+            m_keys.append(key);
+        } else if (firstError.isEmpty()) {
+            firstError = keyError;
+        }
+    }
+    
+    if (m_keys.isEmpty()) {
+        if (error) {
+            *error = QString("JWKS file %1 holds no usable key%2")
+                         .arg(m_settings.jwksFile, firstError.isEmpty() ? QString() : ": " + firstError);
+        }
+        return false;
+    }
+    
+    return true;
+}
+
+JwtAuthenticator::Result JwtAuthenticator::authenticate(const QByteArray &authorization)
+{
+    // The scheme name is case-insensitive (RFC 7235, section 2.1)
+    const QByteArray value = authorization.trimmed();
+    if (value.size() < 7 || qstrnicmp(value.constData(), "Bearer ", 7) != 0) {
+        return reject(Status::Missing, QStringLiteral("The request carries no bearer token"));
+    }
+    
+    const QByteArray token = value.mid(7).trimmed();
+    if (token.isEmpty()) {
+        return reject(Status::Missing, QStringLiteral("The request carries no bearer token"));
+    }
+    if (token.size() > MaxTokenSize) {
+        return reject(Status::Invalid, QStringLiteral("The token is too large"));
+    }
+    
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const QByteArray digest = QCryptographicHash::hash(token, QCryptographicHash::Sha256);
+    
+    if (m_shardCapacity > 0) {
+        Shard &shard = shardFor(digest);
+        QMutexLocker locker(&shard.mutex);
+        
+        const auto found = shard.tokens.constFind(digest);
+        if (found != shard.tokens.constEnd()) {
+            if (found.value()->expiresAt + m_settings.leewaySeconds > now) {
+                const ClaimsPtr claims = found.value();
+                locker.unlock();
+                m_hits.fetch_add(1, std::memory_order_relaxed);
+                return checkScopes(claims);
+            }
+            shard.tokens.erase(found);
+        }
+    }
+    
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    
+    // The signature check runs without any lock held
+    Result result = verify(token, now);
+    if (result.status != Status::Ok) {
+        return reject(result.status, result.detail);
+    }
+    
+    if (m_shardCapacity > 0) {
+        Shard &shard = shardFor(digest);
+        QMutexLocker locker(&shard.mutex);
+        store(shard, digest, result.claims);
+    }
+    
+    return checkScopes(result.claims);
+}
+
+void JwtAuthenticator::clearCache()
+{
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard->mutex);
+        shard->tokens.clear();
+    }
+}
+
+int JwtAuthenticator::keyCount() const
+{
+    return static_cast<int>(m_keys.size());
+}
+
+int JwtAuthenticator::cachedCount() const
+{
+    int count = 0;
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard->mutex);
+        count += static_cast<int>(shard->tokens.size());
+    }
+    return count;
+}
+
+quint64 JwtAuthenticator::hitCount() const
+{
+    return m_hits.load(std::memory_order_relaxed);
+}
+
+quint64 JwtAuthenticator::missCount() const
+{
+    return m_misses.load(std::memory_order_relaxed);
+}
+
+quint64 JwtAuthenticator::rejectedCount() const
+{
+    return m_rejected.load(std::memory_order_relaxed);
+}
+
+JwtAuthenticator::ClaimsPtr JwtAuthenticator::current()
+{
+    return s_currentClaims;
+}
+
+bool JwtAuthenticator::isSupported()
+{
+#ifdef API_HAVE_OPENSSL
+    return true;
+#else
+    return false;
+#endif
+}
+
+JwtAuthenticator::Result JwtAuthenticator::verify(const QByteArray &token, qint64 now) const
+{
+    Result result;
+    result.status = Status::Invalid;
+    
+    // Compact serialization: header.payload.signature
+    const int firstDot = token.indexOf('.');
+    const int secondDot = firstDot < 0 ? -1 : token.indexOf('.', firstDot + 1);
+    if (secondDot < 0 || token.indexOf('.', secondDot + 1) >= 0) {
+        result.detail = QStringLiteral("The token is not a compact JSON Web Signature");
+        return result;
+    }
+    
+    QJsonObject header;
+    if (!decodeJsonPart(token.left(firstDot), header)) {
+        result.detail = QStringLiteral("The token header is malformed");
+        return result;
+    }
+    
+    // Only the configured asymmetric algorithms are accepted, which rules out "none" and
+    // HS256 tokens signed with a public key as the shared secret
+    const QString alg = header.value("alg").toString();
+    if (alg != QLatin1String("RS256") && alg != QLatin1String("ES256")) {
+        result.detail = QStringLiteral("The token algorithm is not supported");
+        return result;
+    }
+    if (header.contains("crit")) {
+        result.detail = QStringLiteral("The token uses unsupported critical header parameters");
+        return result;
+    }
+    
+    const Key *key = findKey(alg, header.value("kid").toString());
+    if (!key) {
+        result.detail = QStringLiteral("No configured key matches the token");
+        return result;
+    }
+    
+    bool ok = false;
+    const QByteArray signature = decodeBase64Url(token.mid(secondDot + 1), &ok);
+    if (!ok) {
+        result.detail = QStringLiteral("The token signature is malformed");
+        return result;
+    }
+
+#ifdef API_HAVE_OPENSSL
+    const QByteArray input = token.left(secondDot);
+    const bool valid = alg == QLatin1String("ES256")
+        ? verifySha256Signature(key->key, input, ecdsaSignatureToDer(signature))
+        : verifySha256Signature(key->key, input, signature);
+#else
+    const bool valid = false;
+#endif
+    if (!valid) {
+        result.detail = QStringLiteral("The token signature is invalid");
+        return result;
+    }
+    
+    // The claims are only looked at once the signature is known to be good
+    QJsonObject payload;
+    if (!decodeJsonPart(token.mid(firstDot + 1, secondDot - firstDot - 1), payload)) {
+        result.detail = QStringLiteral("The token payload is malformed");
+        return result;
+    }
+    
+    // Tokens without an expiry could never leave the cache
+    qint64 expiresAt = 0;
+    if (!numericDate(payload, QStringLiteral("exp"), expiresAt)) {
+        result.detail = QStringLiteral("The token has no expiry");
+        return result;
+    }
+    if (expiresAt + m_settings.leewaySeconds <= now) {
+        result.status = Status::Expired;
+        result.detail = QStringLiteral("The token has expired");
+        return result;
+    }
+    
+    qint64 notBefore = 0;
+    if (numericDate(payload, QStringLiteral("nbf"), notBefore) && notBefore - m_settings.leewaySeconds > now) {
+        result.detail = QStringLiteral("The token is not valid yet");
+        return result;
+    }
+    
+    if (!m_settings.issuer.isEmpty() && payload.value("iss").toString() != m_settings.issuer) {
+        result.detail = QStringLiteral("The token was issued by an untrusted issuer");
+        return result;
+    }
+    
+    if (!m_settings.audience.isEmpty()) {
+        const QJsonValue audience = payload.value("aud");
+        const bool listed = audience.isArray() ? audience.toArray().contains(QJsonValue(m_settings.audience))
+                                               : audience.toString() == m_settings.audience;
+        if (!listed) {
+            result.detail = QStringLiteral("The token is not intended for this audience");
+            return result;
+        }
+    }
+    
+    auto claims = std::make_shared<Claims>();
+    claims->subject = payload.value("sub").toString();
+    claims->expiresAt = expiresAt;
+    
+    // Scopes are a space-separated "scope" string (RFC 8693) or an "scp" list
+    if (payload.value("scope").isString()) {
+        claims->scopes = payload.value("scope").toString().split(' ', Qt::SkipEmptyParts);
+    } else if (payload.value("scp").isArray()) {
+        for (const QJsonValue &scope : payload.value("scp").toArray()) {
+            claims->scopes.append(scope.toString());
+        }
+    } else if (payload.value("scp").isString()) {
+        claims->scopes = payload.value("scp").toString().split(' ', Qt::SkipEmptyParts);
+    }
+    
+    claims->payload = payload;
+    
+    result.status = Status::Ok;
+    result.claims = claims;
+    return result;
+}
+
+JwtAuthenticator::Result JwtAuthenticator::checkScopes(const ClaimsPtr &claims)
+{
+    for (const QString &scope : std::as_const(m_settings.requiredScopes)) {
+        if (!claims->scopes.contains(scope)) {
+            return reject(Status::InsufficientScope, QString("The token lacks the scope '%1'").arg(scope), claims);
+        }
+    }
+    
+    Result result;
+    result.status = Status::Ok;
+    result.claims = claims;
+    return result;
+}
+
+JwtAuthenticator::Result JwtAuthenticator::reject(Status status, const QString &detail, const ClaimsPtr &claims)
+{
+    m_rejected.fetch_add(1, std::memory_order_relaxed);
+    
+    Result result;
+    result.status = status;
+    result.claims = claims;
+    result.detail = detail;
+    return result;
+}
+
+const JwtAuthenticator::Key *JwtAuthenticator::findKey(const QString &alg, const QString &kid) const
+{
+    // Without a "kid" the token can only be matched when one key uses its algorithm
+    const Key *match = nullptr;
+    for (const KeyPtr &key : m_keys) {
+        if (key->alg != alg) {
+            continue;
+        }
+        if (!kid.isEmpty()) {
+            if (key->kid == kid) {
+                return key.get();
+            }
+            continue;
+        }
+        if (match) {
+            return nullptr;
+        }
+        match = key.get();
+    }
+    
+    return match;
+}
+
+JwtAuthenticator::Shard &JwtAuthenticator::shardFor(const QByteArray &digest)
+{
+    return *m_shards[qHash(digest) % m_shards.size()];
+}
+
+void JwtAuthenticator::store(Shard &shard, const QByteArray &digest, const ClaimsPtr &claims)
+{
+    if (shard.tokens.size() >= m_shardCapacity) {
+        // Drop expired tokens first; if the shard is still full, an arbitrary entry makes room
+        const qint64 now = QDateTime::currentSecsSinceEpoch();
+        for (auto it = shard.tokens.begin(); it != shard.tokens.end();) {
+            if (it.value()->expiresAt + m_settings.leewaySeconds <= now) {
+                it = shard.tokens.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (shard.tokens.size() >= m_shardCapacity) {
+            shard.tokens.erase(shard.tokens.begin());
+        }
+    }
+    
+    shard.tokens.insert(digest, claims);
+}
+
+JwtAuthenticator::KeyPtr JwtAuthenticator::parseKey(const QJsonObject &jwk, QString *error)
+{
+    const QString kid = jwk.value("kid").toString();
+    const QString kty = jwk.value("kty").toString();
+    const QString use = jwk.value("use").toString();
+    
+    if (!use.isEmpty() && use != QLatin1String("sig")) {
+        *error = QString("Key '%1' is not a signature key").arg(kid);
+        return nullptr;
+    }
+    
+    auto key = std::make_shared<Key>();
+    key->kid = kid;
+    
+    bool ok = true;
+    if (kty == QLatin1String("RSA")) {
+        key->alg = QStringLiteral("RS256");
+        const QByteArray modulus = decodeBase64Url(jwk.value("n").toString().toLatin1(), &ok);
+        bool exponentOk = false;
+        const QByteArray exponent = decodeBase64Url(jwk.value("e").toString().toLatin1(), &exponentOk);
+        if (!ok || !exponentOk || modulus.isEmpty() || exponent.isEmpty()) {
+            *error = QString("RSA key '%1' has no valid modulus and exponent").arg(kid);
+            return nullptr;
+        }
+#ifdef API_HAVE_OPENSSL
+        key->key = createRsaKey(modulus, exponent);
+        if (key->key && EVP_PKEY_get_bits(key->key) < MinRsaKeyBits) {
+            *error = QString("RSA key '%1' is shorter than %2 bits").arg(kid).arg(MinRsaKeyBits);
+            return nullptr;
+        }
+#endif
+    } else if (kty == QLatin1String("EC")) {
+        key->alg = QStringLiteral("ES256");
+        if (jwk.value("crv").toString() != QLatin1String("P-256")) {
+            *error = QString("EC key '%1' does not use the P-256 curve").arg(kid);
+            return nullptr;
+        }
+        const QByteArray x = decodeBase64Url(jwk.value("x").toString().toLatin1(), &ok);
+        bool yOk = false;
+        const QByteArray y = decodeBase64Url(jwk.value("y").toString().toLatin1(), &yOk);
+        if (!ok || !yOk || x.size() != 32 || y.size() != 32) {
+            *error = QString("EC key '%1' has no valid coordinates").arg(kid);
+            return nullptr;
+        }
+#ifdef API_HAVE_OPENSSL
+        key->key = createP256Key(x, y);
+#endif
+    } else {
+        *error = QString("Key '%1' has the unsupported type '%2'").arg(kid, kty);
+        return nullptr;
+    }
+    
+    const QString alg = jwk.value("alg").toString();
+    if (!alg.isEmpty() && alg != key->alg) {
+        *error = QString("Key '%1' is meant for the unsupported algorithm %2").arg(kid, alg);
+        return nullptr;
+    }
+
+#ifdef API_HAVE_OPENSSL
+    if (!key->key) {
+        *error = QString("Key '%1' could not be imported").arg(kid);
+        return nullptr;
+    }
+#endif
+
+    return key;
+}
+
+ClaimsScope::ClaimsScope(JwtAuthenticator::ClaimsPtr claims)
+    : m_previous(std::move(s_currentClaims))
+{
+    s_currentClaims = std::move(claims);
+}
+
+ClaimsScope::~ClaimsScope()
+{
+    s_currentClaims = std::move(m_previous);
+}
@@ -0,0 +1,147 @@
+#ifndef JWTAUTHENTICATOR_H
+#define JWTAUTHENTICATOR_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The JwtAuthenticator class validates bearer JSON Web Tokens against locally configured keys
+ * 
+ * Keys are read from a JWKS file (RFC 7517) and tokens must be signed with RS256 or ES256.
+ * A token is accepted when its signature verifies, it has not expired, it is already valid
+ * ("nbf") and, if configured, its issuer and audience match.
+ * 
+ * Verifying an RSA or ECDSA signature costs far more than the rest of the request pipeline,
+ * while clients send the same token with every request. A verified token is therefore cached
+ * until its "exp" claim, keyed by the SHA-256 digest of the token so that the cache never
+ * holds a usable credential. The cache is split into shards, each a mutex-protected hash with
+ * its own share of the entry budget.
+ * 
+ * Signature verification uses OpenSSL. Without it (API_HAVE_OPENSSL undefined) no key can be
+ * loaded and every token is rejected.
+ */
+class JwtAuthenticator
+{
+public:
+    struct Settings
+    {
+        QString jwksFile;
+        QString issuer;              // Required "iss" value; empty accepts any issuer
+        QString audience;            // Must be listed in "aud"; empty accepts any audience
+        QStringList requiredScopes;  // Must all be granted by "scope" or "scp"
+        int leewaySeconds = 60;      // Allowed clock skew for "exp" and "nbf"
+        int cacheMaxEntries = 10000; // Shared equally by the shards; 0 disables the cache
+        int cacheShards = 16;
+    };
+    
+    enum class Status {
+        Ok,
+        Missing,           // No bearer token was sent
+        Invalid,           // Malformed, wrongly signed, or rejected claims
+        Expired,
+        InsufficientScope  // Valid, but lacks a required scope
+    };
+    
+    struct Claims
+    {
+        QJsonObject payload;
+        QString subject;
+        QStringList scopes;
+        qint64 expiresAt = 0;  // Unix seconds
+    };
+    
+    using ClaimsPtr = std::shared_ptr<const Claims>;
+    
+    struct Result
+    {
+        Status status = Status::Missing;
+        ClaimsPtr claims;  // Set for Ok and InsufficientScope
+        QString detail;    // Why the token was rejected
+    };
+    
+    JwtAuthenticator();
+    ~JwtAuthenticator();
+    
+    /**
+     * @brief Replaces the settings, loads the JWKS file and empties the cache; must not be called while serving
+     * 
+     * @param error Receives the reason if no usable key could be loaded
+     * @return false if the key set is empty afterwards, in which case every token is rejected
+     */
+    bool configure(const Settings &settings, QString *error = nullptr);
+    
+    /**
+     * @brief Authenticates the value of an Authorization header
+     */
+    Result authenticate(const QByteArray &authorization);
+    
+    /**
+     * @brief Removes all cached tokens
+     */
+    void clearCache();
+    
+    int keyCount() const;
+    int cachedCount() const;
+    quint64 hitCount() const;
+    quint64 missCount() const;
+    quint64 rejectedCount() const;
+    
+    /**
+     * @brief Returns the claims of the request being handled on this thread, or null
+     */
+    static ClaimsPtr current();
+    
+    /**
+     * @brief Returns true if the build can verify signatures
+     */
+    static bool isSupported();
+
+private:
+    struct Key;
+    using KeyPtr = std::shared_ptr<const Key>;
+    
+    struct Shard
+    {
+        mutable QMutex mutex;
+        QHash<QByteArray, ClaimsPtr> tokens;  // By token digest
+    };
+    
+    Settings m_settings;
+    QList<KeyPtr> m_keys;
+    int m_shardCapacity;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<quint64> m_hits{0};
+    std::atomic<quint64> m_misses{0};
+    std::atomic<quint64> m_rejected{0};
+    
+    Result verify(const QByteArray &token, qint64 now) const;
+    Result checkScopes(const ClaimsPtr &claims);
+    Result reject(Status status, const QString &detail, const ClaimsPtr &claims = ClaimsPtr());
+    const Key *findKey(const QString &alg, const QString &kid) const;
+    Shard &shardFor(const QByteArray &digest);
+    void store(Shard &shard, const QByteArray &digest, const ClaimsPtr &claims);
+    static KeyPtr parseKey(const QJsonObject &jwk, QString *error);
+};
+
+/**
+ * @brief The ClaimsScope class makes a token's claims the current ones for its lifetime
+ */
+class ClaimsScope
+{
+public:
+    explicit ClaimsScope(JwtAuthenticator::ClaimsPtr claims);
+    ~ClaimsScope();
+
+private:
+    JwtAuthenticator::ClaimsPtr m_previous;
+};
+
+#endif // JWTAUTHENTICATOR_H
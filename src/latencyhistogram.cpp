@@ -0,0 +1,74 @@
+#include "latencyhistogram.h"
+#include <cmath>
+
+void LatencyHistogram::Snapshot::merge(const Snapshot &other)
+{
+    for (int i = 0; i < BucketCount; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+}
+
+quint64 LatencyHistogram::Snapshot::valueAtQuantile(double quantile) const
+{
+    if (count == 0) {
+        return 0;
+    }
+    
+    const quint64 rank = qMax<quint64>(1, static_cast<quint64>(std::ceil(qBound(0.0, quantile, 1.0) * count)));
+    
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            // Report the largest value the bucket can hold, minus one as the bound is exclusive
+            return bucketUpperBound(i) - 1;
+        }
+    }
+    
+    return bucketUpperBound(BucketCount - 1) - 1;
+}
+
+quint64 LatencyHistogram::Snapshot::countAtOrBelow(quint64 bound) const
+{
+    quint64 total = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        if (bucketUpperBound(i) - 1 > bound) {
+            break;
+        }
+        total += buckets[i];
+    }
+    return total;
+}
+
+void LatencyHistogram::addTo(Snapshot &snapshot) const
+{
+    // Relaxed reads may see a bucket increment before the matching count increment;
+    // scrapes tolerate this skew, so derive the count from the buckets for consistency
+    quint64 count = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        const quint64 value = m_buckets[i].value();
+        snapshot.buckets[i] += value;
+        count += value;
+    }
+    snapshot.count += count;
+    snapshot.sum += m_sum.value();
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SubBucketCount) {
+        return static_cast<quint64>(index) + 1;
+    }
+    
+    const int shift = index / SubBucketCount - 1;
+    const quint64 subBucket = static_cast<quint64>(index % SubBucketCount);
+    
+    // The last bucket would overflow; it holds everything up to the maximum value
+    if (shift >= 64 - SubBucketBits - 1 && subBucket == SubBucketCount - 1) {
+        return ~quint64(0);
+    }
+    
+    return (SubBucketCount + subBucket + 1) << shift;
+}
@@ -0,0 +1,124 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+
+/**
+ * @brief The LocalCounter class is a counter written by a single thread and read by any thread
+ * 
+ * Because only the owning thread writes, an increment is a relaxed load and store rather
+ * than a locked read-modify-write, so it costs the same as a plain integer increment.
+ */
+class LocalCounter
+{
+public:
+    void increment(quint64 amount = 1)
+    {
+        m_value.store(m_value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    
+    quint64 value() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<quint64> m_value{0};
+};
+
+/**
+ * @brief The LatencyHistogram class is a log-bucketed (HDR-style) histogram with no locks or allocations
+ * 
+ * Values are grouped into power-of-two ranges, each split into four linear sub-buckets, which
+ * bounds the relative error of any recorded value to 25% over the full 64-bit range. Like
+ * LocalCounter, a histogram has a single writing thread; readers take snapshots and merge them.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int SubBucketBits = 2;
+    static constexpr int SubBucketCount = 1 << SubBucketBits;
+    static constexpr int BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+    
+    /**
+     * @brief A point-in-time copy of one or more merged histograms
+     */
+    struct Snapshot
+    {
+        std::array<quint64, BucketCount> buckets{};
+        quint64 count = 0;
+        quint64 sum = 0;
+        
+        /**
+         * @brief Adds the values of another snapshot to this one
+         */
+        void merge(const Snapshot &other);
+        
+        /**
+         * @brief Returns the value at the given quantile
+         * 
+         * @param quantile Quantile between 0.0 and 1.0
+         * @return Upper bound of the bucket holding the quantile, 0 if the snapshot is empty
+         */
+        quint64 valueAtQuantile(double quantile) const;
+        
+        /**
+         * @brief Returns the number of recorded values less than or equal to the given bound
+         * 
+         * Exact when the bound is one less than a bucket boundary, such as 2^k - 1.
+         */
+        quint64 countAtOrBelow(quint64 bound) const;
+    };
+    
+    /**
+     * @brief Records a value; must only be called from the owning thread
+     */
+    void record(quint64 value)
+    {
+        m_buckets[bucketIndex(value)].increment();
+        m_count.increment();
+        m_sum.increment(value);
+    }
+    
+    /**
+     * @brief Adds the current values of this histogram to a snapshot
+     */
+    void addTo(Snapshot &snapshot) const;
+    
+    static int bucketIndex(quint64 value)
+    {
+        if (value < SubBucketCount) {
+            return static_cast<int>(value);
+        }
+        
+        const int shift = highestBit(value) - SubBucketBits;
+        return (shift + 1) * SubBucketCount + static_cast<int>((value >> shift) & (SubBucketCount - 1));
+    }
+    
+    /**
+     * @brief Returns the exclusive upper bound of the values counted in a bucket
+     */
+    static quint64 bucketUpperBound(int index);
+
+private:
+    std::array<LocalCounter, BucketCount> m_buckets;
+    LocalCounter m_count;
+    LocalCounter m_sum;
+    
+    static int highestBit(quint64 value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1) {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -4,6 +4,11 @@
 #include <iostream>
 #include "apiserver.h"
 #include "configmanager.h"
+#include "sockethandoff.h"
+#include "signalwatcher.h"
+#include "accesslog.h"
+#include "tracing.h"
+#include "stagetimer.h"
 
 int main(int argc, char *argv[])
 {
@@ -11,6 +16,11 @@ int main(int argc, char *argv[])
     QCoreApplication::setApplicationName("Qt6 Web API Example");
     QCoreApplication::setApplicationVersion("1.0.0");
 
+#ifdef API_STAGE_TIMING
+    // Calibrate the stage clock now instead of on the first timed request
+    StageClock::calibrate();
+#endif
+    
     // Create and initialize the configuration manager
     ConfigManager *config = new ConfigManager();
     
@@ -34,6 +44,42 @@ int main(int argc, char *argv[])
     QString problemBaseUrl = config->getProblemBaseUrl();
     bool enableHttpRedirect = config->isHttpRedirectEnabled();
     int httpPort = config->getHttpPort();
+    bool enableHandoff = config->isHandoffEnabled();
+    QString handoffSocketPath = config->getHandoffSocketPath();
+    
+    // Inherit pre-bound listening sockets from systemd socket activation or,
+    // failing that, from a running instance, so that restarts never close the ports
+    SocketHandoff handoff;
+    QHash<QString, qintptr> inheritedListeners = SocketHandoff::systemdListeners();
+    if (!inheritedListeners.isEmpty()) {
+        std::cout << "Using " << inheritedListeners.size() << " socket(s) from systemd socket activation" << std::endl;
+    } else if (enableHandoff) {
+        inheritedListeners = handoff.receive(handoffSocketPath);
+        if (!inheritedListeners.isEmpty()) {
+            std::cout << "Took over " << inheritedListeners.size() << " listening socket(s) from the running instance" << std::endl;
+        }
+    }
+
+    // Start the asynchronous access and event log
+    AccessLog::Settings logSettings;
+    logSettings.level = AccessLog::levelFromString(config->getLogLevel());
+    logSettings.filePath = config->getLogFile();
+    logSettings.console = config->isConsoleLoggingEnabled();
+    logSettings.includeTimestamp = config->includeTimestamp();
+    logSettings.maxFileSize = static_cast<qint64>(config->getLogMaxFileSizeMb()) * 1024 * 1024;
+    logSettings.maxFiles = config->getLogMaxFiles();
+    AccessLog::instance().start(logSettings);
+    
+    // Start exporting request spans
+    if (config->isTracingEnabled()) {
+        Tracer::Settings traceSettings;
+        traceSettings.sampleRate = config->getTracingSampleRate();
+        traceSettings.exporter = config->getTracingExporter() == "otlp" ? Tracer::Exporter::Otlp : Tracer::Exporter::File;
+        traceSettings.filePath = config->getTracingFile();
+        traceSettings.endpoint = QUrl(config->getTracingEndpoint());
+        traceSettings.serviceName = config->getTracingServiceName();
+        Tracer::instance().start(traceSettings);
+    }
 
     // Create and configure the API server
     ApiServer server;
@@ -72,7 +118,7 @@ int main(int argc, char *argv[])
         
         // Set up HTTP to HTTPS redirect if enabled
         if (enableHttpRedirect) {
-            if (!server.listenHttpRedirect(httpPort, port)) {
+            if (!server.listenHttpRedirect(httpPort, port, inheritedListeners.value("redirect", -1))) {
                 std::cerr << "Error: Failed to set up HTTP to HTTPS redirect on port " << httpPort << std::endl;
                 return 1;
             }
@@ -83,19 +129,51 @@ int main(int argc, char *argv[])
         std::cerr << "Warning: HTTP to HTTPS redirect requires TLS to be enabled. Ignoring redirect setting." << std::endl;
     }
     
-    // Start listening for connections
-    if (!server.listen(port, host)) {
-        std::cerr << "Failed to start server on " 
-                  << (host == QHostAddress::LocalHost ? "localhost" : host.toString().toStdString())
-                  << ":" << port << std::endl;
-        return 1;
+    // Start listening for connections; an exclusive Unix socket replaces the TCP port
+    const bool listenTcp = !(config->isUnixSocketEnabled() && config->isUnixSocketExclusive());
+    if (listenTcp) {
+        const bool listening = inheritedListeners.contains("api")
+            ? server.listenOnDescriptor(inheritedListeners.value("api"), port)
+            : server.listen(port, host);
+        if (!listening) {
+            std::cerr << "Failed to start server on " 
+                      << (host == QHostAddress::LocalHost ? "localhost" : host.toString().toStdString())
+                      << ":" << port << std::endl;
+            return 1;
+        }
+    }
+    
+    // Serve a reverse proxy on the same host over a Unix domain socket
+    if (config->isUnixSocketEnabled()) {
+        const QString unixSocketPath = config->getUnixSocketPath();
+        if (!server.listenUnix(unixSocketPath, config->getUnixSocketPermissions())) {
+            std::cerr << "Error: Failed to listen on Unix socket " << unixSocketPath.toStdString() << std::endl;
+            return 1;
+        }
+        
+        std::cout << "Server running at unix:" << unixSocketPath.toStdString()
+                  << (config->isUnixSocketProxyProtocolEnabled() ? " (PROXY protocol)" : "") << std::endl;
+    }
+
+    // Push notifications to WebSocket subscribers, on their own port
+    if (config->isWebSocketEnabled()) {
+        const int webSocketPort = config->getWebSocketPort();
+        if (!server.listenWebSocket(webSocketPort, host)) {
+            std::cerr << "Error: Failed to listen for WebSocket connections on port " << webSocketPort << std::endl;
+            return 1;
+        }
+        
+        std::cout << "WebSocket endpoint enabled on port " << webSocketPort
+                  << " at " << config->getWebSocketPath().toStdString() << std::endl;
     }
 
     // Display server information
-    std::cout << "Server running at http" << (enableTls ? "s" : "") << "://" 
-              << (host == QHostAddress::Any ? "0.0.0.0" : 
-                 (host == QHostAddress::LocalHost ? "localhost" : host.toString().toStdString()))
-              << ":" << port << std::endl;
+    if (listenTcp) {
+        std::cout << "Server running at http" << (enableTls ? "s" : "") << "://" 
+                  << (host == QHostAddress::Any ? "0.0.0.0" : 
+                     (host == QHostAddress::LocalHost ? "localhost" : host.toString().toStdString()))
+                  << ":" << port << std::endl;
+    }
     std::cout << "Press Ctrl+C to quit" << std::endl;
 
     // Display configured security options
@@ -118,6 +196,53 @@ int main(int argc, char *argv[])
     }
     
     std::cout << "OWASP recommended security headers: enabled" << std::endl;
+    
+    // Everything is listening: let the instance we took over from drain. Until
+    // now it kept serving, and returning early above leaves it serving.
+    handoff.acknowledge();
+    
+    // Hand our listening sockets over to the next instance on request, then
+    // stop accepting and exit once that instance is listening and the
+    // requests in progress have completed
+    if (enableHandoff) {
+        if (handoff.listen(handoffSocketPath, server.listenerDescriptors())) {
+            std::cout << "Listening socket handoff enabled on " << handoffSocketPath.toStdString() << std::endl;
+        } else {
+            std::cerr << "Warning: Failed to listen for socket handoff on " << handoffSocketPath.toStdString() << std::endl;
+        }
+        
+        QObject::connect(&handoff, &SocketHandoff::handedOff, &server, [&server]() {
+            std::cout << "Listening sockets handed off, draining" << std::endl;
+            server.drain();
+        });
+        
+        QObject::connect(&handoff, &SocketHandoff::handoffFailed, &server, []() {
+            std::cerr << "Warning: The new instance did not start listening, continuing to serve" << std::endl;
+        });
+    }
+    
+    // Drain on SIGTERM/SIGINT; a second signal exits immediately
+    SignalWatcher signalWatcher;
+    QObject::connect(&signalWatcher, &SignalWatcher::terminationRequested, &server, [&server, &app]() {
+        if (server.isDraining()) {
+            app.quit();
+            return;
+        }
+        
+        std::cout << "Termination requested, draining" << std::endl;
+        server.drain();
+    });
+    
+    QObject::connect(&server, &ApiServer::drained, &app, [&app]() {
+        std::cout << "Drain complete, exiting" << std::endl;
+        app.quit();
+    });
 
-    return app.exec();
+    const int exitCode = app.exec();
+    
+    // Write out any buffered spans and log records
+    Tracer::instance().stop();
+    AccessLog::instance().stop();
+    
+    return exitCode;
 }
\ No newline at end of file
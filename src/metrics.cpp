@@ -0,0 +1,292 @@
+#include "metrics.h"
+#include "stagetimer.h"
+#include "accesslog.h"
+#include <QMutexLocker>
+
+namespace {
+// Histogram bucket bounds exported to Prometheus: powers of two from 64 us to ~33 s
+constexpr int FirstExportedBucketBit = 6;
+constexpr int LastExportedBucketBit = 25;
+
+// Label of the route id shared by the routes registered after the table is full
+const QString OverflowRouteLabel = QStringLiteral("_other");
+
+const char *const RateLimitDecisionLabels[] = {"allowed", "rejected", "exempt"};
+const char *const HandshakeResultLabels[] = {"started", "completed", "failed"};
+
+QByteArray escapeLabel(const QString &value)
+{
+    QByteArray escaped = value.toUtf8();
+    escaped.replace('\\', "\\\\");
+    escaped.replace('"', "\\\"");
+    escaped.replace('\n', "\\n");
+    return escaped;
+}
+
+void appendHistogram(QByteArray &out, const QByteArray &name, const QByteArray &label, const LatencyHistogram::Snapshot &snapshot)
+{
+    for (int bit = FirstExportedBucketBit; bit <= LastExportedBucketBit; ++bit) {
+        const quint64 boundUs = quint64(1) << bit;
+        out += name + "_bucket{" + label + ",le=\"";
+        out += QByteArray::number(boundUs / 1e6, 'g', 6);
+        out += "\"} ";
+        out += QByteArray::number(snapshot.countAtOrBelow(boundUs - 1));
+        out += '\n';
+    }
+    
+    out += name + "_bucket{" + label + ",le=\"+Inf\"} " + QByteArray::number(snapshot.count) + '\n';
+    out += name + "_sum{" + label + "} " + QByteArray::number(snapshot.sum / 1e6, 'g', 9) + '\n';
+    out += name + "_count{" + label + "} " + QByteArray::number(snapshot.count) + '\n';
+}
+
+void appendHeader(QByteArray &out, const char *name, const char *help, const char *type)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+int Metrics::registerRoute(const QString &route)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    const int existing = m_routes.indexOf(route);
+    if (existing >= 0) {
+        return existing;
+    }
+    
+    if (m_routes.size() < MaxRoutes - 1) {
+        m_routes.append(route);
+        return m_routes.size() - 1;
+    }
+    
+    if (m_routes.size() == MaxRoutes - 1) {
+        m_routes.append(OverflowRouteLabel);
+    }
+    locker.unlock();
+    
+    AccessLog::instance().logEvent(AccessLog::Level::Warning,
+                                   QString("Too many routes for per-route metrics: %1 is recorded as %2")
+                                       .arg(route, OverflowRouteLabel));
+    return MaxRoutes - 1;
+}
+
+void Metrics::recordRequest(int routeId, int statusCode, quint64 latencyUs)
+{
+    ThreadMetrics &metrics = local();
+    
+    if (routeId >= 0 && routeId < MaxRoutes) {
+        metrics.routeLatency[routeId].record(latencyUs);
+    }
+    
+    if (statusCode >= 0 && statusCode < MaxStatusCode) {
+        metrics.statusCodes[statusCode].increment();
+    }
+}
+
+void Metrics::recordStage(int stage, quint64 latencyUs)
+{
+    if (stage >= 0 && stage < MaxStages) {
+        local().stageLatency[stage].record(latencyUs);
+    }
+}
+
+void Metrics::recordRateLimitDecision(RateLimitDecision decision)
+{
+    local().rateLimitDecisions[static_cast<int>(decision)].increment();
+}
+
+void Metrics::recordHandshake(HandshakeResult result)
+{
+    local().handshakes[static_cast<int>(result)].increment();
+}
+
+void Metrics::addGauge(const QByteArray &name, const QByteArray &help, std::function<double()> read)
+{
+    addScraped({name, help, std::move(read), nullptr});
+}
+
+void Metrics::removeGauge(const QByteArray &name)
+{
+    removeScraped(name);
+}
+
+void Metrics::addCounter(const QByteArray &name, const QByteArray &help, std::function<quint64()> read)
+{
+    addScraped({name, help, nullptr, std::move(read)});
+}
+
+void Metrics::removeCounter(const QByteArray &name)
+{
+    removeScraped(name);
+}
+
+void Metrics::addScraped(Gauge gauge)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    for (Gauge &existing : m_gauges) {
+        if (existing.name == gauge.name) {
+            existing = std::move(gauge);
+            return;
+        }
+    }
+    
+    m_gauges.append(std::move(gauge));
+}
+
+void Metrics::removeScraped(const QByteArray &name)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    m_gauges.removeIf([&name](const Gauge &gauge) {
+        return gauge.name == name;
+    });
+}
+
+Metrics::ThreadMetrics &Metrics::local()
+{
+    // Allocated once per thread and intentionally never freed: counters must stay
+    // monotonic for Prometheus even after the thread that wrote them has exited
+    thread_local ThreadMetrics *threadMetrics = nullptr;
+    
+    if (!threadMetrics) {
+        threadMetrics = new ThreadMetrics();
+        
+        QMutexLocker locker(&m_mutex);
+        m_threads.append(threadMetrics);
+    }
+    
+    return *threadMetrics;
+}
+
+QByteArray Metrics::toPrometheus() const
+{
+    // Copy the registrations so that gauges are read without holding the lock;
+    // thread blocks are never freed, so the pointers stay valid
+    QMutexLocker locker(&m_mutex);
+    const QList<ThreadMetrics *> threads = m_threads;
+    const QStringList routes = m_routes;
+    const QList<Gauge> gauges = m_gauges;
+    locker.unlock();
+    
+    QByteArray out;
+    out.reserve(16 * 1024);
+    
+    // Per-route request counts and latency histograms
+    QList<LatencyHistogram::Snapshot> routeSnapshots(routes.size());
+    for (const ThreadMetrics *threadMetrics : threads) {
+        for (int route = 0; route < routes.size(); ++route) {
+            threadMetrics->routeLatency[route].addTo(routeSnapshots[route]);
+        }
+    }
+    
+    appendHeader(out, "http_requests_total", "Requests handled, by route.", "counter");
+    for (int route = 0; route < routes.size(); ++route) {
+        out += "http_requests_total{route=\"" + escapeLabel(routes[route]) + "\"} ";
+        out += QByteArray::number(routeSnapshots[route].count);
+        out += '\n';
+    }
+    
+    appendHeader(out, "http_request_duration_seconds", "Time taken to produce a response, by route.", "histogram");
+    for (int route = 0; route < routes.size(); ++route) {
+        appendHistogram(out, "http_request_duration_seconds", "route=\"" + escapeLabel(routes[route]) + "\"", routeSnapshots[route]);
+    }
+    
+    // Per-stage latency, only recorded when built with stage timing instrumentation
+    bool headerWritten = false;
+    for (int stage = 0; stage < static_cast<int>(PipelineStage::Count) && stage < MaxStages; ++stage) {
+        LatencyHistogram::Snapshot snapshot;
+        for (const ThreadMetrics *threadMetrics : threads) {
+            threadMetrics->stageLatency[stage].addTo(snapshot);
+        }
+        if (snapshot.count == 0) {
+            continue;
+        }
+        
+        if (!headerWritten) {
+            appendHeader(out, "http_stage_duration_seconds", "Time spent in each request pipeline stage.", "histogram");
+            headerWritten = true;
+        }
+        
+        const QByteArray label = QByteArray("stage=\"") + pipelineStageName(static_cast<PipelineStage>(stage)) + "\"";
+        appendHistogram(out, "http_stage_duration_seconds", label, snapshot);
+    }
+    
+    // Responses by status code
+    appendHeader(out, "http_responses_total", "Responses sent, by status code.", "counter");
+    for (int statusCode = 0; statusCode < MaxStatusCode; ++statusCode) {
+        quint64 total = 0;
+        for (const ThreadMetrics *threadMetrics : threads) {
+            total += threadMetrics->statusCodes[statusCode].value();
+        }
+        if (total > 0) {
+            out += "http_responses_total{code=\"" + QByteArray::number(statusCode) + "\"} " + QByteArray::number(total) + '\n';
+        }
+    }
+    
+    // Rate limiting decisions
+    appendHeader(out, "rate_limit_decisions_total", "Rate limiting decisions, by outcome.", "counter");
+    for (int decision = 0; decision < 3; ++decision) {
+        quint64 total = 0;
+        for (const ThreadMetrics *threadMetrics : threads) {
+            total += threadMetrics->rateLimitDecisions[decision].value();
+        }
+        out += "rate_limit_decisions_total{decision=\"";
+        out += RateLimitDecisionLabels[decision];
+        out += "\"} " + QByteArray::number(total) + '\n';
+    }
+    
+    // TLS handshakes
+    appendHeader(out, "tls_handshakes_total", "TLS handshakes, by result.", "counter");
+    for (int result = 0; result < 3; ++result) {
+        quint64 total = 0;
+        for (const ThreadMetrics *threadMetrics : threads) {
+            total += threadMetrics->handshakes[result].value();
+        }
+        out += "tls_handshakes_total{result=\"";
+        out += HandshakeResultLabels[result];
+        out += "\"} " + QByteArray::number(total) + '\n';
+    }
+    
+    // Gauges and counters read at scrape time; metrics that only differ in their labels share one header
+    QList<QByteArray> families;
+    families.reserve(gauges.size());
+    for (const Gauge &gauge : gauges) {
+        const qsizetype labels = gauge.name.indexOf('{');
+        families.append(labels < 0 ? gauge.name : gauge.name.left(labels));
+    }
+    
+    for (int i = 0; i < gauges.size(); ++i) {
+        if (families.indexOf(families[i]) < i) {
+            continue;
+        }
+        
+        const bool counter = static_cast<bool>(gauges[i].readTotal);
+        appendHeader(out, families[i].constData(), gauges[i].help.constData(), counter ? "counter" : "gauge");
+        for (int j = i; j < gauges.size(); ++j) {
+            if (families[j] != families[i]) {
+                continue;
+            }
+            out += gauges[j].name + ' ';
+            out += gauges[j].readTotal ? QByteArray::number(gauges[j].readTotal())
+                                       : QByteArray::number(gauges[j].read(), 'g', 12);
+            out += '\n';
+        }
+    }
+    
+    return out;
+}
@@ -0,0 +1,150 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include "latencyhistogram.h"
+
+/**
+ * @brief The Metrics class collects server metrics and exposes them in the Prometheus text format
+ * 
+ * Every thread that records metrics gets its own cache-line aligned block of counters and
+ * latency histograms, so recording a value takes no locks, performs no allocations and never
+ * contends with other threads. The per-thread blocks are only aggregated when the metrics
+ * are scraped.
+ */
+class Metrics
+{
+public:
+    static constexpr int MaxRoutes = 32;  // Including the overflow route
+    
+    enum class RateLimitDecision {
+        Allowed,
+        Rejected,
+        Exempt
+    };
+    
+    enum class HandshakeResult {
+        Started,
+        Completed,
+        Failed
+    };
+    
+    /**
+     * @brief Returns the process-wide metrics registry
+     */
+    static Metrics &instance();
+    
+    /**
+     * @brief Registers a route label for per-route metrics
+     * 
+     * Once MaxRoutes - 1 routes are registered, further routes are logged with a warning and
+     * share the id of the overflow route, exported with the label "_other".
+     * 
+     * @param route The route label, usually its path pattern
+     * @return The route id to pass to recordRequest()
+     */
+    int registerRoute(const QString &route);
+    
+    /**
+     * @brief Records a handled request
+     * 
+     * @param routeId The id returned by registerRoute()
+     * @param statusCode The HTTP status code of the response
+     * @param latencyUs The time taken to produce the response, in microseconds
+     */
+    void recordRequest(int routeId, int statusCode, quint64 latencyUs);
+    
+    /**
+     * @brief Records the time spent in a pipeline stage
+     * 
+     * @param stage The PipelineStage, as an integer
+     * @param latencyUs The time spent in the stage, in microseconds
+     */
+    void recordStage(int stage, quint64 latencyUs);
+    
+    void recordRateLimitDecision(RateLimitDecision decision);
+    void recordHandshake(HandshakeResult result);
+    
+    /**
+     * @brief Registers a gauge whose value is read when the metrics are scraped
+     * 
+     * A gauge registered under an existing name replaces it.
+     * 
+     * @param name The metric name, optionally with labels (e.g. upstream_inflight{upstream="/api/orders"});
+     *             gauges of the same name with different labels share the first one's description
+     * @param help The metric description
+     * @param read Returns the current value; called from the scraping thread
+     */
+    void addGauge(const QByteArray &name, const QByteArray &help, std::function<double()> read);
+    
+    /**
+     * @brief Unregisters a gauge, e.g. when the object it reads from is destroyed
+     * 
+     * @param name The metric name
+     */
+    void removeGauge(const QByteArray &name);
+    
+    /**
+     * @brief Registers a counter whose value is read when the metrics are scraped
+     * 
+     * For totals kept by another component, e.g. cache hits. The name should end in _total
+     * (before any labels), and the value must never decrease while the counter is registered.
+     * A counter registered under an existing name replaces it.
+     * 
+     * @param name The metric name, optionally with labels, as for addGauge()
+     * @param help The metric description
+     * @param read Returns the current total; called from the scraping thread
+     */
+    void addCounter(const QByteArray &name, const QByteArray &help, std::function<quint64()> read);
+    
+    /**
+     * @brief Unregisters a counter, e.g. when the object it reads from is destroyed
+     * 
+     * @param name The metric name
+     */
+    void removeCounter(const QByteArray &name);
+    
+    /**
+     * @brief Aggregates all threads' metrics in the Prometheus text exposition format
+     */
+    QByteArray toPrometheus() const;
+
+private:
+    static constexpr int MaxStatusCode = 600;
+    static constexpr int MaxStages = 8;
+    
+    struct alignas(64) ThreadMetrics
+    {
+        std::array<LatencyHistogram, MaxRoutes> routeLatency;
+        std::array<LatencyHistogram, MaxStages> stageLatency;
+        std::array<LocalCounter, MaxStatusCode> statusCodes;
+        std::array<LocalCounter, 3> rateLimitDecisions;
+        std::array<LocalCounter, 3> handshakes;
+    };
+    
+    // A gauge or counter read at scrape time; exactly one of the read functions is set
+    struct Gauge
+    {
+        QByteArray name;
+        QByteArray help;
+        std::function<double()> read;
+        std::function<quint64()> readTotal;
+    };
+    
+    mutable QMutex m_mutex;  // Guards registration only, never taken when recording
+    QList<ThreadMetrics *> m_threads;
+    QStringList m_routes;
+    QList<Gauge> m_gauges;
+    
+    Metrics() = default;
+    void addScraped(Gauge gauge);
+    void removeScraped(const QByteArray &name);
+    ThreadMetrics &local();
+};
+
+#endif // METRICS_H
@@ -1,6 +1,24 @@
 #include "problemdetail.h"
-#include <QJsonObject>
-#include <QJsonDocument>
+#include "bufferpool.h"
+#include "jsonwriter.h"
+#include "stagetimer.h"
+#include "tracing.h"
+#include <algorithm>
+
+namespace {
+// Writes the decimal status code into the caller's buffer, without a temporary QString
+QStringView formatStatus(int statusCode, char16_t (&buffer)[12])
+{
+    int length = 0;
+    unsigned int value = statusCode < 0 ? 0u : static_cast<unsigned int>(statusCode);
+    do {
+        buffer[length++] = static_cast<char16_t>(u'0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    std::reverse(buffer, buffer + length);
+    return QStringView(buffer, length);
+}
+}
 
 // Initialize static member with default value
 QString ProblemDetail::s_defaultBaseUrl = "https://problemdetails.example.com/problems";
@@ -8,44 +26,55 @@ QString ProblemDetail::s_defaultBaseUrl = "https://problemdetails.example.com/pr
 ProblemDetail::ProblemDetail(int statusCode)
     : m_statusCode(statusCode)
 {
-    // Set default type URI based on status code and configurable base URL
-    QString typeUri = QString("%1/%2").arg(s_defaultBaseUrl).arg(statusCode);
-    m_type = QUrl(typeUri);
+    // The default type URI ("<base URL>/<status>") is written during serialization,
+    // so constructing a problem does not build and parse a URL
     
     // Set default title based on status code
     switch (statusCode) {
     case 400:
-        m_title = "Bad Request";
+        m_title = QStringLiteral("Bad Request");
         break;
     case 401:
-        m_title = "Unauthorized";
+        m_title = QStringLiteral("Unauthorized");
         break;
     case 403:
-        m_title = "Forbidden";
+        m_title = QStringLiteral("Forbidden");
         break;
     case 404:
-        m_title = "Not Found";
+        m_title = QStringLiteral("Not Found");
         break;
     case 405:
-        m_title = "Method Not Allowed";
+        m_title = QStringLiteral("Method Not Allowed");
         break;
     case 409:
-        m_title = "Conflict";
+        m_title = QStringLiteral("Conflict");
+        break;
+    case 415:
+        m_title = QStringLiteral("Unsupported Media Type");
+        break;
+    case 416:
+        m_title = QStringLiteral("Range Not Satisfiable");
         break;
     case 422:
-        m_title = "Unprocessable Entity";
+        m_title = QStringLiteral("Unprocessable Entity");
         break;
     case 429:
-        m_title = "Too Many Requests";
+        m_title = QStringLiteral("Too Many Requests");
         break;
     case 500:
-        m_title = "Internal Server Error";
+        m_title = QStringLiteral("Internal Server Error");
+        break;
+    case 502:
+        m_title = QStringLiteral("Bad Gateway");
         break;
     case 503:
-        m_title = "Service Unavailable";
+        m_title = QStringLiteral("Service Unavailable");
+        break;
+    case 504:
+        m_title = QStringLiteral("Gateway Timeout");
         break;
     default:
-        m_title = "Unknown Error";
+        m_title = QStringLiteral("Unknown Error");
         break;
     }
 }
@@ -77,29 +106,56 @@ void ProblemDetail::addExtension(const QString &key, const QJsonValue &value)
 
 QHttpServerResponse ProblemDetail::toJsonResponse() const
 {
-    QJsonObject jsonObject;
+    STAGE_TIMER(PipelineStage::Serialization);
+    ScopedSpan span(PipelineStage::Serialization);
     
-    // Add standard problem detail properties
-    jsonObject["type"] = m_type.toString();
-    jsonObject["title"] = m_title;
-    jsonObject["status"] = m_statusCode;
+    QByteArray body = BufferPool::acquire();
+    JsonWriter json(body);
+    json.beginObject();
     
-    if (!m_detail.isEmpty()) {
-        jsonObject["detail"] = m_detail;
+    // Add standard problem detail properties, unless an extension replaces them
+    if (!m_extensions.contains(QStringLiteral("type"))) {
+        json.key("type");
+        if (m_type.isEmpty()) {
+            char16_t status[12];
+            json.value({QStringView(s_defaultBaseUrl), u"/", formatStatus(m_statusCode, status)});
+        } else {
+            json.value(QStringView(m_type.toString()));
+        }
     }
     
-    if (!m_instance.isEmpty()) {
-        jsonObject["instance"] = m_instance;
+    if (!m_extensions.contains(QStringLiteral("title"))) {
+        json.key("title");
+        json.value(QStringView(m_title));
+    }
+    
+    if (!m_extensions.contains(QStringLiteral("status"))) {
+        json.key("status");
+        json.value(m_statusCode);
+    }
+    
+    if (!m_detail.isEmpty() && !m_extensions.contains(QStringLiteral("detail"))) {
+        json.key("detail");
+        json.value(QStringView(m_detail));
+    }
+    
+    if (!m_instance.isEmpty() && !m_extensions.contains(QStringLiteral("instance"))) {
+        json.key("instance");
+        json.value(QStringView(m_instance));
     }
     
     // Add any extension properties
     for (auto it = m_extensions.constBegin(); it != m_extensions.constEnd(); ++it) {
-        jsonObject[it.key()] = it.value();
+        json.key(QStringView(it.key()));
+        json.value(it.value());
     }
     
-    QJsonDocument document(jsonObject);
-    auto response = QHttpServerResponse(document.toJson(), QHttpServerResponse::StatusCode(m_statusCode));
-    response.setHeader("Content-Type", "application/problem+json");
+    json.endObject();
+    
+    // Handing the buffer back to the pool lets its capacity be reused once the response is sent
+    BufferPool::recycle(body);
+    auto response = QHttpServerResponse(QByteArrayLiteral("application/problem+json"), body,
+                                        QHttpServerResponse::StatusCode(m_statusCode));
     
     return response;
 }
@@ -0,0 +1,60 @@
+#include "processstats.h"
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+// Parses a "Name:   1234 kB" line value into bytes
+qint64 parseKilobytes(const QByteArray &value)
+{
+    const QList<QByteArray> parts = value.simplified().split(' ');
+    bool ok = false;
+    const qint64 kilobytes = parts.value(0).toLongLong(&ok);
+    return ok ? kilobytes * 1024 : -1;
+}
+}
+
+ProcessStats ProcessStats::read()
+{
+    ProcessStats stats;
+    
+#ifdef Q_OS_LINUX
+    // procfs files report a size of zero, so read until the end instead of relying on size()
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = status.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            const int colon = line.indexOf(':');
+            if (colon < 0) {
+                continue;
+            }
+            
+            const QByteArray name = line.left(colon);
+            const QByteArray value = line.mid(colon + 1);
+            if (name == "VmRSS") {
+                stats.residentBytes = parseKilobytes(value);
+            } else if (name == "VmHWM") {
+                stats.peakResidentBytes = parseKilobytes(value);
+            } else if (name == "VmSize") {
+                stats.virtualBytes = parseKilobytes(value);
+            } else if (name == "Threads") {
+                stats.threads = value.trimmed().toInt();
+            }
+        }
+    }
+#endif
+    
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    // mallinfo2() walks the allocator's arenas under their locks; fine for an admin snapshot
+    const struct mallinfo2 info = mallinfo2();
+    stats.heapInUseBytes = static_cast<qint64>(info.uordblks + info.hblkhd);
+    stats.heapFreeBytes = static_cast<qint64>(info.fordblks);
+    stats.heapMappedBytes = static_cast<qint64>(info.hblkhd);
+#endif
+    
+    return stats;
+}
@@ -0,0 +1,27 @@
+#ifndef PROCESSSTATS_H
+#define PROCESSSTATS_H
+
+#include <QtGlobal>
+
+/**
+ * @brief The ProcessStats struct is a snapshot of the process's memory and thread usage
+ * 
+ * Values that cannot be determined on the current platform are -1.
+ */
+struct ProcessStats
+{
+    qint64 residentBytes = -1;      // VmRSS
+    qint64 peakResidentBytes = -1;  // VmHWM
+    qint64 virtualBytes = -1;       // VmSize
+    int threads = -1;
+    qint64 heapInUseBytes = -1;     // Allocated by malloc and not yet freed
+    qint64 heapFreeBytes = -1;      // Held by malloc but free
+    qint64 heapMappedBytes = -1;    // Large allocations served by mmap
+    
+    /**
+     * @brief Reads the current values from /proc/self/status and the allocator
+     */
+    static ProcessStats read();
+};
+
+#endif // PROCESSSTATS_H
@@ -0,0 +1,56 @@
+#include "requestarena.h"
+
+RequestArena::RequestArena()
+    : m_resource(m_inline, sizeof(m_inline), std::pmr::new_delete_resource()),
+      m_bytesUsed(0),
+      m_scopeDepth(0)
+{
+}
+
+RequestArena &RequestArena::local()
+{
+    // Destroyed when its thread exits, returning any blocks the upstream resource handed out
+    thread_local RequestArena arena;
+    return arena;
+}
+
+void *RequestArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    m_bytesUsed += bytes;
+    return m_resource.allocate(bytes, alignment);
+}
+
+std::pmr::memory_resource *RequestArena::resource()
+{
+    return &m_resource;
+}
+
+std::size_t RequestArena::bytesUsed() const
+{
+    return m_bytesUsed;
+}
+
+bool RequestArena::inScope() const
+{
+    return m_scopeDepth > 0;
+}
+
+void RequestArena::reset()
+{
+    // Frees any spilled blocks and rewinds to the start of the inline buffer
+    m_resource.release();
+    m_bytesUsed = 0;
+}
+
+RequestArenaScope::RequestArenaScope()
+{
+    RequestArena::local().m_scopeDepth++;
+}
+
+RequestArenaScope::~RequestArenaScope()
+{
+    RequestArena &arena = RequestArena::local();
+    if (--arena.m_scopeDepth == 0) {
+        arena.reset();
+    }
+}
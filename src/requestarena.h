@@ -0,0 +1,80 @@
+#ifndef REQUESTARENA_H
+#define REQUESTARENA_H
+
+#include <QtGlobal>
+#include <cstddef>
+#include <memory_resource>
+
+/**
+ * @brief The RequestArena class is a per-thread monotonic allocator for data that lives for one request
+ * 
+ * Allocation is a pointer bump into a buffer owned by the thread; nothing is freed individually.
+ * The arena is rewound when the outermost RequestArenaScope ends, so the same memory serves
+ * every request on the thread. Requests that need more than the inline buffer spill into
+ * heap blocks, which are released at the end of the request.
+ */
+class RequestArena
+{
+public:
+    static constexpr std::size_t InlineSize = 16 * 1024;
+    
+    /**
+     * @brief Returns the calling thread's arena
+     */
+    static RequestArena &local();
+    
+    /**
+     * @brief Allocates memory that stays valid until the end of the current request
+     */
+    void *allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+    
+    template <typename T>
+    T *allocateArray(std::size_t count)
+    {
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+    
+    /**
+     * @brief Returns the arena as a memory resource, for std::pmr containers
+     */
+    std::pmr::memory_resource *resource();
+    
+    /**
+     * @brief Returns the number of bytes handed out since the last reset
+     */
+    std::size_t bytesUsed() const;
+    
+    /**
+     * @brief Returns true while a RequestArenaScope is open on this thread
+     * 
+     * Outside a scope nothing rewinds the arena, so callers that may run outside
+     * request handling must use their own memory instead.
+     */
+    bool inScope() const;
+
+private:
+    friend class RequestArenaScope;
+    
+    alignas(std::max_align_t) char m_inline[InlineSize];
+    std::pmr::monotonic_buffer_resource m_resource;
+    std::size_t m_bytesUsed;
+    int m_scopeDepth;
+    
+    RequestArena();
+    void reset();
+};
+
+/**
+ * @brief The RequestArenaScope class rewinds the thread's arena when the outermost scope ends
+ */
+class RequestArenaScope
+{
+public:
+    RequestArenaScope();
+    ~RequestArenaScope();
+    
+    RequestArenaScope(const RequestArenaScope &) = delete;
+    RequestArenaScope &operator=(const RequestArenaScope &) = delete;
+};
+
+#endif // REQUESTARENA_H
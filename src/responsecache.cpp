@@ -0,0 +1,339 @@
+#include "responsecache.h"
+#include <QHttpHeaders>
+#include <QThread>
+#include <QUrlQuery>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+// Fixed per-entry overhead charged against the budget: list node, hash node and Entry
+constexpr qint64 EntryOverhead = 256;
+
+bool isCompressible(const QByteArray &mimeType)
+{
+    return mimeType.startsWith("text/")
+        || mimeType.contains("json")
+        || mimeType.contains("xml")
+        || mimeType.contains("javascript");
+}
+
+// True if the Accept-Encoding header lists deflate (or *) without q=0
+bool acceptsDeflate(const QByteArray &acceptEncoding)
+{
+    for (const QByteArray &item : acceptEncoding.split(',')) {
+        const QList<QByteArray> parts = item.split(';');
+        const QByteArray coding = parts.first().trimmed().toLower();
+        if (coding != "deflate" && coding != "*") {
+            continue;
+        }
+        
+        bool acceptable = true;
+        for (int i = 1; i < parts.size(); ++i) {
+            const QByteArray parameter = parts.at(i).trimmed();
+            if (parameter.startsWith("q=") && parameter.mid(2).toDouble() <= 0.0) {
+                acceptable = false;
+            }
+        }
+        
+        if (acceptable) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+}
+
+qint64 ResponseCache::Entry::cost() const
+{
+    return EntryOverhead + mimeType.size() + body.size() + deflateBody.size() + vary.size();
+}
+
+ResponseCache::ResponseCache(const Settings &settings)
+{
+    setSettings(settings);
+}
+
+ResponseCache::~ResponseCache() = default;
+
+void ResponseCache::setSettings(const Settings &settings)
+{
+    m_settings = settings;
+    m_settings.shardCount = std::max(1, settings.shardCount);
+    m_shardBudget = std::max<qint64>(0, m_settings.maxBytes / m_settings.shardCount);
+    
+    m_shards.clear();
+    m_shards.reserve(static_cast<size_t>(m_settings.shardCount));
+    for (int i = 0; i < m_settings.shardCount; ++i) {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+QByteArray ResponseCache::key(const QHttpServerRequest &request, const QList<QByteArray> &varyHeaders)
+{
+    const QUrl url = request.url();
+    
+    // Resolve "." and ".." segments and collapse repeated slashes
+    QString path = url.adjusted(QUrl::NormalizePathSegments).path(QUrl::FullyEncoded);
+    while (path.contains(QLatin1String("//"))) {
+        path.replace(QLatin1String("//"), QLatin1String("/"));
+    }
+    if (path.isEmpty()) {
+        path = QStringLiteral("/");
+    }
+    
+    // Only GET and HEAD are cached, and a HEAD is answered from the GET entry
+    QByteArray key = (request.method() == QHttpServerRequest::Method::Get
+                      || request.method() == QHttpServerRequest::Method::Head)
+        ? QByteArrayLiteral("GET ") : QByteArray::number(static_cast<int>(request.method())) + ' ';
+    key += path.toUtf8();
+    
+    if (url.hasQuery()) {
+        QList<QPair<QString, QString>> items = QUrlQuery(url).queryItems(QUrl::FullyEncoded);
+        std::sort(items.begin(), items.end());
+        
+        char separator = '?';
+        for (const auto &item : items) {
+            key += separator;
+            key += item.first.toUtf8();
+            key += '=';
+            key += item.second.toUtf8();
+            separator = '&';
+        }
+    }
+    
+    for (const QByteArray &header : varyHeaders) {
+        key += '\n';
+        key += request.value(header).trimmed();
+    }
+    
+    return key;
+}
+
+ResponseCache::EntryPtr ResponseCache::fetch(const QByteArray &key, int ttlMs, const Producer &produce, Outcome *outcome)
+{
+    Shard &shard = shardFor(key);
+    std::shared_ptr<Flight> flight;
+    
+    {
+        QMutexLocker locker(&shard.mutex);
+        
+        const auto found = shard.index.constFind(key);
+        if (found != shard.index.constEnd()) {
+            const auto node = found.value();
+            if (node->entry->expiresAtMs > nowMs()) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, node);
+                m_hits.fetch_add(1, std::memory_order_relaxed);
+                if (outcome) {
+                    *outcome = Outcome::Hit;
+                }
+                return node->entry;
+            }
+            erase(shard, node);
+        }
+        
+        const auto running = shard.inflight.constFind(key);
+        if (running != shard.inflight.constEnd()
+            && running.value()->leader != QThread::currentThreadId()) {
+            // Wait for the caller already running the handler; a leader on this thread
+            // means the handler re-entered the event loop, and waiting would deadlock
+            std::shared_ptr<Flight> leader = running.value();
+            while (!leader->finished) {
+                leader->done.wait(&shard.mutex);
+            }
+            
+            if (leader->entry) {
+                m_coalesced.fetch_add(1, std::memory_order_relaxed);
+                if (outcome) {
+                    *outcome = Outcome::Coalesced;
+                }
+                return leader->entry;
+            }
+        } else if (running == shard.inflight.constEnd()) {
+            flight = std::make_shared<Flight>();
+            flight->leader = QThread::currentThreadId();
+            shard.inflight.insert(key, flight);
+        }
+    }
+    
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    if (outcome) {
+        *outcome = Outcome::Miss;
+    }
+    
+    // The handler and compression run without the shard lock held
+    Entry produced;
+    try {
+        produced = produce();
+    } catch (...) {
+        if (flight) {
+            QMutexLocker locker(&shard.mutex);
+            shard.inflight.remove(key);
+            flight->finished = true;
+            flight->done.wakeAll();
+        }
+        throw;
+    }
+    
+    const bool cacheable = produced.statusCode == 200 && ttlMs > 0;
+    if (cacheable) {
+        compress(produced);
+    }
+    produced.storedAtMs = nowMs();
+    produced.expiresAtMs = produced.storedAtMs + ttlMs;
+    
+    EntryPtr entry = std::make_shared<const Entry>(std::move(produced));
+    
+    if (flight) {
+        QMutexLocker locker(&shard.mutex);
+        shard.inflight.remove(key);
+        if (cacheable) {
+            store(shard, key, entry);
+        }
+        flight->entry = entry;
+        flight->finished = true;
+        flight->done.wakeAll();
+    }
+    
+    return entry;
+}
+
+void ResponseCache::clear()
+{
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard->mutex);
+        shard->lru.clear();
+        shard->index.clear();
+        shard->bytes = 0;
+    }
+}
+
+qint64 ResponseCache::sizeBytes() const
+{
+    qint64 bytes = 0;
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard->mutex);
+        bytes += shard->bytes;
+    }
+    return bytes;
+}
+
+int ResponseCache::entryCount() const
+{
+    int count = 0;
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard->mutex);
+        count += static_cast<int>(shard->index.size());
+    }
+    return count;
+}
+
+quint64 ResponseCache::hitCount() const
+{
+    return m_hits.load(std::memory_order_relaxed);
+}
+
+quint64 ResponseCache::missCount() const
+{
+    return m_misses.load(std::memory_order_relaxed);
+}
+
+quint64 ResponseCache::coalescedCount() const
+{
+    return m_coalesced.load(std::memory_order_relaxed);
+}
+
+ResponseCache::Entry ResponseCache::capture(const QHttpServerResponse &response)
+{
+    Entry entry;
+    entry.statusCode = static_cast<int>(response.statusCode());
+    entry.mimeType = response.mimeType();
+    entry.body = response.data();
+    return entry;
+}
+
+QHttpServerResponse ResponseCache::respond(const Entry &entry, const QHttpServerRequest &request, Outcome outcome)
+{
+    const bool compressed = !entry.deflateBody.isEmpty() && acceptsDeflate(request.value("Accept-Encoding"));
+    
+    QHttpServerResponse response(entry.mimeType, compressed ? entry.deflateBody : entry.body,
+                                 QHttpServerResponse::StatusCode(entry.statusCode));
+    QHttpHeaders headers = response.headers();
+    if (compressed) {
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::ContentEncoding, "deflate");
+    }
+    if (!entry.vary.isEmpty()) {
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::Vary, entry.vary);
+    }
+    
+    if (outcome == Outcome::Hit) {
+        const qint64 ageSeconds = std::max<qint64>(0, (nowMs() - entry.storedAtMs) / 1000);
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::Age, QByteArray::number(ageSeconds));
+    }
+    response.setHeaders(std::move(headers));
+    
+    return response;
+}
+
+qint64 ResponseCache::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ResponseCache::Shard &ResponseCache::shardFor(const QByteArray &key)
+{
+    return *m_shards[qHash(key) % m_shards.size()];
+}
+
+void ResponseCache::compress(Entry &entry) const
+{
+    if (m_settings.compressMinBytes <= 0 || entry.body.size() < m_settings.compressMinBytes
+        || !isCompressible(entry.mimeType)) {
+        return;
+    }
+    
+    // qCompress() emits a 4-byte length prefix followed by a zlib stream, which is
+    // exactly the HTTP "deflate" content coding once the prefix is removed
+    QByteArray compressed = qCompress(entry.body, 6);
+    if (compressed.size() <= 4) {
+        return;
+    }
+    compressed.remove(0, 4);
+    
+    if (compressed.size() < entry.body.size()) {
+        entry.deflateBody = compressed;
+        if (!entry.vary.contains("Accept-Encoding")) {
+            entry.vary = entry.vary.isEmpty() ? QByteArray("Accept-Encoding") : entry.vary + ", Accept-Encoding";
+        }
+    }
+}
+
+void ResponseCache::store(Shard &shard, const QByteArray &key, const EntryPtr &entry)
+{
+    const qint64 cost = entry->cost() + key.size();
+    if (cost > m_shardBudget) {
+        return;
+    }
+    
+    const auto existing = shard.index.constFind(key);
+    if (existing != shard.index.constEnd()) {
+        erase(shard, existing.value());
+    }
+    
+    // Evict least recently used entries until the new one fits
+    while (!shard.lru.empty() && shard.bytes + cost > m_shardBudget) {
+        erase(shard, std::prev(shard.lru.end()));
+    }
+    
+    shard.lru.push_front(Node{key, entry});
+    shard.index.insert(key, shard.lru.begin());
+    shard.bytes += cost;
+}
+
+void ResponseCache::erase(Shard &shard, std::list<Node>::iterator node)
+{
+    shard.bytes -= node->entry->cost() + node->key.size();
+    shard.index.remove(node->key);
+    shard.lru.erase(node);
+}
@@ -0,0 +1,153 @@
+#ifndef RESPONSECACHE_H
+#define RESPONSECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHttpServerRequest>
+#include <QHttpServerResponse>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The ResponseCache class stores serialized responses of routes that opt into caching
+ * 
+ * Entries are keyed by method, normalized path and query, and the values of the route's Vary
+ * headers. The store is split into shards, each a mutex-protected LRU list with its own share
+ * of the byte budget, so that lookups for different keys rarely contend. Entries expire after
+ * the route's TTL and are dropped lazily.
+ * 
+ * Concurrent misses for the same key are coalesced: the first caller runs the handler while
+ * the others wait for its result instead of running the handler again (singleflight).
+ * 
+ * An entry holds the body as sent, plus a deflate-compressed copy for compressible content
+ * types, so serving a hit never serializes or compresses anything. Only the status code,
+ * content type and body of a response are cached; other headers set by the handler are not.
+ */
+class ResponseCache
+{
+public:
+    struct Settings
+    {
+        qint64 maxBytes = 64 * 1024 * 1024;  // Shared equally by the shards
+        int shardCount = 16;
+        int compressMinBytes = 1024;         // Smaller bodies get no compressed copy; 0 disables compression
+    };
+    
+    struct Entry
+    {
+        int statusCode = 200;
+        QByteArray mimeType;
+        QByteArray body;
+        QByteArray deflateBody;  // Empty unless compression pays off
+        QByteArray vary;         // Vary header value sent with the entry
+        qint64 storedAtMs = 0;
+        qint64 expiresAtMs = 0;
+        
+        qint64 cost() const;
+    };
+    
+    using EntryPtr = std::shared_ptr<const Entry>;
+    using Producer = std::function<Entry()>;
+    
+    enum class Outcome {
+        Hit,
+        Miss,       // This caller ran the handler
+        Coalesced   // Another caller ran the handler for this caller
+    };
+    
+    explicit ResponseCache(const Settings &settings = Settings());
+    ~ResponseCache();
+    
+    /**
+     * @brief Replaces the settings and empties the cache; must not be called while serving
+     */
+    void setSettings(const Settings &settings);
+    
+    /**
+     * @brief Builds the cache key of a request
+     * 
+     * HEAD shares the key of GET. Query parameters are sorted, so their order does not matter.
+     * 
+     * @param varyHeaders Request headers whose values select between variants
+     */
+    static QByteArray key(const QHttpServerRequest &request, const QList<QByteArray> &varyHeaders);
+    
+    /**
+     * @brief Returns the cached entry for a key, or produces, stores and returns it
+     * 
+     * The producer runs without any lock held. Its result is stored only with status 200 and
+     * when it fits in the shard's budget; waiters coalesced onto it receive it either way.
+     * If the producer throws, waiters run their own producer and the exception propagates.
+     * 
+     * @param ttlMs How long a stored entry is served
+     * @param outcome Receives how the entry was obtained, if not null
+     */
+    EntryPtr fetch(const QByteArray &key, int ttlMs, const Producer &produce, Outcome *outcome = nullptr);
+    
+    /**
+     * @brief Removes all entries
+     */
+    void clear();
+    
+    qint64 sizeBytes() const;
+    int entryCount() const;
+    quint64 hitCount() const;
+    quint64 missCount() const;
+    quint64 coalescedCount() const;
+    
+    /**
+     * @brief Captures the parts of a response that are cached
+     */
+    static Entry capture(const QHttpServerResponse &response);
+    
+    /**
+     * @brief Builds the response for an entry, choosing the compressed copy if the client accepts it
+     */
+    static QHttpServerResponse respond(const Entry &entry, const QHttpServerRequest &request, Outcome outcome);
+    
+    static qint64 nowMs();
+
+private:
+    struct Node
+    {
+        QByteArray key;
+        EntryPtr entry;
+    };
+    
+    struct Flight
+    {
+        QWaitCondition done;
+        bool finished = false;
+        EntryPtr entry;  // Null if the producer threw
+        Qt::HANDLE leader = nullptr;
+    };
+    
+    struct Shard
+    {
+        mutable QMutex mutex;
+        std::list<Node> lru;  // Most recently used first
+        QHash<QByteArray, std::list<Node>::iterator> index;
+        QHash<QByteArray, std::shared_ptr<Flight>> inflight;
+        qint64 bytes = 0;
+    };
+    
+    Settings m_settings;
+    qint64 m_shardBudget;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<quint64> m_hits{0};
+    std::atomic<quint64> m_misses{0};
+    std::atomic<quint64> m_coalesced{0};
+    
+    Shard &shardFor(const QByteArray &key);
+    void compress(Entry &entry) const;
+    void store(Shard &shard, const QByteArray &key, const EntryPtr &entry);
+    static void erase(Shard &shard, std::list<Node>::iterator node);
+};
+
+#endif // RESPONSECACHE_H
@@ -0,0 +1,391 @@
+#include "reverseproxy.h"
+#include "problemdetail.h"
+#include "tracing.h"
+#include <QHostAddress>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QElapsedTimer>
+#include <QHttpHeaders>
+#include <QTimer>
+#include <cmath>
+#include <memory>
+
+namespace {
+// Responses announcing a Content-Length up to this size are buffered and sent in one piece
+constexpr qint64 MaxBufferedBodyBytes = 64 * 1024;
+
+// Connection-level headers that apply to a single hop and are never forwarded (RFC 9110 7.6.1)
+bool isHopByHopHeader(const QByteArray &name)
+{
+    static const QByteArray hopByHop[] = {
+        "connection", "keep-alive", "proxy-connection", "proxy-authenticate", "proxy-authorization",
+        "te", "trailer", "transfer-encoding", "upgrade", "expect"
+    };
+    
+    const QByteArray lower = name.toLower();
+    for (const QByteArray &header : hopByHop) {
+        if (lower == header) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// All request headers, in order, as name/value pairs
+QList<std::pair<QByteArray, QByteArray>> requestHeaders(const QHttpServerRequest &request)
+{
+    QList<std::pair<QByteArray, QByteArray>> headers;
+    const QHttpHeaders httpHeaders = request.headers();
+    for (qsizetype i = 0; i < httpHeaders.size(); ++i) {
+        headers.append({httpHeaders.nameAt(i).toByteArray(), httpHeaders.valueAt(i).toByteArray()});
+    }
+    return headers;
+}
+
+// State of one forwarded request, shared by the reply's signal handlers
+struct ProxyCall
+{
+    explicit ProxyCall(QHttpServerResponder &&responder)
+        : responder(std::move(responder))
+    {
+    }
+    
+    QHttpServerResponder responder;
+    QNetworkReply *reply = nullptr;
+    QTimer *headerTimer = nullptr;
+    bool started = false;    // Status line and headers were sent to the client
+    bool timedOut = false;
+    int statusCode = 0;
+    QList<std::pair<QByteArray, QByteArray>> headers;
+    QByteArray body;         // Small bodies of known length, sent once complete
+    RequestTrace trace;
+    QElapsedTimer clock;
+    qint64 headerLatencyUs = -1;  // Time until the upstream response headers arrived
+    std::shared_ptr<CircuitBreaker> breaker;
+    std::shared_ptr<ConcurrencyLimiter> limiter;
+    QByteArray method;
+    QString path;
+    QHostAddress peerAddress;
+    quint16 peerPort = 0;
+    ReverseProxy::Completion completion;
+};
+
+// Failures of the connection or the HTTP exchange itself, as opposed to error status codes
+bool isTransferError(QNetworkReply::NetworkError error)
+{
+    return error != QNetworkReply::NoError
+        && (error <= QNetworkReply::UnknownProxyError
+            || (error >= QNetworkReply::ProtocolUnknownError && error <= QNetworkReply::ProtocolFailure));
+}
+
+QHttpServerResponse unavailableProblem(const QString &path, const QString &detail, qint64 retryAfterMs)
+{
+    ProblemDetail problem(503);
+    problem.setDetail(detail);
+    problem.setInstance(path);
+    
+    QHttpServerResponse response = problem.toJsonResponse();
+    if (retryAfterMs > 0) {
+        QHttpHeaders headers = response.headers();
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::RetryAfter,
+                                QByteArray::number(static_cast<qint64>(std::ceil(retryAfterMs / 1000.0))));
+        response.setHeaders(std::move(headers));
+    }
+    return response;
+}
+
+QHttpServerResponse gatewayProblem(bool timedOut, const QString &path, const QString &reason)
+{
+    ProblemDetail problem(timedOut ? 504 : 502);
+    problem.setDetail(timedOut ? QStringLiteral("The upstream service did not respond in time")
+                               : QStringLiteral("The upstream service could not be reached: %1").arg(reason));
+    problem.setInstance(path);
+    return problem.toJsonResponse();
+}
+}
+
+ReverseProxy::ReverseProxy(QObject *parent)
+    : QObject(parent),
+      m_network(new QNetworkAccessManager(this)),
+      m_active(0)
+{
+    // Responses are passed through; nothing is cached or followed on the client's behalf
+    m_network->setRedirectPolicy(QNetworkRequest::ManualRedirectPolicy);
+}
+
+ReverseProxy::~ReverseProxy()
+{
+}
+
+ReverseProxy::Upstream::Upstream(const CircuitBreaker::Settings &breakerSettings,
+                                 const ConcurrencyLimiter::Settings &limiterSettings)
+    : breaker(std::make_shared<CircuitBreaker>(breakerSettings)),
+      limiter(std::make_shared<ConcurrencyLimiter>(limiterSettings))
+{
+}
+
+void ReverseProxy::setConnectionAborter(const ConnectionAborter &aborter)
+{
+    m_abortConnection = aborter;
+}
+
+void ReverseProxy::setProtection(const CircuitBreaker::Settings &breaker, const ConcurrencyLimiter::Settings &limiter)
+{
+    m_breakerSettings = breaker;
+    m_limiterSettings = limiter;
+}
+
+void ReverseProxy::addUpstream(const Route &route)
+{
+    upstreamFor(route);
+}
+
+std::shared_ptr<const CircuitBreaker> ReverseProxy::circuitBreaker(const QString &prefix) const
+{
+    const auto it = m_upstreams.constFind(prefix);
+    return it != m_upstreams.constEnd() ? it->breaker : nullptr;
+}
+
+std::shared_ptr<const ConcurrencyLimiter> ReverseProxy::concurrencyLimiter(const QString &prefix) const
+{
+    const auto it = m_upstreams.constFind(prefix);
+    return it != m_upstreams.constEnd() ? it->limiter : nullptr;
+}
+
+ReverseProxy::Upstream &ReverseProxy::upstreamFor(const Route &route)
+{
+    auto it = m_upstreams.find(route.prefix);
+    if (it == m_upstreams.end()) {
+        it = m_upstreams.insert(route.prefix, Upstream(m_breakerSettings, m_limiterSettings));
+    }
+    return it.value();
+}
+
+QUrl ReverseProxy::upstreamUrl(const Route &route, const QUrl &requestUrl)
+{
+    QString path = requestUrl.path(QUrl::FullyEncoded);
+    if (route.stripPrefix) {
+        path = path.mid(route.prefix.size());
+        if (!path.startsWith(QLatin1Char('/'))) {
+            path.prepend(QLatin1Char('/'));
+        }
+    }
+    
+    // Join with the upstream's base path without doubling the slash
+    QString basePath = route.upstream.path(QUrl::FullyEncoded);
+    if (basePath.endsWith(QLatin1Char('/'))) {
+        basePath.chop(1);
+    }
+    
+    QUrl url = route.upstream;
+    url.setPath(basePath + path, QUrl::StrictMode);
+    url.setQuery(requestUrl.query(QUrl::FullyEncoded), QUrl::StrictMode);
+    return url;
+}
+
+void ReverseProxy::forward(const Route &route, const QHttpServerRequest &request, const char *method,
+                           QHttpServerResponder &&responder, const QByteArray &forwardedProto,
+                           const Completion &completion)
+{
+    // Fail fast, without any upstream cost, while the upstream is saturated or known to be failing
+    Upstream &upstream = upstreamFor(route);
+    if (!upstream.limiter->tryAcquire()) {
+        responder.sendResponse(unavailableProblem(request.url().path(),
+                                                  QStringLiteral("Too many requests are in progress for the upstream service"), 0));
+        if (completion) {
+            completion(503);
+        }
+        return;
+    }
+    if (!upstream.breaker->tryAcquire()) {
+        upstream.limiter->cancel();
+        responder.sendResponse(unavailableProblem(request.url().path(),
+                                                  QStringLiteral("The upstream service is failing; requests are suspended"),
+                                                  upstream.breaker->remainingOpenMs()));
+        if (completion) {
+            completion(503);
+        }
+        return;
+    }
+    
+    auto call = std::make_shared<ProxyCall>(std::move(responder));
+    call->method = method;
+    call->path = request.url().path();
+    call->peerAddress = request.remoteAddress();
+    call->peerPort = request.remotePort();
+    call->completion = completion;
+    call->breaker = upstream.breaker;
+    call->limiter = upstream.limiter;
+    
+    const QByteArray incomingTraceparent = request.value("traceparent");
+    Tracer::instance().begin(incomingTraceparent, call->trace);
+    
+    QNetworkRequest upstreamRequest(upstreamUrl(route, request.url()));
+    upstreamRequest.setTransferTimeout(route.idleTimeoutMs);
+    upstreamRequest.setAttribute(QNetworkRequest::CookieLoadControlAttribute, QNetworkRequest::Manual);
+    upstreamRequest.setAttribute(QNetworkRequest::CookieSaveControlAttribute, QNetworkRequest::Manual);
+    
+    // End-to-end headers are forwarded as received; Content-Length is recomputed and the
+    // client's Accept-Encoding is kept, so compressed upstream bodies pass through untouched
+    QByteArray forwardedFor;
+    for (const auto &header : requestHeaders(request)) {
+        const QByteArray name = header.first.toLower();
+        if (isHopByHopHeader(name) || name == "host" || name == "content-length" || name == "traceparent") {
+            continue;
+        }
+        if (name == "x-forwarded-for") {
+            forwardedFor = header.second;
+            continue;
+        }
+        upstreamRequest.setRawHeader(header.first, header.second);
+    }
+    
+    // Requests on a Unix socket have no peer address; the local proxy's header is passed on as received
+    const QByteArray clientAddress = request.remoteAddress().isNull() ? QByteArray() : request.remoteAddress().toString().toUtf8();
+    if (clientAddress.isEmpty()) {
+        if (!forwardedFor.isEmpty()) {
+            upstreamRequest.setRawHeader("X-Forwarded-For", forwardedFor);
+        }
+    } else {
+        upstreamRequest.setRawHeader("X-Forwarded-For", forwardedFor.isEmpty() ? clientAddress : forwardedFor + ", " + clientAddress);
+    }
+    upstreamRequest.setRawHeader("X-Forwarded-Proto", forwardedProto);
+    if (!request.value("Host").isEmpty()) {
+        upstreamRequest.setRawHeader("X-Forwarded-Host", request.value("Host"));
+    }
+    
+    // A sampled request continues its trace upstream; otherwise the caller's context is kept
+    if (call->trace.context.sampled) {
+        upstreamRequest.setRawHeader("traceparent", call->trace.context.traceparent());
+    } else if (!incomingTraceparent.isEmpty()) {
+        upstreamRequest.setRawHeader("traceparent", incomingTraceparent);
+    }
+    
+    call->clock.start();
+    QNetworkReply *reply = m_network->sendCustomRequest(upstreamRequest, call->method, request.body());
+    call->reply = reply;
+    ++m_active;
+    
+    // Deadline for the upstream response headers
+    if (route.timeoutMs > 0) {
+        call->headerTimer = new QTimer(reply);
+        call->headerTimer->setSingleShot(true);
+        connect(call->headerTimer, &QTimer::timeout, reply, [call]() {
+            call->timedOut = true;
+            call->reply->abort();
+        });
+        call->headerTimer->start(route.timeoutMs);
+    }
+    
+    connect(reply, &QNetworkReply::metaDataChanged, this, [call]() {
+        const QVariant status = call->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+        if (call->started || !status.isValid()) {
+            return;
+        }
+        
+        if (call->headerTimer) {
+            call->headerTimer->stop();
+        }
+        
+        call->headerLatencyUs = call->clock.nsecsElapsed() / 1000;
+        call->statusCode = status.toInt();
+        for (const auto &header : call->reply->rawHeaderPairs()) {
+            if (!isHopByHopHeader(header.first) && header.first.toLower() != "content-length") {
+                call->headers.append({header.first, header.second});
+            }
+        }
+        
+        // A small body of known length is collected first, so a failed transfer can still be
+        // answered with a 502 and the client gets a Content-Length instead of chunked encoding
+        const QVariant contentLength = call->reply->header(QNetworkRequest::ContentLengthHeader);
+        if (contentLength.isValid() && contentLength.toLongLong() <= MaxBufferedBodyBytes) {
+            return;
+        }
+        
+        // Anything else, including event streams of unknown length, is streamed with chunked
+        // encoding as it arrives from the upstream
+        QHttpHeaders headers;
+        for (const auto &header : std::as_const(call->headers)) {
+            headers.append(header.first, header.second);
+        }
+        call->responder.writeBeginChunked(headers, QHttpServerResponder::StatusCode(call->statusCode));
+        call->started = true;
+    });
+    
+    connect(reply, &QNetworkReply::readyRead, this, [call]() {
+        if (call->statusCode == 0) {
+            return;
+        }
+        
+        if (call->started) {
+            call->responder.writeChunk(call->reply->readAll());
+            return;
+        }
+        
+        // The upstream sends no more than its Content-Length, so this only guards the buffer
+        call->body += call->reply->readAll();
+        if (call->body.size() > MaxBufferedBodyBytes) {
+            call->reply->abort();
+        }
+    });
+    
+    connect(reply, &QNetworkReply::finished, this, [this, call]() {
+        --m_active;
+        
+        const QNetworkReply::NetworkError error = call->reply->error();
+        const bool timedOut = call->timedOut || error == QNetworkReply::TimeoutError;
+        int statusCode = call->statusCode;
+        
+        const bool transferFailed = timedOut || isTransferError(error);
+        
+        if (call->started) {
+            // Headers are already out, so a failure cannot be reported with a status code; the
+            // terminating chunk is withheld and the connection aborted, so the client sees a
+            // truncated body instead of a complete one
+            if (!transferFailed) {
+                call->responder.writeEndChunked(call->reply->readAll());
+            } else if (m_abortConnection) {
+                m_abortConnection(call->peerAddress, call->peerPort);
+            }
+        } else if (statusCode != 0 && !transferFailed) {
+            call->body += call->reply->readAll();
+            QHttpServerResponse response(call->body, QHttpServerResponse::StatusCode(statusCode));
+            QHttpHeaders headers = response.headers();
+            for (const auto &header : std::as_const(call->headers)) {
+                if (header.first.toLower() == "content-type") {
+                    headers.replaceOrAppend(header.first, header.second);
+                } else {
+                    headers.append(header.first, header.second);
+                }
+            }
+            response.setHeaders(std::move(headers));
+            call->responder.sendResponse(response);
+        } else {
+            // Nothing was sent yet: the upstream was unreachable, timed out or failed part way
+            // through a buffered body
+            QHttpServerResponse response = gatewayProblem(timedOut, call->path, call->reply->errorString());
+            statusCode = static_cast<int>(response.statusCode());
+            call->responder.sendResponse(response);
+        }
+        
+        // Failed calls and upstream server errors count against the upstream; the latency
+        // is that of the response headers, so long bodies do not look like a slow upstream
+        const bool failed = transferFailed || call->statusCode == 0 || call->statusCode >= 500;
+        const qint64 latencyUs = call->headerLatencyUs >= 0 ? call->headerLatencyUs : call->clock.nsecsElapsed() / 1000;
+        call->breaker->record(!failed, latencyUs / 1000);
+        call->limiter->release(latencyUs, failed);
+        
+        Tracer::instance().finish(call->trace, call->method.constData(), call->path, statusCode);
+        if (call->completion) {
+            call->completion(statusCode);
+        }
+        
+        call->reply->deleteLater();
+    });
+}
+
+int ReverseProxy::activeCount() const
+{
+    return m_active;
+}
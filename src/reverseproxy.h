@@ -0,0 +1,135 @@
+#ifndef REVERSEPROXY_H
+#define REVERSEPROXY_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHttpServerRequest>
+#include <QHttpServerResponder>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <functional>
+#include <memory>
+#include "circuitbreaker.h"
+#include "concurrencylimiter.h"
+
+class QNetworkAccessManager;
+
+/**
+ * @brief The ReverseProxy class forwards requests under configured path prefixes to upstream HTTP services
+ * 
+ * Each proxy owns a QNetworkAccessManager, which keeps persistent keep-alive connections to
+ * every upstream host, so one proxy per worker thread gives each worker its own connection
+ * pool. Upstream responses with a small Content-Length are buffered and sent in one piece; all
+ * others are streamed to the client as they arrive. Request bodies have already been read in
+ * full by QHttpServer and are sent as they are.
+ * 
+ * Every route's upstream is protected by a circuit breaker and an adaptive concurrency limit.
+ * Calls the breaker or the limit reject are answered with a 503 problem detail without
+ * contacting the upstream, so a slow or failing dependency cannot tie up the server.
+ * 
+ * A ReverseProxy must be used from the thread it lives in.
+ */
+class ReverseProxy : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Route
+    {
+        QString prefix;           // e.g. "/api/orders"
+        QUrl upstream;            // e.g. "http://127.0.0.1:9001"
+        bool stripPrefix = false; // Remove the prefix from the forwarded path
+        int timeoutMs = 30000;    // Until the upstream response headers arrive
+        int idleTimeoutMs = 30000; // Longest pause while transferring
+    };
+    
+    /**
+     * @brief Called once the response has been handed to the client
+     * 
+     * @param statusCode The status sent to the client
+     */
+    using Completion = std::function<void(int statusCode)>;
+    
+    // Closes the client connection a request arrived on, identified by its peer address and port
+    using ConnectionAborter = std::function<void(const QHostAddress &peerAddress, quint16 peerPort)>;
+    
+    explicit ReverseProxy(QObject *parent = nullptr);
+    ~ReverseProxy();
+    
+    /**
+     * @brief Sets how a client connection is closed when a streamed response fails
+     * 
+     * Once the status line has been sent, an upstream failure can no longer be reported with a
+     * status code. The connection is aborted instead of completing the chunked body, so that the
+     * client sees the response as truncated rather than complete.
+     */
+    void setConnectionAborter(const ConnectionAborter &aborter);
+    
+    /**
+     * @brief Sets the breaker and limiter settings for upstreams added from now on
+     */
+    void setProtection(const CircuitBreaker::Settings &breaker, const ConcurrencyLimiter::Settings &limiter);
+    
+    /**
+     * @brief Creates the circuit breaker and concurrency limiter of a route's upstream
+     */
+    void addUpstream(const Route &route);
+    
+    /**
+     * @brief Returns the circuit breaker of a route added with addUpstream(), or null
+     */
+    std::shared_ptr<const CircuitBreaker> circuitBreaker(const QString &prefix) const;
+    
+    /**
+     * @brief Returns the concurrency limiter of a route added with addUpstream(), or null
+     */
+    std::shared_ptr<const ConcurrencyLimiter> concurrencyLimiter(const QString &prefix) const;
+    
+    /**
+     * @brief Forwards a request to the route's upstream and answers it through the responder
+     * 
+     * Upstream connection failures are answered with a 502 problem detail, timeouts with a 504,
+     * and calls rejected by the circuit breaker or the concurrency limit with a 503. Upstream
+     * error responses are passed through unchanged. A failure after the response headers were
+     * sent closes the client connection through the connection aborter.
+     * 
+     * @param method The request method, e.g. "GET"
+     * @param forwardedProto The scheme the client used, for X-Forwarded-Proto
+     */
+    void forward(const Route &route, const QHttpServerRequest &request, const char *method,
+                 QHttpServerResponder &&responder, const QByteArray &forwardedProto,
+                 const Completion &completion);
+    
+    /**
+     * @brief Returns the number of requests waiting for or receiving an upstream response
+     */
+    int activeCount() const;
+    
+    /**
+     * @brief Builds the upstream URL for a request path under the route's prefix
+     */
+    static QUrl upstreamUrl(const Route &route, const QUrl &requestUrl);
+
+private:
+    struct Upstream
+    {
+        Upstream(const CircuitBreaker::Settings &breakerSettings, const ConcurrencyLimiter::Settings &limiterSettings);
+        
+        std::shared_ptr<CircuitBreaker> breaker;
+        std::shared_ptr<ConcurrencyLimiter> limiter;
+    };
+    
+    QNetworkAccessManager *m_network;
+    int m_active;
+    ConnectionAborter m_abortConnection;
+    CircuitBreaker::Settings m_breakerSettings;
+    ConcurrencyLimiter::Settings m_limiterSettings;
+    QHash<QString, Upstream> m_upstreams;  // By route prefix
+    
+    Upstream &upstreamFor(const Route &route);
+};
+
+#endif // REVERSEPROXY_H
@@ -0,0 +1,74 @@
+#include "signalwatcher.h"
+#include <QSocketNotifier>
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+int s_signalFds[2] = {-1, -1};
+}
+
+SignalWatcher::SignalWatcher(QObject *parent)
+    : QObject(parent),
+      m_notifier(nullptr)
+{
+#ifdef Q_OS_UNIX
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, s_signalFds) != 0) {
+        return;
+    }
+    
+    m_notifier = new QSocketNotifier(s_signalFds[1], QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &SignalWatcher::onActivated);
+    
+    struct sigaction action = {};
+    action.sa_handler = &SignalWatcher::handleSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    
+    ::sigaction(SIGTERM, &action, nullptr);
+    ::sigaction(SIGINT, &action, nullptr);
+#endif
+}
+
+SignalWatcher::~SignalWatcher()
+{
+#ifdef Q_OS_UNIX
+    if (!m_notifier) {
+        return;
+    }
+    
+    // Restore the default behavior before the socket pair goes away
+    ::signal(SIGTERM, SIG_DFL);
+    ::signal(SIGINT, SIG_DFL);
+    
+    ::close(s_signalFds[0]);
+    ::close(s_signalFds[1]);
+    s_signalFds[0] = s_signalFds[1] = -1;
+#endif
+}
+
+void SignalWatcher::handleSignal(int signalNumber)
+{
+#ifdef Q_OS_UNIX
+    // Only async-signal-safe calls are allowed here
+    const char byte = static_cast<char>(signalNumber);
+    const ssize_t written = ::write(s_signalFds[0], &byte, sizeof(byte));
+    Q_UNUSED(written);
+#else
+    Q_UNUSED(signalNumber);
+#endif
+}
+
+void SignalWatcher::onActivated()
+{
+#ifdef Q_OS_UNIX
+    char byte;
+    const ssize_t received = ::read(s_signalFds[1], &byte, sizeof(byte));
+    Q_UNUSED(received);
+#endif
+    
+    emit terminationRequested();
+}
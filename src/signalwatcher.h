@@ -0,0 +1,36 @@
+#ifndef SIGNALWATCHER_H
+#define SIGNALWATCHER_H
+
+#include <QObject>
+
+class QSocketNotifier;
+
+/**
+ * @brief The SignalWatcher class turns SIGTERM and SIGINT into a Qt signal
+ * 
+ * The Unix signal handler only writes a byte to a socket pair; the notification
+ * is delivered through the event loop, where it is safe to run any code.
+ * Only one SignalWatcher may exist per process.
+ */
+class SignalWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SignalWatcher(QObject *parent = nullptr);
+    ~SignalWatcher();
+
+signals:
+    /**
+     * @brief Emitted from the event loop when SIGTERM or SIGINT was received
+     */
+    void terminationRequested();
+
+private:
+    QSocketNotifier *m_notifier;
+    
+    static void handleSignal(int signalNumber);
+    void onActivated();
+};
+
+#endif // SIGNALWATCHER_H
@@ -0,0 +1,305 @@
+#include "sockethandoff.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+#include <QFile>
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// First descriptor passed by systemd socket activation (SD_LISTEN_FDS_START)
+constexpr int ListenFdsStart = 3;
+
+// Upper bound on the number of descriptors exchanged in one handoff
+constexpr int MaxHandoffFds = 8;
+
+// How long the new instance may take to start listening before we keep serving
+constexpr int AcknowledgeTimeoutMs = 30000;
+
+const QByteArray HandoffRequest = "HANDOFF\n";
+const QByteArray HandoffAcknowledgement = "LISTENING\n";
+
+QString positionalListenerName(int index)
+{
+    return index == 0 ? QStringLiteral("api") : QStringLiteral("redirect");
+}
+}
+
+SocketHandoff::SocketHandoff(QObject *parent)
+    : QObject(parent),
+      m_server(nullptr),
+      m_predecessor(-1)
+{
+}
+
+SocketHandoff::~SocketHandoff()
+{
+#ifdef Q_OS_UNIX
+    // Closing without an acknowledgement tells the previous instance to keep serving
+    if (m_predecessor >= 0) {
+        ::close(m_predecessor);
+    }
+#endif
+}
+
+QHash<QString, qintptr> SocketHandoff::systemdListeners()
+{
+    QHash<QString, qintptr> listeners;
+    
+#ifdef Q_OS_UNIX
+    bool ok = false;
+    const qint64 listenPid = qEnvironmentVariable("LISTEN_PID").toLongLong(&ok);
+    if (!ok || listenPid != static_cast<qint64>(::getpid())) {
+        return listeners;
+    }
+    
+    const int count = qEnvironmentVariableIntValue("LISTEN_FDS");
+    const QStringList names = qEnvironmentVariable("LISTEN_FDNAMES").split(':');
+    
+    qunsetenv("LISTEN_PID");
+    qunsetenv("LISTEN_FDS");
+    qunsetenv("LISTEN_FDNAMES");
+    
+    for (int i = 0; i < count; ++i) {
+        const int fd = ListenFdsStart + i;
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        
+        // systemd names sockets after their unit unless FileDescriptorName= is set
+        QString name = i < names.size() ? names[i] : QString();
+        if (name != "api" && name != "redirect") {
+            name = positionalListenerName(i);
+        }
+        
+        if (!listeners.contains(name)) {
+            listeners.insert(name, fd);
+        }
+    }
+#endif
+    
+    return listeners;
+}
+
+QHash<QString, qintptr> SocketHandoff::receive(const QString &socketPath, int timeoutMs)
+{
+    QHash<QString, qintptr> listeners;
+    
+#ifdef Q_OS_UNIX
+    const QByteArray path = QFile::encodeName(socketPath);
+    
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.isEmpty() || path.size() >= static_cast<int>(sizeof(address.sun_path))) {
+        return listeners;
+    }
+    std::memcpy(address.sun_path, path.constData(), path.size());
+    
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return listeners;
+    }
+    
+    // No running instance is the normal case for a cold start
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        return listeners;
+    }
+    
+    timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    if (::write(fd, HandoffRequest.constData(), HandoffRequest.size()) != HandoffRequest.size()) {
+        ::close(fd);
+        return listeners;
+    }
+    
+    // The reply carries the comma-separated listener names as data and the
+    // descriptors, in the same order, as SCM_RIGHTS ancillary data
+    char names[512];
+    iovec iov;
+    iov.iov_base = names;
+    iov.iov_len = sizeof(names);
+    
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MaxHandoffFds)];
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    
+    const ssize_t received = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+    if (received <= 0) {
+        ::close(fd);
+        return listeners;
+    }
+    
+    QVector<int> descriptors;
+    for (cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            const int count = static_cast<int>((header->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for (int i = 0; i < count; ++i) {
+                int descriptor;
+                std::memcpy(&descriptor, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+                descriptors.append(descriptor);
+            }
+        }
+    }
+    
+    const QList<QByteArray> nameList = QByteArray(names, static_cast<int>(received)).split(',');
+    for (int i = 0; i < descriptors.size(); ++i) {
+        const QString name = i < nameList.size() ? QString::fromUtf8(nameList[i]) : positionalListenerName(i);
+        if (!listeners.contains(name)) {
+            listeners.insert(name, descriptors[i]);
+        } else {
+            ::close(descriptors[i]);
+        }
+    }
+    
+    // Keep the connection open until acknowledge() or until we exit
+    if (listeners.isEmpty()) {
+        ::close(fd);
+    } else {
+        m_predecessor = fd;
+    }
+#else
+    Q_UNUSED(socketPath);
+    Q_UNUSED(timeoutMs);
+#endif
+    
+    return listeners;
+}
+
+void SocketHandoff::acknowledge()
+{
+#ifdef Q_OS_UNIX
+    if (m_predecessor < 0) {
+        return;
+    }
+    
+    ::send(m_predecessor, HandoffAcknowledgement.constData(), HandoffAcknowledgement.size(), MSG_NOSIGNAL);
+    ::close(m_predecessor);
+    m_predecessor = -1;
+#endif
+}
+
+bool SocketHandoff::listen(const QString &socketPath, const QHash<QString, qintptr> &listeners)
+{
+    m_listeners = listeners;
+    
+    if (!m_server) {
+        m_server = new QLocalServer(this);
+        m_server->setSocketOptions(QLocalServer::UserAccessOption);
+        connect(m_server, &QLocalServer::newConnection, this, &SocketHandoff::onNewConnection);
+    }
+    
+    // The socket file of the instance we took over from is still present
+    QLocalServer::removeServer(socketPath);
+    
+    return m_server->listen(socketPath);
+}
+
+void SocketHandoff::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        // Runs from sending the sockets until the new instance acknowledges
+        QTimer *acknowledgeTimer = new QTimer(socket);
+        acknowledgeTimer->setSingleShot(true);
+        connect(acknowledgeTimer, &QTimer::timeout, this, [this, socket]() {
+            emit handoffFailed();
+            socket->abort();
+        });
+        
+        connect(socket, &QLocalSocket::disconnected, this, [this, acknowledgeTimer]() {
+            if (acknowledgeTimer->isActive()) {
+                acknowledgeTimer->stop();
+                emit handoffFailed();
+            }
+        });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket, acknowledgeTimer]() {
+            onReadyRead(socket, acknowledgeTimer);
+        });
+    }
+}
+
+void SocketHandoff::onReadyRead(QLocalSocket *socket, QTimer *acknowledgeTimer)
+{
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine();
+        
+        // The sockets were sent, so the line is the new instance confirming it is listening
+        if (acknowledgeTimer->isActive()) {
+            if (line == HandoffAcknowledgement) {
+                acknowledgeTimer->stop();
+                socket->disconnectFromServer();
+                emit handedOff();
+            } else {
+                socket->abort();
+            }
+            return;
+        }
+        
+        if (line != HandoffRequest || !send(socket)) {
+            socket->abort();
+            return;
+        }
+        
+        acknowledgeTimer->start(AcknowledgeTimeoutMs);
+    }
+}
+
+bool SocketHandoff::send(QLocalSocket *socket)
+{
+#ifdef Q_OS_UNIX
+    if (m_listeners.isEmpty() || m_listeners.size() > MaxHandoffFds) {
+        return false;
+    }
+    
+    QByteArray names;
+    QVector<int> descriptors;
+    for (auto it = m_listeners.constBegin(); it != m_listeners.constEnd(); ++it) {
+        if (!names.isEmpty()) {
+            names += ',';
+        }
+        names += it.key().toUtf8();
+        descriptors.append(static_cast<int>(it.value()));
+    }
+    
+    iovec iov;
+    iov.iov_base = names.data();
+    iov.iov_len = names.size();
+    
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MaxHandoffFds)];
+    std::memset(control, 0, sizeof(control));
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * descriptors.size());
+    
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * descriptors.size());
+    std::memcpy(CMSG_DATA(header), descriptors.constData(), sizeof(int) * descriptors.size());
+    
+    return ::sendmsg(static_cast<int>(socket->socketDescriptor()), &message, MSG_NOSIGNAL) == static_cast<ssize_t>(names.size());
+#else
+    Q_UNUSED(socket);
+    return false;
+#endif
+}
@@ -0,0 +1,97 @@
+#ifndef SOCKETHANDOFF_H
+#define SOCKETHANDOFF_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+
+class QLocalServer;
+class QLocalSocket;
+class QTimer;
+
+/**
+ * @brief The SocketHandoff class transfers pre-bound listening sockets between processes
+ * 
+ * Listening sockets can be inherited in two ways, so that a restart never closes the port:
+ * - systemd socket activation (LISTEN_PID/LISTEN_FDS/LISTEN_FDNAMES)
+ * - a handoff from a running instance over a Unix domain socket (SCM_RIGHTS fd passing)
+ * 
+ * Listeners are identified by name: "api" for the main listener and "redirect" for the
+ * HTTP to HTTPS redirect listener.
+ */
+class SocketHandoff : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SocketHandoff(QObject *parent = nullptr);
+    ~SocketHandoff();
+    
+    /**
+     * @brief Returns the listening sockets passed in by systemd socket activation
+     * 
+     * The activation environment variables are cleared so they are not inherited
+     * by child processes. Sockets without a known FileDescriptorName are named by
+     * position: the first is "api", the second "redirect".
+     * 
+     * @return Socket descriptors keyed by listener name, empty if not socket activated
+     */
+    static QHash<QString, qintptr> systemdListeners();
+    
+    /**
+     * @brief Requests the listening sockets of a running instance
+     * 
+     * The connection stays open until acknowledge() is called, so the running
+     * instance keeps serving until this instance is listening. If this instance
+     * exits before acknowledging, the running instance carries on as before.
+     * 
+     * @param socketPath Path of the running instance's handoff socket
+     * @param timeoutMs Maximum time to wait for the running instance to respond
+     * @return Socket descriptors keyed by listener name, empty if no instance handed over
+     */
+    QHash<QString, qintptr> receive(const QString &socketPath, int timeoutMs = 5000);
+    
+    /**
+     * @brief Tells the instance we received the listening sockets from that we are listening
+     * 
+     * The previous instance starts draining once it receives the acknowledgement.
+     * Does nothing if no sockets were received.
+     */
+    void acknowledge();
+    
+    /**
+     * @brief Starts serving handoff requests from a future instance
+     * 
+     * @param socketPath Path of the handoff socket; a stale socket file is replaced
+     * @param listeners The listening sockets to hand over, keyed by listener name
+     * @return true if the handoff socket is listening
+     */
+    bool listen(const QString &socketPath, const QHash<QString, qintptr> &listeners);
+
+signals:
+    /**
+     * @brief Emitted when a new instance acknowledged that it is listening on our sockets
+     * 
+     * The receiver should stop accepting connections and drain.
+     */
+    void handedOff();
+    
+    /**
+     * @brief Emitted when a new instance took our sockets but never acknowledged
+     * 
+     * The new instance exited or did not start listening in time. The listening
+     * sockets were never closed here, so the receiver simply keeps serving.
+     */
+    void handoffFailed();
+
+private:
+    QLocalServer *m_server;
+    QHash<QString, qintptr> m_listeners;
+    int m_predecessor;
+    
+    void onNewConnection();
+    void onReadyRead(QLocalSocket *socket, QTimer *acknowledgeTimer);
+    bool send(QLocalSocket *socket);
+};
+
+#endif // SOCKETHANDOFF_H
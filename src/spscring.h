@@ -0,0 +1,69 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief The SpscRing class is a bounded, lock-free single-producer single-consumer queue
+ * 
+ * Exactly one thread may push and exactly one (other) thread may pop. Neither side ever
+ * blocks: tryPush() fails when the ring is full and tryPop() fails when it is empty.
+ * 
+ * @tparam T A trivially copyable element type
+ * @tparam Capacity Number of elements; must be a power of two
+ */
+template <typename T, int Capacity>
+class SpscRing
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing()
+        : m_items(new T[Capacity])
+    {
+    }
+    
+    /**
+     * @brief Appends an element; producer thread only
+     * 
+     * @return false if the ring is full and the element was not added
+     */
+    bool tryPush(const T &item)
+    {
+        const quint64 head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= static_cast<quint64>(Capacity)) {
+            return false;
+        }
+        
+        m_items[head & (Capacity - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    
+    /**
+     * @brief Removes the oldest element; consumer thread only
+     * 
+     * @return false if the ring is empty
+     */
+    bool tryPop(T &item)
+    {
+        const quint64 tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        
+        item = m_items[tail & (Capacity - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<quint64> m_head{0};
+    alignas(64) std::atomic<quint64> m_tail{0};
+    std::unique_ptr<T[]> m_items;
+};
+
+#endif // SPSCRING_H
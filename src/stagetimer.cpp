@@ -0,0 +1,130 @@
+#include "stagetimer.h"
+
+#ifdef API_STAGE_TIMING
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STAGE_CLOCK_USE_TSC
+#endif
+#endif
+
+const char *pipelineStageName(PipelineStage stage)
+{
+    switch (stage) {
+    case PipelineStage::RateLimit:
+        return "ratelimit";
+    case PipelineStage::Authentication:
+        return "auth";
+    case PipelineStage::Validation:
+        return "validate";
+    case PipelineStage::Handler:
+        return "handler";
+    case PipelineStage::Headers:
+        return "headers";
+    case PipelineStage::Serialization:
+        return "serialize";
+    default:
+        return "unknown";
+    }
+}
+
+#ifdef API_STAGE_TIMING
+
+namespace {
+thread_local StageTimings *s_currentTimings = nullptr;
+thread_local ScopedStageTimer *s_currentTimer = nullptr;
+
+#ifdef STAGE_CLOCK_USE_TSC
+double calibrateTicksPerMicrosecond()
+{
+    // Measure the TSC rate against the steady clock once
+    const auto steadyStart = std::chrono::steady_clock::now();
+    const quint64 tscStart = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const quint64 tscEnd = __rdtsc();
+    const auto steadyEnd = std::chrono::steady_clock::now();
+    
+    const double elapsedUs = std::chrono::duration<double, std::micro>(steadyEnd - steadyStart).count();
+    return elapsedUs > 0 ? (tscEnd - tscStart) / elapsedUs : 1.0;
+}
+
+double ticksPerMicrosecond()
+{
+    static const double rate = calibrateTicksPerMicrosecond();
+    return rate;
+}
+#endif
+}
+
+void StageClock::calibrate()
+{
+#ifdef STAGE_CLOCK_USE_TSC
+    ticksPerMicrosecond();
+#endif
+}
+
+quint64 StageClock::now()
+{
+#ifdef STAGE_CLOCK_USE_TSC
+    return __rdtsc();
+#else
+    return static_cast<quint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+double StageClock::ticksToMicroseconds(quint64 ticks)
+{
+#ifdef STAGE_CLOCK_USE_TSC
+    return ticks / ticksPerMicrosecond();
+#else
+    return ticks / 1000.0;
+#endif
+}
+
+StageTimings *StageTimings::current()
+{
+    return s_currentTimings;
+}
+
+StageTimingScope::StageTimingScope(StageTimings *timings)
+    : m_previous(s_currentTimings)
+{
+    s_currentTimings = timings;
+}
+
+StageTimingScope::~StageTimingScope()
+{
+    s_currentTimings = m_previous;
+}
+
+ScopedStageTimer::ScopedStageTimer(PipelineStage stage)
+    : m_stage(stage),
+      m_start(StageClock::now()),
+      m_parent(s_currentTimer)
+{
+    s_currentTimer = this;
+}
+
+ScopedStageTimer::~ScopedStageTimer()
+{
+    const quint64 elapsed = StageClock::now() - m_start;
+    const quint64 ticks = elapsed - std::min(m_nestedTicks, elapsed);
+    
+    s_currentTimer = m_parent;
+    if (m_parent) {
+        m_parent->m_nestedTicks += elapsed;
+    }
+    
+    if (StageTimings *timings = StageTimings::current()) {
+        timings->ticks[static_cast<int>(m_stage)] += ticks;
+    }
+    
+    Metrics::instance().recordStage(static_cast<int>(m_stage), static_cast<quint64>(StageClock::ticksToMicroseconds(ticks)));
+}
+
+#endif // API_STAGE_TIMING
@@ -0,0 +1,107 @@
+#ifndef STAGETIMER_H
+#define STAGETIMER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief Stages of the request pipeline that can be timed individually
+ */
+enum class PipelineStage {
+    RateLimit,
+    Authentication,
+    Validation,
+    Handler,
+    Headers,
+    Serialization,
+    Count
+};
+
+/**
+ * @brief Returns the name of a pipeline stage, as used in metrics and Server-Timing
+ */
+const char *pipelineStageName(PipelineStage stage);
+
+#ifdef API_STAGE_TIMING
+
+/**
+ * @brief The StageClock class is a cheap monotonic clock for timing pipeline stages
+ * 
+ * Uses the CPU timestamp counter where available (x86), calibrated once against
+ * the steady clock; elsewhere it falls back to the steady clock in nanoseconds.
+ */
+class StageClock
+{
+public:
+    /**
+     * @brief Measures the timestamp counter rate; call at startup, as it takes about 10 ms
+     */
+    static void calibrate();
+    
+    static quint64 now();
+    static double ticksToMicroseconds(quint64 ticks);
+};
+
+/**
+ * @brief The StageTimings struct holds the time spent in each stage by one request
+ */
+struct StageTimings
+{
+    quint64 ticks[static_cast<int>(PipelineStage::Count)] = {};
+    
+    /**
+     * @brief Returns the timings of the request being handled on this thread, if any
+     */
+    static StageTimings *current();
+};
+
+/**
+ * @brief The StageTimingScope class makes a StageTimings the current one for its lifetime
+ */
+class StageTimingScope
+{
+public:
+    explicit StageTimingScope(StageTimings *timings);
+    ~StageTimingScope();
+
+private:
+    StageTimings *m_previous;
+};
+
+/**
+ * @brief The ScopedStageTimer class adds the time spent in its scope to a pipeline stage
+ * 
+ * The time is added to the current request's StageTimings and to the stage's latency histogram.
+ * Time spent in a nested timer (e.g. serialization inside the handler) is only counted for
+ * the nested stage, so the stage totals add up to the time spent in the pipeline.
+ */
+class ScopedStageTimer
+{
+public:
+    explicit ScopedStageTimer(PipelineStage stage);
+    ~ScopedStageTimer();
+
+private:
+    PipelineStage m_stage;
+    quint64 m_start;
+    quint64 m_nestedTicks = 0;  // Spent in timers nested in this one
+    ScopedStageTimer *m_parent;
+};
+
+#define STAGE_TIMER_CONCAT_INNER(a, b) a##b
+#define STAGE_TIMER_CONCAT(a, b) STAGE_TIMER_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing scope as the given pipeline stage
+#define STAGE_TIMER(stage) ScopedStageTimer STAGE_TIMER_CONCAT(stageTimer_, __LINE__)(stage)
+
+// Collects the stage timings of the request handled in the enclosing scope
+#define STAGE_TIMING_SCOPE(timings) StageTimingScope STAGE_TIMER_CONCAT(stageTimingScope_, __LINE__)(timings)
+
+#else
+
+// Instrumentation compiled out: the macros expand to nothing
+#define STAGE_TIMER(stage)
+#define STAGE_TIMING_SCOPE(timings)
+
+#endif // API_STAGE_TIMING
+
+#endif // STAGETIMER_H
@@ -0,0 +1,515 @@
+#include "staticfiles.h"
+#include "httpclock.h"
+#include "problemdetail.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHttpHeaders>
+#include <QHttpServerResponse>
+#include <QIODevice>
+#include <QMimeDatabase>
+#include <QStringList>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+enum class RangeResult {
+    None,          // No usable Range header: send the whole representation
+    Satisfiable,
+    Unsatisfiable
+};
+
+// Reads a byte range of a mapped file; the owner keeps the mapping alive until the transfer ends
+class MappedRangeDevice : public QIODevice
+{
+public:
+    MappedRangeDevice(std::shared_ptr<const void> owner, const char *data, qint64 length)
+        : m_owner(std::move(owner)),
+          m_data(data),
+          m_length(length)
+    {
+        open(QIODevice::ReadOnly);
+    }
+    
+    bool isSequential() const override
+    {
+        return false;
+    }
+    
+    qint64 size() const override
+    {
+        return m_length;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        const qint64 count = std::min(maxSize, m_length - pos());
+        if (count <= 0) {
+            return 0;
+        }
+        std::memcpy(data, m_data + pos(), static_cast<size_t>(count));
+        return count;
+    }
+    
+    qint64 writeData(const char *, qint64) override
+    {
+        return -1;
+    }
+
+private:
+    std::shared_ptr<const void> m_owner;
+    const char *m_data;
+    qint64 m_length;
+};
+
+// True if the Accept-Encoding header lists gzip (or *) without q=0
+bool acceptsGzip(const QByteArray &acceptEncoding)
+{
+    for (const QByteArray &item : acceptEncoding.split(',')) {
+        const QList<QByteArray> parts = item.split(';');
+        const QByteArray coding = parts.first().trimmed().toLower();
+        if (coding != "gzip" && coding != "*") {
+            continue;
+        }
+        
+        bool acceptable = true;
+        for (int i = 1; i < parts.size(); ++i) {
+            const QByteArray parameter = parts.at(i).trimmed();
+            if (parameter.startsWith("q=") && parameter.mid(2).toDouble() <= 0.0) {
+                acceptable = false;
+            }
+        }
+        
+        if (acceptable) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+// Weak comparison (RFC 9110 8.8.3.2), as used by If-None-Match
+bool etagListMatches(const QByteArray &header, const QByteArray &etag)
+{
+    for (QByteArray candidate : header.split(',')) {
+        candidate = candidate.trimmed();
+        if (candidate == "*") {
+            return true;
+        }
+        if (candidate.startsWith("W/")) {
+            candidate.remove(0, 2);
+        }
+        if (candidate == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses a single "bytes=" range (RFC 9110 14.1.2). Several ranges are not supported
+// and, like malformed values, fall back to sending the whole representation.
+RangeResult parseRange(const QByteArray &header, qint64 size, qint64 &offset, qint64 &length)
+{
+    const QByteArray value = header.trimmed();
+    if (!value.startsWith("bytes=")) {
+        return RangeResult::None;
+    }
+    
+    const QByteArray spec = value.mid(6).trimmed();
+    const int dash = spec.indexOf('-');
+    if (dash < 0 || spec.contains(',')) {
+        return RangeResult::None;
+    }
+    
+    const QByteArray first = spec.left(dash).trimmed();
+    const QByteArray last = spec.mid(dash + 1).trimmed();
+    bool ok = false;
+    
+    // "bytes=-N" asks for the last N bytes
+    if (first.isEmpty()) {
+        const qint64 suffix = last.toLongLong(&ok);
+        if (!ok || suffix < 0) {
+            return RangeResult::None;
+        }
+        if (suffix == 0 || size == 0) {
+            return RangeResult::Unsatisfiable;
+        }
+        length = std::min(suffix, size);
+        offset = size - length;
+        return RangeResult::Satisfiable;
+    }
+    
+    const qint64 start = first.toLongLong(&ok);
+    if (!ok || start < 0) {
+        return RangeResult::None;
+    }
+    
+    qint64 end = size - 1;
+    if (!last.isEmpty()) {
+        end = last.toLongLong(&ok);
+        if (!ok || end < start) {
+            return RangeResult::None;
+        }
+        end = std::min(end, size - 1);
+    }
+    
+    if (start >= size) {
+        return RangeResult::Unsatisfiable;
+    }
+    
+    offset = start;
+    length = end - start + 1;
+    return RangeResult::Satisfiable;
+}
+
+QByteArray mimeTypeFor(const QString &path)
+{
+    // QMimeDatabase is thread-safe; matching by extension avoids reading the file
+    const QByteArray name = QMimeDatabase().mimeTypeForFile(path, QMimeDatabase::MatchExtension).name().toUtf8();
+    return name.startsWith("text/") ? name + "; charset=utf-8" : name;
+}
+
+// Sets headers on a response, replacing any it already carries with the same name
+void applyHeaders(QHttpServerResponse &response, const StaticFiles::HeaderList &headers)
+{
+    QHttpHeaders httpHeaders = response.headers();
+    for (const auto &header : headers) {
+        httpHeaders.replaceOrAppend(header.first, header.second);
+    }
+    response.setHeaders(std::move(httpHeaders));
+}
+
+void sendProblem(QHttpServerResponder &responder, ProblemDetail &problem, const StaticFiles::HeaderList &headers)
+{
+    QHttpServerResponse response = problem.toJsonResponse();
+    applyHeaders(response, headers);
+    responder.sendResponse(response);
+}
+}
+
+StaticFiles::File::~File() = default;
+
+StaticFiles::StaticFiles(const Settings &settings)
+{
+    setSettings(settings);
+}
+
+StaticFiles::~StaticFiles() = default;
+
+void StaticFiles::setSettings(const Settings &settings)
+{
+    QMutexLocker locker(&m_mutex);
+    m_settings = settings;
+    m_lru.clear();
+    m_index.clear();
+}
+
+int StaticFiles::serve(const Mount &mount, const QHttpServerRequest &request, QHttpServerResponder &responder,
+                       const HeaderList &extraHeaders)
+{
+    const QString path = request.url().path();
+    
+    const bool head = request.method() == QHttpServerRequest::Method::Head;
+    if (!head && request.method() != QHttpServerRequest::Method::Get) {
+        ProblemDetail problem(405);
+        problem.setDetail(QStringLiteral("Static files can only be read with GET or HEAD"));
+        problem.setInstance(path);
+        HeaderList headers = extraHeaders;
+        headers.append({"Allow", "GET, HEAD"});
+        sendProblem(responder, problem, headers);
+        return 405;
+    }
+    
+    const QString resolved = resolve(mount, path);
+    const FilePtr file = resolved.isEmpty() ? FilePtr() : lookup(mount, resolved);
+    if (!file) {
+        ProblemDetail problem(404);
+        problem.setDetail(QStringLiteral("The requested file does not exist"));
+        problem.setInstance(path);
+        sendProblem(responder, problem, extraHeaders);
+        return 404;
+    }
+    
+    // A precompressed sibling is sent as is to clients that accept gzip
+    FilePtr variant = file;
+    if (file->gzip && acceptsGzip(request.value("Accept-Encoding"))) {
+        variant = file->gzip;
+    }
+    
+    HeaderList headers = extraHeaders;
+    headers.append({"ETag", variant->etag});
+    headers.append({"Last-Modified", file->lastModified});
+    headers.append({"Cache-Control", "public, max-age=" + QByteArray::number(m_settings.maxAgeSeconds)});
+    headers.append({"Accept-Ranges", "bytes"});
+    if (file->gzip) {
+        headers.append({"Vary", "Accept-Encoding"});
+    }
+    if (variant != file) {
+        headers.append({"Content-Encoding", "gzip"});
+    }
+    
+    // Conditional requests: If-None-Match takes precedence over If-Modified-Since
+    const QByteArray ifNoneMatch = request.value("If-None-Match");
+    bool notModified = false;
+    if (!ifNoneMatch.isEmpty()) {
+        notModified = etagListMatches(ifNoneMatch, variant->etag);
+    } else {
+        const QDateTime ifModifiedSince = QDateTime::fromString(QString::fromLatin1(request.value("If-Modified-Since")),
+                                                                Qt::RFC2822Date);
+        notModified = ifModifiedSince.isValid() && file->modifiedMs / 1000 <= ifModifiedSince.toSecsSinceEpoch();
+    }
+    if (notModified) {
+        QHttpServerResponse response(QHttpServerResponse::StatusCode::NotModified);
+        applyHeaders(response, headers);
+        responder.sendResponse(response);
+        return 304;
+    }
+    
+    qint64 offset = 0;
+    qint64 length = variant->size;
+    QHttpServerResponder::StatusCode status = QHttpServerResponder::StatusCode::Ok;
+    
+    // If-Range: the range only applies while the client's copy is still current
+    const QByteArray range = request.value("Range");
+    const QByteArray ifRange = request.value("If-Range").trimmed();
+    const bool rangeApplies = !range.isEmpty()
+        && (ifRange.isEmpty() || ifRange == variant->etag || ifRange == file->lastModified);
+    
+    if (rangeApplies) {
+        switch (parseRange(range, variant->size, offset, length)) {
+        case RangeResult::Satisfiable:
+            status = QHttpServerResponder::StatusCode::PartialContent;
+            headers.append({"Content-Range", "bytes " + QByteArray::number(offset) + '-'
+                                                 + QByteArray::number(offset + length - 1) + '/'
+                                                 + QByteArray::number(variant->size)});
+            break;
+        case RangeResult::Unsatisfiable: {
+            ProblemDetail problem(416);
+            problem.setDetail(QStringLiteral("The requested range lies outside the file"));
+            problem.setInstance(path);
+            HeaderList problemHeaders = extraHeaders;
+            problemHeaders.append({"Content-Range", "bytes */" + QByteArray::number(variant->size)});
+            sendProblem(responder, problem, problemHeaders);
+            return 416;
+        }
+        case RangeResult::None:
+            break;
+        }
+    }
+    
+    QHttpHeaders httpHeaders;
+    httpHeaders.append(QHttpHeaders::WellKnownHeader::ContentType, file->mimeType);
+    for (const auto &header : std::as_const(headers)) {
+        httpHeaders.replaceOrAppend(header.first, header.second);
+    }
+    
+    // HEAD responses report the length a GET would have sent; only the status line and
+    // headers are written
+    if (head) {
+        httpHeaders.replaceOrAppend(QHttpHeaders::WellKnownHeader::ContentLength, QByteArray::number(length));
+        responder.write(httpHeaders, status);
+        return static_cast<int>(status);
+    }
+    
+    // Large bodies are read from the mapping as the socket drains, in fixed-size chunks
+    if (length > m_settings.streamThresholdBytes) {
+        responder.write(new MappedRangeDevice(variant, variant->data + offset, length), httpHeaders, status);
+        return static_cast<int>(status);
+    }
+    
+    // Small bodies are copied out of the mapping: the response may be queued behind a
+    // pipelined request and outlive the file, which can be evicted and unmapped meanwhile
+    responder.write(QByteArray(variant->data + offset, length), httpHeaders, status);
+    return static_cast<int>(status);
+}
+
+int StaticFiles::openCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_index.size());
+}
+
+quint64 StaticFiles::hitCount() const
+{
+    return m_hits.load(std::memory_order_relaxed);
+}
+
+quint64 StaticFiles::missCount() const
+{
+    return m_misses.load(std::memory_order_relaxed);
+}
+
+StaticFiles::FilePtr StaticFiles::lookup(const Mount &mount, const QString &path)
+{
+    const qint64 now = nowMs();
+    
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto found = m_index.constFind(path);
+        if (found != m_index.constEnd()) {
+            const auto node = found.value();
+            m_lru.splice(m_lru.begin(), m_lru, node);
+            
+            const FilePtr cached = node->file;
+            bool current = now - node->checkedAtMs < m_settings.revalidateMs;
+            if (!current) {
+                // Stat the file without holding the lock
+                locker.unlock();
+                current = isCurrent(mount, *cached, path);
+                locker.relock();
+                
+                const auto again = m_index.constFind(path);
+                if (current && again != m_index.constEnd() && again.value()->file == cached) {
+                    again.value()->checkedAtMs = now;
+                }
+            }
+            
+            if (current) {
+                m_hits.fetch_add(1, std::memory_order_relaxed);
+                return cached;
+            }
+        }
+    }
+    
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    
+    // Opening and mapping happen without the lock held
+    const FilePtr file = open(mount, path);
+    
+    QMutexLocker locker(&m_mutex);
+    const auto existing = m_index.constFind(path);
+    if (existing != m_index.constEnd()) {
+        m_lru.erase(existing.value());
+        m_index.erase(existing);
+    }
+    
+    if (!file || m_settings.maxOpenFiles <= 0) {
+        return file;
+    }
+    
+    // Close the least recently used files; responses still sending them keep their mapping
+    while (!m_lru.empty() && static_cast<int>(m_lru.size()) >= m_settings.maxOpenFiles) {
+        m_index.remove(m_lru.back().key);
+        m_lru.pop_back();
+    }
+    
+    m_lru.push_front(Node{path, file, now});
+    m_index.insert(path, m_lru.begin());
+    return file;
+}
+
+StaticFiles::FilePtr StaticFiles::open(const Mount &mount, const QString &path)
+{
+    QFileInfo info(path);
+    if (info.isDir()) {
+        if (mount.indexFile.isEmpty()) {
+            return nullptr;
+        }
+        info.setFile(path + '/' + mount.indexFile);
+    }
+    
+    // Symbolic links may not lead outside the root
+    const QString canonical = info.canonicalFilePath();
+    if (canonical.isEmpty() || !canonical.startsWith(mount.root + '/')) {
+        return nullptr;
+    }
+    
+    const QFileInfo target(canonical);
+    if (!target.isFile() || !target.isReadable()) {
+        return nullptr;
+    }
+    
+    const QByteArray mimeType = mimeTypeFor(canonical);
+    std::shared_ptr<File> file = map(canonical, mimeType);
+    if (!file) {
+        return nullptr;
+    }
+    
+    // A sibling older than the file is stale and would serve outdated content
+    const QFileInfo gzipInfo(canonical + QStringLiteral(".gz"));
+    const QString gzipPath = gzipInfo.canonicalFilePath();
+    if (gzipInfo.isFile() && gzipPath.startsWith(mount.root + '/')
+        && gzipInfo.lastModified().toMSecsSinceEpoch() >= file->modifiedMs) {
+        file->gzip = map(gzipPath, mimeType);
+    }
+    
+    return file;
+}
+
+std::shared_ptr<StaticFiles::File> StaticFiles::map(const QString &canonicalPath, const QByteArray &mimeType)
+{
+    auto file = std::make_shared<File>();
+    file->path = canonicalPath;
+    file->mimeType = mimeType;
+    file->handle = std::make_unique<QFile>(canonicalPath);
+    if (!file->handle->open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    
+    file->size = file->handle->size();
+    file->modifiedMs = file->handle->fileTime(QFileDevice::FileModificationTime).toMSecsSinceEpoch();
+    
+    // The mapping stays valid after the descriptor's file is replaced by a rename
+    if (file->size > 0) {
+        const uchar *mapped = file->handle->map(0, file->size);
+        if (!mapped) {
+            return nullptr;
+        }
+        file->data = reinterpret_cast<const char *>(mapped);
+    }
+    
+    file->etag = '"' + QByteArray::number(file->size, 16) + '-' + QByteArray::number(file->modifiedMs, 16) + '"';
+    file->lastModified = QByteArray(HttpClock::format(file->modifiedMs / 1000).httpDate, HttpClock::HttpDateLength);
+    
+    return file;
+}
+
+bool StaticFiles::isCurrent(const Mount &mount, const File &file, const QString &path)
+{
+    QFileInfo info(path);
+    if (info.isDir()) {
+        info.setFile(path + '/' + mount.indexFile);
+    }
+    
+    // A changed symbolic link, size or modification time means the file was replaced
+    if (info.canonicalFilePath() != file.path || info.size() != file.size
+        || info.lastModified().toMSecsSinceEpoch() != file.modifiedMs) {
+        return false;
+    }
+    
+    const QFileInfo gzipInfo(file.path + QStringLiteral(".gz"));
+    if (!file.gzip) {
+        return !gzipInfo.exists();
+    }
+    return gzipInfo.size() == file.gzip->size && gzipInfo.lastModified().toMSecsSinceEpoch() == file.gzip->modifiedMs;
+}
+
+QString StaticFiles::resolve(const Mount &mount, const QString &requestPath)
+{
+    // The path arrives percent-decoded; anything that could climb out of the root is refused
+    const QString relative = requestPath.mid(mount.prefix.size());
+    if (relative.contains(QChar(0)) || relative.contains('\\')) {
+        return QString();
+    }
+    
+    QString resolved = mount.root;
+    const QStringList segments = relative.split('/', Qt::SkipEmptyParts);
+    for (const QString &segment : segments) {
+        // Also refuses ".." and hidden files such as ".git" or ".env"
+        if (segment.startsWith('.')) {
+            return QString();
+        }
+        resolved += '/';
+        resolved += segment;
+    }
+    
+    return resolved;
+}
+
+qint64 StaticFiles::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
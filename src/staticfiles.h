@@ -0,0 +1,118 @@
+#ifndef STATICFILES_H
+#define STATICFILES_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHttpServerRequest>
+#include <QHttpServerResponder>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <utility>
+
+class QFile;
+
+/**
+ * @brief The StaticFiles class serves files below configured directories from memory-mapped files
+ * 
+ * Each file is opened and mapped once and kept in a bounded LRU cache of open files together
+ * with its metadata (size, modification time, ETag, content type and a precompressed ".gz"
+ * sibling). Cached entries are checked against the file system at most once per revalidation
+ * interval and reopened when the file has changed.
+ * 
+ * Responses are built from the mapping: bodies up to the stream threshold are copied into the
+ * response, and larger bodies are streamed from the mapping through a QIODevice that keeps it
+ * alive, so a large download is never held in a heap buffer. GET and HEAD requests are
+ * supported, with conditional requests (ETag and Last-Modified) and single byte ranges.
+ * 
+ * Files must be replaced (written elsewhere and renamed over the old one), not modified in
+ * place, because a mapped file that shrinks while it is being sent cannot be read.
+ */
+class StaticFiles
+{
+public:
+    struct Settings
+    {
+        int maxOpenFiles = 256;                   // Files kept open and mapped
+        int revalidateMs = 1000;                  // How long cached metadata is trusted; 0 checks every request
+        qint64 streamThresholdBytes = 256 * 1024; // Larger bodies are streamed, not copied
+        int maxAgeSeconds = 3600;                 // Cache-Control max-age sent to clients
+    };
+    
+    struct Mount
+    {
+        QString prefix;  // e.g. "/docs"
+        QString root;    // Canonical directory the prefix maps to
+        QString indexFile = QStringLiteral("index.html");  // Served for directory paths
+    };
+    
+    using HeaderList = QList<std::pair<QByteArray, QByteArray>>;
+    
+    explicit StaticFiles(const Settings &settings = Settings());
+    ~StaticFiles();
+    
+    /**
+     * @brief Replaces the settings and closes all cached files; must not be called while serving
+     */
+    void setSettings(const Settings &settings);
+    
+    /**
+     * @brief Answers a request for a path under the mount's prefix
+     * 
+     * Missing files and paths that leave the mount's root (".." segments, symbolic links
+     * or hidden files) are answered with a 404 problem detail.
+     * 
+     * @param extraHeaders Headers added to every response, e.g. security headers
+     * @return The status code sent
+     */
+    int serve(const Mount &mount, const QHttpServerRequest &request, QHttpServerResponder &responder,
+              const HeaderList &extraHeaders);
+    
+    int openCount() const;
+    quint64 hitCount() const;
+    quint64 missCount() const;
+
+private:
+    struct File
+    {
+        ~File();
+        
+        QString path;  // Canonical path
+        qint64 size = 0;
+        qint64 modifiedMs = 0;
+        QByteArray etag;
+        QByteArray lastModified;  // HTTP date
+        QByteArray mimeType;
+        std::unique_ptr<QFile> handle;  // Owns the mapping
+        const char *data = nullptr;  // Null for empty files
+        std::shared_ptr<const File> gzip;  // Precompressed sibling, if present and not older
+    };
+    
+    using FilePtr = std::shared_ptr<const File>;
+    
+    struct Node
+    {
+        QString key;
+        FilePtr file;
+        qint64 checkedAtMs = 0;
+    };
+    
+    Settings m_settings;
+    mutable QMutex m_mutex;
+    std::list<Node> m_lru;  // Most recently used first
+    QHash<QString, std::list<Node>::iterator> m_index;  // By requested path
+    std::atomic<quint64> m_hits{0};
+    std::atomic<quint64> m_misses{0};
+    
+    FilePtr lookup(const Mount &mount, const QString &path);
+    static FilePtr open(const Mount &mount, const QString &path);
+    static std::shared_ptr<File> map(const QString &canonicalPath, const QByteArray &mimeType);
+    static bool isCurrent(const Mount &mount, const File &file, const QString &path);
+    static QString resolve(const Mount &mount, const QString &requestPath);
+    static qint64 nowMs();
+};
+
+#endif // STATICFILES_H
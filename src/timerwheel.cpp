@@ -0,0 +1,70 @@
+#include "timerwheel.h"
+
+TimerWheel::TimerWheel(int slotCount, int tickMs)
+    : m_slots(qMax(1, slotCount), nullptr),
+      m_tickMs(qMax(1, tickMs)),
+      m_current(0),
+      m_size(0)
+{
+}
+
+void TimerWheel::schedule(Entry *entry, qint64 delayMs)
+{
+    cancel(entry);
+    
+    // Round up so an entry never expires before its delay has elapsed
+    const quint64 ticks = qMax<qint64>(1, (delayMs + m_tickMs - 1) / m_tickMs);
+    const int slotCount = m_slots.size();
+    
+    entry->slot = static_cast<int>((m_current + ticks) % slotCount);
+    entry->rounds = (ticks - 1) / slotCount;
+    entry->prev = nullptr;
+    entry->next = m_slots[entry->slot];
+    if (entry->next) {
+        entry->next->prev = entry;
+    }
+    m_slots[entry->slot] = entry;
+    ++m_size;
+}
+
+void TimerWheel::cancel(Entry *entry)
+{
+    if (!entry->isScheduled()) {
+        return;
+    }
+    
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        m_slots[entry->slot] = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+    
+    entry->prev = nullptr;
+    entry->next = nullptr;
+    entry->slot = -1;
+    --m_size;
+}
+
+QVector<TimerWheel::Entry *> TimerWheel::tick()
+{
+    QVector<Entry *> expired;
+    
+    m_current = (m_current + 1) % m_slots.size();
+    
+    Entry *entry = m_slots[m_current];
+    while (entry) {
+        Entry *next = entry->next;
+        if (entry->rounds > 0) {
+            --entry->rounds;
+        } else {
+            cancel(entry);
+            expired.append(entry);
+        }
+        entry = next;
+    }
+    
+    return expired;
+}
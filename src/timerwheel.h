@@ -0,0 +1,76 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QtGlobal>
+#include <QVector>
+
+/**
+ * @brief The TimerWheel class is a hashed timing wheel for large numbers of coarse timeouts
+ * 
+ * Timeouts are intrusive entries hashed into slots by their expiry tick, so scheduling,
+ * rescheduling and cancelling are O(1) and a single periodic tick drives all of them.
+ * This replaces one QTimer per object when thousands of objects need a deadline.
+ * 
+ * The wheel is not thread-safe; each thread that needs timeouts owns its own wheel.
+ */
+class TimerWheel
+{
+public:
+    /**
+     * @brief An intrusive timer entry; embed it in the object that needs a timeout
+     */
+    struct Entry
+    {
+        Entry *prev = nullptr;
+        Entry *next = nullptr;
+        int slot = -1;
+        quint64 rounds = 0;
+        
+        bool isScheduled() const { return slot >= 0; }
+    };
+    
+    /**
+     * @brief Constructs a timer wheel
+     * 
+     * @param slotCount Number of slots in the wheel
+     * @param tickMs Resolution of the wheel in milliseconds
+     */
+    TimerWheel(int slotCount, int tickMs);
+    
+    /**
+     * @brief Schedules (or reschedules) an entry to expire after the given delay
+     * 
+     * @param entry The entry to schedule
+     * @param delayMs Delay in milliseconds, rounded up to the wheel resolution
+     */
+    void schedule(Entry *entry, qint64 delayMs);
+    
+    /**
+     * @brief Removes an entry from the wheel if it is scheduled
+     * 
+     * @param entry The entry to cancel
+     */
+    void cancel(Entry *entry);
+    
+    /**
+     * @brief Advances the wheel by one tick and returns the entries that expired
+     * 
+     * Expired entries are unscheduled before they are returned, so callers may
+     * reschedule or destroy them freely.
+     * 
+     * @return The expired entries
+     */
+    QVector<Entry *> tick();
+    
+    int tickMs() const { return m_tickMs; }
+    bool isEmpty() const { return m_size == 0; }
+    int size() const { return m_size; }
+
+private:
+    QVector<Entry *> m_slots;
+    int m_tickMs;
+    int m_current;
+    int m_size;
+};
+
+#endif // TIMERWHEEL_H
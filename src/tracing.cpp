@@ -0,0 +1,487 @@
+#include "tracing.h"
+#include "metrics.h"
+#include "asciicopy.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace {
+// The exporter sends a batch at least this often, and as soon as this many spans are pending
+constexpr auto FlushInterval = std::chrono::milliseconds(1000);
+constexpr int MaxBatchSpans = 512;
+constexpr int ExportTimeoutMs = 2000;
+
+thread_local RequestTrace *s_currentTrace = nullptr;
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+template <int Size>
+bool parseHex(const char *text, quint8 (&bytes)[Size])
+{
+    quint8 any = 0;
+    for (int i = 0; i < Size; ++i) {
+        const int high = hexValue(text[2 * i]);
+        const int low = hexValue(text[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        bytes[i] = static_cast<quint8>((high << 4) | low);
+        any |= bytes[i];
+    }
+    // All-zero trace and span ids are invalid
+    return any != 0;
+}
+
+template <int Size>
+void appendHex(QByteArray &out, const quint8 (&bytes)[Size])
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < Size; ++i) {
+        out += digits[bytes[i] >> 4];
+        out += digits[bytes[i] & 0xf];
+    }
+}
+
+template <int Size>
+QString toHex(const quint8 (&bytes)[Size])
+{
+    QByteArray hex;
+    hex.reserve(Size * 2);
+    appendHex(hex, bytes);
+    return QString::fromLatin1(hex);
+}
+
+template <int Size>
+void randomId(quint8 (&bytes)[Size])
+{
+    // Trace and span ids only need to be unique, not unpredictable
+    thread_local std::mt19937_64 generator(QRandomGenerator::system()->generate64());
+    do {
+        for (int i = 0; i < Size; i += 8) {
+            const quint64 value = generator();
+            std::memcpy(bytes + i, &value, qMin(8, Size - i));
+        }
+    } while (std::all_of(bytes, bytes + Size, [](quint8 byte) { return byte == 0; }));
+}
+
+qint64 unixNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+QJsonObject stringAttribute(const QString &key, const QString &value)
+{
+    return QJsonObject{{"key", key}, {"value", QJsonObject{{"stringValue", value}}}};
+}
+}
+
+bool TraceContext::parse(const QByteArray &traceparent, TraceContext &context)
+{
+    // version "-" trace-id "-" parent-id "-" trace-flags; later versions may append fields
+    const QByteArray value = traceparent.trimmed();
+    if (value.size() < 55 || (value.size() > 55 && value[55] != '-')) {
+        return false;
+    }
+    
+    const char *text = value.constData();
+    if (text[2] != '-' || text[35] != '-' || text[52] != '-') {
+        return false;
+    }
+    
+    const int versionHigh = hexValue(text[0]);
+    const int versionLow = hexValue(text[1]);
+    if (versionHigh < 0 || versionLow < 0 || (versionHigh == 0xf && versionLow == 0xf)
+        || (versionHigh == 0 && versionLow == 0 && value.size() != 55)) {
+        return false;
+    }
+    
+    const int flagsHigh = hexValue(text[53]);
+    const int flagsLow = hexValue(text[54]);
+    TraceContext parsed;
+    if (flagsHigh < 0 || flagsLow < 0
+        || !parseHex(text + 3, parsed.traceId) || !parseHex(text + 36, parsed.parentSpanId)) {
+        return false;
+    }
+    
+    parsed.hasParent = true;
+    parsed.sampled = (flagsLow & 0x1) != 0;
+    // Until this server records its own span, downstream calls continue the caller's span
+    std::memcpy(parsed.spanId, parsed.parentSpanId, sizeof(parsed.spanId));
+    
+    context = parsed;
+    return true;
+}
+
+QByteArray TraceContext::traceparent() const
+{
+    QByteArray value;
+    value.reserve(55);
+    value += "00-";
+    appendHex(value, traceId);
+    value += '-';
+    appendHex(value, spanId);
+    value += sampled ? "-01" : "-00";
+    return value;
+}
+
+bool TraceContext::isValid() const
+{
+    return std::any_of(std::begin(traceId), std::end(traceId), [](quint8 byte) { return byte != 0; });
+}
+
+RequestTrace *RequestTrace::current()
+{
+    return s_currentTrace;
+}
+
+RequestTraceScope::RequestTraceScope(RequestTrace *trace)
+    : m_previous(s_currentTrace)
+{
+    s_currentTrace = trace;
+}
+
+RequestTraceScope::~RequestTraceScope()
+{
+    s_currentTrace = m_previous;
+}
+
+ScopedSpan::ScopedSpan(PipelineStage stage)
+    : m_trace(s_currentTrace),
+      m_stage(static_cast<int>(stage))
+{
+    if (m_trace && m_trace->context.sampled) {
+        m_trace->stageStartNs[m_stage] = m_trace->clock.nsecsElapsed();
+    }
+}
+
+ScopedSpan::~ScopedSpan()
+{
+    if (m_trace && m_trace->context.sampled) {
+        m_trace->stageEndNs[m_stage] = m_trace->clock.nsecsElapsed();
+    }
+}
+
+Tracer::Tracer() = default;
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start(const Settings &settings)
+{
+    if (m_running.load()) {
+        return;
+    }
+    
+    m_settings = settings;
+    
+    if (m_settings.exporter == Exporter::Otlp) {
+        if (m_settings.endpoint.scheme() != "http" || m_settings.endpoint.host().isEmpty()) {
+            std::fprintf(stderr, "Warning: Tracing disabled, the OTLP endpoint must be an http:// URL\n");
+            return;
+        }
+    } else {
+        auto file = std::make_unique<QFile>(m_settings.filePath);
+        if (m_settings.filePath.isEmpty() || !file->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+            std::fprintf(stderr, "Warning: Tracing disabled, failed to open span file %s\n", qPrintable(m_settings.filePath));
+            return;
+        }
+        m_file = std::move(file);
+    }
+    
+    Metrics::instance().addCounter("tracing_dropped_spans_total", "Spans dropped because a buffer was full or an export failed.", [this]() {
+        return droppedCount();
+    });
+    
+    m_running.store(true);
+    m_exporter = std::thread(&Tracer::run, this);
+}
+
+void Tracer::stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+    }
+    m_wake.notify_all();
+    m_exporter.join();
+    
+    Metrics::instance().removeCounter("tracing_dropped_spans_total");
+    m_file.reset();
+}
+
+bool Tracer::isEnabled() const
+{
+    return m_running.load(std::memory_order_relaxed);
+}
+
+void Tracer::begin(const QByteArray &traceparent, RequestTrace &trace)
+{
+    if (!m_running.load(std::memory_order_relaxed)) {
+        return;
+    }
+    
+    // A caller's traceparent decides sampling; otherwise sample 1 in sampleRate requests
+    if (!TraceContext::parse(traceparent, trace.context) && m_settings.sampleRate > 0) {
+        thread_local quint64 requestCount = 0;
+        if (requestCount++ % static_cast<quint64>(m_settings.sampleRate) == 0) {
+            randomId(trace.context.traceId);
+            trace.context.sampled = true;
+        }
+    }
+    
+    if (!trace.context.sampled) {
+        return;
+    }
+    
+    randomId(trace.context.spanId);
+    trace.startUnixNs = unixNanoseconds();
+    trace.clock.start();
+    std::fill(std::begin(trace.stageStartNs), std::end(trace.stageStartNs), -1);
+    std::fill(std::begin(trace.stageEndNs), std::end(trace.stageEndNs), -1);
+}
+
+void Tracer::finish(const RequestTrace &trace, const char *method, const QString &path, int statusCode)
+{
+    if (!trace.context.sampled || !m_running.load(std::memory_order_relaxed)) {
+        return;
+    }
+    
+    const qint64 elapsedNs = trace.clock.nsecsElapsed();
+    
+    SpanRecord span;
+    std::memcpy(span.traceId, trace.context.traceId, sizeof(span.traceId));
+    std::memcpy(span.spanId, trace.context.spanId, sizeof(span.spanId));
+    std::memcpy(span.parentSpanId, trace.context.parentSpanId, sizeof(span.parentSpanId));
+    span.startUnixNs = trace.startUnixNs;
+    span.endUnixNs = trace.startUnixNs + elapsedNs;
+    span.statusCode = static_cast<quint16>(statusCode);
+    span.stage = ServerSpan;
+    span.hasParent = trace.context.hasParent;
+    std::strncpy(span.method, method, sizeof(span.method) - 1);
+    span.method[sizeof(span.method) - 1] = '\0';
+    copyAscii(span.path, path);
+    push(span);
+    
+    // Stage spans are children of the server span
+    std::memcpy(span.parentSpanId, trace.context.spanId, sizeof(span.parentSpanId));
+    span.hasParent = true;
+    for (int stage = 0; stage < static_cast<int>(PipelineStage::Count); ++stage) {
+        if (trace.stageStartNs[stage] < 0 || trace.stageEndNs[stage] < 0) {
+            continue;
+        }
+        randomId(span.spanId);
+        span.startUnixNs = trace.startUnixNs + trace.stageStartNs[stage];
+        span.endUnixNs = trace.startUnixNs + trace.stageEndNs[stage];
+        span.stage = static_cast<quint8>(stage);
+        push(span);
+    }
+}
+
+quint64 Tracer::droppedCount() const
+{
+    QMutexLocker locker(&m_ringsMutex);
+    
+    quint64 dropped = m_exportFailures.load(std::memory_order_relaxed);
+    for (const ThreadRing *threadRing : m_rings) {
+        dropped += threadRing->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+Tracer::ThreadRing &Tracer::localRing()
+{
+    // One ring per producing thread; rings live as long as the process
+    thread_local ThreadRing *threadRing = nullptr;
+    
+    if (!threadRing) {
+        threadRing = new ThreadRing();
+        
+        QMutexLocker locker(&m_ringsMutex);
+        m_rings.append(threadRing);
+    }
+    
+    return *threadRing;
+}
+
+void Tracer::push(const SpanRecord &span)
+{
+    ThreadRing &threadRing = localRing();
+    
+    if (!threadRing.ring.tryPush(span)) {
+        threadRing.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Tracer::run()
+{
+    QByteArray spans;
+    
+    while (m_running.load()) {
+        // Keep exporting full batches while the producers are ahead
+        int count = 0;
+        do {
+            count = drain(spans);
+            exportBatch(spans, count);
+            spans.clear();
+        } while (count == MaxBatchSpans);
+        
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait_for(lock, FlushInterval, [this]() {
+            return !m_running.load();
+        });
+    }
+    
+    // Export whatever is left on shutdown
+    int count = 0;
+    do {
+        count = drain(spans);
+        exportBatch(spans, count);
+        spans.clear();
+    } while (count == MaxBatchSpans);
+}
+
+int Tracer::drain(QByteArray &spans)
+{
+    QMutexLocker locker(&m_ringsMutex);
+    const QList<ThreadRing *> rings = m_rings;
+    locker.unlock();
+    
+    int count = 0;
+    SpanRecord span;
+    for (ThreadRing *threadRing : rings) {
+        while (count < MaxBatchSpans && threadRing->ring.tryPop(span)) {
+            if (count > 0) {
+                spans += ',';
+            }
+            appendSpan(span, spans);
+            ++count;
+        }
+    }
+    
+    return count;
+}
+
+void Tracer::appendSpan(const SpanRecord &span, QByteArray &out) const
+{
+    // OTLP/JSON span; ids are hex strings and timestamps are decimal strings
+    QJsonObject object;
+    object["traceId"] = toHex(span.traceId);
+    object["spanId"] = toHex(span.spanId);
+    if (span.hasParent) {
+        object["parentSpanId"] = toHex(span.parentSpanId);
+    }
+    object["startTimeUnixNano"] = QString::number(span.startUnixNs);
+    object["endTimeUnixNano"] = QString::number(span.endUnixNs);
+    
+    if (span.stage == ServerSpan) {
+        object["name"] = QString("%1 %2").arg(QLatin1String(span.method), QLatin1String(span.path));
+        object["kind"] = 2;  // SPAN_KIND_SERVER
+        object["attributes"] = QJsonArray{
+            stringAttribute("http.request.method", QLatin1String(span.method)),
+            stringAttribute("url.path", QLatin1String(span.path)),
+            QJsonObject{{"key", "http.response.status_code"},
+                        {"value", QJsonObject{{"intValue", QString::number(span.statusCode)}}}}
+        };
+        if (span.statusCode >= 500) {
+            object["status"] = QJsonObject{{"code", 2}};  // STATUS_CODE_ERROR
+        }
+    } else {
+        object["name"] = QLatin1String(pipelineStageName(static_cast<PipelineStage>(span.stage)));
+        object["kind"] = 1;  // SPAN_KIND_INTERNAL
+    }
+    
+    out += QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+void Tracer::exportBatch(const QByteArray &spans, int count)
+{
+    if (count == 0) {
+        return;
+    }
+    
+    // One ExportTraceServiceRequest per batch
+    QByteArray body;
+    body.reserve(spans.size() + 256);
+    body += "{\"resourceSpans\":[{\"resource\":{\"attributes\":[";
+    body += QJsonDocument(stringAttribute("service.name", m_settings.serviceName)).toJson(QJsonDocument::Compact);
+    body += "]},\"scopeSpans\":[{\"scope\":{\"name\":\"qt6-web-api\"},\"spans\":[";
+    body += spans;
+    body += "]}]}]}";
+    
+    if (m_file) {
+        body += '\n';
+        if (m_file->write(body) != body.size()) {
+            m_exportFailures.fetch_add(static_cast<quint64>(count), std::memory_order_relaxed);
+        }
+    } else if (!postBatch(body)) {
+        m_exportFailures.fetch_add(static_cast<quint64>(count), std::memory_order_relaxed);
+    }
+}
+
+bool Tracer::postBatch(const QByteArray &body)
+{
+    // A blocking socket is fine here: the exporter thread does nothing else
+    const QUrl &endpoint = m_settings.endpoint;
+    const int port = endpoint.port(4318);
+    
+    QTcpSocket socket;
+    socket.connectToHost(endpoint.host(), static_cast<quint16>(port));
+    if (!socket.waitForConnected(ExportTimeoutMs)) {
+        return false;
+    }
+    
+    QByteArray path = endpoint.path(QUrl::FullyEncoded).toLatin1();
+    if (path.isEmpty()) {
+        path = "/v1/traces";
+    }
+    
+    QByteArray request;
+    request += "POST " + path + " HTTP/1.1\r\n";
+    request += "Host: " + endpoint.host().toLatin1() + ':' + QByteArray::number(port) + "\r\n";
+    request += "Content-Type: application/json\r\n";
+    request += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    request += "Connection: close\r\n\r\n";
+    request += body;
+    
+    socket.write(request);
+    while (socket.bytesToWrite() > 0) {
+        if (!socket.waitForBytesWritten(ExportTimeoutMs)) {
+            return false;
+        }
+    }
+    
+    // Only the status line matters: "HTTP/1.1 2xx ..."
+    while (!socket.canReadLine()) {
+        if (!socket.waitForReadyRead(ExportTimeoutMs)) {
+            return false;
+        }
+    }
+    const QByteArray statusLine = socket.readLine();
+    const int space = statusLine.indexOf(' ');
+    return space > 0 && statusLine.mid(space + 1, 1) == "2";
+}
@@ -0,0 +1,195 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QUrl>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "spscring.h"
+#include "stagetimer.h"
+
+/**
+ * @brief The TraceContext struct holds W3C trace context (traceparent) for one request
+ */
+struct TraceContext
+{
+    quint8 traceId[16] = {};
+    quint8 spanId[8] = {};        // This server's span, sent downstream as the parent
+    quint8 parentSpanId[8] = {};  // The caller's span, if the request carried a traceparent
+    bool hasParent = false;
+    bool sampled = false;
+    
+    /**
+     * @brief Parses a traceparent header value ("00-<trace-id>-<parent-id>-<flags>")
+     * 
+     * @return false if the value is missing or malformed, leaving the context untouched
+     */
+    static bool parse(const QByteArray &traceparent, TraceContext &context);
+    
+    /**
+     * @brief Returns the traceparent value to send with outgoing requests made for this request
+     */
+    QByteArray traceparent() const;
+    
+    bool isValid() const;
+};
+
+/**
+ * @brief The RequestTrace struct collects the spans of one request while it is being handled
+ */
+struct RequestTrace
+{
+    TraceContext context;
+    qint64 startUnixNs = 0;
+    QElapsedTimer clock;  // Started only for sampled requests
+    qint64 stageStartNs[static_cast<int>(PipelineStage::Count)];
+    qint64 stageEndNs[static_cast<int>(PipelineStage::Count)];
+    
+    /**
+     * @brief Returns the trace of the request being handled on this thread, if any
+     */
+    static RequestTrace *current();
+};
+
+/**
+ * @brief The RequestTraceScope class makes a RequestTrace the current one for its lifetime
+ */
+class RequestTraceScope
+{
+public:
+    explicit RequestTraceScope(RequestTrace *trace);
+    ~RequestTraceScope();
+
+private:
+    RequestTrace *m_previous;
+};
+
+/**
+ * @brief The ScopedSpan class records its scope as a pipeline stage span of the current request
+ * 
+ * Does nothing unless the current request is sampled.
+ */
+class ScopedSpan
+{
+public:
+    explicit ScopedSpan(PipelineStage stage);
+    ~ScopedSpan();
+
+private:
+    RequestTrace *m_trace;
+    int m_stage;
+};
+
+/**
+ * @brief The Tracer class samples requests and exports their spans asynchronously
+ * 
+ * Sampling is decided at the head of the request: a request carrying a traceparent follows
+ * the caller's sampled flag, any other request is sampled at the configured rate. Spans of
+ * sampled requests are copied into per-thread ring buffers and exported in batches by a
+ * background thread, as OTLP/JSON lines to a file or by POST to an OTLP/HTTP collector.
+ */
+class Tracer
+{
+public:
+    enum class Exporter {
+        File,
+        Otlp
+    };
+    
+    struct Settings
+    {
+        int sampleRate = 0;  // Sample 1 in N requests without a traceparent; 0 samples none
+        Exporter exporter = Exporter::File;
+        QString filePath;
+        QUrl endpoint;       // OTLP/HTTP traces endpoint, plain http only
+        QString serviceName = "qt6-web-api";
+    };
+    
+    /**
+     * @brief Returns the process-wide tracer
+     */
+    static Tracer &instance();
+    
+    /**
+     * @brief Starts the exporter thread; until then no request is traced
+     */
+    void start(const Settings &settings);
+    
+    /**
+     * @brief Exports all pending spans and stops the exporter thread
+     */
+    void stop();
+    
+    bool isEnabled() const;
+    
+    /**
+     * @brief Starts tracing a request from its traceparent header value
+     */
+    void begin(const QByteArray &traceparent, RequestTrace &trace);
+    
+    /**
+     * @brief Records the server span and stage spans of a sampled request
+     */
+    void finish(const RequestTrace &trace, const char *method, const QString &path, int statusCode);
+    
+    /**
+     * @brief Returns the number of spans dropped because a buffer was full or an export failed
+     */
+    quint64 droppedCount() const;
+
+private:
+    static constexpr quint8 ServerSpan = 0xff;
+    
+    // Fixed-size span copied into the ring buffers
+    struct SpanRecord
+    {
+        quint8 traceId[16];
+        quint8 spanId[8];
+        quint8 parentSpanId[8];
+        qint64 startUnixNs;
+        qint64 endUnixNs;
+        quint16 statusCode;
+        quint8 stage;  // PipelineStage, or ServerSpan
+        bool hasParent;
+        char method[8];
+        char path[96];
+    };
+    
+    static constexpr int RingCapacity = 2048;
+    using Ring = SpscRing<SpanRecord, RingCapacity>;
+    
+    struct ThreadRing
+    {
+        Ring ring;
+        std::atomic<quint64> dropped{0};
+    };
+    
+    Settings m_settings;
+    std::atomic<bool> m_running{false};
+    std::atomic<quint64> m_exportFailures{0};
+    mutable QMutex m_ringsMutex;  // Guards ring registration only
+    QList<ThreadRing *> m_rings;
+    std::thread m_exporter;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::unique_ptr<QFile> m_file;
+    
+    Tracer();
+    ThreadRing &localRing();
+    void push(const SpanRecord &span);
+    void run();
+    int drain(QByteArray &spans);
+    void appendSpan(const SpanRecord &span, QByteArray &out) const;
+    void exportBatch(const QByteArray &spans, int count);
+    bool postBatch(const QByteArray &body);
+};
+
+#endif // TRACING_H
@@ -0,0 +1,388 @@
+#include "unixsocketlistener.h"
+#include <QFile>
+#include <QLocalSocket>
+#include <QTimer>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// Longest version 1 header, including the trailing CRLF
+constexpr qsizetype MaxProxyV1HeaderBytes = 107;
+
+// Fixed part of a version 2 header: signature, version and command, family, address length
+constexpr qsizetype ProxyV2PrefixBytes = 16;
+
+const QByteArray ProxyV1Signature = QByteArrayLiteral("PROXY ");
+const QByteArray ProxyV2Signature = QByteArray("\r\n\r\n\0\r\nQUIT\n", 12);
+
+// Client address of the connection whose requests are being dispatched on this thread; only
+// set for the duration of that connection's readyRead handlers
+thread_local QHostAddress s_currentClientAddress;
+
+bool isPrefixOf(QByteArrayView data, const QByteArray &signature)
+{
+    const qsizetype size = std::min(data.size(), signature.size());
+    return std::memcmp(data.data(), signature.constData(), static_cast<size_t>(size)) == 0;
+}
+}
+
+UnixSocketListener::UnixSocketListener(const Settings &settings, QObject *parent)
+    : QLocalServer(parent),
+      m_settings(settings)
+{
+}
+
+UnixSocketListener::~UnixSocketListener()
+{
+    // The connections are our children and are destroyed after our members
+    for (auto it = m_connections.constBegin(); it != m_connections.constEnd(); ++it) {
+        it.key()->disconnect(this);
+    }
+    
+    stop();
+}
+
+bool UnixSocketListener::listenAt(const QString &path, int permissions)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray target = QFile::encodeName(path);
+    const QByteArray temporary = target + ".tmp" + QByteArray::number(static_cast<qint64>(::getpid()));
+    
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (static_cast<size_t>(temporary.size()) >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, temporary.constData(), static_cast<size_t>(temporary.size()));
+    
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    
+    // Permissions are set before the file appears at its final path
+    ::unlink(temporary.constData());
+    if (::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0
+        || ::chmod(temporary.constData(), static_cast<mode_t>(permissions)) != 0
+        || ::listen(fd, SOMAXCONN) != 0
+        || ::rename(temporary.constData(), target.constData()) != 0) {
+        ::close(fd);
+        ::unlink(temporary.constData());
+        return false;
+    }
+    
+    if (!QLocalServer::listen(static_cast<qintptr>(fd))) {
+        ::close(fd);
+        ::unlink(target.constData());
+        return false;
+    }
+    
+    m_path = path;
+    m_fileId = fileId(target);
+    return true;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(permissions);
+    return false;
+#endif
+}
+
+void UnixSocketListener::stop()
+{
+    close();
+
+#ifdef Q_OS_UNIX
+    // A restarted instance may already have renamed its own socket over the path
+    if (!m_fileId.isEmpty()) {
+        const QByteArray target = QFile::encodeName(m_path);
+        if (fileId(target) == m_fileId) {
+            ::unlink(target.constData());
+        }
+        m_fileId.clear();
+    }
+#endif
+}
+
+void UnixSocketListener::startDraining()
+{
+    m_draining = true;
+    
+    // Collect first: closing a socket may untrack it synchronously
+    QList<QLocalSocket *> idleSockets;
+    for (auto it = m_connections.constBegin(); it != m_connections.constEnd(); ++it) {
+        if (!it.value()) {
+            idleSockets.append(it.key());
+        }
+    }
+    
+    for (QLocalSocket *socket : std::as_const(idleSockets)) {
+        socket->disconnectFromServer();
+    }
+    
+    if (m_activeRequests == 0) {
+        emit drained();
+    }
+}
+
+QString UnixSocketListener::path() const
+{
+    return m_path;
+}
+
+int UnixSocketListener::connectionCount() const
+{
+    return static_cast<int>(m_connections.size());
+}
+
+int UnixSocketListener::activeRequestCount() const
+{
+    return m_activeRequests;
+}
+
+quint64 UnixSocketListener::proxyHeaderErrorCount() const
+{
+    return m_proxyHeaderErrors;
+}
+
+QHostAddress UnixSocketListener::currentClientAddress()
+{
+    return s_currentClientAddress;
+}
+
+UnixSocketListener::ProxyHeaderStatus UnixSocketListener::parseProxyHeader(QByteArrayView data, qsizetype *consumed,
+                                                                           QHostAddress *source)
+{
+    if (data.isEmpty()) {
+        return ProxyHeaderStatus::Incomplete;
+    }
+    
+    // Version 2: binary, "\r\n\r\n\0\r\nQUIT\n" followed by the addresses
+    if (isPrefixOf(data, ProxyV2Signature)) {
+        if (data.size() < ProxyV2PrefixBytes) {
+            return ProxyHeaderStatus::Incomplete;
+        }
+        
+        const quint8 versionCommand = static_cast<quint8>(data[12]);
+        const quint8 family = static_cast<quint8>(data[13]) >> 4;
+        const qsizetype length = (static_cast<quint8>(data[14]) << 8) | static_cast<quint8>(data[15]);
+        if ((versionCommand >> 4) != 0x2 || (versionCommand & 0x0F) > 0x1) {
+            return ProxyHeaderStatus::Invalid;
+        }
+        if (data.size() < ProxyV2PrefixBytes + length) {
+            return ProxyHeaderStatus::Incomplete;
+        }
+        
+        const bool local = (versionCommand & 0x0F) == 0x0;  // Health checks from the proxy itself
+        const auto *addresses = reinterpret_cast<const quint8 *>(data.data() + ProxyV2PrefixBytes);
+        if (!local && family == 0x1) {
+            if (length < 12) {
+                return ProxyHeaderStatus::Invalid;
+            }
+            source->setAddress((quint32(addresses[0]) << 24) | (quint32(addresses[1]) << 16)
+                               | (quint32(addresses[2]) << 8) | quint32(addresses[3]));
+        } else if (!local && family == 0x2) {
+            if (length < 36) {
+                return ProxyHeaderStatus::Invalid;
+            }
+            source->setAddress(addresses);
+        }
+        
+        *consumed = ProxyV2PrefixBytes + length;
+        return ProxyHeaderStatus::Parsed;
+    }
+    
+    // Version 1: "PROXY TCP4 <source> <destination> <source port> <destination port>\r\n"
+    if (!isPrefixOf(data, ProxyV1Signature)) {
+        return ProxyHeaderStatus::Invalid;
+    }
+    
+    const qsizetype end = data.first(std::min(data.size(), MaxProxyV1HeaderBytes)).indexOf(QByteArrayView("\r\n"));
+    if (end < 0) {
+        return data.size() < MaxProxyV1HeaderBytes ? ProxyHeaderStatus::Incomplete : ProxyHeaderStatus::Invalid;
+    }
+    
+    const QList<QByteArray> fields = data.first(end).toByteArray().split(' ');
+    if (fields.size() >= 2 && fields[1] == "UNKNOWN") {
+        *consumed = end + 2;
+        return ProxyHeaderStatus::Parsed;
+    }
+    
+    const QHostAddress::NetworkLayerProtocol protocol = fields.size() == 6 && fields[1] == "TCP4" ? QHostAddress::IPv4Protocol
+                                                       : fields.size() == 6 && fields[1] == "TCP6" ? QHostAddress::IPv6Protocol
+                                                       : QHostAddress::UnknownNetworkLayerProtocol;
+    QHostAddress address;
+    if (protocol == QHostAddress::UnknownNetworkLayerProtocol || !address.setAddress(QString::fromLatin1(fields[2]))
+        || address.protocol() != protocol) {
+        return ProxyHeaderStatus::Invalid;
+    }
+    
+    *source = address;
+    *consumed = end + 2;
+    return ProxyHeaderStatus::Parsed;
+}
+
+bool UnixSocketListener::hasPendingConnections() const
+{
+    return !m_pending.isEmpty();
+}
+
+QLocalSocket *UnixSocketListener::nextPendingConnection()
+{
+    return m_pending.isEmpty() ? nullptr : m_pending.takeFirst();
+}
+
+void UnixSocketListener::incomingConnection(quintptr socketDescriptor)
+{
+    auto *socket = new QLocalSocket(this);
+    if (!socket->setSocketDescriptor(static_cast<qintptr>(socketDescriptor))) {
+        delete socket;
+#ifdef Q_OS_UNIX
+        ::close(static_cast<int>(socketDescriptor));
+#endif
+        return;
+    }
+    
+    if (!m_settings.proxyProtocol) {
+        enqueue(socket, QHostAddress());
+        return;
+    }
+    
+    // The connection is only handed to the HTTP server once its header has been read
+    auto *timeout = new QTimer(socket);
+    timeout->setSingleShot(true);
+    connect(timeout, &QTimer::timeout, this, [this, socket]() {
+        ++m_proxyHeaderErrors;
+        socket->abort();
+        socket->deleteLater();
+    });
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket, timeout]() {
+        readProxyHeader(socket, timeout);
+    });
+    connect(socket, &QLocalSocket::disconnected, this, [socket]() {
+        socket->deleteLater();
+    });
+    timeout->start(m_settings.headerTimeoutMs);
+}
+
+void UnixSocketListener::readProxyHeader(QLocalSocket *socket, QTimer *timeout)
+{
+    // Peeked, so the request bytes after the header stay in the socket for the HTTP server
+    const QByteArray data = socket->peek(socket->bytesAvailable());
+    
+    qsizetype consumed = 0;
+    QHostAddress clientAddress;
+    switch (parseProxyHeader(data, &consumed, &clientAddress)) {
+    case ProxyHeaderStatus::Incomplete:
+        return;
+    case ProxyHeaderStatus::Invalid:
+        ++m_proxyHeaderErrors;
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+        return;
+    case ProxyHeaderStatus::Parsed:
+        break;
+    }
+    
+    socket->skip(consumed);
+    delete timeout;
+    enqueue(socket, clientAddress);
+}
+
+void UnixSocketListener::enqueue(QLocalSocket *socket, const QHostAddress &clientAddress)
+{
+    socket->disconnect(this);
+    
+    m_connections.insert(socket, false);
+    connect(socket, &QObject::destroyed, this, [this, socket]() {
+        untrack(socket);
+    });
+    
+    // Once the response is fully flushed the connection is an idle keep-alive connection
+    connect(socket, &QLocalSocket::bytesWritten, this, [this, socket]() {
+        if (socket->bytesToWrite() == 0) {
+            setRequestInProgress(socket, false);
+        }
+    });
+    
+    // Connected before the HTTP server connects its own handler, so it runs first
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket, clientAddress]() {
+        setRequestInProgress(socket, true);
+        s_currentClientAddress = clientAddress;
+    });
+    
+    m_pending.append(socket);
+    s_currentClientAddress = clientAddress;
+    emit newConnection();
+    s_currentClientAddress = QHostAddress();
+    
+    // Connected after the HTTP server's handler, so the address never leaks to code that runs
+    // outside this connection's dispatch, such as another connection's deferred response
+    connect(socket, &QLocalSocket::readyRead, this, []() {
+        s_currentClientAddress = QHostAddress();
+    });
+    
+    // Request bytes that arrived together with the PROXY protocol header are already buffered
+    if (socket->bytesAvailable() > 0) {
+        QMetaObject::invokeMethod(socket, &QLocalSocket::readyRead, Qt::QueuedConnection);
+    }
+}
+
+void UnixSocketListener::setRequestInProgress(QLocalSocket *socket, bool inProgress)
+{
+    auto it = m_connections.find(socket);
+    if (it == m_connections.end() || it.value() == inProgress) {
+        return;
+    }
+    
+    it.value() = inProgress;
+    m_activeRequests += inProgress ? 1 : -1;
+    
+    if (!inProgress && m_draining) {
+        // No keep-alive while draining: the response has been sent, close the connection
+        socket->disconnectFromServer();
+        if (m_activeRequests == 0) {
+            emit drained();
+        }
+    }
+}
+
+void UnixSocketListener::untrack(QLocalSocket *socket)
+{
+    const auto it = m_connections.constFind(socket);
+    if (it == m_connections.constEnd()) {
+        return;
+    }
+    
+    const bool inProgress = it.value();
+    m_connections.erase(it);
+    
+    if (inProgress && --m_activeRequests == 0 && m_draining) {
+        emit drained();
+    }
+}
+
+QByteArray UnixSocketListener::fileId(const QByteArray &path)
+{
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (::stat(path.constData(), &info) == 0) {
+        return QByteArray::number(static_cast<qulonglong>(info.st_dev)) + ':'
+            + QByteArray::number(static_cast<qulonglong>(info.st_ino));
+    }
+#else
+    Q_UNUSED(path);
+#endif
+    return QByteArray();
+}
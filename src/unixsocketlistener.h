@@ -0,0 +1,129 @@
+#ifndef UNIXSOCKETLISTENER_H
+#define UNIXSOCKETLISTENER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QLocalServer>
+#include <QString>
+
+class QLocalSocket;
+class QTimer;
+
+/**
+ * @brief The UnixSocketListener class accepts HTTP connections on a Unix domain socket, for a
+ * reverse proxy or sidecar running on the same host
+ * 
+ * The socket file is bound under a temporary name, given its permissions and then renamed
+ * over the configured path. Connecting clients therefore never see a socket with the wrong
+ * permissions, and a restarted instance replaces the file atomically while the old one
+ * finishes its connections. On close the file is only removed if it is still this listener's.
+ * 
+ * With the PROXY protocol enabled, every connection must start with a PROXY protocol header
+ * (version 1 or 2) carrying the address of the client the proxy is forwarding for. The
+ * header is consumed before the connection is handed to the HTTP server, and connections
+ * without a valid header within the timeout are closed.
+ * 
+ * Like ConnectionManager for TCP, the listener counts the connections with a request in
+ * progress, so that a drain can wait for them.
+ * 
+ * A UnixSocketListener and its connections must live in the same thread.
+ */
+class UnixSocketListener : public QLocalServer
+{
+    Q_OBJECT
+
+public:
+    struct Settings
+    {
+        bool proxyProtocol = false;
+        int headerTimeoutMs = 5000;  // Time allowed for the PROXY protocol header
+    };
+    
+    enum class ProxyHeaderStatus {
+        Incomplete,  // More bytes are needed
+        Parsed,
+        Invalid
+    };
+    
+    explicit UnixSocketListener(const Settings &settings, QObject *parent = nullptr);
+    ~UnixSocketListener();
+    
+    /**
+     * @brief Listens on a socket file, replacing any file already at the path
+     * 
+     * @param path The socket file path
+     * @param permissions The file mode bits of the socket, e.g. 0660; clients need write permission to connect
+     */
+    bool listenAt(const QString &path, int permissions);
+    
+    /**
+     * @brief Stops accepting connections and removes the socket file unless another process replaced it
+     */
+    void stop();
+    
+    /**
+     * @brief Enters drain mode
+     * 
+     * Idle connections are closed immediately and every other connection is closed
+     * as soon as its current response has been flushed. drained() is emitted once
+     * no request is in progress.
+     */
+    void startDraining();
+    
+    QString path() const;
+    int connectionCount() const;
+    int activeRequestCount() const;
+    quint64 proxyHeaderErrorCount() const;
+    
+    /**
+     * @brief Returns the client address received in the PROXY protocol header of the connection
+     * whose data the calling thread is processing, or a null address if there is none
+     * 
+     * The HTTP server parses and handles requests inside the readyRead handler of their
+     * connection. The listener sets the address in a handler connected before the server's and
+     * clears it in one connected after, so route handlers see the address of the connection
+     * their request arrived on, and code running outside a dispatch sees a null address.
+     */
+    static QHostAddress currentClientAddress();
+    
+    /**
+     * @brief Parses a PROXY protocol header (version 1 or 2) at the start of data
+     * 
+     * @param consumed Receives the size of the header when it was parsed
+     * @param source Receives the client address; stays null for LOCAL/UNKNOWN connections
+     */
+    static ProxyHeaderStatus parseProxyHeader(QByteArrayView data, qsizetype *consumed, QHostAddress *source);
+    
+    bool hasPendingConnections() const override;
+    QLocalSocket *nextPendingConnection() override;
+
+signals:
+    /**
+     * @brief Emitted in drain mode once no request is in progress
+     */
+    void drained();
+
+protected:
+    void incomingConnection(quintptr socketDescriptor) override;
+
+private:
+    Settings m_settings;
+    QString m_path;
+    QByteArray m_fileId;  // Device and inode of the socket file this listener created
+    QList<QLocalSocket *> m_pending;  // Ready for the HTTP server
+    QHash<QLocalSocket *, bool> m_connections;  // Handed to the HTTP server; true while a request is in progress
+    int m_activeRequests = 0;
+    bool m_draining = false;
+    quint64 m_proxyHeaderErrors = 0;
+    
+    void readProxyHeader(QLocalSocket *socket, QTimer *timeout);
+    void enqueue(QLocalSocket *socket, const QHostAddress &clientAddress);
+    void setRequestInProgress(QLocalSocket *socket, bool inProgress);
+    void untrack(QLocalSocket *socket);
+    static QByteArray fileId(const QByteArray &path);
+};
+
+#endif // UNIXSOCKETLISTENER_H
@@ -0,0 +1,648 @@
+#include "websockethub.h"
+#include "connectionmanager.h"
+#include "problemdetail.h"
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <chrono>
+#include <utility>
+
+namespace {
+constexpr qsizetype MaxHandshakeBytes = 8192;
+constexpr qsizetype MaxTopicLength = 128;
+
+// Appended to the client's key to compute Sec-WebSocket-Accept (RFC 6455, section 1.3)
+const QByteArray HandshakeGuid = QByteArrayLiteral("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+
+enum Opcode : quint8 {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA
+};
+
+// Close status codes (RFC 6455, section 7.4.1)
+constexpr quint16 CloseNormal = 1000;
+constexpr quint16 CloseProtocolError = 1002;
+constexpr quint16 CloseUnsupportedData = 1003;
+constexpr quint16 CloseMessageTooBig = 1009;
+
+qint64 nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *reasonPhrase(int statusCode)
+{
+    switch (statusCode) {
+    case 400:
+        return "Bad Request";
+    case 401:
+        return "Unauthorized";
+    case 403:
+        return "Forbidden";
+    case 404:
+        return "Not Found";
+    case 426:
+        return "Upgrade Required";
+    case 429:
+        return "Too Many Requests";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Error";
+    }
+}
+
+// True if a comma-separated header value lists the token, ignoring case
+bool containsToken(const QByteArray &value, const QByteArray &token)
+{
+    for (const QByteArray &item : value.split(',')) {
+        if (item.trimmed().compare(token, Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+WebSocketHub::WebSocketHub(QObject *parent)
+    : QObject(parent),
+      m_pingTimer(new QTimer(this))
+{
+    connect(m_pingTimer, &QTimer::timeout, this, &WebSocketHub::ping);
+    setSettings(Settings());
+}
+
+WebSocketHub::~WebSocketHub()
+{
+    for (Connection *connection : std::as_const(m_connections)) {
+        connection->socket->disconnect(this);
+        delete connection->socket;
+        delete connection;
+    }
+}
+
+void WebSocketHub::setSettings(const Settings &settings)
+{
+    m_settings = settings;
+    if (m_settings.pingIntervalMs > 0) {
+        m_pingTimer->start(m_settings.pingIntervalMs);
+    } else {
+        m_pingTimer->stop();
+    }
+}
+
+void WebSocketHub::setAdmission(const Admission &admission)
+{
+    m_admission = admission;
+}
+
+void WebSocketHub::attach(QTcpServer *listener)
+{
+    listener->setParent(this);
+    m_listeners.append(listener);
+    
+    // QSslServer only announces a connection once its TLS handshake has completed
+    connect(listener, &QTcpServer::pendingConnectionAvailable, this, [this, listener]() {
+        accept(listener);
+    });
+}
+
+void WebSocketHub::stopAccepting()
+{
+    for (QTcpServer *listener : std::as_const(m_listeners)) {
+        listener->close();
+    }
+}
+
+void WebSocketHub::closeAll(quint16 closeCode)
+{
+    for (Connection *connection : std::as_const(m_connections)) {
+        if (connection->open) {
+            close(connection, closeCode);
+        }
+    }
+}
+
+int WebSocketHub::publish(const QString &topic, const QByteArray &payload, bool binary)
+{
+    const auto subscribers = m_subscribers.constFind(topic);
+    if (subscribers == m_subscribers.constEnd()) {
+        return 0;
+    }
+    
+    // Encoded once; every socket queues the same implicitly shared buffer
+    const QByteArray frame = encodeFrame(binary ? Binary : Text, payload);
+    
+    int delivered = 0;
+    QList<Connection *> slowConsumers;
+    for (Connection *connection : subscribers.value()) {
+        if (connection->closing) {
+            continue;
+        }
+        
+        if (connection->socket->bytesToWrite() + frame.size() > m_settings.maxQueueBytes) {
+            ++m_dropped;
+            if (m_settings.slowConsumerPolicy == SlowConsumerPolicy::Disconnect) {
+                slowConsumers.append(connection);
+            }
+            continue;
+        }
+        
+        connection->socket->write(frame);
+        ++delivered;
+    }
+    
+    // Disconnected after the loop, so the subscriber list is not changed while it is iterated
+    for (Connection *connection : std::as_const(slowConsumers)) {
+        ++m_slowDisconnects;
+        abort(connection);
+    }
+    
+    ++m_published;
+    m_delivered += static_cast<quint64>(delivered);
+    return delivered;
+}
+
+QByteArray WebSocketHub::encodeFrame(quint8 opcode, QByteArrayView payload)
+{
+    const quint64 size = static_cast<quint64>(payload.size());
+    
+    QByteArray frame;
+    frame.reserve(payload.size() + 10);
+    frame.append(static_cast<char>(0x80 | opcode));  // FIN: never fragmented
+    if (size < 126) {
+        frame.append(static_cast<char>(size));
+    } else if (size <= 0xFFFF) {
+        frame.append(static_cast<char>(126));
+        frame.append(static_cast<char>(size >> 8));
+        frame.append(static_cast<char>(size & 0xFF));
+    } else {
+        frame.append(static_cast<char>(127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.append(static_cast<char>((size >> shift) & 0xFF));
+        }
+    }
+    frame.append(payload.data(), payload.size());
+    
+    return frame;
+}
+
+int WebSocketHub::connectionCount() const
+{
+    return static_cast<int>(m_connections.size());
+}
+
+int WebSocketHub::topicCount() const
+{
+    return static_cast<int>(m_subscribers.size());
+}
+
+quint64 WebSocketHub::publishedCount() const
+{
+    return m_published;
+}
+
+quint64 WebSocketHub::deliveredCount() const
+{
+    return m_delivered;
+}
+
+quint64 WebSocketHub::droppedCount() const
+{
+    return m_dropped;
+}
+
+quint64 WebSocketHub::slowDisconnectCount() const
+{
+    return m_slowDisconnects;
+}
+
+void WebSocketHub::accept(QTcpServer *listener)
+{
+    while (QTcpSocket *socket = listener->nextPendingConnection()) {
+        // Connections count against the per-client cap from the start, so that a client
+        // cannot hold many sockets open without ever completing a handshake
+        const QString clientKey = ConnectionManager::clientKey(socket->peerAddress());
+        if (m_connections.size() >= m_settings.maxConnections
+            || (m_settings.maxConnectionsPerIp > 0 && !m_settings.exemptClients.contains(clientKey)
+                && m_connectionsPerClient.value(clientKey) >= m_settings.maxConnectionsPerIp)) {
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        
+        socket->setParent(this);
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        
+        auto *connection = new Connection;
+        connection->socket = socket;
+        connection->clientKey = clientKey;
+        connection->lastSeenMs = nowMs();
+        m_connections.insert(connection);
+        m_connectionsPerClient[clientKey]++;
+        
+        if (m_settings.handshakeTimeoutMs > 0) {
+            connection->handshakeTimer = new QTimer(socket);
+            connection->handshakeTimer->setSingleShot(true);
+            connect(connection->handshakeTimer, &QTimer::timeout, this, [this, connection]() {
+                abort(connection);
+            });
+            connection->handshakeTimer->start(m_settings.handshakeTimeoutMs);
+        }
+        
+        connect(socket, &QTcpSocket::readyRead, this, [this, connection]() {
+            readFrom(connection);
+        });
+        
+        // Queued, so a connection is never deleted while one of its handlers is running
+        connect(socket, &QTcpSocket::disconnected, this, [this, connection]() {
+            remove(connection);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void WebSocketHub::readFrom(Connection *connection)
+{
+    if (connection->closing) {
+        connection->socket->readAll();
+        return;
+    }
+    
+    connection->buffer.append(connection->socket->readAll());
+    connection->lastSeenMs = nowMs();
+    
+    if (!connection->open && !handshake(connection)) {
+        return;
+    }
+    
+    while (processFrame(connection)) {
+    }
+}
+
+bool WebSocketHub::handshake(Connection *connection)
+{
+    const qsizetype end = connection->buffer.indexOf("\r\n\r\n");
+    if (end < 0) {
+        if (connection->buffer.size() > MaxHandshakeBytes) {
+            reject(connection, problem(431, "The upgrade request headers are too large", m_settings.path));
+        }
+        return false;
+    }
+    
+    const QList<QByteArray> lines = connection->buffer.left(end).split('\n');
+    connection->buffer.remove(0, end + 4);
+    
+    const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() != 3 || requestLine.at(0) != "GET" || requestLine.at(2) != "HTTP/1.1") {
+        reject(connection, problem(400, "Expected a GET request over HTTP/1.1", m_settings.path));
+        return false;
+    }
+    
+    // Header names are case-insensitive; repeated headers are joined with commas
+    QHash<QByteArray, QByteArray> headers;
+    for (qsizetype i = 1; i < lines.size(); ++i) {
+        const QByteArray line = lines.at(i).trimmed();
+        const qsizetype colon = line.indexOf(':');
+        if (colon <= 0) {
+            continue;
+        }
+        const QByteArray name = line.left(colon).trimmed().toLower();
+        const QByteArray value = line.mid(colon + 1).trimmed();
+        headers[name] = headers.contains(name) ? headers.value(name) + ", " + value : value;
+    }
+    
+    const QUrl url(QString::fromLatin1(requestLine.at(1)));
+    const QString path = url.path();
+    if (path != m_settings.path) {
+        reject(connection, problem(404, "No WebSocket endpoint at this path", path));
+        return false;
+    }
+    
+    if (!containsToken(headers.value("upgrade"), "websocket") || !containsToken(headers.value("connection"), "upgrade")
+        || headers.value("sec-websocket-version") != "13") {
+        Rejection rejection = problem(426, "Connect with a WebSocket (version 13) upgrade request", path);
+        rejection.headers.append({"Upgrade", "websocket"});
+        rejection.headers.append({"Sec-WebSocket-Version", "13"});
+        reject(connection, rejection);
+        return false;
+    }
+    
+    const QByteArray key = headers.value("sec-websocket-key");
+    if (QByteArray::fromBase64(key).size() != 16) {
+        reject(connection, problem(400, "Invalid Sec-WebSocket-Key header", path));
+        return false;
+    }
+    
+    // Browsers send an Origin header, so pages from other sites cannot open connections on a user's behalf
+    const QByteArray origin = headers.value("origin");
+    if (!origin.isEmpty() && !m_settings.allowedOrigins.contains(QStringLiteral("*"))
+        && !m_settings.allowedOrigins.contains(QString::fromLatin1(origin))) {
+        reject(connection, problem(403, "Connections from this origin are not allowed", path));
+        return false;
+    }
+    
+    if (m_admission) {
+        if (std::optional<Rejection> rejection = m_admission(path, headers.value("authorization"), connection->socket->peerAddress())) {
+            reject(connection, *rejection);
+            return false;
+        }
+    }
+    
+    const QByteArray accept = QCryptographicHash::hash(key + HandshakeGuid, QCryptographicHash::Sha1).toBase64();
+    connection->socket->write("HTTP/1.1 101 Switching Protocols\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Accept: " + accept + "\r\n\r\n");
+    connection->open = true;
+    delete connection->handshakeTimer;
+    connection->handshakeTimer = nullptr;
+    
+    const QStringList topics = QUrlQuery(url).queryItemValue("topics", QUrl::FullyDecoded).split(',', Qt::SkipEmptyParts);
+    for (const QString &topic : topics) {
+        subscribe(connection, topic.trimmed());
+    }
+    
+    return true;
+}
+
+bool WebSocketHub::processFrame(Connection *connection)
+{
+    QByteArray &buffer = connection->buffer;
+    if (connection->closing || buffer.size() < 2) {
+        return false;
+    }
+    
+    auto byteAt = [&buffer](qsizetype index) {
+        return static_cast<quint8>(buffer.at(index));
+    };
+    
+    const bool fin = byteAt(0) & 0x80;
+    const quint8 opcode = byteAt(0) & 0x0F;
+    
+    // No extensions are negotiated, so the reserved bits must be clear; clients must mask their frames
+    if ((byteAt(0) & 0x70) || !(byteAt(1) & 0x80)) {
+        close(connection, CloseProtocolError, "Reserved bits set or frame not masked");
+        return false;
+    }
+    
+    quint64 length = byteAt(1) & 0x7F;
+    qsizetype offset = 2;
+    if (length == 126) {
+        if (buffer.size() < 4) {
+            return false;
+        }
+        length = (static_cast<quint64>(byteAt(2)) << 8) | byteAt(3);
+        offset = 4;
+    } else if (length == 127) {
+        if (buffer.size() < 10) {
+            return false;
+        }
+        length = 0;
+        for (qsizetype i = 2; i < 10; ++i) {
+            length = (length << 8) | byteAt(i);
+        }
+        offset = 10;
+    }
+    
+    const bool control = opcode & 0x08;
+    if (control && (!fin || length > 125)) {
+        close(connection, CloseProtocolError, "Fragmented or oversized control frame");
+        return false;
+    }
+    if (length > static_cast<quint64>(m_settings.maxMessageBytes)) {
+        close(connection, CloseMessageTooBig, "Message too big");
+        return false;
+    }
+    
+    // Wait until the whole frame has arrived
+    const qsizetype frameSize = offset + 4 + static_cast<qsizetype>(length);
+    if (buffer.size() < frameSize) {
+        return false;
+    }
+    
+    QByteArray payload = buffer.mid(offset + 4, static_cast<qsizetype>(length));
+    const char *mask = buffer.constData() + offset;
+    char *data = payload.data();
+    for (qsizetype i = 0; i < payload.size(); ++i) {
+        data[i] = static_cast<char>(data[i] ^ mask[i % 4]);
+    }
+    buffer.remove(0, frameSize);
+    
+    switch (opcode) {
+    case Close: {
+        // Echo the client's status code, then close once the reply has been sent
+        const quint16 code = payload.size() >= 2
+            ? static_cast<quint16>((static_cast<quint8>(payload.at(0)) << 8) | static_cast<quint8>(payload.at(1)))
+            : CloseNormal;
+        close(connection, code);
+        return false;
+    }
+    case Ping:
+        connection->socket->write(encodeFrame(Pong, payload));
+        break;
+    case Pong:
+        break;
+    case Continuation:
+        if (connection->fragmentOpcode == 0) {
+            close(connection, CloseProtocolError, "Continuation frame without a message");
+            return false;
+        }
+        if (connection->fragments.size() + payload.size() > m_settings.maxMessageBytes) {
+            close(connection, CloseMessageTooBig, "Message too big");
+            return false;
+        }
+        connection->fragments += payload;
+        if (fin) {
+            const quint8 messageOpcode = std::exchange(connection->fragmentOpcode, 0);
+            handleMessage(connection, messageOpcode, std::exchange(connection->fragments, QByteArray()));
+        }
+        break;
+    case Text:
+    case Binary:
+        if (connection->fragmentOpcode != 0) {
+            close(connection, CloseProtocolError, "New message before the previous one was complete");
+            return false;
+        }
+        if (fin) {
+            handleMessage(connection, opcode, payload);
+        } else {
+            connection->fragmentOpcode = opcode;
+            connection->fragments = payload;
+        }
+        break;
+    default:
+        close(connection, CloseProtocolError, "Unknown opcode");
+        return false;
+    }
+    
+    return !connection->closing;
+}
+
+void WebSocketHub::handleMessage(Connection *connection, quint8 opcode, const QByteArray &payload)
+{
+    if (opcode != Text) {
+        close(connection, CloseUnsupportedData, "Only text messages are accepted");
+        return;
+    }
+    
+    const QJsonObject message = QJsonDocument::fromJson(payload).object();
+    const QString action = message.value("action").toString();
+    const QString topic = message.value("topic").toString();
+    
+    if (action == QLatin1String("subscribe")) {
+        subscribe(connection, topic);
+    } else if (action == QLatin1String("unsubscribe")) {
+        unsubscribe(connection, topic);
+    } else {
+        send(connection, QJsonObject{{"error", "Expected {\"action\": \"subscribe\" or \"unsubscribe\", \"topic\": \"...\"}"}});
+    }
+}
+
+void WebSocketHub::subscribe(Connection *connection, const QString &topic)
+{
+    if (topic.isEmpty() || topic.size() > MaxTopicLength) {
+        send(connection, QJsonObject{{"error", QString("Topic names must be 1 to %1 characters").arg(MaxTopicLength)}});
+        return;
+    }
+    
+    if (!connection->topics.contains(topic)) {
+        if (connection->topics.size() >= m_settings.maxTopicsPerConnection) {
+            send(connection, QJsonObject{{"error", QString("At most %1 subscriptions per connection").arg(m_settings.maxTopicsPerConnection)}});
+            return;
+        }
+        connection->topics.insert(topic);
+        m_subscribers[topic].append(connection);
+    }
+    
+    send(connection, QJsonObject{{"subscribed", topic}});
+}
+
+void WebSocketHub::unsubscribe(Connection *connection, const QString &topic)
+{
+    if (connection->topics.remove(topic)) {
+        const auto subscribers = m_subscribers.find(topic);
+        if (subscribers != m_subscribers.end()) {
+            subscribers->removeOne(connection);
+            if (subscribers->isEmpty()) {
+                m_subscribers.erase(subscribers);
+            }
+        }
+    }
+    
+    send(connection, QJsonObject{{"unsubscribed", topic}});
+}
+
+void WebSocketHub::send(Connection *connection, const QJsonObject &message)
+{
+    connection->socket->write(encodeFrame(Text, QJsonDocument(message).toJson(QJsonDocument::Compact)));
+}
+
+void WebSocketHub::reject(Connection *connection, const Rejection &rejection)
+{
+    QByteArray response = "HTTP/1.1 " + QByteArray::number(rejection.statusCode) + ' '
+        + reasonPhrase(rejection.statusCode) + "\r\n";
+    response += "Content-Type: application/problem+json\r\n";
+    response += "Content-Length: " + QByteArray::number(rejection.body.size()) + "\r\n";
+    response += "Connection: close\r\n";
+    for (const auto &header : rejection.headers) {
+        response += header.first + ": " + header.second + "\r\n";
+    }
+    response += "\r\n";
+    response += rejection.body;
+    
+    connection->socket->write(response);
+    connection->closing = true;
+    connection->socket->disconnectFromHost();
+}
+
+void WebSocketHub::close(Connection *connection, quint16 closeCode, const QByteArray &reason)
+{
+    if (connection->closing) {
+        return;
+    }
+    
+    // Control frame payloads are limited to 125 bytes, two of them for the code
+    QByteArray payload;
+    payload.append(static_cast<char>(closeCode >> 8));
+    payload.append(static_cast<char>(closeCode & 0xFF));
+    payload.append(reason.left(123));
+    
+    connection->socket->write(encodeFrame(Close, payload));
+    connection->closing = true;
+    connection->socket->disconnectFromHost();
+}
+
+void WebSocketHub::abort(Connection *connection)
+{
+    connection->closing = true;
+    connection->socket->abort();
+}
+
+void WebSocketHub::remove(Connection *connection)
+{
+    for (const QString &topic : std::as_const(connection->topics)) {
+        const auto subscribers = m_subscribers.find(topic);
+        if (subscribers != m_subscribers.end()) {
+            subscribers->removeOne(connection);
+            if (subscribers->isEmpty()) {
+                m_subscribers.erase(subscribers);
+            }
+        }
+    }
+    
+    auto perClient = m_connectionsPerClient.find(connection->clientKey);
+    if (perClient != m_connectionsPerClient.end() && --perClient.value() <= 0) {
+        m_connectionsPerClient.erase(perClient);
+    }
+    
+    delete connection->handshakeTimer;
+    m_connections.remove(connection);
+    connection->socket->deleteLater();
+    delete connection;
+}
+
+void WebSocketHub::ping()
+{
+    // Connections that stayed silent for two intervals (no pong, no data) are dead or stuck;
+    // a connection still in its handshake gets one interval
+    const qint64 now = nowMs();
+    const QByteArray frame = encodeFrame(Ping, QByteArrayView());
+    
+    QList<Connection *> silent;
+    for (Connection *connection : std::as_const(m_connections)) {
+        const qint64 limitMs = connection->open ? 2LL * m_settings.pingIntervalMs : m_settings.pingIntervalMs;
+        if (now - connection->lastSeenMs > limitMs) {
+            silent.append(connection);
+        } else if (connection->open && !connection->closing) {
+            connection->socket->write(frame);
+        }
+    }
+    
+    for (Connection *connection : std::as_const(silent)) {
+        abort(connection);
+    }
+}
+
+WebSocketHub::Rejection WebSocketHub::problem(int statusCode, const QString &detail, const QString &instance)
+{
+    ProblemDetail problem(statusCode);
+    problem.setDetail(detail);
+    problem.setInstance(instance);
+    
+    Rejection rejection;
+    rejection.statusCode = statusCode;
+    rejection.body = problem.toJsonResponse().data();
+    return rejection;
+}
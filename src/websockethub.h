@@ -0,0 +1,164 @@
+#ifndef WEBSOCKETHUB_H
+#define WEBSOCKETHUB_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <optional>
+#include <utility>
+
+class QJsonObject;
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+/**
+ * @brief The WebSocketHub class pushes messages to WebSocket clients subscribed to topics
+ * 
+ * The hub accepts connections from its own listener and implements the server side of
+ * RFC 6455 directly on the TCP sockets: QHttpServer does not hand out the socket of an
+ * upgraded connection, and QWebSocket frames every message again for every socket.
+ * 
+ * Clients connect to the configured path, optionally subscribing with a "topics" query
+ * parameter (?topics=a,b), and send {"action": "subscribe", "topic": "a"} or
+ * {"action": "unsubscribe", "topic": "a"} text messages to change their subscriptions.
+ * 
+ * publish() encodes a frame once and writes the same implicitly shared buffer to every
+ * subscriber, so a broadcast costs one encode plus one socket write per subscriber; frames
+ * of 4 KiB or more are queued by the sockets without being copied. A subscriber whose
+ * send queue would exceed the limit is a slow consumer: depending on the policy the message
+ * is dropped for it, or it is disconnected.
+ * 
+ * The hub lives on one thread; call publish() there, or queue it with QMetaObject::invokeMethod.
+ */
+class WebSocketHub : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class SlowConsumerPolicy {
+        Drop,       // Skip the message for that subscriber
+        Disconnect  // Close the subscriber's connection
+    };
+    
+    struct Settings
+    {
+        QString path = QStringLiteral("/ws");
+        int maxConnections = 10000;
+        int maxConnectionsPerIp = 64;        // Including connections still in their handshake
+        QStringList exemptClients;           // Client keys not subject to the per-IP cap
+        int handshakeTimeoutMs = 10000;      // Time allowed for the upgrade request
+        qint64 maxQueueBytes = 1024 * 1024;  // Unsent bytes allowed per connection
+        SlowConsumerPolicy slowConsumerPolicy = SlowConsumerPolicy::Drop;
+        int maxMessageBytes = 64 * 1024;     // Largest message accepted from a client
+        int maxTopicsPerConnection = 32;
+        int pingIntervalMs = 30000;          // Connections silent for two intervals are closed
+        QStringList allowedOrigins = {QStringLiteral("*")};  // Checked against the Origin header
+    };
+    
+    using HeaderList = QList<std::pair<QByteArray, QByteArray>>;
+    
+    // Answer to send instead of upgrading the connection
+    struct Rejection
+    {
+        int statusCode = 403;
+        QByteArray body;  // Problem detail JSON
+        HeaderList headers;
+    };
+    
+    // Decides whether an upgrade request may proceed, e.g. rate limiting and authentication
+    using Admission = std::function<std::optional<Rejection>(const QString &path, const QByteArray &authorization,
+                                                             const QHostAddress &peer)>;
+    
+    explicit WebSocketHub(QObject *parent = nullptr);
+    ~WebSocketHub();
+    
+    void setSettings(const Settings &settings);
+    void setAdmission(const Admission &admission);
+    
+    /**
+     * @brief Accepts connections from a listening server; the hub takes ownership of it
+     */
+    void attach(QTcpServer *listener);
+    
+    /**
+     * @brief Stops accepting connections; open connections are kept
+     */
+    void stopAccepting();
+    
+    /**
+     * @brief Sends a close frame with the given status code to every open connection
+     */
+    void closeAll(quint16 closeCode = 1001);
+    
+    /**
+     * @brief Sends a message to every subscriber of a topic
+     * 
+     * @param binary Sends a binary frame instead of a text frame (text must be UTF-8)
+     * @return The number of subscribers the message was queued for
+     */
+    Q_INVOKABLE int publish(const QString &topic, const QByteArray &payload, bool binary = false);
+    
+    /**
+     * @brief Encodes a single unmasked frame, as sent by a server
+     */
+    static QByteArray encodeFrame(quint8 opcode, QByteArrayView payload);
+    
+    int connectionCount() const;
+    int topicCount() const;
+    quint64 publishedCount() const;
+    quint64 deliveredCount() const;
+    quint64 droppedCount() const;
+    quint64 slowDisconnectCount() const;
+
+private:
+    struct Connection
+    {
+        QTcpSocket *socket = nullptr;
+        QString clientKey;
+        QTimer *handshakeTimer = nullptr;  // Closes the connection if the upgrade request is late
+        QByteArray buffer;  // Received bytes not processed yet
+        bool open = false;  // Handshake completed
+        bool closing = false;
+        qint64 lastSeenMs = 0;
+        QSet<QString> topics;
+        quint8 fragmentOpcode = 0;  // Opcode of the fragmented message being received, 0 if none
+        QByteArray fragments;
+    };
+    
+    Settings m_settings;
+    Admission m_admission;
+    QList<QTcpServer *> m_listeners;
+    QSet<Connection *> m_connections;
+    QHash<QString, int> m_connectionsPerClient;
+    QHash<QString, QList<Connection *>> m_subscribers;  // By topic
+    QTimer *m_pingTimer;
+    quint64 m_published = 0;
+    quint64 m_delivered = 0;
+    quint64 m_dropped = 0;
+    quint64 m_slowDisconnects = 0;
+    
+    void accept(QTcpServer *listener);
+    void readFrom(Connection *connection);
+    bool handshake(Connection *connection);
+    bool processFrame(Connection *connection);
+    void handleMessage(Connection *connection, quint8 opcode, const QByteArray &payload);
+    void subscribe(Connection *connection, const QString &topic);
+    void unsubscribe(Connection *connection, const QString &topic);
+    void send(Connection *connection, const QJsonObject &message);
+    void reject(Connection *connection, const Rejection &rejection);
+    void close(Connection *connection, quint16 closeCode, const QByteArray &reason = QByteArray());
+    void abort(Connection *connection);
+    void remove(Connection *connection);
+    void ping();
+    static Rejection problem(int statusCode, const QString &detail, const QString &instance);
+};
+
+#endif // WEBSOCKETHUB_H
@@ -0,0 +1,280 @@
+#include <QtTest>
+#include <QDateTime>
+#include <QHttpHeaders>
+#include <QHttpServer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <functional>
+#include <utility>
+#include "idempotencyguard.h"
+
+/**
+ * @brief The IdempotencyGuardTest class sends POST requests with an Idempotency-Key to a
+ * handler behind an IdempotencyGuard
+ * 
+ * The handler creates a numbered order each time it runs, so the tests can tell a replayed
+ * response from one the handler produced again.
+ */
+class IdempotencyGuardTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void replaysStoredResponse();
+    void rejectsKeyReusedForDifferentRequest();
+    void separatesClients();
+    void retriesAfterServerError();
+    void rejectsMalformedKey();
+    void conflictsWhileOriginalRuns();
+    void storeDropsExpiredRecords();
+    void storeEvictsClosestToExpiry();
+    void storeDeclinesOversizedRecord();
+};
+
+namespace {
+constexpr int WaitMs = 5000;
+
+// The server under test: POST /orders creates an order, guarded by its Idempotency-Key
+class OrderServer
+{
+public:
+    OrderServer()
+        : m_guard(std::make_unique<MemoryIdempotencyStore>(100, 1024 * 1024)),
+          m_listener(new QTcpServer())
+    {
+        m_server.route("/orders", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &request) {
+            if (!IdempotencyGuard::appliesTo(request)) {
+                return create(request);
+            }
+            return m_guard.handle(request, request.value("X-Client"), [this, &request]() {
+                return create(request);
+            });
+        });
+        
+        // The server takes ownership of the listener
+        m_listener->listen(QHostAddress::LocalHost);
+        m_server.bind(m_listener);
+    }
+    
+    quint16 port() const
+    {
+        return m_listener->serverPort();
+    }
+    
+    int executions = 0;
+    std::function<void()> whileRunning;  // Runs inside the handler before it answers
+
+private:
+    IdempotencyGuard m_guard;
+    QTcpServer *m_listener;
+    QHttpServer m_server;
+    
+    QHttpServerResponse create(const QHttpServerRequest &request)
+    {
+        ++executions;
+        if (request.body() == "fail") {
+            return QHttpServerResponse(QHttpServerResponse::StatusCode::ServiceUnavailable);
+        }
+        if (whileRunning) {
+            // Runs once; the hook may send requests that reach this handler again
+            const std::function<void()> hook = std::exchange(whileRunning, nullptr);
+            hook();
+        }
+        
+        const QByteArray order = QByteArray::number(executions);
+        QHttpServerResponse response("application/json", "{\"order\":" + order + '}', QHttpServerResponse::StatusCode::Created);
+        QHttpHeaders headers = response.headers();
+        headers.append("Location", "/orders/" + order);
+        response.setHeaders(std::move(headers));
+        return response;
+    }
+};
+
+struct Response
+{
+    QByteArray head;  // Status line and headers, without the blank line
+    QByteArray body;
+    
+    int statusCode() const
+    {
+        return head.mid(9, 3).toInt();
+    }
+    
+    QByteArray header(const QByteArray &name) const
+    {
+        for (const QByteArray &line : head.split('\n')) {
+            const int colon = line.indexOf(':');
+            if (colon > 0 && line.left(colon).trimmed().toLower() == name.toLower()) {
+                return line.mid(colon + 1).trimmed();
+            }
+        }
+        return QByteArray();
+    }
+};
+
+Response post(quint16 port, const QByteArray &key, const QByteArray &body, const QByteArray &client = "client-a")
+{
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    if (!socket.waitForConnected(WaitMs)) {
+        return Response();
+    }
+    socket.write("POST /orders HTTP/1.1\r\nHost: localhost\r\nX-Client: " + client + "\r\n"
+                 + (key.isNull() ? QByteArray() : "Idempotency-Key: " + key + "\r\n")
+                 + "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+    
+    // Complete once the headers and as many body bytes as Content-Length announces are in
+    QByteArray received;
+    Response response;
+    QTest::qWaitFor([&]() {
+        received += socket.readAll();
+        const qsizetype end = received.indexOf("\r\n\r\n");
+        if (end < 0) {
+            return socket.state() == QAbstractSocket::UnconnectedState;
+        }
+        response.head = received.left(end);
+        response.body = received.mid(end + 4);
+        return response.body.size() >= response.header("Content-Length").toLongLong();
+    }, WaitMs);
+    return response;
+}
+
+IdempotencyStore::RecordPtr record(const QByteArray &body, qint64 expiresInMs)
+{
+    auto record = std::make_shared<IdempotencyStore::Record>();
+    record->body = body;
+    record->expiresAtMs = QDateTime::currentMSecsSinceEpoch() + expiresInMs;
+    return record;
+}
+}
+
+void IdempotencyGuardTest::replaysStoredResponse()
+{
+    OrderServer server;
+    
+    const Response first = post(server.port(), "key-1", "{\"sku\":\"ABC-1\"}");
+    QCOMPARE(first.statusCode(), 201);
+    QCOMPARE(first.body, QByteArray("{\"order\":1}"));
+    QVERIFY(first.header("Idempotent-Replayed").isEmpty());
+    
+    const Response retry = post(server.port(), "key-1", "{\"sku\":\"ABC-1\"}");
+    QCOMPARE(retry.statusCode(), 201);
+    QCOMPARE(retry.body, first.body);
+    QCOMPARE(retry.header("Location"), QByteArray("/orders/1"));
+    QCOMPARE(retry.header("Content-Type"), QByteArray("application/json"));
+    QCOMPARE(retry.header("Idempotent-Replayed"), QByteArray("true"));
+    QCOMPARE(server.executions, 1);
+    
+    // Without a key every request runs the handler
+    QCOMPARE(post(server.port(), QByteArray(), "{\"sku\":\"ABC-1\"}").body, QByteArray("{\"order\":2}"));
+    QCOMPARE(server.executions, 2);
+}
+
+void IdempotencyGuardTest::rejectsKeyReusedForDifferentRequest()
+{
+    OrderServer server;
+    
+    QCOMPARE(post(server.port(), "key-1", "{\"sku\":\"ABC-1\"}").statusCode(), 201);
+    
+    const Response reused = post(server.port(), "key-1", "{\"sku\":\"XYZ-9\"}");
+    QCOMPARE(reused.statusCode(), 422);
+    QCOMPARE(reused.header("Content-Type"), QByteArray("application/problem+json"));
+    QCOMPARE(server.executions, 1);
+}
+
+void IdempotencyGuardTest::separatesClients()
+{
+    OrderServer server;
+    
+    QCOMPARE(post(server.port(), "key-1", "{}", "client-a").body, QByteArray("{\"order\":1}"));
+    
+    // The same key from another client is a different request
+    const Response other = post(server.port(), "key-1", "{}", "client-b");
+    QCOMPARE(other.body, QByteArray("{\"order\":2}"));
+    QVERIFY(other.header("Idempotent-Replayed").isEmpty());
+    QCOMPARE(server.executions, 2);
+}
+
+void IdempotencyGuardTest::retriesAfterServerError()
+{
+    OrderServer server;
+    
+    QCOMPARE(post(server.port(), "key-1", "fail").statusCode(), 503);
+    QCOMPARE(post(server.port(), "key-1", "fail").statusCode(), 503);
+    QCOMPARE(server.executions, 2);
+}
+
+void IdempotencyGuardTest::rejectsMalformedKey()
+{
+    OrderServer server;
+    
+    QCOMPARE(post(server.port(), QByteArray(256, 'k'), "{}").statusCode(), 400);
+    QCOMPARE(post(server.port(), "caf\xc3\xa9", "{}").statusCode(), 400);
+    QCOMPARE(server.executions, 0);
+    
+    QCOMPARE(post(server.port(), QByteArray(255, 'k'), "{}").statusCode(), 201);
+}
+
+void IdempotencyGuardTest::conflictsWhileOriginalRuns()
+{
+    OrderServer server;
+    
+    // The duplicate arrives while the handler is still running and re-enters the event loop,
+    // so it cannot wait for the original on the same thread
+    Response duplicate;
+    server.whileRunning = [&]() {
+        duplicate = post(server.port(), "key-1", "{}");
+    };
+    
+    const Response original = post(server.port(), "key-1", "{}");
+    QCOMPARE(original.statusCode(), 201);
+    QCOMPARE(duplicate.statusCode(), 409);
+    QCOMPARE(server.executions, 1);
+    
+    // Once the original finished, a retry gets its response
+    const Response retry = post(server.port(), "key-1", "{}");
+    QCOMPARE(retry.body, original.body);
+    QCOMPARE(retry.header("Idempotent-Replayed"), QByteArray("true"));
+}
+
+void IdempotencyGuardTest::storeDropsExpiredRecords()
+{
+    MemoryIdempotencyStore store(10, 1024 * 1024);
+    
+    store.insert("expired", record("a", -1));
+    store.insert("live", record("b", 60000));
+    
+    QVERIFY(!store.find("expired"));
+    QVERIFY(store.find("live"));
+    QCOMPARE(store.find("live")->body, QByteArray("b"));
+    QCOMPARE(store.entryCount(), 1);
+}
+
+void IdempotencyGuardTest::storeEvictsClosestToExpiry()
+{
+    MemoryIdempotencyStore store(2, 1024 * 1024);
+    
+    store.insert("late", record("a", 120000));
+    store.insert("early", record("b", 60000));
+    store.insert("new", record("c", 90000));
+    
+    QCOMPARE(store.entryCount(), 2);
+    QVERIFY(!store.find("early"));
+    QVERIFY(store.find("late"));
+    QVERIFY(store.find("new"));
+}
+
+void IdempotencyGuardTest::storeDeclinesOversizedRecord()
+{
+    MemoryIdempotencyStore store(10, 4096);
+    
+    store.insert("small", record("a", 60000));
+    store.insert("large", record(QByteArray(8192, 'x'), 60000));
+    
+    QVERIFY(!store.find("large"));
+    QVERIFY(store.find("small"));
+    QVERIFY(store.sizeBytes() <= 4096);
+}
+
+QTEST_MAIN(IdempotencyGuardTest)
+#include "idempotencyguardtest.moc"
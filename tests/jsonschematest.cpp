@@ -0,0 +1,260 @@
+#include <QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "jsonschema.h"
+
+/**
+ * @brief The JsonSchemaTest class validates request bodies against a compiled order schema
+ * 
+ * Every reject case checks the JSON Pointer of the violation as well, since that is what a
+ * client gets back to find the offending value.
+ */
+class JsonSchemaTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void acceptsValidDocument();
+    void reportsTypeMismatch();
+    void reportsMissingRequiredProperty();
+    void rejectsAdditionalProperty();
+    void checksStringConstraints();
+    void checksNumberBounds();
+    void checksArrayItems();
+    void rejectsFalseSchema();
+    void escapesPointerTokens();
+    void stopsAtMaxViolations();
+    void reportsMalformedJson();
+    void limitsNesting();
+    void rejectsUnsupportedSchema();
+
+private:
+    std::shared_ptr<const JsonSchema> m_schema;
+    
+    QList<JsonSchema::Violation> expectInvalid(const QByteArray &json);
+};
+
+namespace {
+const QByteArray OrderSchema = R"({
+    "title": "Order",
+    "type": "object",
+    "required": ["sku", "quantity"],
+    "additionalProperties": false,
+    "properties": {
+        "sku": {"type": "string", "pattern": "^[A-Z]{3}-[0-9]+$"},
+        "name": {"type": "string", "minLength": 1, "maxLength": 5},
+        "quantity": {"type": "integer", "minimum": 1, "exclusiveMaximum": 100},
+        "price": {"type": "number", "exclusiveMinimum": 0},
+        "status": {"enum": ["open", "closed", null]},
+        "tags": {"type": "array", "items": {"type": "string"}, "minItems": 1, "maxItems": 3},
+        "legacy": false,
+        "a/b~c": {"type": "boolean"}
+    }
+})";
+
+QJsonObject parse(const QByteArray &json)
+{
+    return QJsonDocument::fromJson(json).object();
+}
+
+// Wraps the given properties into an order that is otherwise valid
+QByteArray order(const QByteArray &properties)
+{
+    return R"({"sku": "ABC-1", "quantity": 5)" + (properties.isEmpty() ? QByteArray() : ", " + properties) + '}';
+}
+}
+
+void JsonSchemaTest::initTestCase()
+{
+    QString error;
+    m_schema = JsonSchema::compile(parse(OrderSchema), &error);
+    QVERIFY2(m_schema, qPrintable(error));
+}
+
+QList<JsonSchema::Violation> JsonSchemaTest::expectInvalid(const QByteArray &json)
+{
+    QList<JsonSchema::Violation> violations;
+    const JsonSchema::Result result = m_schema->validate(json, violations);
+    if (result != JsonSchema::Result::Invalid) {
+        violations.clear();
+    }
+    return violations;
+}
+
+void JsonSchemaTest::acceptsValidDocument()
+{
+    const QByteArray documents[] = {
+        order(QByteArray()),
+        order(R"("name": "héllo", "price": 9.99, "status": null, "tags": ["a", "b"])"),
+        order(R"("name": "héllo", "status": "closed", "a/b~c": true)"),
+        R"({"sku": "XYZ-42", "quantity": 1.0})"
+    };
+    
+    for (const QByteArray &document : documents) {
+        QList<JsonSchema::Violation> violations;
+        QCOMPARE(m_schema->validate(document, violations), JsonSchema::Result::Valid);
+        QVERIFY(violations.isEmpty());
+    }
+}
+
+void JsonSchemaTest::reportsTypeMismatch()
+{
+    const QList<JsonSchema::Violation> violations = expectInvalid(R"({"sku": "ABC-1", "quantity": "5"})");
+    
+    QCOMPARE(violations.size(), 1);
+    QCOMPARE(violations[0].pointer, QString("/quantity"));
+    QCOMPARE(violations[0].message, QString("must be of type integer"));
+    
+    QCOMPARE(expectInvalid(R"({"sku": "ABC-1", "quantity": 1.5})").value(0).pointer, QString("/quantity"));
+    QCOMPARE(expectInvalid("[]").value(0).message, QString("must be of type object"));
+}
+
+void JsonSchemaTest::reportsMissingRequiredProperty()
+{
+    const QList<JsonSchema::Violation> violations = expectInvalid("{}");
+    
+    QCOMPARE(violations.size(), 2);
+    QCOMPARE(violations[0].pointer, QString("/sku"));
+    QCOMPARE(violations[0].message, QString("is required"));
+    QCOMPARE(violations[1].pointer, QString("/quantity"));
+}
+
+void JsonSchemaTest::rejectsAdditionalProperty()
+{
+    const QList<JsonSchema::Violation> violations = expectInvalid(order(R"("discount": {"percent": 10})"));
+    
+    QCOMPARE(violations.size(), 1);
+    QCOMPARE(violations[0].pointer, QString("/discount"));
+    QCOMPARE(violations[0].message, QString("is not an allowed property"));
+}
+
+void JsonSchemaTest::checksStringConstraints()
+{
+    QCOMPARE(expectInvalid(order(R"("name": "")")).value(0).message, QString("must be at least 1 characters long"));
+    
+    // Length counts code points, not UTF-8 bytes or escapes
+    QCOMPARE(expectInvalid(order(R"("name": "héllos")")).value(0).message, QString("must be at most 5 characters long"));
+    QCOMPARE(expectInvalid(order(R"("name": "éééééé")")).value(0).pointer, QString("/name"));
+    
+    const QList<JsonSchema::Violation> pattern = expectInvalid(R"({"sku": "abc-1", "quantity": 5})");
+    QCOMPARE(pattern.size(), 1);
+    QCOMPARE(pattern[0].pointer, QString("/sku"));
+    QVERIFY(pattern[0].message.startsWith("must match the pattern"));
+    
+    QCOMPARE(expectInvalid(order(R"("status": "pending")")).value(0).message, QString("must be one of the allowed values"));
+    QCOMPARE(expectInvalid(order(R"("status": 1)")).value(0).pointer, QString("/status"));
+}
+
+void JsonSchemaTest::checksNumberBounds()
+{
+    QCOMPARE(expectInvalid(R"({"sku": "ABC-1", "quantity": 0})").value(0).message, QString("must be at least 1"));
+    QCOMPARE(expectInvalid(R"({"sku": "ABC-1", "quantity": 100})").value(0).message, QString("must be less than 100"));
+    QCOMPARE(expectInvalid(order(R"("price": 0)")).value(0).message, QString("must be greater than 0"));
+    QCOMPARE(expectInvalid(order(R"("price": -1e400)")).value(0).pointer, QString("/price"));
+}
+
+void JsonSchemaTest::checksArrayItems()
+{
+    QCOMPARE(expectInvalid(order(R"("tags": [])")).value(0).message, QString("must have at least 1 items"));
+    QCOMPARE(expectInvalid(order(R"("tags": ["a", "b", "c", "d"])")).value(0).message, QString("must have at most 3 items"));
+    
+    const QList<JsonSchema::Violation> violations = expectInvalid(order(R"("tags": ["a", 2, "c"])"));
+    QCOMPARE(violations.size(), 1);
+    QCOMPARE(violations[0].pointer, QString("/tags/1"));
+    QCOMPARE(violations[0].message, QString("must be of type string"));
+}
+
+void JsonSchemaTest::rejectsFalseSchema()
+{
+    const QList<JsonSchema::Violation> violations = expectInvalid(order(R"("legacy": 1)"));
+    
+    QCOMPARE(violations.size(), 1);
+    QCOMPARE(violations[0].pointer, QString("/legacy"));
+    QCOMPARE(violations[0].message, QString("is not allowed"));
+}
+
+void JsonSchemaTest::escapesPointerTokens()
+{
+    const QList<JsonSchema::Violation> violations = expectInvalid(order(R"("a/b~c": "yes")"));
+    
+    QCOMPARE(violations.size(), 1);
+    QCOMPARE(violations[0].pointer, QString("/a~1b~0c"));
+}
+
+void JsonSchemaTest::stopsAtMaxViolations()
+{
+    const QByteArray document = R"({"quantity": "x", "name": "", "price": 0, "extra": 1})";
+    QList<JsonSchema::Violation> violations;
+    
+    QCOMPARE(m_schema->validate(document, violations), JsonSchema::Result::Invalid);
+    QCOMPARE(violations.size(), 5);
+    
+    QCOMPARE(m_schema->validate(document, violations, 2), JsonSchema::Result::Invalid);
+    QCOMPARE(violations.size(), 2);
+    QCOMPARE(violations[1].pointer, QString("/name"));
+}
+
+void JsonSchemaTest::reportsMalformedJson()
+{
+    const QByteArray documents[] = {
+        R"({"sku": "ABC-1",})",
+        R"({"sku": "ABC-1")",
+        R"({"sku": "\x"})",
+        R"({"sku": "ABC-1", "quantity": 05})",
+        R"({"sku": "ABC-1", "quantity": 5} trailing)",
+        R"({"quantity": "x", "sku": tru})",
+        "{\"sku\": \"A\tB\"}",
+        ""
+    };
+    
+    for (const QByteArray &document : documents) {
+        QList<JsonSchema::Violation> violations;
+        QCOMPARE(m_schema->validate(document, violations), JsonSchema::Result::Malformed);
+        
+        // Violations found before the syntax error are dropped
+        QCOMPARE(violations.size(), 1);
+        QVERIFY(violations[0].message.startsWith("Malformed JSON"));
+    }
+}
+
+void JsonSchemaTest::limitsNesting()
+{
+    const std::shared_ptr<const JsonSchema> anything = JsonSchema::compile(QJsonObject());
+    QVERIFY(anything);
+    QList<JsonSchema::Violation> violations;
+    
+    const QByteArray deepest = QByteArray(JsonSchema::MaxDepth, '[') + QByteArray(JsonSchema::MaxDepth, ']');
+    QCOMPARE(anything->validate(deepest, violations), JsonSchema::Result::Valid);
+    
+    const QByteArray tooDeep = QByteArray(1000, '[') + QByteArray(1000, ']');
+    QCOMPARE(anything->validate(tooDeep, violations), JsonSchema::Result::Malformed);
+}
+
+void JsonSchemaTest::rejectsUnsupportedSchema()
+{
+    const QByteArray schemas[] = {
+        R"({"$ref": "#/definitions/order"})",
+        R"({"allOf": [{"type": "object"}]})",
+        R"({"type": "decimal"})",
+        R"({"pattern": "("})",
+        R"({"items": [{"type": "string"}]})",
+        R"({"minLength": -1})",
+        R"({"enum": [{"a": 1}]})",
+        R"({"properties": {"nested": {"oneOf": []}}})"
+    };
+    
+    for (const QByteArray &schema : schemas) {
+        QString error;
+        QVERIFY2(!JsonSchema::compile(parse(schema), &error), schema.constData());
+        QVERIFY(!error.isEmpty());
+    }
+    
+    // The location of the offending keyword is reported
+    QString error;
+    JsonSchema::compile(parse(schemas[7]), &error);
+    QVERIFY(error.contains("/properties/nested/oneOf"));
+}
+
+QTEST_MAIN(JsonSchemaTest)
+#include "jsonschematest.moc"
@@ -0,0 +1,375 @@
+#include <QtTest>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMessageAuthenticationCode>
+#include <QTemporaryDir>
+#include "jwtauthenticator.h"
+
+#include <openssl/bn.h>
+#include <openssl/core_names.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+
+/**
+ * @brief The JwtAuthenticatorTest class checks which bearer tokens the authenticator accepts
+ * 
+ * Keys are generated with OpenSSL for each run and published to the authenticator as a JWKS
+ * file, so every token is signed the way an identity provider would sign it. The reject cases
+ * cover the classic JWT pitfalls: algorithm confusion, "none", unknown critical parameters,
+ * expiry, weak RSA keys and EC public keys that are not points on the curve.
+ */
+class JwtAuthenticatorTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void acceptsRs256();
+    void acceptsEs256();
+    void rejectsMissingToken();
+    void rejectsNoneAlgorithm();
+    void rejectsHmacWithPublicKey();
+    void rejectsAlgorithmOfOtherKey();
+    void rejectsCriticalHeader();
+    void rejectsTamperedPayload();
+    void rejectsExpiredToken();
+    void acceptsExpiryWithinLeeway();
+    void rejectsTokenWithoutExpiry();
+    void rejectsShortRsaKey();
+    void rejectsEcPointOffCurve();
+    void cachesVerifiedToken();
+
+private:
+    QTemporaryDir m_dir;
+    EVP_PKEY *m_rsaKey = nullptr;
+    EVP_PKEY *m_ecKey = nullptr;
+    QJsonObject m_rsaJwk;
+    QJsonObject m_ecJwk;
+    
+    bool configure(JwtAuthenticator &authenticator, const QJsonArray &keys, int leewaySeconds = 60);
+};
+
+namespace {
+QByteArray base64Url(const QByteArray &data)
+{
+    return data.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+}
+
+QByteArray bignumParameter(EVP_PKEY *key, const char *name, int size = 0)
+{
+    BIGNUM *value = nullptr;
+    if (EVP_PKEY_get_bn_param(key, name, &value) != 1) {
+        return QByteArray();
+    }
+    
+    QByteArray bytes(size > 0 ? size : BN_num_bytes(value), Qt::Uninitialized);
+    BN_bn2binpad(value, reinterpret_cast<unsigned char *>(bytes.data()), static_cast<int>(bytes.size()));
+    BN_free(value);
+    return bytes;
+}
+
+QJsonObject rsaJwk(EVP_PKEY *key, const QString &kid)
+{
+    return QJsonObject{
+        {"kty", "RSA"},
+        {"kid", kid},
+        {"use", "sig"},
+        {"n", QString::fromLatin1(base64Url(bignumParameter(key, OSSL_PKEY_PARAM_RSA_N)))},
+        {"e", QString::fromLatin1(base64Url(bignumParameter(key, OSSL_PKEY_PARAM_RSA_E)))}
+    };
+}
+
+QJsonObject ecJwk(EVP_PKEY *key, const QString &kid)
+{
+    return QJsonObject{
+        {"kty", "EC"},
+        {"kid", kid},
+        {"crv", "P-256"},
+        {"x", QString::fromLatin1(base64Url(bignumParameter(key, OSSL_PKEY_PARAM_EC_PUB_X, 32)))},
+        {"y", QString::fromLatin1(base64Url(bignumParameter(key, OSSL_PKEY_PARAM_EC_PUB_Y, 32)))}
+    };
+}
+
+QByteArray sign(EVP_PKEY *key, const QByteArray &input)
+{
+    QByteArray signature;
+    EVP_MD_CTX *context = EVP_MD_CTX_new();
+    size_t length = 0;
+    if (context
+        && EVP_DigestSignInit(context, nullptr, EVP_sha256(), nullptr, key) == 1
+        && EVP_DigestSign(context, nullptr, &length,
+                          reinterpret_cast<const unsigned char *>(input.constData()), input.size()) == 1) {
+        signature.resize(static_cast<qsizetype>(length));
+        if (EVP_DigestSign(context, reinterpret_cast<unsigned char *>(signature.data()), &length,
+                           reinterpret_cast<const unsigned char *>(input.constData()), input.size()) == 1) {
+            signature.resize(static_cast<qsizetype>(length));
+        } else {
+            signature.clear();
+        }
+    }
+    EVP_MD_CTX_free(context);
+    
+    // JWS carries ECDSA signatures as the raw r || s pair instead of DER
+    if (EVP_PKEY_get_base_id(key) == EVP_PKEY_EC && !signature.isEmpty()) {
+        const auto *der = reinterpret_cast<const unsigned char *>(signature.constData());
+        ECDSA_SIG *sig = d2i_ECDSA_SIG(nullptr, &der, signature.size());
+        signature = QByteArray(64, Qt::Uninitialized);
+        auto *raw = reinterpret_cast<unsigned char *>(signature.data());
+        BN_bn2binpad(ECDSA_SIG_get0_r(sig), raw, 32);
+        BN_bn2binpad(ECDSA_SIG_get0_s(sig), raw + 32, 32);
+        ECDSA_SIG_free(sig);
+    }
+    
+    return signature;
+}
+
+QByteArray encodePart(const QJsonObject &object)
+{
+    return base64Url(QJsonDocument(object).toJson(QJsonDocument::Compact));
+}
+
+QByteArray token(EVP_PKEY *key, const QJsonObject &header, const QJsonObject &payload)
+{
+    const QByteArray input = encodePart(header) + '.' + encodePart(payload);
+    return input + '.' + base64Url(sign(key, input));
+}
+
+QJsonObject claimsExpiringIn(qint64 seconds)
+{
+    return QJsonObject{
+        {"sub", "user-1"},
+        {"scope", "orders:read"},
+        {"exp", QDateTime::currentSecsSinceEpoch() + seconds}
+    };
+}
+
+QByteArray bearer(const QByteArray &token)
+{
+    return "Bearer " + token;
+}
+}
+
+void JwtAuthenticatorTest::initTestCase()
+{
+    if (!JwtAuthenticator::isSupported()) {
+        QSKIP("Built without OpenSSL, no token can be verified");
+    }
+    
+    QVERIFY(m_dir.isValid());
+    m_rsaKey = EVP_RSA_gen(2048);
+    m_ecKey = EVP_EC_gen("P-256");
+    QVERIFY(m_rsaKey);
+    QVERIFY(m_ecKey);
+    m_rsaJwk = rsaJwk(m_rsaKey, "rsa-1");
+    m_ecJwk = ecJwk(m_ecKey, "ec-1");
+}
+
+void JwtAuthenticatorTest::cleanupTestCase()
+{
+    EVP_PKEY_free(m_rsaKey);
+    EVP_PKEY_free(m_ecKey);
+}
+
+bool JwtAuthenticatorTest::configure(JwtAuthenticator &authenticator, const QJsonArray &keys, int leewaySeconds)
+{
+    static int fileNumber = 0;
+    const QString path = m_dir.filePath(QString("jwks-%1.json").arg(++fileNumber));
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject{{"keys", keys}}).toJson());
+    file.close();
+    
+    JwtAuthenticator::Settings settings;
+    settings.jwksFile = path;
+    settings.leewaySeconds = leewaySeconds;
+    return authenticator.configure(settings);
+}
+
+void JwtAuthenticatorTest::acceptsRs256()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    const QByteArray jwt = token(m_rsaKey, {{"alg", "RS256"}, {"kid", "rsa-1"}}, claimsExpiringIn(600));
+    const JwtAuthenticator::Result result = authenticator.authenticate(bearer(jwt));
+    
+    QCOMPARE(result.status, JwtAuthenticator::Status::Ok);
+    QVERIFY(result.claims);
+    QCOMPARE(result.claims->subject, QString("user-1"));
+    QCOMPARE(result.claims->scopes, QStringList{"orders:read"});
+}
+
+void JwtAuthenticatorTest::acceptsEs256()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk, m_ecJwk}));
+    
+    // Without a "kid" the only ES256 key is used
+    const QByteArray jwt = token(m_ecKey, {{"alg", "ES256"}}, claimsExpiringIn(600));
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Ok);
+}
+
+void JwtAuthenticatorTest::rejectsMissingToken()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    QCOMPARE(authenticator.authenticate(QByteArray()).status, JwtAuthenticator::Status::Missing);
+    QCOMPARE(authenticator.authenticate("Basic dXNlcjpwYXNz").status, JwtAuthenticator::Status::Missing);
+    QCOMPARE(authenticator.authenticate("Bearer ").status, JwtAuthenticator::Status::Missing);
+    QCOMPARE(authenticator.authenticate("Bearer not-a-token").status, JwtAuthenticator::Status::Invalid);
+}
+
+void JwtAuthenticatorTest::rejectsNoneAlgorithm()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    const QByteArray jwt = encodePart({{"alg", "none"}}) + '.' + encodePart(claimsExpiringIn(600)) + '.';
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Invalid);
+}
+
+void JwtAuthenticatorTest::rejectsHmacWithPublicKey()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    // The attacker knows the public key and uses it as an HMAC secret
+    const QByteArray secret = QJsonDocument(m_rsaJwk).toJson(QJsonDocument::Compact);
+    const QByteArray input = encodePart({{"alg", "HS256"}, {"kid", "rsa-1"}}) + '.' + encodePart(claimsExpiringIn(600));
+    const QByteArray jwt = input + '.' + base64Url(QMessageAuthenticationCode::hash(input, secret, QCryptographicHash::Sha256));
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Invalid);
+}
+
+void JwtAuthenticatorTest::rejectsAlgorithmOfOtherKey()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    // Validly signed with a P-256 key, but the key set only trusts the RSA key
+    const QByteArray jwt = token(m_ecKey, {{"alg", "ES256"}, {"kid", "rsa-1"}}, claimsExpiringIn(600));
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Invalid);
+}
+
+void JwtAuthenticatorTest::rejectsCriticalHeader()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    const QJsonObject header{{"alg", "RS256"}, {"kid", "rsa-1"}, {"crit", QJsonArray{"b64"}}, {"b64", false}};
+    const QByteArray jwt = token(m_rsaKey, header, claimsExpiringIn(600));
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Invalid);
+}
+
+void JwtAuthenticatorTest::rejectsTamperedPayload()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk, m_ecJwk}));
+    
+    QJsonObject escalated = claimsExpiringIn(600);
+    escalated["scope"] = "orders:read admin";
+    
+    for (EVP_PKEY *key : {m_rsaKey, m_ecKey}) {
+        const QByteArray alg = key == m_rsaKey ? "RS256" : "ES256";
+        const QList<QByteArray> parts = token(key, {{"alg", QString::fromLatin1(alg)}}, claimsExpiringIn(600)).split('.');
+        const QByteArray jwt = parts[0] + '.' + encodePart(escalated) + '.' + parts[2];
+        
+        QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Invalid);
+    }
+}
+
+void JwtAuthenticatorTest::rejectsExpiredToken()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}, 60));
+    
+    const QByteArray jwt = token(m_rsaKey, {{"alg", "RS256"}}, claimsExpiringIn(-120));
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Expired);
+}
+
+void JwtAuthenticatorTest::acceptsExpiryWithinLeeway()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}, 60));
+    
+    const QByteArray jwt = token(m_rsaKey, {{"alg", "RS256"}}, claimsExpiringIn(-10));
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Ok);
+}
+
+void JwtAuthenticatorTest::rejectsTokenWithoutExpiry()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    const QByteArray jwt = token(m_rsaKey, {{"alg", "RS256"}}, {{"sub", "user-1"}});
+    
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Invalid);
+}
+
+void JwtAuthenticatorTest::rejectsShortRsaKey()
+{
+    EVP_PKEY *shortKey = EVP_RSA_gen(1024);
+    QVERIFY(shortKey);
+    const QJsonObject shortJwk = rsaJwk(shortKey, "rsa-short");
+    
+    // A key set holding only the short key is unusable
+    JwtAuthenticator authenticator;
+    QVERIFY(!configure(authenticator, {shortJwk}));
+    QCOMPARE(authenticator.keyCount(), 0);
+    
+    // Next to a strong key it is skipped, and its tokens are refused
+    QVERIFY(configure(authenticator, {shortJwk, m_rsaJwk}));
+    QCOMPARE(authenticator.keyCount(), 1);
+    const QByteArray jwt = token(shortKey, {{"alg", "RS256"}, {"kid", "rsa-short"}}, claimsExpiringIn(600));
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Invalid);
+    
+    EVP_PKEY_free(shortKey);
+}
+
+void JwtAuthenticatorTest::rejectsEcPointOffCurve()
+{
+    // Valid base64url coordinates of the right size that do not describe a point on P-256
+    QJsonObject offCurve = m_ecJwk;
+    offCurve["kid"] = "ec-invalid";
+    offCurve["y"] = QString::fromLatin1(base64Url(QByteArray(32, '\x01')));
+    
+    JwtAuthenticator authenticator;
+    QVERIFY(!configure(authenticator, {offCurve}));
+    QCOMPARE(authenticator.keyCount(), 0);
+    
+    // Coordinates of the wrong size are refused before they reach OpenSSL
+    QJsonObject truncated = m_ecJwk;
+    truncated["x"] = QString::fromLatin1(base64Url(QByteArray(31, '\x01')));
+    QVERIFY(!configure(authenticator, {truncated}));
+}
+
+void JwtAuthenticatorTest::cachesVerifiedToken()
+{
+    JwtAuthenticator authenticator;
+    QVERIFY(configure(authenticator, {m_rsaJwk}));
+    
+    const QByteArray jwt = token(m_rsaKey, {{"alg", "RS256"}}, claimsExpiringIn(600));
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Ok);
+    QCOMPARE(authenticator.authenticate(bearer(jwt)).status, JwtAuthenticator::Status::Ok);
+    
+    QCOMPARE(authenticator.missCount(), quint64(1));
+    QCOMPARE(authenticator.hitCount(), quint64(1));
+    QCOMPARE(authenticator.cachedCount(), 1);
+}
+
+QTEST_MAIN(JwtAuthenticatorTest)
+#include "jwtauthenticatortest.moc"
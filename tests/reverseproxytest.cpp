@@ -0,0 +1,262 @@
+#include <QtTest>
+#include <QHttpServer>
+#include <QHttpServerResponder>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <functional>
+#include "connectionmanager.h"
+#include "reverseproxy.h"
+
+/**
+ * @brief The ReverseProxyTest class forwards requests through a ReverseProxy to a stub upstream
+ * 
+ * The stub answers with raw bytes, so that each test controls exactly how and when the
+ * upstream fails: before its response headers, part way through a buffered or streamed body,
+ * or never. Bodies of unknown length are streamed; small ones with a Content-Length are buffered.
+ */
+class ReverseProxyTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void streamsUpstreamBody();
+    void truncatedBodyAbortsClient();
+    void buffersSmallBody();
+    void truncatedSmallBodyIsBadGateway();
+    void unreachableUpstream();
+    void upstreamTimeout();
+};
+
+namespace {
+constexpr int WaitMs = 5000;
+
+// Accepts connections and hands each one to the behaviour once its request headers are in
+class StubUpstream
+{
+public:
+    using Behaviour = std::function<void(QTcpSocket *socket)>;
+    
+    explicit StubUpstream(const Behaviour &behaviour)
+    {
+        QObject::connect(&m_server, &QTcpServer::newConnection, &m_server, [this, behaviour]() {
+            while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+                QObject::connect(socket, &QIODevice::readyRead, socket, [socket, behaviour]() {
+                    if (socket->property("answered").toBool() || !socket->peek(socket->bytesAvailable()).contains("\r\n\r\n")) {
+                        return;
+                    }
+                    socket->setProperty("answered", true);
+                    behaviour(socket);
+                });
+            }
+        });
+        m_server.listen(QHostAddress::LocalHost);
+    }
+    
+    QUrl url() const
+    {
+        return QUrl(QString("http://127.0.0.1:%1").arg(m_server.serverPort()));
+    }
+
+private:
+    QTcpServer m_server;
+};
+
+// The server under test: every request for /test is forwarded to the upstream
+class ProxyServer
+{
+public:
+    explicit ProxyServer(const QUrl &upstream, int timeoutMs = 30000)
+        : m_listener(new ManagedTcpServer(&m_connections))
+    {
+        m_route.prefix = "/test";
+        m_route.upstream = upstream;
+        m_route.timeoutMs = timeoutMs;
+        
+        m_proxy.setConnectionAborter([this](const QHostAddress &peerAddress, quint16 peerPort) {
+            m_connections.abort(peerAddress, peerPort);
+        });
+        
+        m_server.route("/test", [this](const QHttpServerRequest &request, QHttpServerResponder &responder) {
+            m_proxy.forward(m_route, request, "GET", std::move(responder), "http", [this](int statusCode) {
+                m_completedStatus = statusCode;
+            });
+        });
+        
+        // The server takes ownership of the listener
+        m_listener->listen(QHostAddress::LocalHost);
+        m_server.bind(m_listener);
+    }
+    
+    quint16 port() const
+    {
+        return m_listener->serverPort();
+    }
+    
+    // Status passed to the completion callback, 0 until the call has finished
+    int completedStatus() const
+    {
+        return m_completedStatus;
+    }
+
+private:
+    ConnectionManager m_connections;
+    ManagedTcpServer *m_listener;
+    QHttpServer m_server;
+    ReverseProxy m_proxy;
+    ReverseProxy::Route m_route;
+    int m_completedStatus = 0;
+};
+
+// Sends GET /test and collects the response until the predicate holds or the connection closes
+QByteArray fetch(quint16 port, const std::function<bool(const QByteArray &)> &complete, bool *closed)
+{
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, port);
+    if (!client.waitForConnected(WaitMs)) {
+        return QByteArray();
+    }
+    client.write("GET /test HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    
+    QByteArray received;
+    QTest::qWaitFor([&]() {
+        received += client.readAll();
+        return complete(received) || client.state() == QAbstractSocket::UnconnectedState;
+    }, WaitMs);
+    received += client.readAll();
+    
+    *closed = client.state() == QAbstractSocket::UnconnectedState;
+    return received;
+}
+
+bool hasHeaders(const QByteArray &response)
+{
+    return response.contains("\r\n\r\n");
+}
+}
+
+void ReverseProxyTest::streamsUpstreamBody()
+{
+    StubUpstream upstream([](QTcpSocket *socket) {
+        socket->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n");
+        QTimer::singleShot(50, socket, [socket]() {
+            socket->write("6\r\n world\r\n0\r\n\r\n");
+        });
+    });
+    ProxyServer proxy(upstream.url());
+    
+    bool closed = false;
+    const QByteArray response = fetch(proxy.port(), [](const QByteArray &received) {
+        return received.endsWith("0\r\n\r\n");
+    }, &closed);
+    
+    QVERIFY(response.startsWith("HTTP/1.1 200"));
+    QVERIFY(response.toLower().contains("transfer-encoding: chunked"));
+    QVERIFY(response.contains("hello"));
+    QVERIFY(response.contains(" world"));
+    QVERIFY(response.endsWith("0\r\n\r\n"));
+    QVERIFY(!closed);
+    QTRY_COMPARE_WITH_TIMEOUT(proxy.completedStatus(), 200, WaitMs);
+}
+
+void ReverseProxyTest::truncatedBodyAbortsClient()
+{
+    // The upstream disconnects after its first chunk
+    StubUpstream upstream([](QTcpSocket *socket) {
+        socket->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nTransfer-Encoding: chunked\r\n\r\n7\r\npartial\r\n");
+        QTimer::singleShot(50, socket, [socket]() {
+            socket->abort();
+        });
+    });
+    ProxyServer proxy(upstream.url());
+    
+    bool closed = false;
+    const QByteArray response = fetch(proxy.port(), [](const QByteArray &) {
+        return false;
+    }, &closed);
+    
+    QVERIFY(response.startsWith("HTTP/1.1 200"));
+    QVERIFY(response.contains("partial"));
+    QVERIFY(!response.endsWith("0\r\n\r\n"));
+    QVERIFY(closed);
+}
+
+void ReverseProxyTest::buffersSmallBody()
+{
+    StubUpstream upstream([](QTcpSocket *socket) {
+        socket->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 11\r\n\r\nhello");
+        QTimer::singleShot(50, socket, [socket]() {
+            socket->write(" world");
+        });
+    });
+    ProxyServer proxy(upstream.url());
+    
+    bool closed = false;
+    const QByteArray response = fetch(proxy.port(), [](const QByteArray &received) {
+        return received.endsWith("hello world");
+    }, &closed);
+    
+    QVERIFY(response.startsWith("HTTP/1.1 200"));
+    QVERIFY(response.toLower().contains("content-length: 11"));
+    QVERIFY(!response.toLower().contains("transfer-encoding: chunked"));
+    QVERIFY(response.toLower().contains("content-type: text/plain"));
+    QVERIFY(response.endsWith("\r\n\r\nhello world"));
+    QVERIFY(!closed);
+    QTRY_COMPARE_WITH_TIMEOUT(proxy.completedStatus(), 200, WaitMs);
+}
+
+void ReverseProxyTest::truncatedSmallBodyIsBadGateway()
+{
+    // The upstream promises 100 bytes and disconnects after 7; nothing was sent to the client
+    // yet, so the failure is reported as such instead of passing on the upstream's 200
+    StubUpstream upstream([](QTcpSocket *socket) {
+        socket->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 100\r\n\r\npartial");
+        QTimer::singleShot(50, socket, [socket]() {
+            socket->abort();
+        });
+    });
+    ProxyServer proxy(upstream.url());
+    
+    bool closed = false;
+    const QByteArray response = fetch(proxy.port(), hasHeaders, &closed);
+    
+    QVERIFY(response.startsWith("HTTP/1.1 502"));
+    QVERIFY(response.contains("application/problem+json"));
+    QVERIFY(!response.contains("partial"));
+    QTRY_COMPARE_WITH_TIMEOUT(proxy.completedStatus(), 502, WaitMs);
+}
+
+void ReverseProxyTest::unreachableUpstream()
+{
+    // A port that was just free, so connections to it are refused
+    QUrl upstreamUrl;
+    {
+        QTcpServer unused;
+        QVERIFY(unused.listen(QHostAddress::LocalHost));
+        upstreamUrl = QUrl(QString("http://127.0.0.1:%1").arg(unused.serverPort()));
+    }
+    ProxyServer proxy(upstreamUrl);
+    
+    bool closed = false;
+    const QByteArray response = fetch(proxy.port(), hasHeaders, &closed);
+    
+    QVERIFY(response.startsWith("HTTP/1.1 502"));
+    QVERIFY(response.contains("application/problem+json"));
+    QTRY_COMPARE_WITH_TIMEOUT(proxy.completedStatus(), 502, WaitMs);
+}
+
+void ReverseProxyTest::upstreamTimeout()
+{
+    // The upstream accepts the request and never answers
+    StubUpstream upstream([](QTcpSocket *) {});
+    ProxyServer proxy(upstream.url(), 200);
+    
+    bool closed = false;
+    const QByteArray response = fetch(proxy.port(), hasHeaders, &closed);
+    
+    QVERIFY(response.startsWith("HTTP/1.1 504"));
+    QVERIFY(response.contains("application/problem+json"));
+    QTRY_COMPARE_WITH_TIMEOUT(proxy.completedStatus(), 504, WaitMs);
+}
+
+QTEST_MAIN(ReverseProxyTest)
+#include "reverseproxytest.moc"
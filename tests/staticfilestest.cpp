@@ -0,0 +1,270 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QHttpServer>
+#include <QHttpServerResponder>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <functional>
+#include "staticfiles.h"
+
+/**
+ * @brief The StaticFilesTest class requests files from a StaticFiles mount over a real connection
+ * 
+ * Responses are read as raw bytes, so that the tests see exactly what goes on the wire: the
+ * status line, the headers and whether a body follows them.
+ */
+class StaticFilesTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void servesWholeFile();
+    void headHasLengthWithoutBody();
+    void servesByteRange();
+    void servesSuffixRange();
+    void headOfRangeHasRangeLength();
+    void unsatisfiableRange();
+    void ifRangeMismatchSendsWholeFile();
+    void streamsLargeFile();
+
+private:
+    QTemporaryDir m_root;
+};
+
+namespace {
+constexpr int WaitMs = 5000;
+
+// How long to keep reading after a HEAD response, to catch body bytes that must not be there
+constexpr int SettleMs = 200;
+
+const QByteArray SmallContent = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+// The server under test: every path under /files is served from the root directory
+class FileServer
+{
+public:
+    explicit FileServer(const QString &root, qint64 streamThresholdBytes = 256 * 1024)
+        : m_listener(new QTcpServer())
+    {
+        StaticFiles::Settings settings;
+        settings.streamThresholdBytes = streamThresholdBytes;
+        m_files.setSettings(settings);
+        
+        m_mount.prefix = "/files";
+        m_mount.root = QDir(root).canonicalPath();
+        
+        m_server.route("/files/<arg>", [this](const QUrl &, const QHttpServerRequest &request, QHttpServerResponder &responder) {
+            m_files.serve(m_mount, request, responder, StaticFiles::HeaderList());
+        });
+        
+        // The server takes ownership of the listener
+        m_listener->listen(QHostAddress::LocalHost);
+        m_server.bind(m_listener);
+    }
+    
+    quint16 port() const
+    {
+        return m_listener->serverPort();
+    }
+
+private:
+    StaticFiles m_files;
+    StaticFiles::Mount m_mount;
+    QTcpServer *m_listener;
+    QHttpServer m_server;
+};
+
+struct Response
+{
+    QByteArray head;  // Status line and headers, without the blank line
+    QByteArray body;  // Everything received after the blank line
+    
+    QByteArray header(const QByteArray &name) const
+    {
+        for (const QByteArray &line : head.split('\n')) {
+            const int colon = line.indexOf(':');
+            if (colon > 0 && line.left(colon).trimmed().toLower() == name.toLower()) {
+                return line.mid(colon + 1).trimmed();
+            }
+        }
+        return QByteArray();
+    }
+};
+
+// Sends a request and collects the response until the predicate holds or the wait ends,
+// then keeps reading for settleMs
+Response fetch(quint16 port, const QByteArray &method, const QByteArray &path, const QByteArray &extraHeaders,
+               const std::function<bool(const QByteArray &)> &complete, int settleMs = 0)
+{
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, port);
+    if (!client.waitForConnected(WaitMs)) {
+        return Response();
+    }
+    client.write(method + ' ' + path + " HTTP/1.1\r\nHost: localhost\r\n" + extraHeaders + "\r\n");
+    
+    QByteArray received;
+    QTest::qWaitFor([&]() {
+        received += client.readAll();
+        return complete(received) || client.state() == QAbstractSocket::UnconnectedState;
+    }, WaitMs);
+    if (settleMs > 0) {
+        QTest::qWait(settleMs);
+    }
+    received += client.readAll();
+    
+    Response response;
+    const qsizetype end = received.indexOf("\r\n\r\n");
+    response.head = end < 0 ? received : received.left(end);
+    response.body = end < 0 ? QByteArray() : received.mid(end + 4);
+    return response;
+}
+
+// Complete once the headers and as many body bytes as Content-Length announces are in
+bool hasBodyOfContentLength(const QByteArray &received)
+{
+    const qsizetype end = received.indexOf("\r\n\r\n");
+    if (end < 0) {
+        return false;
+    }
+    
+    Response response;
+    response.head = received.left(end);
+    return received.size() - end - 4 >= response.header("Content-Length").toLongLong();
+}
+
+bool hasHeaders(const QByteArray &received)
+{
+    return received.contains("\r\n\r\n");
+}
+}
+
+void StaticFilesTest::initTestCase()
+{
+    QVERIFY(m_root.isValid());
+    
+    QFile small(m_root.filePath("small.txt"));
+    QVERIFY(small.open(QIODevice::WriteOnly));
+    small.write(SmallContent);
+    small.close();
+    
+    QFile large(m_root.filePath("large.bin"));
+    QVERIFY(large.open(QIODevice::WriteOnly));
+    for (int i = 0; i < 64 * 1024; ++i) {
+        large.putChar(static_cast<char>(i % 251));
+    }
+    large.close();
+}
+
+void StaticFilesTest::servesWholeFile()
+{
+    FileServer server(m_root.path());
+    
+    const Response response = fetch(server.port(), "GET", "/files/small.txt", QByteArray(), hasBodyOfContentLength);
+    
+    QVERIFY(response.head.startsWith("HTTP/1.1 200"));
+    QCOMPARE(response.header("Content-Length").toLongLong(), SmallContent.size());
+    QVERIFY(response.header("Content-Type").startsWith("text/plain"));
+    QCOMPARE(response.header("Accept-Ranges"), QByteArray("bytes"));
+    QVERIFY(!response.header("ETag").isEmpty());
+    QCOMPARE(response.body, SmallContent);
+}
+
+void StaticFilesTest::headHasLengthWithoutBody()
+{
+    FileServer server(m_root.path());
+    
+    const Response response = fetch(server.port(), "HEAD", "/files/small.txt", QByteArray(), hasHeaders, SettleMs);
+    
+    QVERIFY(response.head.startsWith("HTTP/1.1 200"));
+    QCOMPARE(response.header("Content-Length").toLongLong(), SmallContent.size());
+    QVERIFY(response.header("Content-Type").startsWith("text/plain"));
+    QVERIFY(!response.header("ETag").isEmpty());
+    QVERIFY(response.body.isEmpty());
+}
+
+void StaticFilesTest::servesByteRange()
+{
+    FileServer server(m_root.path());
+    
+    const Response response = fetch(server.port(), "GET", "/files/small.txt", "Range: bytes=2-5\r\n", hasBodyOfContentLength);
+    
+    QVERIFY(response.head.startsWith("HTTP/1.1 206"));
+    QCOMPARE(response.header("Content-Range"), "bytes 2-5/" + QByteArray::number(SmallContent.size()));
+    QCOMPARE(response.header("Content-Length"), QByteArray("4"));
+    QCOMPARE(response.body, QByteArray("2345"));
+}
+
+void StaticFilesTest::servesSuffixRange()
+{
+    FileServer server(m_root.path());
+    
+    const Response response = fetch(server.port(), "GET", "/files/small.txt", "Range: bytes=-3\r\n", hasBodyOfContentLength);
+    
+    const qint64 size = SmallContent.size();
+    QVERIFY(response.head.startsWith("HTTP/1.1 206"));
+    QCOMPARE(response.header("Content-Range"),
+             "bytes " + QByteArray::number(size - 3) + '-' + QByteArray::number(size - 1) + '/' + QByteArray::number(size));
+    QCOMPARE(response.body, QByteArray("xyz"));
+}
+
+void StaticFilesTest::headOfRangeHasRangeLength()
+{
+    FileServer server(m_root.path());
+    
+    const Response response = fetch(server.port(), "HEAD", "/files/small.txt", "Range: bytes=10-19\r\n", hasHeaders, SettleMs);
+    
+    QVERIFY(response.head.startsWith("HTTP/1.1 206"));
+    QCOMPARE(response.header("Content-Length"), QByteArray("10"));
+    QCOMPARE(response.header("Content-Range"), "bytes 10-19/" + QByteArray::number(SmallContent.size()));
+    QVERIFY(response.body.isEmpty());
+}
+
+void StaticFilesTest::unsatisfiableRange()
+{
+    FileServer server(m_root.path());
+    
+    const Response response = fetch(server.port(), "GET", "/files/small.txt", "Range: bytes=1000-2000\r\n", hasBodyOfContentLength);
+    
+    QVERIFY(response.head.startsWith("HTTP/1.1 416"));
+    QCOMPARE(response.header("Content-Range"), "bytes */" + QByteArray::number(SmallContent.size()));
+    QCOMPARE(response.header("Content-Type"), QByteArray("application/problem+json"));
+}
+
+void StaticFilesTest::ifRangeMismatchSendsWholeFile()
+{
+    FileServer server(m_root.path());
+    
+    // The client's copy is stale, so the range is ignored
+    const Response response = fetch(server.port(), "GET", "/files/small.txt",
+                                    "Range: bytes=2-5\r\nIf-Range: \"stale\"\r\n", hasBodyOfContentLength);
+    
+    QVERIFY(response.head.startsWith("HTTP/1.1 200"));
+    QVERIFY(response.header("Content-Range").isEmpty());
+    QCOMPARE(response.body, SmallContent);
+}
+
+void StaticFilesTest::streamsLargeFile()
+{
+    // Everything above 1 KiB is streamed from the mapping instead of copied
+    FileServer server(m_root.path(), 1024);
+    
+    QFile expected(m_root.filePath("large.bin"));
+    QVERIFY(expected.open(QIODevice::ReadOnly));
+    const QByteArray content = expected.readAll();
+    
+    const Response whole = fetch(server.port(), "GET", "/files/large.bin", QByteArray(), hasBodyOfContentLength);
+    QVERIFY(whole.head.startsWith("HTTP/1.1 200"));
+    QCOMPARE(whole.header("Content-Length").toLongLong(), content.size());
+    QCOMPARE(whole.body, content);
+    
+    const Response range = fetch(server.port(), "GET", "/files/large.bin", "Range: bytes=1000-60999\r\n", hasBodyOfContentLength);
+    QVERIFY(range.head.startsWith("HTTP/1.1 206"));
+    QCOMPARE(range.body, content.mid(1000, 60000));
+}
+
+QTEST_MAIN(StaticFilesTest)
+#include "staticfilestest.moc"
@@ -0,0 +1,263 @@
+#include <QtTest>
+#include <QHttpServer>
+#include <QLocalSocket>
+#include <QTemporaryDir>
+#include "unixsocketlistener.h"
+
+/**
+ * @brief The UnixSocketListenerTest class checks the PROXY protocol handling of a UnixSocketListener
+ * 
+ * The parser is tested on raw headers of both protocol versions, including headers that are
+ * cut short and headers a proxy would never send. The listener itself is tested over a real
+ * socket file, with a route that answers with the client address from the header.
+ */
+class UnixSocketListenerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parsesV1Tcp4();
+    void parsesV1Tcp6();
+    void parsesV1Unknown();
+    void waitsForCompleteV1Header();
+    void rejectsInvalidV1Header();
+    void parsesV2Ipv4();
+    void parsesV2Ipv6();
+    void parsesV2Local();
+    void waitsForCompleteV2Header();
+    void rejectsInvalidV2Header();
+    void servesClientAddressFromHeader();
+    void closesConnectionWithoutHeader();
+};
+
+namespace {
+constexpr int WaitMs = 5000;
+
+using Status = UnixSocketListener::ProxyHeaderStatus;
+
+struct Parsed
+{
+    Status status = Status::Invalid;
+    qsizetype consumed = -1;
+    QHostAddress source;
+};
+
+Parsed parse(const QByteArray &data)
+{
+    Parsed parsed;
+    parsed.status = UnixSocketListener::parseProxyHeader(data, &parsed.consumed, &parsed.source);
+    return parsed;
+}
+
+// A version 2 header: signature, version and command, address family and protocol, addresses
+QByteArray proxyV2(quint8 versionCommand, quint8 familyProtocol, const QByteArray &addresses)
+{
+    QByteArray header("\r\n\r\n\0\r\nQUIT\n", 12);
+    header.append(static_cast<char>(versionCommand));
+    header.append(static_cast<char>(familyProtocol));
+    header.append(static_cast<char>(addresses.size() >> 8));
+    header.append(static_cast<char>(addresses.size() & 0xFF));
+    return header + addresses;
+}
+
+// Source 192.0.2.1:56324, destination 192.0.2.2:443
+const QByteArray Ipv4Addresses("\xc0\x00\x02\x01\xc0\x00\x02\x02\xdc\x04\x01\xbb", 12);
+
+const QByteArray Request = "GET /whoami HTTP/1.1\r\nHost: localhost\r\n\r\n";
+}
+
+void UnixSocketListenerTest::parsesV1Tcp4()
+{
+    const QByteArray header = "PROXY TCP4 192.0.2.1 192.0.2.2 56324 443\r\n";
+    
+    const Parsed parsed = parse(header + Request);
+    
+    QCOMPARE(parsed.status, Status::Parsed);
+    QCOMPARE(parsed.consumed, header.size());
+    QCOMPARE(parsed.source, QHostAddress("192.0.2.1"));
+}
+
+void UnixSocketListenerTest::parsesV1Tcp6()
+{
+    const QByteArray header = "PROXY TCP6 2001:db8::1 2001:db8::2 56324 443\r\n";
+    
+    const Parsed parsed = parse(header + Request);
+    
+    QCOMPARE(parsed.status, Status::Parsed);
+    QCOMPARE(parsed.consumed, header.size());
+    QCOMPARE(parsed.source, QHostAddress("2001:db8::1"));
+}
+
+void UnixSocketListenerTest::parsesV1Unknown()
+{
+    // Sent for connections the proxy cannot describe; the rest of the line is ignored
+    for (const QByteArray &header : {QByteArray("PROXY UNKNOWN\r\n"),
+                                     QByteArray("PROXY UNKNOWN ffff:f::1 ffff:f::2 1 2\r\n")}) {
+        const Parsed parsed = parse(header + Request);
+        QCOMPARE(parsed.status, Status::Parsed);
+        QCOMPARE(parsed.consumed, header.size());
+        QVERIFY(parsed.source.isNull());
+    }
+}
+
+void UnixSocketListenerTest::waitsForCompleteV1Header()
+{
+    QCOMPARE(parse(QByteArray()).status, Status::Incomplete);
+    QCOMPARE(parse("PRO").status, Status::Incomplete);
+    QCOMPARE(parse("PROXY TCP4 192.0.2.1 192.0.2.2 56324 443").status, Status::Incomplete);
+    QCOMPARE(parse("PROXY TCP4 192.0.2.1 192.0.2.2 56324 443\r").status, Status::Incomplete);
+}
+
+void UnixSocketListenerTest::rejectsInvalidV1Header()
+{
+    const QByteArray headers[] = {
+        Request,
+        "PROXY TCP5 192.0.2.1 192.0.2.2 56324 443\r\n",
+        "PROXY TCP4 2001:db8::1 2001:db8::2 56324 443\r\n",
+        "PROXY TCP6 192.0.2.1 192.0.2.2 56324 443\r\n",
+        "PROXY TCP4 192.0.2.1 192.0.2.2 56324\r\n",
+        "PROXY TCP4 not-an-address 192.0.2.2 56324 443\r\n",
+        "PROXY\r\n",
+        // No CRLF within the longest header a proxy may send
+        "PROXY TCP4 " + QByteArray(200, '1')
+    };
+    
+    for (const QByteArray &header : headers) {
+        QVERIFY2(parse(header).status == Status::Invalid, header.left(60).constData());
+    }
+}
+
+void UnixSocketListenerTest::parsesV2Ipv4()
+{
+    const QByteArray header = proxyV2(0x21, 0x11, Ipv4Addresses);
+    
+    const Parsed parsed = parse(header + Request);
+    
+    QCOMPARE(parsed.status, Status::Parsed);
+    QCOMPARE(parsed.consumed, qsizetype(16 + 12));
+    QCOMPARE(parsed.source, QHostAddress("192.0.2.1"));
+    
+    // Type-length-value extensions after the addresses are skipped with the header
+    const QByteArray tlv("\x04\x00\x02\x12\x34", 5);
+    const Parsed extended = parse(proxyV2(0x21, 0x11, Ipv4Addresses + tlv) + Request);
+    QCOMPARE(extended.status, Status::Parsed);
+    QCOMPARE(extended.consumed, 16 + 12 + tlv.size());
+    QCOMPARE(extended.source, QHostAddress("192.0.2.1"));
+}
+
+void UnixSocketListenerTest::parsesV2Ipv6()
+{
+    QByteArray addresses;
+    addresses += QByteArray("\x20\x01\x0d\xb8", 4) + QByteArray(11, '\0') + '\x01';  // 2001:db8::1
+    addresses += QByteArray("\x20\x01\x0d\xb8", 4) + QByteArray(11, '\0') + '\x02';  // 2001:db8::2
+    addresses += QByteArray("\xdc\x04\x01\xbb", 4);
+    
+    const Parsed parsed = parse(proxyV2(0x21, 0x21, addresses) + Request);
+    
+    QCOMPARE(parsed.status, Status::Parsed);
+    QCOMPARE(parsed.consumed, qsizetype(16 + 36));
+    QCOMPARE(parsed.source, QHostAddress("2001:db8::1"));
+}
+
+void UnixSocketListenerTest::parsesV2Local()
+{
+    // Health checks from the proxy itself carry no client address, whatever follows
+    for (const QByteArray &header : {proxyV2(0x20, 0x00, QByteArray()), proxyV2(0x20, 0x11, Ipv4Addresses)}) {
+        const Parsed parsed = parse(header + Request);
+        QCOMPARE(parsed.status, Status::Parsed);
+        QCOMPARE(parsed.consumed, header.size());
+        QVERIFY(parsed.source.isNull());
+    }
+}
+
+void UnixSocketListenerTest::waitsForCompleteV2Header()
+{
+    const QByteArray header = proxyV2(0x21, 0x11, Ipv4Addresses);
+    
+    QCOMPARE(parse(header.left(8)).status, Status::Incomplete);
+    QCOMPARE(parse(header.left(15)).status, Status::Incomplete);
+    QCOMPARE(parse(header.left(20)).status, Status::Incomplete);
+    QCOMPARE(parse(header).status, Status::Parsed);
+}
+
+void UnixSocketListenerTest::rejectsInvalidV2Header()
+{
+    const QByteArray headers[] = {
+        proxyV2(0x11, 0x11, Ipv4Addresses),          // Version 1 in a version 2 header
+        proxyV2(0x22, 0x11, Ipv4Addresses),          // Unknown command
+        proxyV2(0x21, 0x11, Ipv4Addresses.left(8)),  // Too short for IPv4 addresses
+        proxyV2(0x21, 0x21, Ipv4Addresses)           // Too short for IPv6 addresses
+    };
+    
+    for (const QByteArray &header : headers) {
+        QCOMPARE(parse(header + Request).status, Status::Invalid);
+    }
+}
+
+void UnixSocketListenerTest::servesClientAddressFromHeader()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    
+    UnixSocketListener::Settings settings;
+    settings.proxyProtocol = true;
+    auto *listener = new UnixSocketListener(settings);
+    QVERIFY(listener->listenAt(dir.filePath("api.sock"), 0600));
+    
+    // The server takes ownership of the listener
+    QHttpServer server;
+    server.route("/whoami", []() {
+        return UnixSocketListener::currentClientAddress().toString();
+    });
+    server.bind(listener);
+    
+    // The header arrives in two parts, together with the request
+    QLocalSocket client;
+    client.connectToServer(dir.filePath("api.sock"));
+    QVERIFY(client.waitForConnected(WaitMs));
+    client.write("PROXY TCP4 203.0.113.7 ");
+    client.flush();
+    QTest::qWait(50);
+    client.write("192.0.2.2 56324 443\r\n" + Request);
+    
+    QByteArray received;
+    QVERIFY(QTest::qWaitFor([&]() {
+        received += client.readAll();
+        return received.endsWith("203.0.113.7");
+    }, WaitMs));
+    QVERIFY(received.startsWith("HTTP/1.1 200"));
+    QCOMPARE(listener->proxyHeaderErrorCount(), quint64(0));
+}
+
+void UnixSocketListenerTest::closesConnectionWithoutHeader()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    
+    UnixSocketListener::Settings settings;
+    settings.proxyProtocol = true;
+    auto *listener = new UnixSocketListener(settings);
+    QVERIFY(listener->listenAt(dir.filePath("api.sock"), 0600));
+    
+    QHttpServer server;
+    server.route("/whoami", []() {
+        return QString("reached");
+    });
+    server.bind(listener);
+    
+    QLocalSocket client;
+    client.connectToServer(dir.filePath("api.sock"));
+    QVERIFY(client.waitForConnected(WaitMs));
+    client.write(Request);
+    
+    QByteArray received;
+    QVERIFY(QTest::qWaitFor([&]() {
+        received += client.readAll();
+        return client.state() == QLocalSocket::UnconnectedState;
+    }, WaitMs));
+    QVERIFY(received.isEmpty());
+    QCOMPARE(listener->proxyHeaderErrorCount(), quint64(1));
+}
+
+QTEST_MAIN(UnixSocketListenerTest)
+#include "unixsocketlistenertest.moc"
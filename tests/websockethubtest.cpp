@@ -0,0 +1,522 @@
+#include <QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <optional>
+#include "websockethub.h"
+
+/**
+ * @brief The WebSocketHubTest class talks RFC 6455 to a WebSocketHub over a real connection
+ * 
+ * The client writes its frames byte by byte, so that the tests can send what a well-behaved
+ * WebSocket library never would: unmasked frames, reserved bits, fragmented control frames
+ * and lengths beyond the hub's message limit.
+ */
+class WebSocketHubTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void encodesFrameLengths();
+    void acceptsUpgrade();
+    void rejectsInvalidUpgrade();
+    void rejectsByAdmission();
+    void limitsConnectionsPerIp();
+    void subscribesAndReceivesPublished();
+    void reassemblesFragmentedMessage();
+    void answersPing();
+    void echoesCloseCode();
+    void rejectsUnmaskedFrame();
+    void rejectsReservedBits();
+    void rejectsFragmentedControlFrame();
+    void rejectsContinuationWithoutMessage();
+    void rejectsOversizedMessage();
+    void rejectsOversizedFragments();
+    void rejectsBinaryMessage();
+    void dropsForSlowConsumer();
+    void disconnectsSlowConsumer();
+};
+
+namespace {
+constexpr int WaitMs = 5000;
+
+// The sample handshake of RFC 6455, section 1.3
+const QByteArray UpgradeHeaders = "Upgrade: websocket\r\n"
+                                  "Connection: Upgrade\r\n"
+                                  "Sec-WebSocket-Version: 13\r\n"
+                                  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n";
+const QByteArray SampleAccept = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=";
+
+// First frame byte: FIN plus opcode
+constexpr quint8 Fin = 0x80;
+constexpr quint8 Continuation = 0x0;
+constexpr quint8 Text = 0x1;
+constexpr quint8 Binary = 0x2;
+constexpr quint8 Close = 0x8;
+constexpr quint8 Ping = 0x9;
+constexpr quint8 Pong = 0xA;
+
+// The server under test: a hub on its own listener
+class HubServer
+{
+public:
+    explicit HubServer(const WebSocketHub::Settings &settings = WebSocketHub::Settings())
+    {
+        auto *listener = new QTcpServer();
+        listener->listen(QHostAddress::LocalHost);
+        m_port = listener->serverPort();
+        
+        hub.setSettings(settings);
+        hub.attach(listener);
+    }
+    
+    quint16 port() const
+    {
+        return m_port;
+    }
+    
+    WebSocketHub hub;
+
+private:
+    quint16 m_port = 0;
+};
+
+struct Frame
+{
+    bool fin = false;
+    quint8 opcode = 0;
+    QByteArray payload;
+    
+    quint16 closeCode() const
+    {
+        return payload.size() >= 2
+            ? static_cast<quint16>((static_cast<quint8>(payload.at(0)) << 8) | static_cast<quint8>(payload.at(1)))
+            : 0;
+    }
+    
+    QJsonObject json() const
+    {
+        return QJsonDocument::fromJson(payload).object();
+    }
+};
+
+// Encodes a client frame; the length is taken from the payload unless given
+QByteArray clientFrame(quint8 head, const QByteArray &payload, bool masked = true, quint64 length = 0)
+{
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    const quint64 size = length > 0 ? length : static_cast<quint64>(payload.size());
+    const char maskBit = masked ? static_cast<char>(0x80) : 0;
+    
+    QByteArray frame;
+    frame.append(static_cast<char>(head));
+    if (size < 126) {
+        frame.append(static_cast<char>(maskBit | static_cast<char>(size)));
+    } else if (size <= 0xFFFF) {
+        frame.append(static_cast<char>(maskBit | 126));
+        frame.append(static_cast<char>(size >> 8));
+        frame.append(static_cast<char>(size & 0xFF));
+    } else {
+        frame.append(static_cast<char>(maskBit | 127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.append(static_cast<char>((size >> shift) & 0xFF));
+        }
+    }
+    
+    if (!masked) {
+        return frame + payload;
+    }
+    frame.append(mask, 4);
+    for (qsizetype i = 0; i < payload.size(); ++i) {
+        frame.append(static_cast<char>(payload.at(i) ^ mask[i % 4]));
+    }
+    return frame;
+}
+
+QByteArray message(const char *action, const QString &topic)
+{
+    return QJsonDocument(QJsonObject{{"action", action}, {"topic", topic}}).toJson(QJsonDocument::Compact);
+}
+
+class Client
+{
+public:
+    // Sends an upgrade request and returns the response head, without the blank line
+    QByteArray connect(quint16 port, const QByteArray &target = "/ws", const QByteArray &headers = UpgradeHeaders)
+    {
+        m_socket.connectToHost(QHostAddress::LocalHost, port);
+        if (!m_socket.waitForConnected(WaitMs)) {
+            return QByteArray();
+        }
+        m_socket.write("GET " + target + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n");
+        
+        QTest::qWaitFor([this]() {
+            m_buffer += m_socket.readAll();
+            return m_buffer.contains("\r\n\r\n") || m_socket.state() == QAbstractSocket::UnconnectedState;
+        }, WaitMs);
+        
+        const qsizetype end = m_buffer.indexOf("\r\n\r\n");
+        if (end < 0) {
+            return QByteArray();
+        }
+        const QByteArray head = m_buffer.left(end);
+        m_buffer.remove(0, end + 4);
+        return head;
+    }
+    
+    void send(const QByteArray &bytes)
+    {
+        m_socket.write(bytes);
+    }
+    
+    std::optional<Frame> readFrame()
+    {
+        std::optional<Frame> frame;
+        QTest::qWaitFor([&]() {
+            m_buffer += m_socket.readAll();
+            frame = takeFrame();
+            return frame.has_value() || m_socket.state() == QAbstractSocket::UnconnectedState;
+        }, WaitMs);
+        return frame;
+    }
+    
+    bool waitForDisconnected()
+    {
+        return QTest::qWaitFor([this]() {
+            m_socket.readAll();
+            return m_socket.state() == QAbstractSocket::UnconnectedState;
+        }, WaitMs);
+    }
+
+private:
+    QTcpSocket m_socket;
+    QByteArray m_buffer;
+    
+    // Server frames are never masked
+    std::optional<Frame> takeFrame()
+    {
+        if (m_buffer.size() < 2) {
+            return std::nullopt;
+        }
+        
+        qint64 length = static_cast<quint8>(m_buffer.at(1)) & 0x7F;
+        qsizetype offset = 2;
+        if (length == 126) {
+            if (m_buffer.size() < 4) {
+                return std::nullopt;
+            }
+            length = (static_cast<quint8>(m_buffer.at(2)) << 8) | static_cast<quint8>(m_buffer.at(3));
+            offset = 4;
+        } else if (length == 127) {
+            if (m_buffer.size() < 10) {
+                return std::nullopt;
+            }
+            length = 0;
+            for (qsizetype i = 2; i < 10; ++i) {
+                length = (length << 8) | static_cast<quint8>(m_buffer.at(i));
+            }
+            offset = 10;
+        }
+        if (m_buffer.size() < offset + length) {
+            return std::nullopt;
+        }
+        
+        Frame frame;
+        frame.fin = static_cast<quint8>(m_buffer.at(0)) & 0x80;
+        frame.opcode = static_cast<quint8>(m_buffer.at(0)) & 0x0F;
+        frame.payload = m_buffer.mid(offset, length);
+        m_buffer.remove(0, offset + length);
+        return frame;
+    }
+};
+
+// Completes the handshake, and the subscription if a topic is given
+bool openClient(Client &client, quint16 port, const QString &topic = QString())
+{
+    const QByteArray target = topic.isEmpty() ? QByteArray("/ws") : "/ws?topics=" + topic.toUtf8();
+    if (!client.connect(port, target).startsWith("HTTP/1.1 101")) {
+        return false;
+    }
+    if (topic.isEmpty()) {
+        return true;
+    }
+    const std::optional<Frame> subscribed = client.readFrame();
+    return subscribed && subscribed->json().value("subscribed").toString() == topic;
+}
+
+// Sends a frame the hub must refuse and returns the close code it answers with
+quint16 closeCodeFor(const QByteArray &frame, const WebSocketHub::Settings &settings = WebSocketHub::Settings())
+{
+    HubServer server(settings);
+    Client client;
+    if (!openClient(client, server.port())) {
+        return 0;
+    }
+    
+    // Frames answering the ones before the offending frame are skipped
+    client.send(frame);
+    std::optional<Frame> reply = client.readFrame();
+    while (reply && reply->opcode != Close) {
+        reply = client.readFrame();
+    }
+    if (!reply || !client.waitForDisconnected()) {
+        return 0;
+    }
+    return reply->closeCode();
+}
+}
+
+void WebSocketHubTest::encodesFrameLengths()
+{
+    const QByteArray small = WebSocketHub::encodeFrame(Text, QByteArray(125, 'a'));
+    QCOMPARE(small.size(), 2 + 125);
+    QCOMPARE(static_cast<quint8>(small.at(0)), quint8(Fin | Text));
+    QCOMPARE(static_cast<quint8>(small.at(1)), quint8(125));
+    
+    const QByteArray medium = WebSocketHub::encodeFrame(Binary, QByteArray(126, 'b'));
+    QCOMPARE(medium.size(), 4 + 126);
+    QCOMPARE(medium.mid(1, 3), QByteArray("\x7e\x00\x7e", 3));
+    
+    const QByteArray large = WebSocketHub::encodeFrame(Binary, QByteArray(65536, 'c'));
+    QCOMPARE(large.size(), 10 + 65536);
+    QCOMPARE(large.mid(1, 9), QByteArray("\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 9));
+}
+
+void WebSocketHubTest::acceptsUpgrade()
+{
+    HubServer server;
+    Client client;
+    
+    const QByteArray head = client.connect(server.port());
+    
+    QVERIFY(head.startsWith("HTTP/1.1 101"));
+    QVERIFY(head.contains("Sec-WebSocket-Accept: " + SampleAccept));
+    QCOMPARE(server.hub.connectionCount(), 1);
+}
+
+void WebSocketHubTest::rejectsInvalidUpgrade()
+{
+    WebSocketHub::Settings settings;
+    settings.allowedOrigins = QStringList{"https://app.example.com"};
+    HubServer server(settings);
+    
+    Client plain;
+    const QByteArray plainHead = plain.connect(server.port(), "/ws", QByteArray());
+    QVERIFY(plainHead.startsWith("HTTP/1.1 426"));
+    QVERIFY(plainHead.contains("Sec-WebSocket-Version: 13"));
+    
+    Client oldVersion;
+    QByteArray headers = UpgradeHeaders;
+    headers.replace("Version: 13", "Version: 8");
+    QVERIFY(oldVersion.connect(server.port(), "/ws", headers).startsWith("HTTP/1.1 426"));
+    
+    Client badKey;
+    headers = UpgradeHeaders;
+    headers.replace("dGhlIHNhbXBsZSBub25jZQ==", "c2hvcnQ=");
+    QVERIFY(badKey.connect(server.port(), "/ws", headers).startsWith("HTTP/1.1 400"));
+    
+    Client wrongPath;
+    QVERIFY(wrongPath.connect(server.port(), "/other").startsWith("HTTP/1.1 404"));
+    
+    Client foreignOrigin;
+    QVERIFY(foreignOrigin.connect(server.port(), "/ws", UpgradeHeaders + "Origin: https://evil.example.net\r\n")
+                .startsWith("HTTP/1.1 403"));
+    
+    Client allowedOrigin;
+    QVERIFY(allowedOrigin.connect(server.port(), "/ws", UpgradeHeaders + "Origin: https://app.example.com\r\n")
+                .startsWith("HTTP/1.1 101"));
+}
+
+void WebSocketHubTest::rejectsByAdmission()
+{
+    HubServer server;
+    server.hub.setAdmission([](const QString &, const QByteArray &authorization, const QHostAddress &)
+                                -> std::optional<WebSocketHub::Rejection> {
+        if (authorization == "Bearer good") {
+            return std::nullopt;
+        }
+        WebSocketHub::Rejection rejection;
+        rejection.statusCode = 401;
+        rejection.headers.append({"WWW-Authenticate", "Bearer"});
+        return rejection;
+    });
+    
+    Client anonymous;
+    const QByteArray head = anonymous.connect(server.port());
+    QVERIFY(head.startsWith("HTTP/1.1 401"));
+    QVERIFY(head.contains("WWW-Authenticate: Bearer"));
+    
+    Client authorized;
+    QVERIFY(authorized.connect(server.port(), "/ws", UpgradeHeaders + "Authorization: Bearer good\r\n").startsWith("HTTP/1.1 101"));
+}
+
+void WebSocketHubTest::limitsConnectionsPerIp()
+{
+    WebSocketHub::Settings settings;
+    settings.maxConnectionsPerIp = 1;
+    HubServer server(settings);
+    
+    Client first;
+    QVERIFY(openClient(first, server.port()));
+    
+    // The second connection is dropped without an answer
+    Client second;
+    QVERIFY(second.connect(server.port()).isEmpty());
+    QCOMPARE(server.hub.connectionCount(), 1);
+}
+
+void WebSocketHubTest::subscribesAndReceivesPublished()
+{
+    WebSocketHub::Settings settings;
+    settings.maxTopicsPerConnection = 2;
+    HubServer server(settings);
+    Client client;
+    QVERIFY(openClient(client, server.port(), "news"));
+    
+    QCOMPARE(server.hub.publish("news", "hello"), 1);
+    std::optional<Frame> frame = client.readFrame();
+    QVERIFY(frame);
+    QVERIFY(frame->fin);
+    QCOMPARE(frame->opcode, Text);
+    QCOMPARE(frame->payload, QByteArray("hello"));
+    
+    client.send(clientFrame(Fin | Text, message("subscribe", "sports")));
+    frame = client.readFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame->json().value("subscribed").toString(), QString("sports"));
+    QCOMPARE(server.hub.topicCount(), 2);
+    
+    // Past the subscription limit
+    client.send(clientFrame(Fin | Text, message("subscribe", "weather")));
+    frame = client.readFrame();
+    QVERIFY(frame);
+    QVERIFY(frame->json().contains("error"));
+    
+    client.send(clientFrame(Fin | Text, message("unsubscribe", "news")));
+    frame = client.readFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame->json().value("unsubscribed").toString(), QString("news"));
+    QCOMPARE(server.hub.publish("news", "gone"), 0);
+}
+
+void WebSocketHubTest::reassemblesFragmentedMessage()
+{
+    HubServer server;
+    Client client;
+    QVERIFY(openClient(client, server.port()));
+    
+    // A ping may arrive between the fragments of a message
+    const QByteArray subscribe = message("subscribe", "news");
+    client.send(clientFrame(Text, subscribe.left(10)));
+    client.send(clientFrame(Fin | Ping, "between"));
+    client.send(clientFrame(Fin | Continuation, subscribe.mid(10)));
+    
+    std::optional<Frame> frame = client.readFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame->opcode, Pong);
+    frame = client.readFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame->json().value("subscribed").toString(), QString("news"));
+}
+
+void WebSocketHubTest::answersPing()
+{
+    HubServer server;
+    Client client;
+    QVERIFY(openClient(client, server.port()));
+    
+    client.send(clientFrame(Fin | Ping, "payload"));
+    
+    const std::optional<Frame> frame = client.readFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame->opcode, Pong);
+    QCOMPARE(frame->payload, QByteArray("payload"));
+}
+
+void WebSocketHubTest::echoesCloseCode()
+{
+    const QByteArray goingAway("\x03\xe9", 2);
+    QCOMPARE(closeCodeFor(clientFrame(Fin | Close, goingAway)), quint16(1001));
+}
+
+void WebSocketHubTest::rejectsUnmaskedFrame()
+{
+    QCOMPARE(closeCodeFor(clientFrame(Fin | Text, message("subscribe", "news"), false)), quint16(1002));
+}
+
+void WebSocketHubTest::rejectsReservedBits()
+{
+    QCOMPARE(closeCodeFor(clientFrame(Fin | 0x40 | Text, message("subscribe", "news"))), quint16(1002));
+}
+
+void WebSocketHubTest::rejectsFragmentedControlFrame()
+{
+    QCOMPARE(closeCodeFor(clientFrame(Ping, "partial")), quint16(1002));
+    QCOMPARE(closeCodeFor(clientFrame(Fin | Ping, QByteArray(126, 'p'))), quint16(1002));
+}
+
+void WebSocketHubTest::rejectsContinuationWithoutMessage()
+{
+    QCOMPARE(closeCodeFor(clientFrame(Fin | Continuation, "orphan")), quint16(1002));
+    QCOMPARE(closeCodeFor(clientFrame(Text, "first") + clientFrame(Fin | Text, "second")), quint16(1002));
+}
+
+void WebSocketHubTest::rejectsOversizedMessage()
+{
+    WebSocketHub::Settings settings;
+    settings.maxMessageBytes = 64;
+    
+    QCOMPARE(closeCodeFor(clientFrame(Fin | Text, message("subscribe", QString(64, 'a'))), settings), quint16(1009));
+    
+    // The announced length is enough; the hub does not wait for a gigabyte to arrive
+    QCOMPARE(closeCodeFor(clientFrame(Fin | Text, QByteArray(), true, quint64(1) << 30), settings), quint16(1009));
+}
+
+void WebSocketHubTest::rejectsOversizedFragments()
+{
+    WebSocketHub::Settings settings;
+    settings.maxMessageBytes = 64;
+    
+    const QByteArray fragments = clientFrame(Text, QByteArray(40, 'a')) + clientFrame(Fin | Continuation, QByteArray(40, 'a'));
+    QCOMPARE(closeCodeFor(fragments, settings), quint16(1009));
+}
+
+void WebSocketHubTest::rejectsBinaryMessage()
+{
+    QCOMPARE(closeCodeFor(clientFrame(Fin | Binary, "\x01\x02")), quint16(1003));
+}
+
+void WebSocketHubTest::dropsForSlowConsumer()
+{
+    WebSocketHub::Settings settings;
+    settings.maxQueueBytes = 256;
+    HubServer server(settings);
+    Client client;
+    QVERIFY(openClient(client, server.port(), "news"));
+    
+    // A message that alone exceeds the queue limit can never be queued
+    QCOMPARE(server.hub.publish("news", QByteArray(300, 'x')), 0);
+    QCOMPARE(server.hub.droppedCount(), quint64(1));
+    
+    QCOMPARE(server.hub.publish("news", "small"), 1);
+    const std::optional<Frame> frame = client.readFrame();
+    QVERIFY(frame);
+    QCOMPARE(frame->payload, QByteArray("small"));
+}
+
+void WebSocketHubTest::disconnectsSlowConsumer()
+{
+    WebSocketHub::Settings settings;
+    settings.maxQueueBytes = 256;
+    settings.slowConsumerPolicy = WebSocketHub::SlowConsumerPolicy::Disconnect;
+    HubServer server(settings);
+    Client client;
+    QVERIFY(openClient(client, server.port(), "news"));
+    
+    QCOMPARE(server.hub.publish("news", QByteArray(300, 'x')), 0);
+    QCOMPARE(server.hub.slowDisconnectCount(), quint64(1));
+    QVERIFY(client.waitForDisconnected());
+}
+
+QTEST_MAIN(WebSocketHubTest)
+#include "websockethubtest.moc"